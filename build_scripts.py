@@ -224,6 +224,16 @@ fluxScript flux_allocate_script(enum fluxScriptID id)
 ;
 #endif
 
+void flux_free_script(fluxScript script)
+#ifdef FLUX_SCRIPTS_IMPLEMENTATION
+{
+    flux_scene_free(script->raw);
+    flux_scene_free(script);
+}
+#else
+;
+#endif
+
 """
 
 processor = ScriptProcessor()
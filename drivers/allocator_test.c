@@ -0,0 +1,172 @@
+#include "check.h"
+#include "hqtools/hqtools.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define N_THREADS 4
+#define N_THREAD_ALLOCATIONS 20000
+#define N_ALLOCATIONS 200000
+
+static hqAllocator test_allocator;
+
+/* a size that depends on where in the sequence the allocation is */
+static size_t size_of(int i) { return 8 + (size_t)(i * 37 % 200); }
+
+static void fill(unsigned char* ptr, size_t sz, unsigned char value) {
+    memset(ptr, value, sz);
+}
+
+static bool filled(const unsigned char* ptr, size_t sz, unsigned char value) {
+    for (size_t i = 0; i < sz; i++) {
+        if (ptr[i] != value)
+            return false;
+    }
+    return true;
+}
+
+/* counts and sizes follow allocs, reallocs and frees */
+static void test_counts(void) {
+    hqAllocator allocator;
+    hq_allocator_init(&allocator, "allocator_test_counts");
+    CHECK(hq_allocator_get_n_alive(allocator) == 0);
+    CHECK(hq_allocator_get_alive_bytes(allocator) == 0);
+
+    unsigned char* ptrs[100];
+    size_t bytes = 0;
+    for (int i = 0; i < 100; i++) {
+        ptrs[i] = HQ_ALLOC(allocator, size_of(i));
+        fill(ptrs[i], size_of(i), (unsigned char)i);
+        bytes += size_of(i);
+    }
+    CHECK(hq_allocator_get_n_alive(allocator) == 100);
+    CHECK(hq_allocator_get_alive_bytes(allocator) == bytes);
+
+    ptrs[7] = HQ_REALLOC(allocator, ptrs[7], 4096);
+    bytes += 4096 - size_of(7);
+    CHECK(filled(ptrs[7], size_of(7), 7));
+    CHECK(hq_allocator_get_n_alive(allocator) == 100);
+    CHECK(hq_allocator_get_alive_bytes(allocator) == bytes);
+
+    ptrs[7] = HQ_REALLOC(allocator, ptrs[7], 3);
+    bytes -= 4096 - 3;
+    CHECK(filled(ptrs[7], 3, 7));
+    CHECK(hq_allocator_get_alive_bytes(allocator) == bytes);
+
+    /* frees out of allocation order, so probe runs are broken up */
+    for (int i = 0; i < 100; i += 2) {
+        bytes -= i == 7 ? 3 : size_of(i);
+        HQ_FREE(allocator, ptrs[i]);
+    }
+    CHECK(hq_allocator_get_n_alive(allocator) == 50);
+    CHECK(hq_allocator_get_alive_bytes(allocator) == bytes);
+
+    bool intact = true;
+    for (int i = 1; i < 100; i += 2)
+        intact &= filled(ptrs[i], i == 7 ? 3 : size_of(i), (unsigned char)i);
+    CHECK(intact);
+
+    /* the freed slots are reused, and every pointer is still found */
+    for (int i = 0; i < 100; i += 2) {
+        ptrs[i] = HQ_ALLOC(allocator, size_of(i));
+        fill(ptrs[i], size_of(i), (unsigned char)i);
+        bytes += size_of(i);
+    }
+    CHECK(hq_allocator_get_n_alive(allocator) == 100);
+    CHECK(hq_allocator_get_alive_bytes(allocator) == bytes);
+    for (int i = 99; i >= 0; i--)
+        HQ_FREE(allocator, ptrs[i]);
+    CHECK(hq_allocator_get_n_alive(allocator) == 0);
+    CHECK(hq_allocator_get_alive_bytes(allocator) == 0);
+
+    hq_allocator_delete(allocator);
+}
+
+/* each thread churns its own pointers through the shared allocator */
+static void* churn(void* arg) {
+    int id = (int)(intptr_t)arg;
+    unsigned char** ptrs =
+        malloc(sizeof(unsigned char*) * N_THREAD_ALLOCATIONS);
+    bool* ok = malloc(sizeof(bool));
+    *ok = true;
+    for (int i = 0; i < N_THREAD_ALLOCATIONS; i++) {
+        ptrs[i] = HQ_ALLOC(test_allocator, size_of(i));
+        fill(ptrs[i], size_of(i), (unsigned char)id);
+        if (i % 3 == 0) {
+            ptrs[i] = HQ_REALLOC(test_allocator, ptrs[i], 2 * size_of(i));
+            *ok &= filled(ptrs[i], size_of(i), (unsigned char)id);
+            fill(ptrs[i], 2 * size_of(i), (unsigned char)id);
+        }
+        if (i % 2 == 1) {
+            HQ_FREE(test_allocator, ptrs[i - 1]);
+            ptrs[i - 1] = NULL;
+        }
+    }
+    for (int i = 0; i < N_THREAD_ALLOCATIONS; i++) {
+        if (!ptrs[i])
+            continue;
+        size_t sz = i % 3 == 0 ? 2 * size_of(i) : size_of(i);
+        *ok &= filled(ptrs[i], sz, (unsigned char)id);
+        HQ_FREE(test_allocator, ptrs[i]);
+    }
+    free(ptrs);
+    return ok;
+}
+
+static void test_threads(void) {
+    hq_allocator_init(&test_allocator, "allocator_test_threads");
+    pthread_t threads[N_THREADS];
+    for (int i = 0; i < N_THREADS; i++)
+        pthread_create(&threads[i], NULL, churn, (void*)(intptr_t)(i + 1));
+    bool ok = true;
+    for (int i = 0; i < N_THREADS; i++) {
+        void* result;
+        pthread_join(threads[i], &result);
+        ok &= *(bool*)result;
+        free(result);
+    }
+    CHECK(ok);
+    CHECK(hq_allocator_get_n_alive(test_allocator) == 0);
+    CHECK(hq_allocator_get_alive_bytes(test_allocator) == 0);
+    hq_allocator_delete(test_allocator);
+}
+
+/* frees in an order unrelated to allocation order stay cheap */
+static void test_many_frees(void) {
+    hqAllocator allocator;
+    hq_allocator_init(&allocator, "allocator_test_many");
+    void** ptrs = malloc(sizeof(void*) * N_ALLOCATIONS);
+    double start = now();
+    for (int i = 0; i < N_ALLOCATIONS; i++)
+        ptrs[i] = HQ_ALLOC(allocator, 16);
+    srand(7);
+    for (int i = N_ALLOCATIONS - 1; i > 0; i--) {
+        int j = rand() % (i + 1);
+        void* tmp = ptrs[i];
+        ptrs[i] = ptrs[j];
+        ptrs[j] = tmp;
+    }
+    for (int i = 0; i < N_ALLOCATIONS; i++)
+        HQ_FREE(allocator, ptrs[i]);
+    double elapsed = now() - start;
+    printf("%d allocations and shuffled frees: %.1f ms\n", N_ALLOCATIONS,
+           elapsed * 1000.0);
+    CHECK(hq_allocator_get_n_alive(allocator) == 0);
+    /* a scan per free takes minutes here */
+    CHECK(elapsed < 2.0);
+    free(ptrs);
+    hq_allocator_delete(allocator);
+}
+
+int main() {
+    hq_allocator_init_global();
+    SetTraceLogLevel(LOG_WARNING);
+    test_counts();
+    test_threads();
+    test_many_frees();
+    int status = check_report();
+    hq_allocator_delete_global();
+    return status;
+}
@@ -0,0 +1,246 @@
+#include "asset_registry.h"
+#include "asset_stream.h"
+#include "check.h"
+#include "hqtools/hqtools.h"
+#include "mesh_cache.h"
+#include "raylib.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* n textured quads, one mesh each */
+static void write_obj(const char* path, int n) {
+    FILE* f = fopen(path, "w");
+    fprintf(f, "mtllib stream_test.mtl\n");
+    fprintf(f, "vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\nvn 0 1 0\n");
+    for (int i = 0; i < n; i++) {
+        fprintf(f, "o quad%d\n", i);
+        fprintf(f, "v %d 0 0\nv %d 0 0\nv %d 0 1\nv %d 0 1\n", i, i + 1, i + 1,
+                i);
+        fprintf(f, "usemtl textured\n");
+        fprintf(f, "f %d/1/1 %d/2/1 %d/3/1 %d/4/1\n", 4 * i + 1, 4 * i + 2,
+                4 * i + 3, 4 * i + 4);
+    }
+    fclose(f);
+}
+
+/* one flat n by n grid of quads, enough triangles for levels of detail */
+static void write_grid(const char* path, int n) {
+    FILE* f = fopen(path, "w");
+    for (int z = 0; z <= n; z++) {
+        for (int x = 0; x <= n; x++) {
+            fprintf(f, "v %d 0 %d\n", x, z);
+        }
+    }
+    for (int z = 0; z < n; z++) {
+        for (int x = 0; x < n; x++) {
+            int v = z * (n + 1) + x + 1;
+            fprintf(f, "f %d %d %d %d\n", v, v + n + 1, v + n + 2, v + 1);
+        }
+    }
+    fclose(f);
+}
+
+static unsigned int diffuse_id(Model model) {
+    Material material = model.materials[model.meshMaterial[0]];
+    return material.maps[MATERIAL_MAP_DIFFUSE].texture.id;
+}
+
+/* pumps the stream like the game loop would, returns the number of frames */
+static int wait_for(renderModelRequest request) {
+    int frames = 0;
+    double start = GetTime();
+    while (!render_model_request_is_ready(request) &&
+           (GetTime() - start < 10.0)) {
+        render_update_asset_stream();
+        frames++;
+    }
+    return frames;
+}
+
+static void test_shared_request(void) {
+    renderAssetStats before = render_get_asset_stats();
+
+    /* two requests for one file share the load */
+    renderModelRequest a = render_request_model("build/stream_test_a.obj");
+    renderModelRequest b = render_request_model("build/stream_test_a.obj");
+    CHECK(!render_model_request_is_ready(a));
+    CHECK(render_get_stream_pending() == 1);
+    wait_for(a);
+    CHECK(render_model_request_is_ready(a));
+    CHECK(render_model_request_is_ready(b));
+    CHECK(render_get_stream_pending() == 0);
+
+    Model model_a = render_model_request_take(a);
+    Model model_b = render_model_request_take(b);
+    CHECK(model_a.meshCount == 3);
+    CHECK(model_a.meshes == model_b.meshes);
+    CHECK(model_a.meshes[0].vboId != NULL);
+    CHECK(model_a.meshes[2].vboId != NULL);
+    renderAssetStats stats = render_get_asset_stats();
+    CHECK(stats.n_models == before.n_models + 1);
+    CHECK(stats.n_textures == before.n_textures + 1);
+
+    /* the texture was decoded on a streaming thread, and is shared */
+    Texture2D texture = render_acquire_texture("build/stream_test.png");
+    CHECK(texture.id != 0);
+    CHECK(diffuse_id(model_a) == texture.id);
+    render_release_texture(texture);
+
+    /* streaming cooked the model */
+    FILE* cooked = fopen("build/stream_test_a.obj" RENDER_MESH_CACHE_EXTENSION,
+                         "rb");
+    CHECK(cooked != NULL);
+    if (cooked)
+        fclose(cooked);
+
+    /* loaded models are ready right away, as are generated ones */
+    renderModelRequest c = render_request_model("build/stream_test_a.obj");
+    CHECK(render_model_request_is_ready(c));
+    renderModelRequest cube = render_request_model("CUBE");
+    CHECK(render_model_request_is_ready(cube));
+    Model cube_model = render_model_request_take(cube);
+    CHECK(cube_model.meshes != NULL);
+    CHECK(render_get_stream_pending() == 0);
+
+    /* freeing a request whose model was not taken releases it */
+    render_model_request_free(c);
+    render_model_request_free(a);
+    render_model_request_free(b);
+    render_release_model(model_a);
+    CHECK(render_get_asset_stats().n_unused == stats.n_unused);
+    render_release_model(model_b);
+    CHECK(render_get_asset_stats().n_unused == stats.n_unused + 1);
+    render_model_request_free(cube);
+    render_release_model(cube_model);
+}
+
+static void test_budget(void) {
+    /* with no budget each frame uploads one texture or mesh */
+    render_set_stream_budget(0);
+    renderModelRequest request =
+        render_request_model("build/stream_test_b.obj");
+    int frames = wait_for(request);
+    CHECK(frames >= 4);
+    CHECK(render_get_stream_upload_time() >= 0);
+    Model model = render_model_request_take(request);
+    CHECK(model.meshCount == 3);
+    render_model_request_free(request);
+    render_release_model(model);
+    render_set_stream_budget(RENDER_STREAM_DEFAULT_BUDGET);
+    CHECK(render_get_stream_budget() == RENDER_STREAM_DEFAULT_BUDGET);
+}
+
+static void test_lods(void) {
+    /* streamed models are simplified by the streaming threads, and their
+     * levels are uploaded under the budget like the rest of the model */
+    render_set_stream_budget(0);
+    renderModelRequest request =
+        render_request_model("build/stream_test_grid.obj");
+    int frames = wait_for(request);
+    Model model = render_model_request_take(request);
+    CHECK(model.meshCount == 1);
+    const int* n_lods = NULL;
+    const Mesh* lods = render_model_file_get_lods(model, &n_lods);
+    CHECK(lods != NULL);
+    if (lods) {
+        CHECK(n_lods[0] > 1);
+        CHECK(frames >= n_lods[0]);
+        for (int l = 1; l < n_lods[0]; l++) {
+            CHECK(lods[l - 1].vboId != NULL);
+            CHECK(lods[l - 1].triangleCount < model.meshes[0].triangleCount);
+        }
+    }
+    render_model_request_free(request);
+    render_release_model(model);
+    render_set_stream_budget(RENDER_STREAM_DEFAULT_BUDGET);
+
+    /* models loaded on the main thread are left to the pipeline */
+    model = render_load_model_file("build/stream_test_grid.obj");
+    CHECK(render_model_file_get_lods(model, &n_lods) == NULL);
+    CHECK(n_lods == NULL);
+    render_unload_model_file(model);
+}
+
+static void test_cancel(void) {
+    render_clear_asset_cache();
+    renderAssetStats before = render_get_asset_stats();
+
+    /* dropped requests do not leave their model behind */
+    renderModelRequest request =
+        render_request_model("build/stream_test_c.obj");
+    render_model_request_free(request);
+    render_finish_asset_stream();
+    CHECK(render_get_stream_pending() == 0);
+    CHECK(render_get_asset_stats().n_models == before.n_models);
+
+    /* missing files come back without meshes */
+    request = render_request_model("build/stream_test_missing.obj");
+    render_finish_asset_stream();
+    CHECK(render_model_request_is_ready(request));
+    CHECK(render_model_request_take(request).meshes == NULL);
+    render_model_request_free(request);
+    CHECK(render_get_asset_stats().n_models == before.n_models);
+}
+
+static void test_close(void) {
+    /* closing drops loads in progress, their requests get no model */
+    renderModelRequest request =
+        render_request_model("build/stream_test_a.obj");
+    render_close_asset_stream();
+    CHECK(render_model_request_is_ready(request));
+    CHECK(render_model_request_take(request).meshes == NULL);
+    render_model_request_free(request);
+    CHECK(render_get_stream_pending() == 0);
+
+    /* and streaming starts again on the next request */
+    request = render_request_model("build/stream_test_a.obj");
+    wait_for(request);
+    Model model = render_model_request_take(request);
+    CHECK(model.meshCount == 3);
+    render_model_request_free(request);
+    render_release_model(model);
+}
+
+int main() {
+    hq_allocator_init_global();
+    SetConfigFlags(FLAG_WINDOW_HIDDEN);
+    InitWindow(64, 64, "asset_stream_test");
+    SetTraceLogLevel(LOG_WARNING);
+
+    Image image = GenImageChecked(16, 8, 2, 2, RED, BLUE);
+    ExportImage(image, "build/stream_test.png");
+    UnloadImage(image);
+    FILE* f = fopen("build/stream_test.mtl", "w");
+    fprintf(f, "newmtl textured\nKd 1 1 1\nmap_Kd stream_test.png\n");
+    fclose(f);
+    const char* objs[] = {"build/stream_test_a.obj", "build/stream_test_b.obj",
+                          "build/stream_test_c.obj"};
+    for (int i = 0; i < 3; i++) {
+        write_obj(objs[i], 3);
+        remove(TextFormat("%s%s", objs[i], RENDER_MESH_CACHE_EXTENSION));
+    }
+    write_grid("build/stream_test_grid.obj", 32);
+    remove("build/stream_test_grid.obj" RENDER_MESH_CACHE_EXTENSION);
+
+    test_shared_request();
+    test_budget();
+    test_lods();
+    test_cancel();
+    test_close();
+
+    render_close_asset_stream();
+    render_clear_asset_cache();
+    CloseWindow();
+    for (int i = 0; i < 3; i++) {
+        remove(objs[i]);
+        remove(TextFormat("%s%s", objs[i], RENDER_MESH_CACHE_EXTENSION));
+    }
+    remove("build/stream_test_grid.obj");
+    remove("build/stream_test_grid.obj" RENDER_MESH_CACHE_EXTENSION);
+    remove("build/stream_test.mtl");
+    remove("build/stream_test.png");
+    int status = check_report();
+    hq_allocator_delete_global();
+    return status;
+}
@@ -0,0 +1,152 @@
+#include "asset_registry.h"
+#include "check.h"
+#include "hqtools/hqtools.h"
+#include "mesh_cache.h"
+#include "raylib.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* one textured quad */
+static void write_obj(const char* path) {
+    FILE* f = fopen(path, "w");
+    fprintf(f, "mtllib asset_test.mtl\n");
+    fprintf(f, "v 0 0 0\nv 1 0 0\nv 1 0 1\nv 0 0 1\n");
+    fprintf(f, "vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\nvn 0 1 0\n");
+    fprintf(f, "usemtl textured\nf 1/1/1 2/2/1 3/3/1 4/4/1\n");
+    fclose(f);
+}
+
+static unsigned int diffuse_id(Model model) {
+    Material material = model.materials[model.meshMaterial[0]];
+    return material.maps[MATERIAL_MAP_DIFFUSE].texture.id;
+}
+
+static void test_textures(void) {
+    Image image = GenImageChecked(16, 8, 2, 2, RED, BLUE);
+    ExportImage(image, "build/asset_test.png");
+    UnloadImage(image);
+    renderAssetStats before = render_get_asset_stats();
+
+    /* paths to the same file share one texture */
+    Texture2D a = render_acquire_texture("build/asset_test.png");
+    Texture2D b = render_acquire_texture("build/../build/asset_test.png");
+    CHECK(a.id != 0);
+    CHECK(a.id == b.id);
+    renderAssetStats stats = render_get_asset_stats();
+    CHECK(stats.misses == before.misses + 1);
+    CHECK(stats.hits == before.hits + 1);
+    CHECK(stats.n_textures == before.n_textures + 1);
+    CHECK(stats.resident_bytes == before.resident_bytes + 16 * 8 * 4);
+
+    /* missing files are not kept */
+    CHECK(render_acquire_texture("build/asset_test_missing.png").id == 0);
+    CHECK(render_get_asset_stats().n_textures == stats.n_textures);
+
+    /* the texture stays loaded after its last release */
+    render_release_texture(a);
+    CHECK(render_get_asset_stats().n_unused == before.n_unused);
+    render_release_texture(b);
+    stats = render_get_asset_stats();
+    CHECK(stats.n_unused == before.n_unused + 1);
+    CHECK(stats.unused_bytes == before.unused_bytes + 16 * 8 * 4);
+    Texture2D c = render_acquire_texture("build/asset_test.png");
+    CHECK(c.id == a.id);
+    CHECK(render_get_asset_stats().hits == stats.hits + 1);
+    render_release_texture(c);
+}
+
+static void test_models(void) {
+    render_clear_asset_cache();
+    renderAssetStats before = render_get_asset_stats();
+    CHECK(before.n_models == 0);
+
+    Model cube = render_acquire_model("CUBE");
+    Model cube2 = render_acquire_model("CUBE");
+    Model sphere = render_acquire_model("SPHERE");
+    Model plane = render_acquire_model("PLANE");
+    CHECK(cube.meshes == cube2.meshes);
+    CHECK(cube.meshes != sphere.meshes);
+    renderAssetStats stats = render_get_asset_stats();
+    CHECK(stats.n_models == 3);
+    CHECK(stats.misses == before.misses + 3);
+    CHECK(stats.hits == before.hits + 1);
+
+    /* release oldest first: cube, then sphere, then plane */
+    render_release_model(cube);
+    render_release_model(cube2);
+    render_release_model(sphere);
+    render_release_model(plane);
+    stats = render_get_asset_stats();
+    CHECK(stats.n_unused == 3);
+    CHECK(stats.unused_bytes == stats.resident_bytes);
+
+    /* shrinking the budget evicts the least recently released */
+    render_set_asset_cache_size(stats.unused_bytes - 1);
+    renderAssetStats shrunk = render_get_asset_stats();
+    CHECK(shrunk.evictions == stats.evictions + 1);
+    CHECK(shrunk.n_models == 2);
+    sphere = render_acquire_model("SPHERE");
+    CHECK(render_get_asset_stats().hits == shrunk.hits + 1);
+    cube = render_acquire_model("CUBE");
+    CHECK(render_get_asset_stats().misses == shrunk.misses + 1);
+
+    /* without a budget, released assets go right away */
+    render_set_asset_cache_size(0);
+    CHECK(render_get_asset_stats().n_models == 2);
+    render_release_model(sphere);
+    render_release_model(cube);
+    CHECK(render_get_asset_stats().n_models == 0);
+    render_set_asset_cache_size(RENDER_ASSET_CACHE_DEFAULT_SIZE);
+}
+
+static void test_shared_textures(void) {
+    render_clear_asset_cache();
+    FILE* f = fopen("build/asset_test.mtl", "w");
+    fprintf(f, "newmtl textured\nKd 1 1 1\nmap_Kd asset_test.png\n");
+    fclose(f);
+    write_obj("build/asset_test_a.obj");
+    write_obj("build/asset_test_b.obj");
+
+    /* both models, and the material, use the same texture */
+    Model a = render_acquire_model("build/asset_test_a.obj");
+    Model b = render_acquire_model("build/asset_test_b.obj");
+    Texture2D texture = render_acquire_texture("build/asset_test.png");
+    CHECK(a.meshes != b.meshes);
+    CHECK(diffuse_id(a) == texture.id);
+    CHECK(diffuse_id(b) == texture.id);
+    renderAssetStats stats = render_get_asset_stats();
+    CHECK(stats.n_models == 2);
+    CHECK(stats.n_textures == 1);
+
+    render_release_model(a);
+    render_release_model(b);
+    render_release_texture(texture);
+    /* the cached models still hold the texture */
+    CHECK(render_get_asset_stats().n_unused == 2);
+    render_clear_asset_cache();
+    stats = render_get_asset_stats();
+    CHECK((stats.n_models == 0) && (stats.n_textures == 0));
+    CHECK(stats.resident_bytes == 0);
+
+    remove("build/asset_test_a.obj");
+    remove("build/asset_test_b.obj");
+    remove("build/asset_test_a.obj" RENDER_MESH_CACHE_EXTENSION);
+    remove("build/asset_test_b.obj" RENDER_MESH_CACHE_EXTENSION);
+    remove("build/asset_test.mtl");
+    remove("build/asset_test.png");
+}
+
+int main() {
+    hq_allocator_init_global();
+    SetConfigFlags(FLAG_WINDOW_HIDDEN);
+    InitWindow(64, 64, "asset_test");
+    SetTraceLogLevel(LOG_WARNING);
+    test_textures();
+    test_models();
+    test_shared_textures();
+    CloseWindow();
+    int status = check_report();
+    hq_allocator_delete_global();
+    return status;
+}
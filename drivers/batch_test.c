@@ -0,0 +1,208 @@
+#include "check.h"
+#include "hqtools/hqtools.h"
+#include "raylib.h"
+#include "raymath.h"
+#include "static_batch.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* a quad of n x n cells in the xz plane, from -1 to 1, facing +y */
+static Mesh make_grid(int n) {
+    Mesh mesh = {0};
+    mesh.vertexCount = (n + 1) * (n + 1);
+    mesh.triangleCount = n * n * 2;
+    mesh.vertices = (float*)RL_CALLOC(mesh.vertexCount * 3, sizeof(float));
+    mesh.normals = (float*)RL_CALLOC(mesh.vertexCount * 3, sizeof(float));
+    mesh.texcoords = (float*)RL_CALLOC(mesh.vertexCount * 2, sizeof(float));
+    mesh.indices = (unsigned short*)RL_CALLOC(mesh.triangleCount * 3,
+                                              sizeof(unsigned short));
+    for (int y = 0; y <= n; y++) {
+        for (int x = 0; x <= n; x++) {
+            int v = y * (n + 1) + x;
+            mesh.vertices[v * 3] = -1.0f + 2.0f * (float)x / (float)n;
+            mesh.vertices[v * 3 + 2] = -1.0f + 2.0f * (float)y / (float)n;
+            mesh.normals[v * 3 + 1] = 1.0f;
+            mesh.texcoords[v * 2] = (float)x / (float)n;
+            mesh.texcoords[v * 2 + 1] = (float)y / (float)n;
+        }
+    }
+    int k = 0;
+    for (int y = 0; y < n; y++) {
+        for (int x = 0; x < n; x++) {
+            int a = y * (n + 1) + x;
+            int b = a + n + 1;
+            unsigned short tri[6] = {a, b, a + 1, a + 1, b, b + 1};
+            memcpy(mesh.indices + k, tri, sizeof(tri));
+            k += 6;
+        }
+    }
+    return mesh;
+}
+
+/* a model with two meshes, each with its own material */
+static Model make_model(int n) {
+    Model model = {0};
+    model.transform = MatrixIdentity();
+    model.meshCount = 2;
+    model.materialCount = 2;
+    model.meshes = (Mesh*)RL_CALLOC(2, sizeof(Mesh));
+    model.materials = (Material*)RL_CALLOC(2, sizeof(Material));
+    model.meshMaterial = (int*)RL_CALLOC(2, sizeof(int));
+    model.meshes[0] = make_grid(n);
+    model.meshes[1] = make_grid(1);
+    for (int i = 0; i < 2; i++) {
+        model.materials[i].maps =
+            (MaterialMap*)RL_CALLOC(12, sizeof(MaterialMap));
+        model.materials[i].maps[MATERIAL_MAP_DIFFUSE].texture.id = 10 + i;
+        model.meshMaterial[i] = i;
+    }
+    return model;
+}
+
+static void test_chunks(void) {
+    Model model = make_model(4);
+    /* 10 x 10 x 10 instances, 10 apart: 4 + 3 + 3 per axis in 32 chunks */
+    int n = 1000;
+    Matrix* transforms = malloc(sizeof(Matrix) * n);
+    for (int i = 0; i < n; i++) {
+        transforms[i] = MatrixTranslate((float)(i % 10) * 10.0f,
+                                        (float)((i / 10) % 10) * 10.0f,
+                                        (float)(i / 100) * 10.0f);
+    }
+    Model batch = render_build_static_batch(model, transforms, n, 32.0f);
+    CHECK(batch.meshCount == 27 * 2);
+    CHECK(batch.materialCount == 2);
+    CHECK(batch.materials[0].maps != model.materials[0].maps);
+    CHECK(batch.materials[1].maps[MATERIAL_MAP_DIFFUSE].texture.id == 11);
+
+    int triangles[2] = {0, 0};
+    bool in_cell = true;
+    bool indices_in_range = true;
+    for (int i = 0; i < batch.meshCount; i++) {
+        Mesh mesh = batch.meshes[i];
+        triangles[batch.meshMaterial[i]] += mesh.triangleCount;
+        for (int j = 0; j < mesh.triangleCount * 3; j++) {
+            indices_in_range =
+                indices_in_range && (mesh.indices[j] < mesh.vertexCount);
+        }
+        /* every vertex of a chunk is within one model radius of the chunk */
+        Vector3 first = {mesh.vertices[0], mesh.vertices[1],
+                         mesh.vertices[2]};
+        int cx = (int)floorf((first.x + 1.0f) / 32.0f);
+        int cz = (int)floorf((first.z + 1.0f) / 32.0f);
+        for (int v = 0; v < mesh.vertexCount; v++) {
+            float x = mesh.vertices[v * 3];
+            float z = mesh.vertices[v * 3 + 2];
+            in_cell = in_cell && (x >= cx * 32.0f - 1.0f) &&
+                      (x <= (cx + 1) * 32.0f + 1.0f) &&
+                      (z >= cz * 32.0f - 1.0f) &&
+                      (z <= (cz + 1) * 32.0f + 1.0f);
+        }
+    }
+    CHECK(triangles[0] == n * model.meshes[0].triangleCount);
+    CHECK(triangles[1] == n * model.meshes[1].triangleCount);
+    CHECK(indices_in_range);
+    CHECK(in_cell);
+    printf("chunks: %d instances x %d meshes -> %d chunks\n", n,
+           model.meshCount, batch.meshCount);
+
+    UnloadModel(batch);
+    free(transforms);
+    UnloadModel(model);
+}
+
+static void test_transform(void) {
+    Model model = make_model(1);
+    /* rotated so +y faces +x, scaled by 2 and moved */
+    Matrix transform = MatrixMultiply(
+        MatrixMultiply(MatrixScale(2, 2, 2), MatrixRotateZ(-PI / 2)),
+        MatrixTranslate(5, 0, 0));
+    Model batch = render_build_static_batch(model, &transform, 1, 32.0f);
+    CHECK(batch.meshCount == 2);
+    Mesh mesh = batch.meshes[0];
+    bool positions = true;
+    bool normals = true;
+    for (int v = 0; v < mesh.vertexCount; v++) {
+        const float* p = mesh.vertices + v * 3;
+        const float* q = model.meshes[0].vertices + v * 3;
+        Vector3 expected = Vector3Transform((Vector3){q[0], q[1], q[2]},
+                                            transform);
+        positions = positions && (fabsf(p[0] - expected.x) < 1e-5f) &&
+                    (fabsf(p[1] - expected.y) < 1e-5f) &&
+                    (fabsf(p[2] - expected.z) < 1e-5f);
+        const float* n = mesh.normals + v * 3;
+        normals = normals && (fabsf(n[0] - 1.0f) < 1e-5f) &&
+                  (fabsf(n[1]) < 1e-5f) && (fabsf(n[2]) < 1e-5f);
+    }
+    CHECK(positions);
+    CHECK(normals);
+    CHECK(memcmp(mesh.texcoords, model.meshes[0].texcoords,
+                 sizeof(float) * 2 * mesh.vertexCount) == 0);
+    UnloadModel(batch);
+    UnloadModel(model);
+}
+
+static void test_vertex_limit(void) {
+    /* 64 x 64 cells: 4225 vertices, so 16 instances fit in a chunk */
+    Model model = make_model(64);
+    int n = 40;
+    Matrix* transforms = malloc(sizeof(Matrix) * n);
+    for (int i = 0; i < n; i++) {
+        transforms[i] = MatrixTranslate(0, (float)i * 0.1f, 0);
+    }
+    Model batch = render_build_static_batch(model, transforms, n, 32.0f);
+    int chunks[2] = {0, 0};
+    int triangles = 0;
+    bool under_limit = true;
+    bool indices_in_range = true;
+    for (int i = 0; i < batch.meshCount; i++) {
+        Mesh mesh = batch.meshes[i];
+        chunks[batch.meshMaterial[i]]++;
+        if (batch.meshMaterial[i] == 0)
+            triangles += mesh.triangleCount;
+        under_limit = under_limit &&
+                      (mesh.vertexCount <= RENDER_STATIC_BATCH_MAX_VERTICES);
+        for (int j = 0; j < mesh.triangleCount * 3; j++) {
+            indices_in_range =
+                indices_in_range && (mesh.indices[j] < mesh.vertexCount);
+        }
+    }
+    CHECK(chunks[0] == 3);
+    CHECK(chunks[1] == 1);
+    CHECK(triangles == n * model.meshes[0].triangleCount);
+    CHECK(under_limit);
+    CHECK(indices_in_range);
+    UnloadModel(batch);
+    free(transforms);
+    UnloadModel(model);
+}
+
+static void bench(int n) {
+    Model model = make_model(2);
+    Matrix* transforms = malloc(sizeof(Matrix) * n);
+    for (int i = 0; i < n; i++) {
+        transforms[i] = MatrixTranslate((float)(rand() % 1000),
+                                        0, (float)(rand() % 1000));
+    }
+    double start = now();
+    Model batch = render_build_static_batch(model, transforms, n, 32.0f);
+    double elapsed = now() - start;
+    printf("bench: %d instances (%d draws) -> %d chunks in %.2f ms\n", n,
+           n * model.meshCount, batch.meshCount, elapsed * 1e3);
+    UnloadModel(batch);
+    free(transforms);
+    UnloadModel(model);
+}
+
+int main() {
+    hq_allocator_init_global();
+    test_chunks();
+    test_transform();
+    test_vertex_limit();
+    bench(100000);
+    int status = check_report();
+    hq_allocator_delete_global();
+    return status;
+}
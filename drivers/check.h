@@ -0,0 +1,52 @@
+/**
+ * @file check.h
+ * @brief Checks and timing of the test and bench drivers. A failed check is
+ * reported and counted, and the driver keeps going; `check_report()` prints
+ * the totals at the end.
+ *
+ * Include from the driver's own translation unit only: the counters are
+ * static.
+ **/
+
+#ifndef _FLUX_DRIVERS_CHECK_H_
+#define _FLUX_DRIVERS_CHECK_H_
+
+#include <stdio.h>
+#include <time.h>
+
+/** Number of failed checks. */
+static int n_failed = 0;
+
+/** Number of checks. */
+static int n_checks = 0;
+
+/** Checks a condition, and reports it with its location if it is false. */
+#define CHECK(cond)                                                            \
+    do {                                                                       \
+        n_checks++;                                                            \
+        if (!(cond)) {                                                         \
+            n_failed++;                                                        \
+            printf("FAILED %s:%d: %s\n", __FILE__, __LINE__, #cond);           \
+        }                                                                      \
+    } while (0)
+
+/**
+ * @brief Reads the wall clock, for timing benches.
+ * @return Time in seconds.
+ */
+static inline double now(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Prints how many checks passed.
+ * @return The exit status of the driver: 0 if every check passed.
+ */
+static inline int check_report(void) {
+    printf("%d/%d checks passed\n", n_checks - n_failed, n_checks);
+    return n_failed != 0;
+}
+
+#endif
@@ -0,0 +1,660 @@
+#include "aabb_tree.h"
+#include "check.h"
+#include "frustum.h"
+#include "hqtools/hqtools.h"
+#include "job_pool.h"
+#include "occlusion.h"
+#include "raylib.h"
+#include "raymath.h"
+#include "render_queue.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static float randf(float lo, float hi) {
+    return lo + (hi - lo) * ((float)rand() / (float)RAND_MAX);
+}
+
+static Matrix perspective_vp(void) {
+    Matrix view = MatrixLookAt((Vector3){0, 0, 0}, (Vector3){0, 0, -1},
+                               (Vector3){0, 1, 0});
+    Matrix proj = MatrixPerspective(60.0 * DEG2RAD, 16.0 / 9.0, 0.1, 100.0);
+    return MatrixMultiply(view, proj);
+}
+
+static bool box_visible(const renderFrustum* frustum, Vector3 center,
+                        float half) {
+    Vector3 h = {half, half, half};
+    return render_frustum_test_aabb(frustum, Vector3Subtract(center, h),
+                                    Vector3Add(center, h));
+}
+
+/* a point is inside the frustum iff its clip coordinates are inside the clip
+ * volume, so zero sized boxes must agree with a direct clip space test */
+static bool point_in_clip(Vector3 p, Matrix vp) {
+    float x = vp.m0 * p.x + vp.m4 * p.y + vp.m8 * p.z + vp.m12;
+    float y = vp.m1 * p.x + vp.m5 * p.y + vp.m9 * p.z + vp.m13;
+    float z = vp.m2 * p.x + vp.m6 * p.y + vp.m10 * p.z + vp.m14;
+    float w = vp.m3 * p.x + vp.m7 * p.y + vp.m11 * p.z + vp.m15;
+    return (x >= -w) && (x <= w) && (y >= -w) && (y <= w) && (z >= -w) &&
+           (z <= w);
+}
+
+static void test_planes(void) {
+    renderFrustum frustum = render_frustum_from_matrix(perspective_vp());
+    for (int i = 0; i < RENDER_FRUSTUM_N_PLANES; i++) {
+        Vector4 p = frustum.planes[i];
+        float len = sqrtf(p.x * p.x + p.y * p.y + p.z * p.z);
+        CHECK(fabsf(len - 1.0f) < 1e-4f);
+    }
+    // camera looks down -z
+    CHECK(frustum.planes[RENDER_FRUSTUM_NEAR].z < -0.99f);
+    CHECK(fabsf(frustum.planes[RENDER_FRUSTUM_NEAR].w - (-0.1f)) < 1e-3f);
+    CHECK(frustum.planes[RENDER_FRUSTUM_FAR].z > 0.99f);
+    CHECK(fabsf(frustum.planes[RENDER_FRUSTUM_FAR].w - 100.0f) < 1e-2f);
+}
+
+static void test_perspective_boxes(void) {
+    renderFrustum frustum = render_frustum_from_matrix(perspective_vp());
+    CHECK(box_visible(&frustum, (Vector3){0, 0, -10}, 1));
+    CHECK(!box_visible(&frustum, (Vector3){0, 0, 10}, 1));
+    CHECK(!box_visible(&frustum, (Vector3){-100, 0, -10}, 1));
+    CHECK(!box_visible(&frustum, (Vector3){100, 0, -10}, 1));
+    CHECK(!box_visible(&frustum, (Vector3){0, 100, -10}, 1));
+    CHECK(!box_visible(&frustum, (Vector3){0, -100, -10}, 1));
+    CHECK(!box_visible(&frustum, (Vector3){0, 0, -200}, 1));
+    // straddling the near, far and side planes
+    CHECK(box_visible(&frustum, (Vector3){0, 0, 0}, 1));
+    CHECK(box_visible(&frustum, (Vector3){0, 0, -100}, 1));
+    CHECK(box_visible(&frustum, (Vector3){10.5, 0, -10}, 1));
+    // a huge box containing the whole frustum
+    CHECK(box_visible(&frustum, (Vector3){0, 0, 0}, 1000));
+}
+
+static void test_ortho_boxes(void) {
+    Matrix view = MatrixLookAt((Vector3){0, 10, 0}, (Vector3){0, 0, 0},
+                               (Vector3){0, 0, -1});
+    Matrix proj = MatrixOrtho(-5, 5, -5, 5, 0.1, 50);
+    renderFrustum frustum =
+        render_frustum_from_matrix(MatrixMultiply(view, proj));
+    CHECK(box_visible(&frustum, (Vector3){0, 0, 0}, 1));
+    CHECK(box_visible(&frustum, (Vector3){4, 0, 4}, 1));
+    CHECK(!box_visible(&frustum, (Vector3){7, 0, 0}, 1));
+    CHECK(!box_visible(&frustum, (Vector3){0, 0, -7}, 1));
+    CHECK(!box_visible(&frustum, (Vector3){0, 20, 0}, 1));
+    CHECK(!box_visible(&frustum, (Vector3){0, -50, 0}, 1));
+
+    // shadow casters: dropping the near plane keeps boxes between the light
+    // and the volume, but still culls to the sides
+    render_frustum_disable_plane(&frustum, RENDER_FRUSTUM_NEAR);
+    CHECK(box_visible(&frustum, (Vector3){0, 20, 0}, 1));
+    CHECK(box_visible(&frustum, (Vector3){0, 1000, 0}, 1));
+    CHECK(!box_visible(&frustum, (Vector3){7, 20, 0}, 1));
+    CHECK(!box_visible(&frustum, (Vector3){0, -50, 0}, 1));
+}
+
+static void fill_random_bounds(renderBounds* bounds, int n, float extent,
+                               float max_half) {
+    render_bounds_clear(bounds);
+    render_bounds_reserve(bounds, n);
+    for (int i = 0; i < n; i++) {
+        Vector3 c = {randf(-extent, extent), randf(-extent, extent),
+                     randf(-extent, extent)};
+        Vector3 h = {randf(0, max_half), randf(0, max_half),
+                     randf(0, max_half)};
+        render_bounds_push(bounds, Vector3Subtract(c, h), Vector3Add(c, h));
+    }
+}
+
+static void test_points(void) {
+    Matrix vp = perspective_vp();
+    renderFrustum frustum = render_frustum_from_matrix(vp);
+    int mismatches = 0;
+    for (int i = 0; i < 100000; i++) {
+        Vector3 p = {randf(-120, 120), randf(-120, 120), randf(-120, 20)};
+        if (render_frustum_test_aabb(&frustum, p, p) != point_in_clip(p, vp)) {
+            // only allow disagreement right on a plane
+            Vector3 e = {1e-3f, 1e-3f, 1e-3f};
+            if (point_in_clip(Vector3Add(p, e), vp) ==
+                point_in_clip(Vector3Subtract(p, e), vp))
+                mismatches++;
+        }
+    }
+    CHECK(mismatches == 0);
+}
+
+static void test_simd_matches_scalar(void) {
+    renderFrustum frustum = render_frustum_from_matrix(perspective_vp());
+    renderBounds bounds;
+    render_bounds_init(&bounds);
+
+    // sizes that are not a multiple of the SIMD width exercise the tail
+    int sizes[] = {0, 1, 3, 4, 7, 8, 9, 17, 10007};
+    for (int s = 0; s < (int)(sizeof(sizes) / sizeof(int)); s++) {
+        int n = sizes[s];
+        fill_random_bounds(&bounds, n, 120, 5);
+        int* a = (int*)malloc(sizeof(int) * (n + 1));
+        int* b = (int*)malloc(sizeof(int) * (n + 1));
+        int n_a = render_frustum_cull(&frustum, &bounds, a);
+        int n_b = render_frustum_cull_scalar(&frustum, &bounds, b);
+        CHECK(n_a == n_b);
+        int same = 1;
+        for (int i = 0; i < n_a && i < n_b; i++)
+            same &= a[i] == b[i];
+        CHECK(same);
+        int expected = 0;
+        for (int i = 0; i < n; i++) {
+            Vector3 min = {bounds.min_x[i], bounds.min_y[i], bounds.min_z[i]};
+            Vector3 max = {bounds.max_x[i], bounds.max_y[i], bounds.max_z[i]};
+            expected += render_frustum_test_aabb(&frustum, min, max);
+        }
+        CHECK(n_a == expected);
+        free(a);
+        free(b);
+    }
+    render_bounds_free(&bounds);
+}
+
+static void test_transform_aabb(void) {
+    BoundingBox box = {{-1, -2, -0.5f}, {3, 1, 0.5f}};
+    int mismatches = 0;
+    for (int i = 0; i < 1000; i++) {
+        Matrix m = MatrixMultiply(
+            MatrixMultiply(MatrixScale(randf(0.1f, 3), randf(0.1f, 3),
+                                       randf(0.1f, 3)),
+                           MatrixRotateXYZ((Vector3){randf(0, 2 * PI),
+                                                     randf(0, 2 * PI),
+                                                     randf(0, 2 * PI)})),
+            MatrixTranslate(randf(-50, 50), randf(-50, 50), randf(-50, 50)));
+        BoundingBox fast = render_transform_aabb(box, m);
+        // reference: transform all 8 corners
+        Vector3 min = {INFINITY, INFINITY, INFINITY};
+        Vector3 max = {-INFINITY, -INFINITY, -INFINITY};
+        for (int c = 0; c < 8; c++) {
+            Vector3 corner = {(c & 1) ? box.max.x : box.min.x,
+                              (c & 2) ? box.max.y : box.min.y,
+                              (c & 4) ? box.max.z : box.min.z};
+            corner = Vector3Transform(corner, m);
+            min = Vector3Min(min, corner);
+            max = Vector3Max(max, corner);
+        }
+        mismatches += Vector3Distance(min, fast.min) > 1e-3f;
+        mismatches += Vector3Distance(max, fast.max) > 1e-3f;
+    }
+    CHECK(mismatches == 0);
+}
+
+static BoundingBox random_box(float extent, float max_half) {
+    Vector3 c = {randf(-extent, extent), randf(-extent, extent),
+                 randf(-extent, extent)};
+    Vector3 h = {randf(0.01f, max_half), randf(0.01f, max_half),
+                 randf(0.01f, max_half)};
+    return (BoundingBox){Vector3Subtract(c, h), Vector3Add(c, h)};
+}
+
+static bool boxes_overlap(BoundingBox a, BoundingBox b) {
+    return (a.min.x <= b.max.x) && (a.max.x >= b.min.x) &&
+           (a.min.y <= b.max.y) && (a.max.y >= b.min.y) &&
+           (a.min.z <= b.max.z) && (a.max.z >= b.min.z);
+}
+
+static bool mark_proxy(void* data, int proxy, void* user_data) {
+    char* found = (char*)data;
+    found[(int)(size_t)user_data]++;
+    return true;
+}
+
+static void test_aabb_tree(void) {
+    const int n = 5000;
+    fluxAABBTree tree = flux_aabb_tree_create(0.5f);
+    int* proxies = (int*)malloc(sizeof(int) * n);
+    bool* alive = (bool*)malloc(sizeof(bool) * n);
+    char* found = (char*)malloc(n);
+    for (int i = 0; i < n; i++) {
+        proxies[i] =
+            flux_aabb_tree_insert(tree, random_box(200, 3), (void*)(size_t)i);
+        alive[i] = true;
+    }
+    CHECK(flux_aabb_tree_validate(tree));
+    CHECK(flux_aabb_tree_get_n_proxies(tree) == n);
+    // a balanced tree of 5000 leaves is about 13 high
+    CHECK(flux_aabb_tree_get_height(tree) < 30);
+
+    // small moves stay in the fat box, large ones reinsert
+    BoundingBox fat = flux_aabb_tree_get_fat_box(tree, proxies[0]);
+    BoundingBox nudged = {Vector3AddValue(fat.min, 0.6f),
+                          Vector3AddValue(fat.max, -0.4f)};
+    CHECK(!flux_aabb_tree_move(tree, proxies[0], nudged));
+    for (int i = 0; i < n; i += 3) {
+        flux_aabb_tree_move(tree, proxies[i], random_box(200, 3));
+    }
+    for (int i = 1; i < n; i += 7) {
+        flux_aabb_tree_remove(tree, proxies[i]);
+        alive[i] = false;
+    }
+    CHECK(flux_aabb_tree_validate(tree));
+
+    // box queries match brute force on the fat boxes
+    int mismatches = 0;
+    for (int q = 0; q < 50; q++) {
+        BoundingBox query = random_box(200, 40);
+        memset(found, 0, n);
+        flux_aabb_tree_query_box(tree, query, mark_proxy, found);
+        for (int i = 0; i < n; i++) {
+            bool expected =
+                alive[i] &&
+                boxes_overlap(flux_aabb_tree_get_fat_box(tree, proxies[i]),
+                              query);
+            mismatches += found[i] != (char)expected;
+        }
+    }
+    CHECK(mismatches == 0);
+    CHECK(flux_aabb_tree_get_nodes_visited(tree) < n);
+
+    // frustum queries (two volumes) match brute force, each proxy once
+    Matrix view = MatrixLookAt((Vector3){0, 0, 0}, (Vector3){0, 0, -1},
+                               (Vector3){0, 1, 0});
+    renderFrustum frusta[2];
+    frusta[0] = render_frustum_from_matrix(perspective_vp());
+    frusta[1] = render_frustum_from_matrix(
+        MatrixMultiply(view, MatrixOrtho(-20, 20, -20, 20, -100, 100)));
+    Vector4 planes[2 * RENDER_FRUSTUM_N_PLANES];
+    memcpy(planes, frusta[0].planes, sizeof(frusta[0].planes));
+    memcpy(planes + RENDER_FRUSTUM_N_PLANES, frusta[1].planes,
+           sizeof(frusta[1].planes));
+    memset(found, 0, n);
+    flux_aabb_tree_query_volumes(tree, planes, RENDER_FRUSTUM_N_PLANES, 2,
+                                 mark_proxy, found);
+    mismatches = 0;
+    int n_found = 0;
+    for (int i = 0; i < n; i++) {
+        bool expected = false;
+        if (alive[i]) {
+            BoundingBox box = flux_aabb_tree_get_fat_box(tree, proxies[i]);
+            expected = render_frustum_test_aabb(&frusta[0], box.min, box.max) ||
+                       render_frustum_test_aabb(&frusta[1], box.min, box.max);
+        }
+        mismatches += found[i] != (char)expected;
+        n_found += found[i] != 0;
+    }
+    CHECK(mismatches == 0);
+    CHECK(n_found > 0);
+
+    for (int i = 0; i < n; i++) {
+        if (alive[i])
+            flux_aabb_tree_remove(tree, proxies[i]);
+    }
+    CHECK(flux_aabb_tree_get_n_proxies(tree) == 0);
+    CHECK(flux_aabb_tree_get_height(tree) == -1);
+    CHECK(flux_aabb_tree_validate(tree));
+
+    free(found);
+    free(alive);
+    free(proxies);
+    flux_aabb_tree_destroy(tree);
+}
+
+static void bench_aabb_tree(int n, int reps) {
+    fluxAABBTree tree = flux_aabb_tree_create(0.5f);
+    renderBounds bounds;
+    render_bounds_init(&bounds);
+    for (int i = 0; i < n; i++) {
+        BoundingBox box = random_box(400, 3);
+        flux_aabb_tree_insert(tree, box, (void*)(size_t)i);
+        render_bounds_push(&bounds, box.min, box.max);
+    }
+    renderFrustum frustum = render_frustum_from_matrix(perspective_vp());
+    char* found = (char*)malloc(n);
+    int* visible = (int*)malloc(sizeof(int) * n);
+
+    double start = now();
+    for (int r = 0; r < reps; r++)
+        flux_aabb_tree_query_volumes(tree, frustum.planes,
+                                     RENDER_FRUSTUM_N_PLANES, 1, mark_proxy,
+                                     found);
+    double tree_time = now() - start;
+    int visited = flux_aabb_tree_get_nodes_visited(tree);
+
+    start = now();
+    int n_visible = 0;
+    for (int r = 0; r < reps; r++)
+        n_visible = render_frustum_cull(&frustum, &bounds, visible);
+    double linear_time = now() - start;
+
+    printf("bench aabb tree: %d boxes x %d, %d visible, height %d\n", n,
+           reps, n_visible, flux_aabb_tree_get_height(tree));
+    printf("  linear (%s): %8.3f ms/query\n", render_frustum_simd_name(),
+           linear_time / reps * 1e3);
+    printf("  tree         : %8.3f ms/query (%d nodes visited, %.2fx)\n",
+           tree_time / reps * 1e3, visited, linear_time / tree_time);
+
+    free(visible);
+    free(found);
+    render_bounds_free(&bounds);
+    flux_aabb_tree_destroy(tree);
+}
+
+/* a wall at z = -10 in front of the perspective_vp() camera, as two triangles
+ */
+static const float wall[] = {-5, -3, -10, 5, -3, -10, 5,  3, -10,
+                             -5, -3, -10, 5, 3,  -10, -5, 3, -10};
+
+static bool box_occluded(const renderOcclusionBuffer* buffer, Vector3 center,
+                         float half) {
+    Vector3 h = {half, half, half};
+    return !render_occlusion_test_aabb(buffer, Vector3Subtract(center, h),
+                                       Vector3Add(center, h));
+}
+
+/* a box may only be occluded by the wall if the wall (give or take a pixel of
+ * the 256x144 buffer, about 0.1 units at its distance) is between the eye and
+ * every corner of the box */
+static bool wall_hides(Vector3 min, Vector3 max) {
+    for (int c = 0; c < 8; c++) {
+        Vector3 p = {(c & 1) ? max.x : min.x, (c & 2) ? max.y : min.y,
+                     (c & 4) ? max.z : min.z};
+        if (p.z >= -10)
+            return false;
+        float x = p.x * 10 / -p.z;
+        float y = p.y * 10 / -p.z;
+        if ((x < -5.1f) || (x > 5.1f) || (y < -3.1f) || (y > 3.1f))
+            return false;
+    }
+    return true;
+}
+
+static void test_occlusion(void) {
+    renderOcclusionBuffer buffer;
+    render_occlusion_init(&buffer, 250, 144);
+    CHECK(buffer.width == 256);
+    CHECK(buffer.level_width[0] == 256);
+
+    render_occlusion_begin(&buffer, perspective_vp());
+    // nothing is occluded before the pyramid is built
+    CHECK(!box_occluded(&buffer, (Vector3){0, 0, -20}, 1));
+    render_occlusion_rasterize(&buffer, wall, NULL, 2, MatrixIdentity());
+    render_occlusion_build_hiz(&buffer);
+    CHECK(buffer.occluder_triangles == 2);
+
+    CHECK(box_occluded(&buffer, (Vector3){0, 0, -20}, 1));
+    CHECK(box_occluded(&buffer, (Vector3){2, -1, -80}, 5));
+    CHECK(!box_occluded(&buffer, (Vector3){0, 0, -5}, 1));
+    CHECK(!box_occluded(&buffer, (Vector3){0, 0, -10.5}, 1));
+    CHECK(!box_occluded(&buffer, (Vector3){30, 0, -40}, 1));
+    CHECK(!box_occluded(&buffer, (Vector3){0, 0, -20}, 9));
+    CHECK(!box_occluded(&buffer, (Vector3){0, 0, 0}, 1));
+
+    // the same wall, indexed and moved sideways by its model matrix
+    unsigned short indices[] = {0, 1, 2, 0, 2, 5};
+    render_occlusion_begin(&buffer, perspective_vp());
+    render_occlusion_rasterize(&buffer, wall, indices, 2,
+                               MatrixTranslate(6, 0, 0));
+    render_occlusion_build_hiz(&buffer);
+    CHECK(!box_occluded(&buffer, (Vector3){0, 0, -20}, 1));
+    CHECK(box_occluded(&buffer, (Vector3){12, 0, -20}, 1));
+
+    // never occlude a box the wall does not hide
+    render_occlusion_begin(&buffer, perspective_vp());
+    render_occlusion_rasterize(&buffer, wall, NULL, 2, MatrixIdentity());
+    render_occlusion_build_hiz(&buffer);
+    int wrong = 0;
+    int occluded = 0;
+    for (int i = 0; i < 100000; i++) {
+        Vector3 center = {randf(-30, 30), randf(-20, 20), randf(-60, 0)};
+        Vector3 h = {randf(0, 3), randf(0, 3), randf(0, 3)};
+        Vector3 min = Vector3Subtract(center, h);
+        Vector3 max = Vector3Add(center, h);
+        if (render_occlusion_test_aabb(&buffer, min, max))
+            continue;
+        occluded++;
+        if (!wall_hides(min, max))
+            wrong++;
+    }
+    CHECK(wrong == 0);
+    CHECK(occluded > 1000);
+
+    render_occlusion_free(&buffer);
+}
+
+static void bench_occlusion(int n, int reps) {
+    renderOcclusionBuffer buffer;
+    render_occlusion_init(&buffer, 256, 144);
+    renderBounds bounds;
+    render_bounds_init(&bounds);
+    for (int i = 0; i < n; i++) {
+        Vector3 center = {randf(-40, 40), randf(-20, 20), randf(-60, -1)};
+        Vector3 h = {randf(0, 1), randf(0, 1), randf(0, 1)};
+        render_bounds_push(&bounds, Vector3Subtract(center, h),
+                           Vector3Add(center, h));
+    }
+    int* visible = (int*)malloc(sizeof(int) * n);
+
+    double start = now();
+    for (int r = 0; r < reps; r++) {
+        render_occlusion_begin(&buffer, perspective_vp());
+        for (int w = -2; w <= 2; w++)
+            render_occlusion_rasterize(&buffer, wall, NULL, 2,
+                                       MatrixTranslate(w * 11, 0, 0));
+        render_occlusion_build_hiz(&buffer);
+    }
+    double raster_time = now() - start;
+
+    start = now();
+    int n_visible = 0;
+    for (int r = 0; r < reps; r++) {
+        for (int i = 0; i < n; i++)
+            visible[i] = i;
+        n_visible = render_occlusion_cull(&buffer, &bounds, visible, n);
+    }
+    double test_time = now() - start;
+
+    printf("bench occlusion: %d boxes x %d, %d occluded (%s)\n", n, reps,
+           n - n_visible, render_occlusion_simd_name());
+    printf("  rasterize + hiz: %8.3f ms/frame\n", raster_time / reps * 1e3);
+    printf("  test           : %8.1f Mboxes/s\n",
+           (double)n * reps / test_time * 1e-6);
+
+    free(visible);
+    render_bounds_free(&bounds);
+    render_occlusion_free(&buffer);
+}
+
+/** Boxes per job in the threaded culling tests (as `RENDER_CULL_CHUNK`). */
+#define CHUNK 4096
+
+typedef struct cullJobs {
+    const renderFrustum* frustum;
+    const renderBounds* bounds;
+    int* visible;
+    int* counts;
+} cullJobs;
+
+static void cull_chunk(void* data, int job) {
+    cullJobs* jobs = (cullJobs*)data;
+    int start = job * CHUNK;
+    int end = start + CHUNK;
+    if (end > jobs->bounds->n)
+        end = jobs->bounds->n;
+    jobs->counts[job] = render_frustum_cull_range(
+        jobs->frustum, jobs->bounds, start, end, jobs->visible + start);
+}
+
+// culls in CHUNK sized jobs on the pool, then compacts the slices in job
+// order, the same way the pipeline builds its render queue
+static int cull_threaded(fluxJobPool pool, const renderFrustum* frustum,
+                         const renderBounds* bounds, int* visible,
+                         int* counts) {
+    int n_jobs = (bounds->n + CHUNK - 1) / CHUNK;
+    cullJobs jobs = {frustum, bounds, visible, counts};
+    flux_job_pool_run(pool, cull_chunk, &jobs, n_jobs);
+    int n_visible = 0;
+    for (int j = 0; j < n_jobs; j++) {
+        memmove(visible + n_visible, visible + j * CHUNK,
+                sizeof(int) * counts[j]);
+        n_visible += counts[j];
+    }
+    return n_visible;
+}
+
+static void test_threaded_matches_serial(void) {
+    renderFrustum frustum = render_frustum_from_matrix(perspective_vp());
+    renderBounds bounds;
+    render_bounds_init(&bounds);
+    fill_random_bounds(&bounds, 100003, 120, 2);
+    int n = bounds.n;
+    int* expected = (int*)malloc(sizeof(int) * n);
+    int* visible = (int*)malloc(sizeof(int) * n);
+    int* counts = (int*)malloc(sizeof(int) * (n / CHUNK + 1));
+    int n_expected = render_frustum_cull(&frustum, &bounds, expected);
+
+    // ranges
+    int n_range = render_frustum_cull_range(&frustum, &bounds, 17, 1000,
+                                            visible);
+    int n_range_expected = 0;
+    for (int i = 0; i < n_expected; i++)
+        n_range_expected += (expected[i] >= 17) && (expected[i] < 1000);
+    CHECK(n_range == n_range_expected);
+    CHECK(render_frustum_cull_range(&frustum, &bounds, 5, 5, visible) == 0);
+
+    int n_threads[] = {1, 2, 3, 4, flux_get_n_cores()};
+    for (int t = 0; t < (int)(sizeof(n_threads) / sizeof(int)); t++) {
+        fluxJobPool pool = flux_job_pool_create(n_threads[t]);
+        for (int rep = 0; rep < 3; rep++) {
+            int n_visible =
+                cull_threaded(pool, &frustum, &bounds, visible, counts);
+            CHECK(n_visible == n_expected);
+            CHECK(memcmp(visible, expected, sizeof(int) * n_expected) == 0);
+        }
+        flux_job_pool_destroy(pool);
+    }
+    free(counts);
+    free(visible);
+    free(expected);
+    render_bounds_free(&bounds);
+}
+
+static void bench_threads(int n, int reps) {
+    renderFrustum frustum = render_frustum_from_matrix(perspective_vp());
+    renderBounds bounds;
+    render_bounds_init(&bounds);
+    fill_random_bounds(&bounds, n, 120, 2);
+    int* visible = (int*)malloc(sizeof(int) * n);
+    int* counts = (int*)malloc(sizeof(int) * (n / CHUNK + 1));
+
+    double boxes = (double)n * (double)reps;
+    double base_time = 0;
+    printf("bench threads: %d boxes x %d, %d boxes per job\n", n, reps, CHUNK);
+    int n_cores = flux_get_n_cores();
+    for (int t = 1;; t = 2 * t < n_cores ? 2 * t : n_cores) {
+        fluxJobPool pool = flux_job_pool_create(t);
+        double start = now();
+        for (int r = 0; r < reps; r++)
+            cull_threaded(pool, &frustum, &bounds, visible, counts);
+        double time = now() - start;
+        if (t == 1)
+            base_time = time;
+        printf("  %2d threads: %8.1f Mboxes/s (%.2fx)\n", t,
+               boxes / time * 1e-6, base_time / time);
+        flux_job_pool_destroy(pool);
+        if (t == n_cores)
+            break;
+    }
+
+    free(counts);
+    free(visible);
+    render_bounds_free(&bounds);
+}
+
+static void bench(int n, int reps) {
+    renderFrustum frustum = render_frustum_from_matrix(perspective_vp());
+    renderBounds bounds;
+    render_bounds_init(&bounds);
+    fill_random_bounds(&bounds, n, 120, 2);
+    int* visible = (int*)malloc(sizeof(int) * n);
+
+    int n_visible = 0;
+    double start = now();
+    for (int r = 0; r < reps; r++)
+        n_visible = render_frustum_cull_scalar(&frustum, &bounds, visible);
+    double scalar_time = now() - start;
+
+    start = now();
+    for (int r = 0; r < reps; r++)
+        n_visible = render_frustum_cull(&frustum, &bounds, visible);
+    double simd_time = now() - start;
+
+    double boxes = (double)n * (double)reps;
+    printf("bench: %d boxes x %d, %d visible\n", n, reps, n_visible);
+    printf("  scalar: %8.1f Mboxes/s\n", boxes / scalar_time * 1e-6);
+    printf("  %-6s: %8.1f Mboxes/s (%.2fx)\n", render_frustum_simd_name(),
+           boxes / simd_time * 1e-6, scalar_time / simd_time);
+
+    free(visible);
+    render_bounds_free(&bounds);
+}
+
+/* keys get their shader after culling, and must sort as if made with it */
+static void test_queue_shader_keys(void) {
+    for (int i = 0; i < 100; i++) {
+        bool translucent = rand() % 2;
+        unsigned int shader = (unsigned int)(rand() % 200);
+        unsigned int texture = (unsigned int)rand();
+        int batch = rand() % RENDER_QUEUE_MAX_BATCHES;
+        float depth = randf(0.0f, 1.0f);
+        unsigned long long key =
+            render_queue_make_key(translucent, 0, texture, batch, depth);
+        unsigned long long expected =
+            render_queue_make_key(translucent, shader, texture, batch, depth);
+        CHECK(render_queue_key_set_shader(key, shader) == expected);
+        CHECK(render_queue_key_set_shader(expected, 0) == key);
+        CHECK(render_queue_key_batch(expected) == batch);
+    }
+
+    /* opaque batches drawn with the same shader end up next to each other */
+    renderQueue queue;
+    render_queue_init(&queue);
+    for (int b = 0; b < 8; b++) {
+        unsigned long long key =
+            render_queue_make_key(false, 0, (unsigned int)b, b, 0.5f);
+        render_queue_push(&queue, render_queue_key_set_shader(key, 3 + b % 2),
+                          b);
+    }
+    render_queue_sort(&queue);
+    int shader_changes = 0;
+    for (int j = 1; j < queue.n; j++) {
+        if (queue.items[j].instance % 2 != queue.items[j - 1].instance % 2)
+            shader_changes++;
+    }
+    CHECK(shader_changes == 1);
+    render_queue_free(&queue);
+}
+
+int main() {
+
+    hq_allocator_init_global();
+
+    srand(1234);
+
+    test_planes();
+    test_perspective_boxes();
+    test_ortho_boxes();
+    test_points();
+    test_simd_matches_scalar();
+    test_transform_aabb();
+    test_threaded_matches_serial();
+    test_aabb_tree();
+    test_occlusion();
+    test_queue_shader_keys();
+
+    printf("simd path: %s\n", render_frustum_simd_name());
+    int status = check_report();
+
+    bench(1 << 20, 50);
+    bench_threads(1 << 22, 20);
+    bench_aabb_tree(1 << 20, 20);
+    bench_occlusion(1 << 18, 20);
+
+    hq_allocator_delete_global();
+
+    return status;
+}
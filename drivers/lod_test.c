@@ -0,0 +1,413 @@
+#include "asset_registry.h"
+#include "asset_stream.h"
+#include "check.h"
+#include "hqtools/hqtools.h"
+#include "mesh_cache.h"
+#include "pipeline.h"
+#include "raylib.h"
+#include "simplify.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* unit sphere with a uv seam and poles, like GenMeshSphere: the seam and pole
+ * vertices are duplicated, so the simplifier has to weld them */
+static Mesh make_sphere(int rings, int slices) {
+    Mesh mesh = {0};
+    mesh.vertexCount = (rings + 1) * (slices + 1);
+    mesh.triangleCount = rings * slices * 2;
+    mesh.vertices = (float*)RL_CALLOC(mesh.vertexCount * 3, sizeof(float));
+    mesh.normals = (float*)RL_CALLOC(mesh.vertexCount * 3, sizeof(float));
+    mesh.texcoords = (float*)RL_CALLOC(mesh.vertexCount * 2, sizeof(float));
+    mesh.indices = (unsigned short*)RL_CALLOC(mesh.triangleCount * 3,
+                                              sizeof(unsigned short));
+    for (int r = 0; r <= rings; r++) {
+        for (int s = 0; s <= slices; s++) {
+            int v = r * (slices + 1) + s;
+            float theta = PI * (float)r / (float)rings;
+            float phi = 2 * PI * (float)s / (float)slices;
+            float p[3] = {sinf(theta) * cosf(phi), cosf(theta),
+                          sinf(theta) * sinf(phi)};
+            memcpy(mesh.vertices + v * 3, p, sizeof(p));
+            memcpy(mesh.normals + v * 3, p, sizeof(p));
+            mesh.texcoords[v * 2] = (float)s / (float)slices;
+            mesh.texcoords[v * 2 + 1] = (float)r / (float)rings;
+        }
+    }
+    int k = 0;
+    for (int r = 0; r < rings; r++) {
+        for (int s = 0; s < slices; s++) {
+            int a = r * (slices + 1) + s;
+            int b = a + slices + 1;
+            unsigned short tri[6] = {a, b, a + 1, a + 1, b, b + 1};
+            memcpy(mesh.indices + k, tri, sizeof(tri));
+            k += 6;
+        }
+    }
+    return mesh;
+}
+
+/* largest distance of a triangle centroid from the unit sphere */
+static float sphere_deviation(const float* positions,
+                              const unsigned int* indices, int n) {
+    float worst = 0;
+    for (int i = 0; i < n; i += 3) {
+        float c[3] = {0, 0, 0};
+        for (int j = 0; j < 3; j++) {
+            for (int a = 0; a < 3; a++) {
+                c[a] += positions[indices[i + j] * 3 + a] / 3.0f;
+            }
+        }
+        float d = 1.0f - sqrtf(c[0] * c[0] + c[1] * c[1] + c[2] * c[2]);
+        if (d > worst)
+            worst = d;
+    }
+    return worst;
+}
+
+static bool has_degenerate(const unsigned int* indices, int n) {
+    for (int i = 0; i < n; i += 3) {
+        if ((indices[i] == indices[i + 1]) ||
+            (indices[i + 1] == indices[i + 2]) ||
+            (indices[i + 2] == indices[i]))
+            return true;
+    }
+    return false;
+}
+
+static void test_sphere(void) {
+    Mesh sphere = make_sphere(32, 64);
+    int n_indices = sphere.triangleCount * 3;
+    unsigned int* indices = malloc(sizeof(unsigned int) * n_indices);
+    unsigned int* out = malloc(sizeof(unsigned int) * n_indices);
+    for (int i = 0; i < n_indices; i++) {
+        indices[i] = sphere.indices[i];
+    }
+
+    /* no target: nothing to do */
+    float error;
+    int n = render_simplify(sphere.vertices, sphere.vertexCount, indices,
+                            n_indices, n_indices, 0.01f, out, &error);
+    CHECK(n == n_indices);
+    CHECK(memcmp(out, indices, sizeof(unsigned int) * n) == 0);
+    CHECK(error == 0.0f);
+
+    int previous = n_indices;
+    for (int l = 1; l < 4; l++) {
+        int target = n_indices >> l;
+        n = render_simplify(sphere.vertices, sphere.vertexCount, indices,
+                            n_indices, target, 0.05f, out, &error);
+        float deviation = sphere_deviation(sphere.vertices, out, n);
+        printf("sphere lod %d: %d -> %d triangles, error %g, deviation %g\n",
+               l, n_indices / 3, n / 3, error, deviation);
+        CHECK(n % 3 == 0);
+        CHECK(n <= target);
+        CHECK(n < previous);
+        CHECK(error <= 0.05f);
+        CHECK(deviation < 0.05f);
+        CHECK(!has_degenerate(out, n));
+        bool in_range = true;
+        for (int i = 0; i < n; i++) {
+            in_range = in_range && (out[i] < (unsigned int)sphere.vertexCount);
+        }
+        CHECK(in_range);
+        previous = n;
+    }
+
+    /* a tight error bound stops before the target */
+    n = render_simplify(sphere.vertices, sphere.vertexCount, indices,
+                        n_indices, 3, 0.001f, out, &error);
+    CHECK(n > 3);
+    CHECK(error <= 0.001f);
+
+    free(out);
+    free(indices);
+    UnloadMesh(sphere);
+}
+
+/* flat grid: interior vertices can all go, the border is locked */
+static void test_grid_border(void) {
+    int size = 16;
+    int n_vertices = (size + 1) * (size + 1);
+    int n_indices = size * size * 6;
+    float* positions = malloc(sizeof(float) * 3 * n_vertices);
+    unsigned int* indices = malloc(sizeof(unsigned int) * n_indices);
+    unsigned int* out = malloc(sizeof(unsigned int) * n_indices);
+    for (int y = 0; y <= size; y++) {
+        for (int x = 0; x <= size; x++) {
+            float* p = positions + (y * (size + 1) + x) * 3;
+            p[0] = (float)x;
+            p[1] = 0;
+            p[2] = (float)y;
+        }
+    }
+    int k = 0;
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            unsigned int a = y * (size + 1) + x;
+            unsigned int b = a + size + 1;
+            unsigned int tri[6] = {a, b, a + 1, a + 1, b, b + 1};
+            memcpy(indices + k, tri, sizeof(tri));
+            k += 6;
+        }
+    }
+    float error;
+    int n = render_simplify(positions, n_vertices, indices, n_indices, 0,
+                            0.01f, out, &error);
+    printf("grid: %d -> %d triangles, error %g\n", n_indices / 3, n / 3,
+           error);
+    CHECK(n < n_indices / 2);
+    CHECK(error < 1e-4f);
+    CHECK(!has_degenerate(out, n));
+
+    /* every border vertex is still used, and the area is unchanged */
+    bool* used = malloc(sizeof(bool) * n_vertices);
+    memset(used, 0, sizeof(bool) * n_vertices);
+    double area = 0;
+    for (int i = 0; i < n; i += 3) {
+        const float* p0 = positions + out[i] * 3;
+        const float* p1 = positions + out[i + 1] * 3;
+        const float* p2 = positions + out[i + 2] * 3;
+        area += 0.5 * fabs((p1[0] - p0[0]) * (p2[2] - p0[2]) -
+                           (p2[0] - p0[0]) * (p1[2] - p0[2]));
+        used[out[i]] = used[out[i + 1]] = used[out[i + 2]] = true;
+    }
+    bool border_kept = true;
+    for (int y = 0; y <= size; y++) {
+        for (int x = 0; x <= size; x++) {
+            if ((x == 0) || (y == 0) || (x == size) || (y == size))
+                border_kept = border_kept && used[y * (size + 1) + x];
+        }
+    }
+    CHECK(border_kept);
+    CHECK(fabs(area - size * size) < 1e-3);
+
+    free(used);
+    free(out);
+    free(indices);
+    free(positions);
+}
+
+static void test_simplify_mesh(void) {
+    Mesh sphere = make_sphere(32, 64);
+    float error;
+    Mesh lod = render_simplify_mesh(sphere, sphere.triangleCount / 4, 0.05f,
+                                    &error);
+    CHECK(lod.triangleCount > 0);
+    CHECK(lod.triangleCount <= sphere.triangleCount / 4);
+    CHECK(lod.vertexCount < sphere.vertexCount);
+    CHECK(lod.indices != NULL);
+    CHECK(lod.normals != NULL);
+    CHECK(lod.texcoords != NULL);
+    CHECK(lod.colors == NULL);
+    bool in_range = true;
+    for (int i = 0; i < lod.triangleCount * 3; i++) {
+        in_range = in_range && (lod.indices[i] < lod.vertexCount);
+    }
+    CHECK(in_range);
+    /* attributes travel with their positions */
+    bool attributes_match = true;
+    for (int v = 0; v < lod.vertexCount; v++) {
+        const float* p = lod.vertices + v * 3;
+        const float* n = lod.normals + v * 3;
+        attributes_match = attributes_match && (fabsf(p[0] - n[0]) < 1e-6f) &&
+                           (fabsf(p[1] - n[1]) < 1e-6f) &&
+                           (fabsf(p[2] - n[2]) < 1e-6f);
+    }
+    CHECK(attributes_match);
+    UnloadMesh(lod);
+
+    /* a mesh without vertices gives an empty mesh */
+    Mesh empty = {0};
+    lod = render_simplify_mesh(empty, 0, 0.05f, &error);
+    CHECK(lod.triangleCount == 0);
+    CHECK(lod.vertices == NULL);
+    UnloadMesh(sphere);
+}
+
+static void test_simplify_lods(void) {
+    Mesh sphere = make_sphere(32, 64);
+    Mesh lods[RENDER_MAX_LODS - 1];
+    int n_lods = render_simplify_lods(sphere, lods);
+    CHECK(n_lods == RENDER_MAX_LODS);
+    int previous = sphere.triangleCount;
+    for (int l = 1; l < n_lods; l++) {
+        CHECK(lods[l - 1].triangleCount * 5 <= previous * 4);
+        CHECK(lods[l - 1].vboId == NULL);
+        previous = lods[l - 1].triangleCount;
+        render_free_simplified_mesh(lods[l - 1]);
+    }
+    UnloadMesh(sphere);
+
+    /* small meshes keep level 0 only */
+    Mesh small = make_sphere(4, 8);
+    CHECK(render_simplify_lods(small, lods) == 1);
+    UnloadMesh(small);
+}
+
+/* a flat n by n grid of quads */
+static void write_grid(const char* path, int n) {
+    FILE* f = fopen(path, "w");
+    for (int z = 0; z <= n; z++) {
+        for (int x = 0; x <= n; x++) {
+            fprintf(f, "v %d 0 %d\n", x, z);
+        }
+    }
+    for (int z = 0; z < n; z++) {
+        for (int x = 0; x < n; x++) {
+            int v = z * (n + 1) + x + 1;
+            fprintf(f, "f %d %d %d %d\n", v, v + n + 1, v + n + 2, v + 1);
+        }
+    }
+    fclose(f);
+}
+
+/* streamed models were simplified by the streaming threads, and render
+ * models made from them share those levels instead of simplifying again */
+static void test_streamed_lods(void) {
+    const char* path = "build/lod_test_grid.obj";
+    write_grid(path, 32);
+    remove(TextFormat("%s%s", path, RENDER_MESH_CACHE_EXTENSION));
+    renderModelRequest request = render_request_model(path);
+    render_finish_asset_stream();
+    Model model = render_model_request_take(request);
+    render_model_request_free(request);
+    const int* n_lods = NULL;
+    const Mesh* lods = render_model_file_get_lods(model, &n_lods);
+    CHECK(lods != NULL);
+
+    renderModel a = render_make_model(model);
+    renderModel b = render_make_model(model);
+    CHECK(render_model_get_lod_count(a, 0) > 1);
+    if (lods) {
+        CHECK(render_model_get_lod_count(a, 0) == n_lods[0]);
+        CHECK(render_model_get_lod_mesh(a, 0, 1).vboId == lods[0].vboId);
+        CHECK(render_model_get_lod_mesh(b, 0, 1).vboId == lods[0].vboId);
+    }
+    render_free_model(a);
+    render_free_model(b);
+
+    /* static batches still get no levels */
+    renderModel batch = render_make_model_ex(model, false);
+    CHECK(render_model_get_lod_count(batch, 0) == 1);
+    render_free_model(batch);
+
+    render_release_model(model);
+    render_clear_asset_cache();
+    remove(path);
+    remove(TextFormat("%s%s", path, RENDER_MESH_CACHE_EXTENSION));
+}
+
+#define N_OBJECTS 4
+
+/* one main pass over the objects that are drawn, each with its own levels */
+static void draw_objects(renderModel rmodel, Camera3D camera,
+                         const float* distances, const bool* drawn,
+                         unsigned char (*lods)[1]) {
+    render_reset_instances(rmodel);
+    for (int i = 0; i < N_OBJECTS; i++) {
+        if (!drawn[i])
+            continue;
+        fluxTransform transform = {{0.0f, 0.0f, -distances[i]},
+                                   {0.0f, 0.0f, 0.0f},
+                                   {1.0f, 1.0f, 1.0f}};
+        render_add_model_instance_ex(
+            rmodel, render_model_get_transform(rmodel, transform), NULL,
+            lods[i]);
+    }
+    BeginDrawing();
+    render_begin(camera);
+    render_rmodel(rmodel, WHITE);
+    render_end();
+    EndDrawing();
+}
+
+/* the level of each object is kept with the object, so dropping an instance
+ * from the middle (and moving the later ones down a slot) does not hand
+ * them their neighbours' levels */
+static void test_hysteresis(void) {
+    Mesh mesh = make_sphere(32, 64);
+    UploadMesh(&mesh, false);
+    Model model = LoadModelFromMesh(mesh);
+    renderModel rmodel = render_make_model(model);
+    CHECK(render_model_get_lod_count(rmodel, 0) > 1);
+    Camera3D camera = {0};
+    camera.target = (Vector3){0.0f, 0.0f, -1.0f};
+    camera.up = (Vector3){0.0f, 1.0f, 0.0f};
+    camera.fovy = 45.0f;
+    camera.projection = CAMERA_PERSPECTIVE;
+
+    /* a unit sphere switches to level 1 beyond about 18.6, and back to level
+     * 0 within about 15.2, so at 17 it keeps whichever level it had */
+    unsigned char lods[N_OBJECTS][1] = {{0}};
+    bool drawn[N_OBJECTS] = {true, true, true, true};
+    float distances[N_OBJECTS] = {25.0f, 25.0f, 10.0f, 25.0f};
+    draw_objects(rmodel, camera, distances, drawn, lods);
+    CHECK((lods[0][0] == 1) && (lods[1][0] == 1) && (lods[2][0] == 0) &&
+          (lods[3][0] == 1));
+
+    float band[N_OBJECTS] = {17.0f, 25.0f, 17.0f, 17.0f};
+    draw_objects(rmodel, camera, band, drawn, lods);
+    CHECK((lods[0][0] == 1) && (lods[2][0] == 0) && (lods[3][0] == 1));
+
+    drawn[1] = false;
+    for (int frame = 0; frame < 3; frame++) {
+        draw_objects(rmodel, camera, band, drawn, lods);
+    }
+    CHECK((lods[0][0] == 1) && (lods[2][0] == 0) && (lods[3][0] == 1));
+
+    /* shadow maps are drawn with the same levels, so a level switch alone
+     * (nothing moved) changes the caster hash */
+    render_begin(camera);
+    render_rmodel(rmodel, WHITE);
+    unsigned long long far_hash = render_get_caster_hash(NULL);
+    CHECK(render_get_caster_hash(NULL) == far_hash);
+    Camera3D closer = camera;
+    closer.position.z = -10.0f;
+    closer.target.z = -11.0f;
+    render_begin(closer);
+    render_rmodel(rmodel, WHITE);
+    CHECK(render_get_caster_hash(NULL) != far_hash);
+    render_end();
+
+    render_free_model(rmodel);
+    UnloadModel(model);
+}
+
+static void bench(int rings, int slices, int reps) {
+    Mesh sphere = make_sphere(rings, slices);
+    double start = now();
+    int n_triangles = 0;
+    for (int r = 0; r < reps; r++) {
+        for (int l = 1; l < 4; l++) {
+            Mesh lod = render_simplify_mesh(
+                sphere, sphere.triangleCount >> l, 0.05f, NULL);
+            n_triangles += lod.triangleCount;
+            UnloadMesh(lod);
+        }
+    }
+    double elapsed = (now() - start) / reps;
+    printf("bench: 3 lods of %d triangles in %.2f ms (%d lod triangles)\n",
+           sphere.triangleCount, elapsed * 1e3, n_triangles / reps);
+    UnloadMesh(sphere);
+}
+
+int main() {
+    hq_allocator_init_global();
+    test_sphere();
+    test_grid_border();
+    test_simplify_mesh();
+    test_simplify_lods();
+    SetConfigFlags(FLAG_WINDOW_HIDDEN);
+    InitWindow(64, 64, "lod_test");
+    render_init();
+    test_hysteresis();
+    test_streamed_lods();
+    render_close();
+    CloseWindow();
+    bench(100, 200, 5);
+    int status = check_report();
+    hq_allocator_delete_global();
+    return status;
+}
@@ -0,0 +1,172 @@
+#include "asset_registry.h"
+#include "check.h"
+#include "hqtools/hqtools.h"
+#include "mesh_cache.h"
+#include "raylib.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* n x n grid in two objects, the second one textured */
+static void write_obj(const char* path, int n) {
+    FILE* f = fopen(path, "w");
+    fprintf(f, "mtllib mesh_cache_test.mtl\n");
+    for (int y = 0; y <= n; y++) {
+        for (int x = 0; x <= n; x++) {
+            fprintf(f, "v %f %f %f\n", (float)x, 0.01f * (float)(x * y % 7),
+                    (float)y);
+            fprintf(f, "vt %f %f\n", (float)x / n, (float)y / n);
+        }
+    }
+    fprintf(f, "vn 0 1 0\n");
+    for (int y = 0; y < n; y++) {
+        if (y == 0)
+            fprintf(f, "o plain\nusemtl plain\n");
+        if (y == n / 2)
+            fprintf(f, "o textured\nusemtl textured\n");
+        for (int x = 0; x < n; x++) {
+            int a = y * (n + 1) + x + 1;
+            int b = a + n + 1;
+            fprintf(f, "f %d/%d/1 %d/%d/1 %d/%d/1 %d/%d/1\n", a, a, b, b,
+                    b + 1, b + 1, a + 1, a + 1);
+        }
+    }
+    fclose(f);
+    f = fopen("build/mesh_cache_test.mtl", "w");
+    fprintf(f, "newmtl plain\nKd 0.5 0.25 1.0\n\n");
+    fprintf(f, "newmtl textured\nKd 1 1 1\nmap_Kd mesh_cache_test.png\n");
+    fclose(f);
+}
+
+static bool same_meshes(Model a, Model b) {
+    if (a.meshCount != b.meshCount)
+        return false;
+    for (int i = 0; i < a.meshCount; i++) {
+        Mesh ma = a.meshes[i];
+        Mesh mb = b.meshes[i];
+        if ((ma.vertexCount != mb.vertexCount) ||
+            (ma.triangleCount != mb.triangleCount) ||
+            (memcmp(ma.vertices, mb.vertices,
+                    sizeof(float) * 3 * ma.vertexCount) != 0) ||
+            (memcmp(ma.texcoords, mb.texcoords,
+                    sizeof(float) * 2 * ma.vertexCount) != 0) ||
+            (memcmp(ma.normals, mb.normals,
+                    sizeof(float) * 3 * ma.vertexCount) != 0) ||
+            (a.meshMaterial[i] != b.meshMaterial[i]))
+            return false;
+    }
+    return true;
+}
+
+static void test_cache(void) {
+    const char* source = "build/mesh_cache_test.obj";
+    const char* cooked =
+        "build/mesh_cache_test.obj" RENDER_MESH_CACHE_EXTENSION;
+    Image image = GenImageChecked(16, 8, 2, 2, RED, BLUE);
+    ExportImage(image, "build/mesh_cache_test.png");
+    UnloadImage(image);
+    write_obj(source, 64);
+    remove(cooked);
+
+    /* the first load cooks */
+    Model reference = LoadModel(source);
+    Model model = render_load_model_file(source);
+    CHECK(FileExists(cooked));
+    CHECK(render_model_file_get_bounds(model) != NULL);
+    CHECK(same_meshes(reference, model));
+    CHECK(model.materialCount == reference.materialCount);
+    /* materials are in the order of the MTL file */
+    CHECK(model.materials[1].maps[MATERIAL_MAP_DIFFUSE].texture.width == 16);
+    Color plain = model.materials[0].maps[MATERIAL_MAP_DIFFUSE].color;
+    Color expected = reference.materials[0].maps[MATERIAL_MAP_DIFFUSE].color;
+    CHECK(memcmp(&plain, &expected, sizeof(Color)) == 0);
+    CHECK((plain.r > plain.g) && (plain.b > plain.r));
+    const BoundingBox* bounds = render_model_file_get_bounds(model);
+    bool same_bounds = true;
+    for (int i = 0; i < model.meshCount; i++) {
+        BoundingBox box = GetMeshBoundingBox(reference.meshes[i]);
+        same_bounds =
+            same_bounds && (memcmp(&box, &bounds[i], sizeof(box)) == 0);
+    }
+    CHECK(same_bounds);
+    render_unload_model_file(model);
+
+    /* later loads map the cooked file */
+    double start = now();
+    model = render_load_model_file(source);
+    double cooked_time = now() - start;
+    CHECK(render_model_file_get_bounds(model) != NULL);
+    CHECK(same_meshes(reference, model));
+    render_unload_model_file(model);
+    start = now();
+    Model parsed = LoadModel(source);
+    double parse_time = now() - start;
+    render_unload_model_file(parsed);
+    printf("LoadModel %.2f ms, cooked %.2f ms\n", parse_time * 1e3,
+           cooked_time * 1e3);
+    render_unload_model_file(reference);
+
+    /* a changed source is cooked again */
+    write_obj(source, 32);
+    reference = LoadModel(source);
+    model = render_load_model_file(source);
+    CHECK(render_model_file_get_bounds(model) != NULL);
+    CHECK(same_meshes(reference, model));
+    render_unload_model_file(model);
+
+    /* so is a damaged cooked file */
+    FILE* f = fopen(cooked, "r+b");
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+    FILE* truncated = fopen(cooked, "wb");
+    fwrite("FLUXMESH", 1, 8, truncated);
+    fclose(truncated);
+    CHECK(render_load_cooked_model(cooked, source).meshCount == 0);
+    model = render_load_model_file(source);
+    CHECK(same_meshes(reference, model));
+    f = fopen(cooked, "rb");
+    fseek(f, 0, SEEK_END);
+    CHECK(ftell(f) == size);
+    fclose(f);
+    render_unload_model_file(model);
+
+    /* without its source, the cooked file is all there is */
+    model = render_load_cooked_model(cooked, NULL);
+    CHECK(same_meshes(reference, model));
+    render_unload_model_file(model);
+
+    /* cooked files can go to a directory of their own */
+    render_set_mesh_cache_dir("build");
+    model = render_load_model_file(source);
+    CHECK(render_model_file_get_bounds(model) != NULL);
+    CHECK(same_meshes(reference, model));
+    render_unload_model_file(model);
+    render_set_mesh_cache_dir(NULL);
+
+    /* models that are not cooked still load */
+    Model cube = LoadModelFromMesh(GenMeshCube(1, 1, 1));
+    CHECK(!render_cook_model(cube, "cube.gltf", "build/cube.fluxmesh"));
+    CHECK(render_model_file_get_bounds(cube) == NULL);
+    render_unload_model_file(cube);
+    render_unload_model_file(reference);
+    render_clear_asset_cache();
+    CHECK(render_get_asset_stats().n_textures == 0);
+
+    remove(source);
+    remove(cooked);
+    remove("build/mesh_cache_test.mtl");
+    remove("build/mesh_cache_test.png");
+}
+
+int main() {
+    hq_allocator_init_global();
+    SetConfigFlags(FLAG_WINDOW_HIDDEN);
+    InitWindow(64, 64, "mesh_cache_test");
+    SetTraceLogLevel(LOG_WARNING);
+    test_cache();
+    CloseWindow();
+    int status = check_report();
+    hq_allocator_delete_global();
+    return status;
+}
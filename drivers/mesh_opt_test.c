@@ -0,0 +1,358 @@
+#include "check.h"
+#include "hqtools/hqtools.h"
+#include "mesh_optimizer.h"
+#include "raylib.h"
+#include "rlobj.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* n x n grid of quads: positions (3 floats per vertex) and triangles */
+static void make_grid(int n, float** positions, unsigned int** indices) {
+    *positions = malloc(sizeof(float) * 3 * (n + 1) * (n + 1));
+    *indices = malloc(sizeof(unsigned int) * n * n * 6);
+    for (int y = 0; y <= n; y++) {
+        for (int x = 0; x <= n; x++) {
+            float* p = *positions + (y * (n + 1) + x) * 3;
+            p[0] = (float)x;
+            p[1] = 0;
+            p[2] = (float)y;
+        }
+    }
+    int k = 0;
+    for (int y = 0; y < n; y++) {
+        for (int x = 0; x < n; x++) {
+            unsigned int a = y * (n + 1) + x;
+            unsigned int b = a + n + 1;
+            unsigned int tri[6] = {a, b, a + 1, a + 1, b, b + 1};
+            memcpy(*indices + k, tri, sizeof(tri));
+            k += 6;
+        }
+    }
+}
+
+static void shuffle_triangles(unsigned int* indices, int n_triangles) {
+    for (int t = n_triangles - 1; t > 0; t--) {
+        int o = rand() % (t + 1);
+        unsigned int tmp[3];
+        memcpy(tmp, indices + t * 3, sizeof(tmp));
+        memcpy(indices + t * 3, indices + o * 3, sizeof(tmp));
+        memcpy(indices + o * 3, tmp, sizeof(tmp));
+    }
+}
+
+static int compare_triangles(const void* a, const void* b) {
+    const unsigned int* ta = a;
+    const unsigned int* tb = b;
+    for (int i = 0; i < 3; i++) {
+        if (ta[i] != tb[i])
+            return (ta[i] < tb[i]) ? -1 : 1;
+    }
+    return 0;
+}
+
+/* true if both lists hold the same triangles with the same winding */
+static bool same_triangles(const unsigned int* a, const unsigned int* b,
+                           int n_indices) {
+    unsigned int* ca = malloc(sizeof(unsigned int) * n_indices);
+    unsigned int* cb = malloc(sizeof(unsigned int) * n_indices);
+    const unsigned int* src[2] = {a, b};
+    unsigned int* dst[2] = {ca, cb};
+    for (int l = 0; l < 2; l++) {
+        for (int i = 0; i < n_indices; i += 3) {
+            /* rotate the smallest index first, which keeps the winding */
+            int r = 0;
+            if (src[l][i + 1] < src[l][i + r])
+                r = 1;
+            if (src[l][i + 2] < src[l][i + r])
+                r = 2;
+            for (int j = 0; j < 3; j++) {
+                dst[l][i + j] = src[l][i + (r + j) % 3];
+            }
+        }
+        qsort(dst[l], n_indices / 3, sizeof(unsigned int) * 3,
+              compare_triangles);
+    }
+    bool same = memcmp(ca, cb, sizeof(unsigned int) * n_indices) == 0;
+    free(ca);
+    free(cb);
+    return same;
+}
+
+static void test_acmr(void) {
+    unsigned int unindexed[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+    CHECK(render_vertex_cache_acmr(unindexed, 12, 12, 16) == 3.0f);
+    unsigned int quad[6] = {0, 1, 2, 2, 1, 3};
+    CHECK(render_vertex_cache_acmr(quad, 6, 4, 16) == 2.0f);
+    /* a cache of 3 forgets the first triangle before it comes back */
+    unsigned int revisit[12] = {0, 1, 2, 3, 4, 5, 0, 6, 7, 0, 1, 2};
+    CHECK(render_vertex_cache_acmr(revisit, 12, 8, 3) == 2.75f);
+    CHECK(render_vertex_cache_acmr(revisit, 12, 8, 16) == 2.0f);
+    CHECK(render_vertex_cache_acmr(NULL, 0, 0, 16) == 0.0f);
+}
+
+static void test_vertex_cache(void) {
+    int n = 64;
+    int n_vertices = (n + 1) * (n + 1);
+    int n_indices = n * n * 6;
+    float* positions;
+    unsigned int* indices;
+    make_grid(n, &positions, &indices);
+    shuffle_triangles(indices, n_indices / 3);
+    unsigned int* original = malloc(sizeof(unsigned int) * n_indices);
+    memcpy(original, indices, sizeof(unsigned int) * n_indices);
+
+    float before = render_vertex_cache_acmr(indices, n_indices, n_vertices,
+                                            RENDER_VERTEX_CACHE_SIZE);
+    render_optimize_vertex_cache(indices, n_indices, n_vertices);
+    float after = render_vertex_cache_acmr(indices, n_indices, n_vertices,
+                                           RENDER_VERTEX_CACHE_SIZE);
+    printf("vertex cache: ACMR %.3f -> %.3f\n", before, after);
+    CHECK(before > 2.0f);
+    CHECK(after < 0.8f);
+    CHECK(same_triangles(original, indices, n_indices));
+
+    render_optimize_overdraw(indices, n_indices, positions, n_vertices);
+    float overdraw = render_vertex_cache_acmr(indices, n_indices, n_vertices,
+                                              RENDER_VERTEX_CACHE_SIZE);
+    printf("overdraw: ACMR %.3f -> %.3f\n", after, overdraw);
+    CHECK(overdraw < after * 1.1f);
+    CHECK(same_triangles(original, indices, n_indices));
+
+    /* degenerate and tiny inputs are left alone */
+    unsigned int one[3] = {2, 1, 0};
+    render_optimize_vertex_cache(one, 3, 3);
+    render_optimize_overdraw(one, 3, positions, 3);
+    CHECK((one[0] == 2) && (one[1] == 1) && (one[2] == 0));
+    unsigned int degenerate[6] = {0, 0, 1, 1, 2, 3};
+    render_optimize_vertex_cache(degenerate, 6, 4);
+    CHECK(same_triangles((unsigned int[]){0, 0, 1, 1, 2, 3}, degenerate, 6));
+
+    free(original);
+    free(indices);
+    free(positions);
+}
+
+/* two nested boxes facing outwards: the outer one should be drawn first */
+static void test_overdraw(void) {
+    float positions[16 * 3];
+    for (int b = 0; b < 2; b++) {
+        float s = (b == 0) ? 1.0f : 2.0f;
+        for (int v = 0; v < 8; v++) {
+            positions[(b * 8 + v) * 3] = (v & 1) ? s : -s;
+            positions[(b * 8 + v) * 3 + 1] = (v & 2) ? s : -s;
+            positions[(b * 8 + v) * 3 + 2] = (v & 4) ? s : -s;
+        }
+    }
+    static const unsigned int box[36] = {
+        0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6, 0, 1, 4, 1, 5, 4,
+        2, 6, 3, 3, 6, 7, 0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5};
+    unsigned int indices[72];
+    for (int i = 0; i < 72; i++) {
+        indices[i] = box[i % 36] + ((i < 36) ? 0 : 8);
+    }
+    render_optimize_overdraw(indices, 72, positions, 16);
+    /* the first triangle is on the outer box */
+    CHECK(indices[0] >= 8);
+    CHECK(indices[69] < 8);
+}
+
+static void write_grid_obj(const char* path, int n) {
+    FILE* f = fopen(path, "w");
+    for (int y = 0; y <= n; y++) {
+        for (int x = 0; x <= n; x++) {
+            fprintf(f, "v %d 0 %d\n", x, y);
+            fprintf(f, "vt %g %g\n", (float)x / n, (float)y / n);
+        }
+    }
+    fprintf(f, "vn 0 1 0\n");
+    for (int y = 0; y < n; y++) {
+        for (int x = 0; x < n; x++) {
+            int a = y * (n + 1) + x + 1;
+            int b = a + n + 1;
+            fprintf(f, "f %d/%d/1 %d/%d/1 %d/%d/1 %d/%d/1\n", a, a, b, b,
+                    b + 1, b + 1, a + 1, a + 1);
+        }
+    }
+    fclose(f);
+}
+
+static void test_obj(void) {
+    const char* path = "build/mesh_opt_test.obj";
+    write_grid_obj(path, 32);
+    Model model = LoadObjDry(path);
+    CHECK(model.meshCount == 1);
+    if (model.meshCount == 1) {
+        Mesh mesh = model.meshes[0];
+        CHECK(mesh.triangleCount == 32 * 32 * 2);
+        CHECK(mesh.vertexCount == 33 * 33);
+        CHECK(mesh.indices != NULL);
+        bool attributes_match = true;
+        for (int v = 0; v < mesh.vertexCount; v++) {
+            const float* p = mesh.vertices + v * 3;
+            const float* t = mesh.texcoords + v * 2;
+            const float* n = mesh.normals + v * 3;
+            attributes_match = attributes_match &&
+                               (fabsf(p[0] / 32 - t[0]) < 1e-4f) &&
+                               (fabsf(1.0f - p[2] / 32 - t[1]) < 1e-4f) &&
+                               (n[1] == 1.0f);
+        }
+        CHECK(attributes_match);
+    }
+    UnloadModel(model);
+
+    /* more than 65535 unique vertices: split into several meshes */
+    write_grid_obj(path, 300);
+    double start = now();
+    model = LoadObjDry(path);
+    double elapsed = now() - start;
+    printf("obj: %d x %d grid in %.1f ms, %d meshes\n", 300, 300,
+           elapsed * 1e3, model.meshCount);
+    CHECK(model.meshCount >= 2);
+    int triangles = 0;
+    bool under_limit = true;
+    bool indices_in_range = true;
+    for (int i = 0; i < model.meshCount; i++) {
+        Mesh mesh = model.meshes[i];
+        triangles += mesh.triangleCount;
+        under_limit = under_limit && (mesh.vertexCount <= 65535);
+        for (int j = 0; j < mesh.triangleCount * 3; j++) {
+            indices_in_range =
+                indices_in_range && (mesh.indices[j] < mesh.vertexCount);
+        }
+    }
+    CHECK(triangles == 300 * 300 * 2);
+    CHECK(under_limit);
+    CHECK(indices_in_range);
+    UnloadModel(model);
+    remove(path);
+}
+
+/* objects, materials, polygons and invalid lines, in random order, without
+ * a final newline */
+static void write_messy_obj(const char* path, int n_objects) {
+    FILE* f = fopen(path, "w");
+    fprintf(f, "# messy\nmtllib missing.mtl\n");
+    int n_vertices = 0;
+    for (int o = 0; o < n_objects; o++) {
+        fprintf(f, "o object_%d\n", o);
+        if (o % 3 != 2)
+            fprintf(f, "usemtl material_%d\n", o % 5);
+        for (int i = 0; i < 2000; i++) {
+            int kind = rand() % 8;
+            if ((kind < 3) || (n_vertices < 8)) {
+                fprintf(f, "v %f %f %f\n", (float)rand() / RAND_MAX,
+                        (float)(rand() % 100), -(float)rand() / RAND_MAX);
+                fprintf(f, "vt %f %f\nvn 0 0 1\n", (float)rand() / RAND_MAX,
+                        (float)rand() / RAND_MAX);
+                n_vertices++;
+            } else if (kind == 3) {
+                /* the face has more triangles than its line has corners */
+                fprintf(f, "v 1 2\n# comment\n\nf 1,2,3\n");
+            } else if (kind == 4) {
+                /* a pentagon, one corner refers forwards */
+                fprintf(f, "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n",
+                        n_vertices, n_vertices, 1, n_vertices - 1,
+                        n_vertices - 1, 1, n_vertices - 2, n_vertices - 2, 1,
+                        n_vertices - 3, n_vertices - 3, 1, n_vertices + 1,
+                        n_vertices + 1, 1);
+            } else {
+                int a = 1 + rand() % n_vertices;
+                int b = 1 + rand() % n_vertices;
+                int c = 1 + rand() % n_vertices;
+                fprintf(f, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, b, b, b,
+                        c, c, c);
+            }
+        }
+        if (o % 4 == 1)
+            fprintf(f, "usemtl material_last\n");
+    }
+    fprintf(f, "f 1/1/1 2/2/2 3/3/3");
+    fclose(f);
+}
+
+static bool same_array(const void* a, const void* b, size_t size) {
+    if ((a == NULL) || (b == NULL))
+        return a == b;
+    return memcmp(a, b, size) == 0;
+}
+
+static bool same_models(Model a, Model b) {
+    if ((a.meshCount != b.meshCount) || (a.materialCount != b.materialCount))
+        return false;
+    for (int i = 0; i < a.meshCount; i++) {
+        Mesh ma = a.meshes[i];
+        Mesh mb = b.meshes[i];
+        if ((ma.vertexCount != mb.vertexCount) ||
+            (ma.triangleCount != mb.triangleCount) ||
+            (a.meshMaterial[i] != b.meshMaterial[i]))
+            return false;
+        size_t n = ma.vertexCount;
+        if (!same_array(ma.vertices, mb.vertices, sizeof(float) * 3 * n) ||
+            !same_array(ma.texcoords, mb.texcoords, sizeof(float) * 2 * n) ||
+            !same_array(ma.normals, mb.normals, sizeof(float) * 3 * n) ||
+            !same_array(ma.indices, mb.indices,
+                        sizeof(unsigned short) * 3 * ma.triangleCount))
+            return false;
+    }
+    return true;
+}
+
+/* chunked parallel scans give exactly the single threaded result */
+static void test_obj_threads(void) {
+    const char* path = "build/mesh_opt_test.obj";
+    write_messy_obj(path, 40);
+    SetObjLoaderThreads(1);
+    Model serial = LoadObjDry(path);
+    CHECK(serial.meshCount >= 40);
+    int counts[] = {2, 3, 8, 16};
+    for (int i = 0; i < 4; i++) {
+        SetObjLoaderThreads(counts[i]);
+        Model parallel = LoadObjDry(path);
+        CHECK(same_models(serial, parallel));
+        UnloadModel(parallel);
+    }
+    SetObjLoaderThreads(0);
+    UnloadModel(serial);
+
+    /* an empty file has no meshes */
+    FILE* f = fopen(path, "w");
+    fclose(f);
+    Model empty = LoadObjDry(path);
+    CHECK(empty.meshCount == 0);
+    UnloadModel(empty);
+    remove(path);
+}
+
+static void bench(int n) {
+    int n_vertices = (n + 1) * (n + 1);
+    int n_indices = n * n * 6;
+    float* positions;
+    unsigned int* indices;
+    make_grid(n, &positions, &indices);
+    shuffle_triangles(indices, n_indices / 3);
+    double start = now();
+    render_optimize_vertex_cache(indices, n_indices, n_vertices);
+    double cache = now() - start;
+    start = now();
+    render_optimize_overdraw(indices, n_indices, positions, n_vertices);
+    double overdraw = now() - start;
+    printf("bench: %d triangles, vertex cache %.2f ms, overdraw %.2f ms\n",
+           n_indices / 3, cache * 1e3, overdraw * 1e3);
+    free(indices);
+    free(positions);
+}
+
+int main() {
+    hq_allocator_init_global();
+    test_acmr();
+    test_vertex_cache();
+    test_overdraw();
+    test_obj();
+    test_obj_threads();
+    bench(256);
+    int status = check_report();
+    hq_allocator_delete_global();
+    return status;
+}
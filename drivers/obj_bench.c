@@ -0,0 +1,99 @@
+#include "check.h"
+#include "hqtools/hqtools.h"
+#include "job_pool.h"
+#include "raylib.h"
+#include "rlobj.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+static double file_megabytes(const char* path) {
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return 0;
+    return (double)st.st_size / (1024.0 * 1024.0);
+}
+
+/* n x n grid with texcoords and normals, like an exported terrain */
+static void write_grid_obj(const char* path, int n) {
+    FILE* f = fopen(path, "w");
+    for (int y = 0; y <= n; y++) {
+        for (int x = 0; x <= n; x++) {
+            float h = 0.25f * (float)((x * 7 + y * 13) % 17) / 17.0f;
+            fprintf(f, "v %f %f %f\n", (float)x * 0.1f, h, (float)y * 0.1f);
+        }
+    }
+    for (int y = 0; y <= n; y++) {
+        for (int x = 0; x <= n; x++) {
+            fprintf(f, "vt %f %f\n", (float)x / n, (float)y / n);
+        }
+    }
+    for (int y = 0; y <= n; y++) {
+        for (int x = 0; x <= n; x++) {
+            fprintf(f, "vn 0.000000 1.000000 0.000000\n");
+        }
+    }
+    for (int y = 0; y < n; y++) {
+        for (int x = 0; x < n; x++) {
+            int a = y * (n + 1) + x + 1;
+            int b = a + n + 1;
+            fprintf(f, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, b, b, b,
+                    a + 1, a + 1, a + 1);
+            fprintf(f, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", a + 1, a + 1, a + 1,
+                    b, b, b, b + 1, b + 1, b + 1);
+        }
+    }
+    fclose(f);
+}
+
+static void bench(const char* path, int reps, int n_threads) {
+    double megabytes = file_megabytes(path);
+    SetObjLoaderThreads(n_threads);
+    int n_triangles = 0;
+    int n_vertices = 0;
+    double start = now();
+    for (int r = 0; r < reps; r++) {
+        Model model = LoadObjDry(path);
+        n_triangles = 0;
+        n_vertices = 0;
+        for (int i = 0; i < model.meshCount; i++) {
+            n_triangles += model.meshes[i].triangleCount;
+            n_vertices += model.meshes[i].vertexCount;
+        }
+        UnloadModel(model);
+    }
+    double elapsed = (now() - start) / reps;
+    printf("%-32s %8.3f MB %2d threads %9d tris %9d verts %9.2f ms %8.1f "
+           "MB/s\n",
+           path, megabytes, n_threads, n_triangles, n_vertices,
+           elapsed * 1e3, megabytes / elapsed);
+}
+
+int main(int argc, char** argv) {
+    hq_allocator_init_global();
+    SetTraceLogLevel(LOG_WARNING);
+
+    int n_cores = flux_get_n_cores();
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++) {
+            bench(argv[i], 1, 1);
+            bench(argv[i], 1, n_cores);
+        }
+    } else {
+        bench("drivers/assets/blender_cube.obj", 200, 1);
+        bench("drivers/assets/gun.obj", 200, 1);
+        bench("drivers/assets/map2.obj", 200, 1);
+
+        /* big files are scanned in parallel; the rest of the load is not */
+        const char* path = "build/obj_bench.obj";
+        write_grid_obj(path, 512);
+        for (int n = 1; n < n_cores; n *= 2) {
+            bench(path, 3, n);
+        }
+        bench(path, 3, n_cores);
+        remove(path);
+    }
+
+    hq_allocator_delete_global();
+    return 0;
+}
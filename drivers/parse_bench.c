@@ -0,0 +1,221 @@
+#include "check.h"
+#include "parse_number.h"
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static double random_double(void) {
+    return ((double)rand() / RAND_MAX - 0.5) * 2000.0;
+}
+
+/* a number in one of the shapes exporters and hand edited files use */
+static void write_number(char* out, size_t size, int kind) {
+    switch (kind % 8) {
+    case 0:
+        snprintf(out, size, "%f", random_double());
+        break;
+    case 1:
+        snprintf(out, size, "%.9g", random_double() * 1e-3);
+        break;
+    case 2:
+        snprintf(out, size, "%.17g", random_double());
+        break;
+    case 3:
+        snprintf(out, size, "%g", random_double() * 1e30);
+        break;
+    case 4:
+        snprintf(out, size, "%d", rand() - RAND_MAX / 2);
+        break;
+    case 5: {
+        /* random digits, often more than fit a mantissa */
+        int n = 1 + rand() % 30;
+        int point = rand() % (n + 1);
+        char* p = out;
+        if (rand() % 2)
+            *p++ = '-';
+        for (int i = 0; i < n; i++) {
+            if (i == point)
+                *p++ = '.';
+            *p++ = (char)('0' + rand() % 10);
+        }
+        if (rand() % 2)
+            p += sprintf(p, "e%d", rand() % 80 - 40);
+        *p = '\0';
+        break;
+    }
+    case 6: {
+        /* values halfway between two floats, which must round to even */
+        float f = (float)random_double();
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+        bits++;
+        float g;
+        memcpy(&g, &bits, sizeof(g));
+        snprintf(out, size, "%.17g", ((double)f + (double)g) / 2.0);
+        break;
+    }
+    default:
+        snprintf(out, size, "%.6e", random_double() * 1e-40);
+        break;
+    }
+}
+
+static void test_exact(void) {
+    const char* fixed[] = {"0",        "-0",       "+1.5",     ".5",
+                           "5.",       "1e5",      "1E-5",     "1e",
+                           "1e+",      "-.e1",     "00012.5",  "0.000001",
+                           "inf",      "-nan",     "0x1p4",    "1e400",
+                           "1e-400",   "3.4028236e38",         "1.17549435e-38",
+                           "7e-46",    "123456789012345678901234567890",
+                           "0.1000000000000000055511151231257827"};
+    int n_fixed = sizeof(fixed) / sizeof(fixed[0]);
+    int double_mismatches = 0;
+    int float_mismatches = 0;
+    for (int i = 0; i < n_fixed; i++) {
+        char* libc_end;
+        double d_libc = strtod(fixed[i], &libc_end);
+        double d;
+        const char* end = flux_parse_double(fixed[i], NULL, &d);
+        if ((memcmp(&d, &d_libc, sizeof(d)) != 0 && d == d) ||
+            (end != libc_end)) {
+            printf("double mismatch on %s\n", fixed[i]);
+            double_mismatches++;
+        }
+        float f_libc = strtof(fixed[i], &libc_end);
+        float f;
+        end = flux_parse_float(fixed[i], NULL, &f);
+        if ((memcmp(&f, &f_libc, sizeof(f)) != 0 && f == f) ||
+            (end != libc_end)) {
+            printf("float mismatch on %s\n", fixed[i]);
+            float_mismatches++;
+        }
+    }
+    CHECK(double_mismatches == 0);
+    CHECK(float_mismatches == 0);
+
+    /* random numbers, each followed by a space as in a file */
+    char text[128];
+    double_mismatches = 0;
+    float_mismatches = 0;
+    srand(1);
+    for (int i = 0; i < 1000000; i++) {
+        write_number(text, sizeof(text) - 1, i);
+        strcat(text, " ");
+        const char* buffer_end = text + strlen(text);
+        char* libc_end;
+        double d_libc = strtod(text, &libc_end);
+        double d;
+        const char* end = flux_parse_double(text, buffer_end, &d);
+        if ((memcmp(&d, &d_libc, sizeof(d)) != 0) || (end != libc_end)) {
+            if (double_mismatches++ < 5)
+                printf("double mismatch on %s\n", text);
+        }
+        float f_libc = strtof(text, &libc_end);
+        float f;
+        end = flux_parse_float(text, buffer_end, &f);
+        if ((memcmp(&f, &f_libc, sizeof(f)) != 0) || (end != libc_end)) {
+            if (float_mismatches++ < 5)
+                printf("float mismatch on %s\n", text);
+        }
+    }
+    CHECK(double_mismatches == 0);
+    CHECK(float_mismatches == 0);
+}
+
+static void test_int(void) {
+    int out;
+    CHECK(*flux_parse_int("123/4", NULL, &out) == '/' && out == 123);
+    CHECK(*flux_parse_int("-77 ", NULL, &out) == ' ' && out == -77);
+    CHECK(*flux_parse_int("x", NULL, &out) == 'x' && out == 0);
+    CHECK(*flux_parse_int("-", NULL, &out) == '-' && out == 0);
+    flux_parse_int("99999999999999999999", NULL, &out);
+    CHECK(out == INT_MAX);
+    flux_parse_int("-2147483648", NULL, &out);
+    CHECK(out == INT_MIN);
+    flux_parse_int("-2147483649", NULL, &out);
+    CHECK(out == INT_MIN);
+    const char* digits = "000001234567890123 ";
+    CHECK(*flux_parse_int(digits, digits + strlen(digits), &out) == ' ' &&
+          out == INT_MAX);
+    digits = "1234567812 ";
+    flux_parse_int(digits, digits + strlen(digits), &out);
+    CHECK(out == 1234567812);
+    CHECK(flux_atoi("  42") == 42);
+    CHECK(flux_atof("\t-2.5e1") == -25.0);
+}
+
+/* numbers as in an OBJ file, parsed with libc and with flux_parse_* */
+static void bench(void) {
+    int n_numbers = 2000000;
+    size_t size = (size_t)n_numbers * 16;
+    char* text = malloc(size + 1);
+    char* p = text;
+    srand(2);
+    for (int i = 0; i < n_numbers; i++) {
+        if (i % 4 == 3)
+            p += sprintf(p, "%d ", rand() % 100000);
+        else
+            p += sprintf(p, "%f ", random_double());
+    }
+    *p = '\0';
+    const char* end = p;
+    double megabytes = (double)(end - text) / (1024.0 * 1024.0);
+
+    double sum_libc = 0;
+    double start = now();
+    for (char* q = text; q < end;) {
+        sum_libc += strtof(q, &q);
+        q++;
+    }
+    double libc_time = now() - start;
+
+    double sum = 0;
+    start = now();
+    for (const char* q = text; q < end;) {
+        float f;
+        q = flux_parse_float(q, end, &f) + 1;
+        sum += f;
+    }
+    double flux_time = now() - start;
+    CHECK(sum == sum_libc);
+
+    long isum_libc = 0;
+    start = now();
+    for (char* q = text; q < end;) {
+        isum_libc += strtol(q, &q, 10);
+        while (*q && *q != ' ')
+            q++;
+        q++;
+    }
+    double libc_int_time = now() - start;
+
+    long isum = 0;
+    start = now();
+    for (const char* q = text; q < end;) {
+        int i;
+        q = flux_parse_int(q, end, &i);
+        isum += i;
+        while (*q && *q != ' ')
+            q++;
+        q++;
+    }
+    double flux_int_time = now() - start;
+    CHECK(isum == isum_libc);
+
+    printf("floats: strtof %8.1f MB/s, flux_parse_float %8.1f MB/s (%.2fx)\n",
+           megabytes / libc_time, megabytes / flux_time,
+           libc_time / flux_time);
+    printf("ints:   strtol %8.1f MB/s, flux_parse_int   %8.1f MB/s (%.2fx)\n",
+           megabytes / libc_int_time, megabytes / flux_int_time,
+           libc_int_time / flux_int_time);
+    free(text);
+}
+
+int main() {
+    test_exact();
+    test_int();
+    bench();
+    return check_report();
+}
@@ -0,0 +1,233 @@
+#include "check.h"
+#include "hqtools/hqtools.h"
+#include "prefab_parser.h"
+#include "raylib.h"
+#include "scene_parser.h"
+#include "tokenizer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SCENE_PATH "build/scene_parse_bench.scene"
+#define PREFAB_PATH "build/scene_parse_bench.prefab"
+#define EDGE_PATH "build/scene_parse_bench_edge.scene"
+#define SEED 1234
+/* every ARGS_EVERY-th game object has extra arguments */
+#define ARGS_EVERY 1000
+
+static const char* prefab_names[] = {"rock", "tree", "bush", "crate"};
+
+/* the i-th game object's line, after srand(SEED) */
+static int format_gameobject(char* out, size_t size, int i) {
+    float x = ((float)rand() / RAND_MAX - 0.5f) * 4096.0f;
+    float z = ((float)rand() / RAND_MAX - 0.5f) * 4096.0f;
+    float yaw = (float)rand() / RAND_MAX * 6.283f;
+    float scale = 0.5f + (float)rand() / RAND_MAX;
+    int n = snprintf(out, size,
+                     "sceneGameObject = %s,%.3f,0,%.3f,0,%.4f,0,%.2f,%.2f,"
+                     "%.2f",
+                     prefab_names[i % 4], x, z, yaw, scale, scale, scale);
+    if ((i % ARGS_EVERY) == 0)
+        n += snprintf(out + n, size - n, ",id:%d, tag:bench", i);
+    return n;
+}
+
+/* the transform format_gameobject() wrote, parsed with libc */
+static fluxTransform expected_transform(const char* line) {
+    fluxTransform transform;
+    const char* p = strchr(line, ',') + 1;
+    float* out[9] = {&transform.pos.x,   &transform.pos.y,
+                     &transform.pos.z,   &transform.rot.x,
+                     &transform.rot.y,   &transform.rot.z,
+                     &transform.scale.x, &transform.scale.y,
+                     &transform.scale.z};
+    for (int k = 0; k < 9; k++) {
+        char* end;
+        *out[k] = strtof(p, &end);
+        p = end + 1;
+    }
+    return transform;
+}
+
+static size_t write_scene(int n_objects) {
+    FILE* f = fopen(PREFAB_PATH, "w");
+    fprintf(f, "prefabName = rock\nprefabModel = CUBE\n");
+    fprintf(f, "prefabScripts = spin, bob\nprefabTint = 10,20,30,255\n");
+    fprintf(f, "prefabLODBias = 1.5\n");
+    fclose(f);
+
+    f = fopen(SCENE_PATH, "w");
+    fprintf(f, "sceneName = scene_parse_bench\n");
+    fprintf(f, "scenePrefabs = %s\n", PREFAB_PATH);
+    srand(SEED);
+    char line[256];
+    for (int i = 0; i < n_objects; i++) {
+        format_gameobject(line, sizeof(line), i);
+        fprintf(f, "%s\n", line);
+    }
+    size_t size = (size_t)ftell(f);
+    fclose(f);
+    return size;
+}
+
+/* everything the tokenizer has to step over or split */
+static void check_edge_cases(void) {
+    FILE* f = fopen(EDGE_PATH, "wb");
+    fprintf(f, "\n\n  sceneName   =  edge case  \r\n");
+    fprintf(f, "sceneGameObject=rock,1,2,3,4,5,6,7,8,9\r\n");
+    fprintf(f, "\t\r\n");
+    fprintf(f, "this line has no equals sign\n");
+    fprintf(f, "sceneCellSize = 16 = 32\n");
+    fprintf(f, " = 3\n");
+    fprintf(f, "sceneCellSize =\n");
+    fprintf(f, "sceneGameObject = tree , -1.5, 0,0, 0,0,0, 1,1,1, a b ,,c,\n");
+    fprintf(f, "sceneCellRadius = 10,20");
+    fclose(f);
+
+    fluxParsedScene scene = parser_read_scene(EDGE_PATH);
+    CHECK(strcmp(hstr_unpack(parser_parsed_scene_get_name(scene)),
+                 "edge case") == 0);
+    CHECK(parser_parsed_scene_get_n_gameobjects(scene) == 2);
+    CHECK(parser_parsed_scene_get_cell_size(scene) == 64.0f);
+    CHECK(parser_parsed_scene_get_load_radius(scene) == 10.0f);
+    CHECK(parser_parsed_scene_get_unload_radius(scene) == 20.0f);
+
+    fluxParsedGameObject rock = parser_parsed_scene_get_gameobject(scene, 0);
+    fluxTransform transform = parser_parsed_gameobject_get_transform(rock);
+    CHECK(strcmp(hstr_unpack(parser_parsed_gameobject_get_prefab_name(rock)),
+                 "rock") == 0);
+    CHECK((transform.pos.x == 1.0f) && (transform.rot.y == 5.0f) &&
+          (transform.scale.z == 9.0f));
+    CHECK(hstr_array_len(parser_parsed_gameobject_get_args(rock)) == 0);
+
+    fluxParsedGameObject tree = parser_parsed_scene_get_gameobject(scene, 1);
+    transform = parser_parsed_gameobject_get_transform(tree);
+    hstrArray args = parser_parsed_gameobject_get_args(tree);
+    CHECK(strcmp(hstr_unpack(parser_parsed_gameobject_get_prefab_name(tree)),
+                 "tree") == 0);
+    CHECK(transform.pos.x == -1.5f);
+    CHECK(hstr_array_len(args) == 2);
+    CHECK(strcmp(hstr_unpack(hstr_array_get(args, 0)), "a b") == 0);
+    CHECK(strcmp(hstr_unpack(hstr_array_get(args, 1)), "c") == 0);
+    parser_delete_parsed_scene(scene);
+    remove(EDGE_PATH);
+
+    scene = parser_read_scene("build/scene_parse_bench_missing.scene");
+    CHECK(parser_parsed_scene_get_name(scene) == NULL);
+    CHECK(parser_parsed_scene_get_n_gameobjects(scene) == 0);
+    parser_delete_parsed_scene(scene);
+}
+
+int main(int argc, char** argv) {
+    hq_allocator_init_global();
+    SetTraceLogLevel(LOG_WARNING);
+    int n_objects = 1000000;
+    if (argc >= 2)
+        n_objects = atoi(argv[1]);
+
+    int n_alive = hq_allocator_get_n_alive(hq_global_allocator);
+    check_edge_cases();
+    CHECK(hq_allocator_get_n_alive(hq_global_allocator) == n_alive);
+
+    double start = now();
+    size_t file_size = write_scene(n_objects);
+    printf("wrote %d game objects, %.1f MB in %.1f s\n", n_objects,
+           (double)file_size / (1024.0 * 1024.0), now() - start);
+
+    /* tokenizing alone */
+    start = now();
+    fluxTokenizer tokenizer;
+    CHECK(parser_open_tokenizer(&tokenizer, SCENE_PATH));
+    int n_lines = 0;
+    size_t tokenizer_bytes = hq_allocator_get_alive_bytes(hq_global_allocator);
+    while (parser_next_line(&tokenizer))
+        n_lines++;
+    CHECK(hq_allocator_get_alive_bytes(hq_global_allocator) ==
+          tokenizer_bytes);
+    parser_close_tokenizer(&tokenizer);
+    double tokenize_time = now() - start;
+    CHECK(n_lines == n_objects + 2);
+
+    size_t start_bytes = hq_allocator_get_alive_bytes(hq_global_allocator);
+    start = now();
+    fluxParsedScene scene = parser_read_scene(SCENE_PATH);
+    double parse_time = now() - start;
+    size_t scene_bytes =
+        hq_allocator_get_alive_bytes(hq_global_allocator) - start_bytes;
+    int scene_allocations =
+        hq_allocator_get_n_alive(hq_global_allocator) - n_alive;
+
+    CHECK(strcmp(hstr_unpack(parser_parsed_scene_get_name(scene)),
+                 "scene_parse_bench") == 0);
+    CHECK(parser_parsed_scene_get_n_prefabs(scene) == 1);
+    fluxParsedPrefab prefab = parser_parsed_scene_get_prefab(scene, 0);
+    CHECK(strcmp(hstr_unpack(parser_parsed_prefab_get_name(prefab)),
+                 "rock") == 0);
+    CHECK(hstr_array_len(parser_parsed_prefab_get_scripts(prefab)) == 2);
+    CHECK(strcmp(hstr_unpack(hstr_array_get(
+                     parser_parsed_prefab_get_scripts(prefab), 1)),
+                 "bob") == 0);
+    CHECK(parser_parsed_prefab_get_tint(prefab).g == 20);
+    CHECK(parser_parsed_prefab_get_lod_bias(prefab) == 1.5f);
+    CHECK(parser_parsed_scene_get_n_gameobjects(scene) == n_objects);
+
+    /* every game object, against libc parsing the same text */
+    srand(SEED);
+    char line[256];
+    int n_wrong = 0;
+    int n_with_args = 0;
+    for (int i = 0;
+         (i < n_objects) && (i < parser_parsed_scene_get_n_gameobjects(scene));
+         i++) {
+        format_gameobject(line, sizeof(line), i);
+        fluxTransform expected = expected_transform(line);
+        fluxParsedGameObject gameobject =
+            parser_parsed_scene_get_gameobject(scene, i);
+        fluxTransform transform =
+            parser_parsed_gameobject_get_transform(gameobject);
+        hstrArray args = parser_parsed_gameobject_get_args(gameobject);
+        bool right =
+            (memcmp(&transform, &expected, sizeof(fluxTransform)) == 0) &&
+            (strcmp(hstr_unpack(
+                        parser_parsed_gameobject_get_prefab_name(gameobject)),
+                    prefab_names[i % 4]) == 0);
+        if ((i % ARGS_EVERY) == 0) {
+            n_with_args++;
+            right = right && (hstr_array_len(args) == 2) &&
+                    (strcmp(hstr_unpack(hstr_array_get(args, 1)),
+                            "tag:bench") == 0);
+        } else {
+            right = right && (hstr_array_len(args) == 0);
+        }
+        if (!right)
+            n_wrong++;
+    }
+    CHECK(n_wrong == 0);
+
+    /* memory: the scene's own array of game objects, plus what the few with
+     * arguments need; nothing per line, and nothing the size of the file */
+    int args_allocations = 6 * n_with_args;
+    CHECK(scene_allocations <= 64 + args_allocations);
+    double object_bytes = (double)scene_bytes / (double)n_objects;
+    CHECK(object_bytes <= 160.0);
+    CHECK(scene_bytes < file_size * 2);
+
+    parser_delete_parsed_scene(scene);
+    CHECK(hq_allocator_get_n_alive(hq_global_allocator) == n_alive);
+
+    double mb = (double)file_size / (1024.0 * 1024.0);
+    printf("tokenize: %.3f s, %.0f MB/s\n", tokenize_time,
+           mb / tokenize_time);
+    printf("parse: %.3f s, %.0f MB/s, %.2f M game objects/s\n", parse_time,
+           mb / parse_time, n_objects / parse_time * 1e-6);
+    printf("parsed scene: %.1f MB in %d allocations, %.0f bytes per game "
+           "object\n",
+           (double)scene_bytes / (1024.0 * 1024.0), scene_allocations,
+           object_bytes);
+
+    remove(SCENE_PATH);
+    remove(PREFAB_PATH);
+    int status = check_report();
+    hq_allocator_delete_global();
+    return status;
+}
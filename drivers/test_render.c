@@ -92,6 +92,88 @@ static void get_visible_meshes_callback(int n_args, const char** args) {
     TraceLog(LOG_INFO, "%d", render_get_visible_meshes());
 }
 
+static void draw_calls_callback(int n_args, const char** args) {
+    TraceLog(LOG_INFO, "draw calls: %d (%d instanced)",
+             render_get_draw_calls(), render_get_instanced_draw_calls());
+}
+
+static void cull_stats_callback(int n_args, const char** args) {
+    TraceLog(LOG_INFO, "visible meshes: %d, corner transforms saved: %lld",
+             render_get_visible_meshes(),
+             render_get_corner_transforms_saved());
+}
+
+static void instance_memory_callback(int n_args, const char** args) {
+    TraceLog(LOG_INFO, "instance memory: %.1f KB",
+             (float)render_get_instance_memory() / 1024.0f);
+}
+
+static void shadow_casters_callback(int n_args, const char** args) {
+    for (int i = 0; i < FLUX_MAX_LIGHTS; i++) {
+        if (!render_light_is_enabled(i))
+            continue;
+        TraceLog(LOG_INFO, "light %d: %d visible casters", i,
+                 render_light_get_visible_casters(i));
+    }
+}
+
+static void shadow_cache_callback(int n_args, const char** args) {
+    TraceLog(LOG_INFO, "shadow maps: %d rendered, %d cached",
+             render_get_shadow_maps_rendered(),
+             render_get_shadow_maps_cached());
+}
+
+static void shadow_atlas_callback(int n_args, const char** args) {
+    int res = render_get_shadow_atlas_res();
+    TraceLog(LOG_INFO, "shadow atlas %dx%d (%s), %.1f%% used", res, res,
+             render_shadow_atlas_is_loaded() ? "loaded" : "not loaded",
+             render_get_shadow_atlas_occupancy() * 100.0f);
+    for (int i = 0; i < FLUX_MAX_LIGHTS; i++) {
+        if (!render_light_is_enabled(i))
+            continue;
+        TraceLog(LOG_INFO, "light %d: %dx%d", i,
+                 render_light_get_shadow_res(i),
+                 render_light_get_shadow_res(i));
+    }
+}
+
+static void render_queue_callback(int n_args, const char** args) {
+    TraceLog(LOG_INFO, "render queue: %d items", render_get_queue_items());
+    TraceLog(LOG_INFO, "shader binds: %d (%d unsorted)",
+             render_get_shader_binds(), render_get_unsorted_shader_binds());
+    TraceLog(LOG_INFO, "texture binds: %d (%d unsorted)",
+             render_get_texture_binds(), render_get_unsorted_texture_binds());
+}
+
+static void cull_threads_callback(int n_args, const char** args) {
+    if (n_args >= 2)
+        render_set_cull_threads(atoi(args[1]));
+    TraceLog(LOG_INFO, "cull_threads = %d", render_get_cull_threads());
+}
+
+static void occlusion_callback(int n_args, const char** args) {
+    if (n_args >= 2)
+        render_set_occlusion(atoi(args[1]) != 0);
+    TraceLog(LOG_INFO, "occlusion = %d", render_get_occlusion());
+    TraceLog(LOG_INFO, "%d occluder triangles, %d occluded instances",
+             render_get_occluder_triangles(),
+             render_get_occluded_instances());
+}
+
+static void lod_stats_callback(int n_args, const char** args) {
+    long long drawn = render_get_triangles_drawn();
+    long long full = render_get_triangles_full();
+    TraceLog(LOG_INFO, "triangles: %lld drawn, %lld without lods (%.1f%%)",
+             drawn, full, full > 0 ? 100.0 * (double)drawn / (double)full : 0);
+}
+
+static void instancing_threshold_callback(int n_args, const char** args) {
+    if (n_args >= 2)
+        render_set_instancing_threshold(atoi(args[1]));
+    TraceLog(LOG_INFO, "instancing_threshold = %d",
+             render_get_instancing_threshold());
+}
+
 static void set_fps_max_callback(int n_args, const char** args) {
     if (n_args < 2)
         return;
@@ -126,6 +208,18 @@ int main() {
     editor_add_console_command("disable_mouse", disable_mouse_callback);
     editor_add_console_command("get_visible_meshes",
                                get_visible_meshes_callback);
+    editor_add_console_command("draw_calls", draw_calls_callback);
+    editor_add_console_command("instancing_threshold",
+                               instancing_threshold_callback);
+    editor_add_console_command("cull_stats", cull_stats_callback);
+    editor_add_console_command("instance_memory", instance_memory_callback);
+    editor_add_console_command("shadow_casters", shadow_casters_callback);
+    editor_add_console_command("shadow_cache", shadow_cache_callback);
+    editor_add_console_command("shadow_atlas", shadow_atlas_callback);
+    editor_add_console_command("render_queue", render_queue_callback);
+    editor_add_console_command("cull_threads", cull_threads_callback);
+    editor_add_console_command("occlusion", occlusion_callback);
+    editor_add_console_command("lod_stats", lod_stats_callback);
     editor_add_console_command("fps_max", set_fps_max_callback);
     editor_add_console_command("toggle_fullscreen", toggle_fullscreen_callback);
     editor_add_console_command("set_window_size", set_window_size_callback);
@@ -183,6 +277,7 @@ int main() {
     renderModel sphere_rmodel = render_make_model(sphere);
     renderModel plane_model = render_make_model(plane);
     renderModel gun_model = render_make_model(gun);
+    render_model_set_occluder(gun_model, true);
 
     while (!WindowShouldClose() && !do_quit) {
 
@@ -0,0 +1,306 @@
+#include "asset_registry.h"
+#include "asset_stream.h"
+#include "check.h"
+#include "gameobject.h"
+#include "hqtools/hqtools.h"
+#include "mesh_cache.h"
+#include "raylib.h"
+#include "scene.h"
+#include "world.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CELL_SIZE 32.0f
+#define LOAD_RADIUS 64.0f
+#define UNLOAD_RADIUS 96.0f
+#define FRAME_TIME (1.0 / 60.0)
+
+static int cells_per_side = 100;
+static int objects_per_cell = 100;
+
+static const char* cell_path(int x, int z) {
+    return TextFormat("build/world_bench_%d_%d.scene", x, z);
+}
+
+/* a world of cells_per_side^2 cells, each with objects_per_cell trees and
+ * rocks, both world prefabs */
+static void write_world(void) {
+    FILE* f = fopen("build/world_bench_tree.obj", "w");
+    fprintf(f, "v 0 0 0\nv 1 0 0\nv 1 2 0\nv 0 2 0\nvn 0 0 1\n");
+    fprintf(f, "f 1//1 2//1 3//1 4//1\n");
+    fclose(f);
+    f = fopen("build/world_bench_tree.prefab", "w");
+    fprintf(f, "prefabName = tree\n");
+    fprintf(f, "prefabModel = build/world_bench_tree.obj\n");
+    fclose(f);
+    f = fopen("build/world_bench_rock.prefab", "w");
+    fprintf(f, "prefabName = rock\nprefabModel = CUBE\n");
+    fclose(f);
+    f = fopen("build/world_bench_cam.prefab", "w");
+    fprintf(f, "prefabName = cam\nprefabIsCamera = true\n");
+    fclose(f);
+
+    f = fopen("build/world_bench.scene", "w");
+    fprintf(f, "sceneName = world_bench\n");
+    fprintf(f, "scenePrefabs = build/world_bench_cam.prefab\n");
+    fprintf(f, "sceneWorldPrefabs = build/world_bench_tree.prefab,"
+               "build/world_bench_rock.prefab\n");
+    fprintf(f, "sceneCellSize = %g\n", CELL_SIZE);
+    fprintf(f, "sceneCellRadius = %g,%g\n", LOAD_RADIUS, UNLOAD_RADIUS);
+    fprintf(f, "sceneGameObject = cam,16,2,16,0,0,0,1,1,1\n");
+    for (int z = 0; z < cells_per_side; z++) {
+        for (int x = 0; x < cells_per_side; x++) {
+            fprintf(f, "sceneCell = %d,%d,%s\n", x, z, cell_path(x, z));
+        }
+    }
+    fclose(f);
+
+    for (int z = 0; z < cells_per_side; z++) {
+        for (int x = 0; x < cells_per_side; x++) {
+            f = fopen(cell_path(x, z), "w");
+            for (int i = 0; i < objects_per_cell; i++) {
+                float px = (x + (float)rand() / RAND_MAX) * CELL_SIZE;
+                float pz = (z + (float)rand() / RAND_MAX) * CELL_SIZE;
+                float yaw = (float)rand() / RAND_MAX * 6.0f;
+                fprintf(f, "sceneGameObject = %s,%.3f,0,%.3f,0,%.3f,0,1,1,1\n",
+                        (i % 2) ? "tree" : "rock", px, pz, yaw);
+            }
+            fclose(f);
+        }
+    }
+}
+
+static void remove_world(void) {
+    for (int z = 0; z < cells_per_side; z++) {
+        for (int x = 0; x < cells_per_side; x++) {
+            remove(cell_path(x, z));
+        }
+    }
+    remove("build/world_bench.scene");
+    remove("build/world_bench_cam.prefab");
+    remove("build/world_bench_rock.prefab");
+    remove("build/world_bench_tree.prefab");
+    remove("build/world_bench_tree.obj");
+    remove("build/world_bench_tree.obj" RENDER_MESH_CACHE_EXTENSION);
+}
+
+/* a scene with one tall object, whose model streams in */
+static void write_tower(void) {
+    FILE* f = fopen("build/world_bench_tower.obj", "w");
+    fprintf(f, "v 0 0 0\nv 1 0 0\nv 1 10 0\nv 0 10 0\nvn 0 0 1\n");
+    fprintf(f, "f 1//1 2//1 3//1 4//1\n");
+    fclose(f);
+    remove("build/world_bench_tower.obj" RENDER_MESH_CACHE_EXTENSION);
+    f = fopen("build/world_bench_tower.prefab", "w");
+    fprintf(f, "prefabName = tower\n");
+    fprintf(f, "prefabModel = build/world_bench_tower.obj\n");
+    fclose(f);
+    f = fopen("build/world_bench_tower.scene", "w");
+    fprintf(f, "sceneName = tower\n");
+    fprintf(f, "scenePrefabs = build/world_bench_tower.prefab\n");
+    fprintf(f, "sceneGameObject = tower,5,0,5,0,0,0,1,1,1\n");
+    fclose(f);
+}
+
+static void remove_tower(void) {
+    remove("build/world_bench_tower.scene");
+    remove("build/world_bench_tower.prefab");
+    remove("build/world_bench_tower.obj");
+    remove("build/world_bench_tower.obj" RENDER_MESH_CACHE_EXTENSION);
+}
+
+static int peak_cells = 0;
+static int peak_objects = 0;
+static size_t peak_bytes = 0;
+static double peak_frame = 0;
+static double total_frame = 0;
+static int n_frames = 0;
+
+static void move_camera(float x, float z) {
+    fluxGameObject camera = flux_scene_get_active_camera();
+    fluxTransform transform = flux_gameobject_get_transform(camera);
+    transform.pos.x = x;
+    transform.pos.z = z;
+    flux_gameobject_set_transform(camera, transform);
+}
+
+/* one frame of the game loop, without drawing, paced to FRAME_TIME */
+static void frame(void) {
+    double start = GetTime();
+    render_update_asset_stream();
+    flux_scene_update_streaming();
+    flux_update_world();
+    double elapsed = GetTime() - start;
+
+    n_frames++;
+    total_frame += elapsed;
+    if (elapsed > peak_frame)
+        peak_frame = elapsed;
+    if (flux_world_get_resident_cells() > peak_cells)
+        peak_cells = flux_world_get_resident_cells();
+    if (flux_world_get_resident_objects() > peak_objects)
+        peak_objects = flux_world_get_resident_objects();
+    size_t bytes = hq_allocator_get_alive_bytes(hq_global_allocator);
+    if (bytes > peak_bytes)
+        peak_bytes = bytes;
+    if (elapsed < FRAME_TIME)
+        WaitTime(FRAME_TIME - elapsed);
+}
+
+/* runs frames until every cell around the camera is in */
+static int settle(void) {
+    int frames = 0;
+    while (((flux_world_get_pending_cells() > 0) ||
+            (render_get_stream_pending() > 0) || !flux_scene_is_ready() ||
+            (frames == 0)) &&
+           (frames < 10000)) {
+        frame();
+        frames++;
+    }
+    return frames;
+}
+
+int main(int argc, char** argv) {
+    hq_allocator_init_global();
+    if (argc >= 3) {
+        cells_per_side = atoi(argv[1]);
+        objects_per_cell = atoi(argv[2]);
+    }
+    SetConfigFlags(FLAG_WINDOW_HIDDEN);
+    InitWindow(64, 64, "world_bench");
+    SetTraceLogLevel(LOG_WARNING);
+
+    double start = GetTime();
+    write_world();
+    long long total_objects =
+        (long long)cells_per_side * cells_per_side * objects_per_cell;
+    printf("wrote %d cells, %lld game objects in %.1f s\n",
+           cells_per_side * cells_per_side, total_objects,
+           GetTime() - start);
+
+    int n_alive = hq_allocator_get_n_alive(hq_global_allocator);
+    flux_reset_scene();
+    flux_load_scene("build/world_bench.scene");
+    CHECK(flux_world_is_open());
+    CHECK(flux_world_get_n_cells() == cells_per_side * cells_per_side);
+    CHECK(flux_scene_get_active_camera() != NULL);
+    size_t world_bytes = hq_allocator_get_alive_bytes(hq_global_allocator);
+
+    settle();
+    int start_cells = flux_world_get_resident_cells();
+    size_t start_bytes = hq_allocator_get_alive_bytes(hq_global_allocator);
+    CHECK(start_cells > 0);
+    CHECK(flux_world_get_resident_objects() ==
+          start_cells * objects_per_cell);
+    CHECK(flux_world_get_loaded_prefabs() == 2);
+    double object_bytes = (double)(start_bytes - world_bytes) /
+                          (double)(start_cells * objects_per_cell);
+    peak_bytes = 0;
+
+    /* fly across the world's diagonal */
+    float world_size = cells_per_side * CELL_SIZE;
+    float speed = 8.0f;
+    float distance = (world_size - CELL_SIZE) * 1.41421356f;
+    int path_frames = (int)(distance / speed);
+    start = GetTime();
+    for (int i = 0; i <= path_frames; i++) {
+        float t = 16.0f + (world_size - CELL_SIZE) * i / path_frames;
+        move_camera(t, t);
+        frame();
+    }
+    double path_time = GetTime() - start;
+    settle();
+    CHECK(flux_world_get_pending_cells() == 0);
+    CHECK(flux_world_get_resident_objects() ==
+          flux_world_get_resident_cells() * objects_per_cell);
+
+    /* cells within the unload radius of a point, what may be resident */
+    int span = (int)(2.0f * UNLOAD_RADIUS / CELL_SIZE) + 2;
+    CHECK(peak_cells <= span * span);
+    CHECK(peak_objects <= span * span * objects_per_cell);
+    /* memory grows with the resident game objects, not the world */
+    CHECK(peak_bytes <= world_bytes + 2.0 * object_bytes * peak_objects);
+
+    /* moving back and forth less than the radius gap loads nothing new */
+    move_camera(world_size - 24.0f, world_size - 24.0f);
+    settle();
+    move_camera(world_size - 8.0f, world_size - 8.0f);
+    settle();
+    int resident = flux_world_get_resident_cells();
+    bool steady = true;
+    for (int i = 0; i < 60; i++) {
+        float t = world_size - ((i % 2) ? 24.0f : 8.0f);
+        move_camera(t, t);
+        frame();
+        steady = steady && (flux_world_get_pending_cells() == 0) &&
+                 (flux_world_get_resident_cells() == resident);
+    }
+    CHECK(steady);
+
+    /* teleporting away and back before the cells left behind were taken in:
+     * the world's thread skips them while they are unwanted, and they are
+     * parsed again once the camera is back */
+    for (int i = 0; i < 10; i++) {
+        move_camera(16.0f, 16.0f);
+        flux_update_world();
+        move_camera(world_size - 16.0f, world_size - 16.0f);
+        flux_update_world();
+        WaitTime(0.02);
+        move_camera(16.0f, 16.0f);
+        flux_update_world();
+    }
+    settle();
+    CHECK(flux_world_get_pending_cells() == 0);
+    CHECK(flux_world_get_resident_objects() ==
+          flux_world_get_resident_cells() * objects_per_cell);
+
+    printf("%d frames, %.1f s across %.0f units\n", path_frames + 1,
+           path_time, distance);
+    printf("peak resident: %d/%d cells, %d/%lld game objects, %.1f MB\n",
+           peak_cells, cells_per_side * cells_per_side, peak_objects,
+           total_objects, (double)peak_bytes / (1024.0 * 1024.0));
+    printf("%.1f MB for the scene and cell index, %.0f bytes per game "
+           "object\n",
+           (double)world_bytes / (1024.0 * 1024.0), object_bytes);
+    printf("streaming per frame: %.3f ms average, %.3f ms peak (budget %.1f "
+           "ms)\n",
+           total_frame / n_frames * 1000.0, peak_frame * 1000.0,
+           flux_get_world_budget() * 1000.0);
+
+    /* a scene loading in the background gets its streamed model while the
+     * world is still queried; its object is refitted in its own tree, and
+     * the world's tree is left alone */
+    write_tower();
+    flux_load_scene_async("build/world_bench_tower.scene", NULL, NULL);
+    BoundingBox around = {{0.0f, -10.0f, 0.0f}, {world_size, 10.0f, 64.0f}};
+    fluxGameObject found[4];
+    bool world_intact = true;
+    int load_frames = 0;
+    while (flux_scene_is_loading() && (load_frames < 10000)) {
+        frame();
+        flux_update_scene_load();
+        if (flux_scene_is_loading() && (flux_scene_get_tree_proxies() > 0))
+            world_intact = world_intact &&
+                           (flux_scene_query_box(around, found, 4) >= 0);
+        load_frames++;
+    }
+    CHECK(!flux_scene_is_loading());
+    CHECK(world_intact);
+    CHECK(!flux_world_is_open());
+    BoundingBox top = {{4.0f, 8.0f, 4.0f}, {7.0f, 9.0f, 6.0f}};
+    CHECK(flux_scene_query_box(top, found, 4) == 1);
+
+    flux_close_scene();
+    CHECK(!flux_world_is_open());
+    render_close_asset_stream();
+    render_clear_asset_cache();
+    CHECK(hq_allocator_get_n_alive(hq_global_allocator) == n_alive);
+
+    CloseWindow();
+    remove_world();
+    remove_tower();
+    int status = check_report();
+    hq_allocator_delete_global();
+    return status;
+}
@@ -3,6 +3,8 @@
  *
  */
 
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #define HQTOOLS_DONT_REPLACE_MALLOC
@@ -45,7 +47,11 @@ typedef struct hqAllocatorInternal {
     /*! \brief Number of alive `allocation`s */
     int n_alive;
 
-    /*! \brief Number of total `allocation`s (alive or otherwise) */
+    /*! \brief Total size of the alive `allocation`s */
+    size_t alive_bytes;
+
+    /*! \brief Number of `allocation`s in use (alive or dead, dead ones are
+     * reused) */
     int n_total;
 
     /*! \brief Number of total `allocation`s allocated for this `hqAllocator`
@@ -55,6 +61,24 @@ typedef struct hqAllocatorInternal {
     /*! \brief Pointer to `struct allocation`s */
     allocation* allocations;
 
+    /*! \brief Indices of dead `allocation`s, reused before growing */
+    int* dead;
+
+    /*! \brief Number of indices in `dead` */
+    int n_dead;
+
+    /*! \brief Open addressing table from alive pointers to the index of
+     * their `allocation` plus one (0 marks an empty bucket), so frees do not
+     * scan every `allocation` */
+    int* buckets;
+
+    /*! \brief Number of buckets, a power of two */
+    int n_buckets;
+
+    /*! \brief Serializes allocations from several threads. Recursive, as
+     * logging from inside the allocator may allocate again. */
+    pthread_mutex_t lock;
+
 } hqAllocatorInternal;
 
 /*!
@@ -76,11 +100,23 @@ void hq_allocator_init(hqAllocator* allocator, const char* name) {
     assert(*allocator =
                (hqAllocator)malloc(sizeof(struct hqAllocatorInternal)));
     (*allocator)->n_alive = 0;
+    (*allocator)->alive_bytes = 0;
     (*allocator)->n_total = 0;
     (*allocator)->n_preallocated = 10;
     assert((*allocator)->allocations = (allocation*)malloc(
                sizeof(allocation) * (*allocator)->n_preallocated));
+    assert((*allocator)->dead =
+               (int*)malloc(sizeof(int) * (*allocator)->n_preallocated));
+    (*allocator)->n_dead = 0;
+    (*allocator)->n_buckets = 64;
+    assert((*allocator)->buckets =
+               (int*)calloc((*allocator)->n_buckets, sizeof(int)));
     (*allocator)->name = name;
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&(*allocator)->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
     //LOG(DEBUG, "initialized allocator %s", name);
 }
 
@@ -120,8 +156,11 @@ void hq_allocator_delete(hqAllocator allocator) {
     if(allocator->n_alive != n_alive)
              printf("allocator got number of alive pointers wrong\n");
     free(allocator->allocations);
+    free(allocator->dead);
+    free(allocator->buckets);
     printf("deleted allocator %s (n_total = %d, n_alive = %d)\n",
         allocator->name, allocator->n_total, allocator->n_alive);
+    pthread_mutex_destroy(&allocator->lock);
     free(allocator);
 }
 
@@ -142,6 +181,86 @@ static void grow_allocations(hqAllocator allocator) {
     allocator->n_preallocated *= 2;
     allocator->allocations = (allocation*)realloc(
         allocator->allocations, sizeof(allocation) * allocator->n_preallocated);
+    allocator->dead = (int*)realloc(allocator->dead,
+                                    sizeof(int) * allocator->n_preallocated);
+}
+
+/*!
+ * \brief Gets the first bucket to probe for a pointer.
+ */
+static int hash_pointer(hqAllocator allocator, void* ptr) {
+    uint64_t h = (uint64_t)(uintptr_t)ptr;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return (int)(h & (uint64_t)(allocator->n_buckets - 1));
+}
+
+/*!
+ * \brief Finds the bucket of an alive pointer.
+ *
+ * \return The bucket, or -1 if `ptr` is not alive in `allocator`.
+ */
+static int find_bucket(hqAllocator allocator, void* ptr) {
+    int mask = allocator->n_buckets - 1;
+    for (int b = hash_pointer(allocator, ptr);; b = (b + 1) & mask) {
+        int slot = allocator->buckets[b];
+        if (slot == 0)
+            return -1;
+        if (allocator->allocations[slot - 1].ptr == ptr)
+            return b;
+    }
+}
+
+/*!
+ * \brief Adds the `allocation` at index `slot` to the bucket table.
+ */
+static void insert_bucket(hqAllocator allocator, int slot) {
+    int mask = allocator->n_buckets - 1;
+    int b = hash_pointer(allocator, allocator->allocations[slot].ptr);
+    while (allocator->buckets[b] != 0)
+        b = (b + 1) & mask;
+    allocator->buckets[b] = slot + 1;
+}
+
+/*!
+ * \brief Doubles the bucket table when it is half full.
+ */
+static void grow_buckets(hqAllocator allocator) {
+    if (2 * (allocator->n_alive + 1) <= allocator->n_buckets)
+        return;
+    int* old = allocator->buckets;
+    int n_old = allocator->n_buckets;
+    allocator->n_buckets *= 2;
+    assert(allocator->buckets =
+               (int*)calloc(allocator->n_buckets, sizeof(int)));
+    for (int b = 0; b < n_old; b++) {
+        if (old[b] != 0)
+            insert_bucket(allocator, old[b] - 1);
+    }
+    free(old);
+}
+
+/*!
+ * \brief Empties a bucket, moving later entries of its probe run back so
+ * lookups still find them.
+ */
+static void remove_bucket(hqAllocator allocator, int bucket) {
+    int mask = allocator->n_buckets - 1;
+    int hole = bucket;
+    allocator->buckets[hole] = 0;
+    for (int b = (hole + 1) & mask; allocator->buckets[b] != 0;
+         b = (b + 1) & mask) {
+        int slot = allocator->buckets[b];
+        int home =
+            hash_pointer(allocator, allocator->allocations[slot - 1].ptr);
+        // move it if its home is not cyclically in (hole, b]
+        if (((b - home) & mask) >= ((b - hole) & mask)) {
+            allocator->buckets[hole] = slot;
+            allocator->buckets[b] = 0;
+            hole = b;
+        }
+    }
 }
 
 /*!
@@ -159,6 +278,9 @@ static allocation* get_fresh_allocation(hqAllocator allocator) {
     assert(allocator->allocations);
     assert(allocator->n_preallocated > 0);
 
+    if (allocator->n_dead > 0)
+        return &allocator->allocations[allocator->dead[--allocator->n_dead]];
+
     if (allocator->n_total >= allocator->n_preallocated)
         grow_allocations(allocator);
 
@@ -187,16 +309,24 @@ void* hq_allocator_alloc(hqAllocator allocator, size_t sz, const char* file,
 
     LOG(DEBUG,"allocating %lu bytes (%s:%d)",sz,file,line);
 
+    void* ptr;
+    assert(ptr = malloc(sz));
+
+    pthread_mutex_lock(&allocator->lock);
+    grow_buckets(allocator);
     allocation* this_allocation = get_fresh_allocation(allocator);
-    assert(this_allocation->ptr = malloc(sz));
+    this_allocation->ptr = ptr;
     this_allocation->alive = 1;
     this_allocation->file = file;
     this_allocation->line = line;
     this_allocation->sz = sz;
+    insert_bucket(allocator, (int)(this_allocation - allocator->allocations));
 
     allocator->n_alive++;
+    allocator->alive_bytes += sz;
+    pthread_mutex_unlock(&allocator->lock);
 
-    return this_allocation->ptr;
+    return ptr;
 }
 
 /*!
@@ -220,20 +350,27 @@ void* hq_allocator_realloc(hqAllocator allocator, void* ptr, size_t sz,
         //exit(1);
     }
 
-    for (int i = 0; i < allocator->n_total; i++) {
-        allocation* this_allocation = &allocator->allocations[i];
-        if (ptr == this_allocation->ptr) {
-            assert(this_allocation->alive);
-            LOG(DEBUG,
-                "reallocating pointer %p (originated in %s:%d, reallocated in "
-                "%s:%d)",
-                ptr, this_allocation->file, this_allocation->line, file, line);
-            this_allocation->sz = sz;
-            this_allocation->ptr =
-                realloc(this_allocation->ptr, this_allocation->sz);
-            return this_allocation->ptr;
-        }
+    pthread_mutex_lock(&allocator->lock);
+    int bucket = find_bucket(allocator, ptr);
+    if (bucket >= 0) {
+        int slot = allocator->buckets[bucket] - 1;
+        allocation* this_allocation = &allocator->allocations[slot];
+        assert(this_allocation->alive);
+        LOG(DEBUG,
+            "reallocating pointer %p (originated in %s:%d, reallocated in "
+            "%s:%d)",
+            ptr, this_allocation->file, this_allocation->line, file, line);
+        remove_bucket(allocator, bucket);
+        allocator->alive_bytes += sz - this_allocation->sz;
+        this_allocation->sz = sz;
+        this_allocation->ptr =
+            realloc(this_allocation->ptr, this_allocation->sz);
+        insert_bucket(allocator, slot);
+        void* out = this_allocation->ptr;
+        pthread_mutex_unlock(&allocator->lock);
+        return out;
     }
+    pthread_mutex_unlock(&allocator->lock);
 
     LOG(ERROR,
         "tried to reallocate pointer %p (%s:%d) in allocator %s but it doesn't "
@@ -256,30 +393,36 @@ void hq_allocator_free(hqAllocator allocator, void* ptr, const char* file,
     LOG_FUNC_CALL();
 
     assert(allocator);
-    assert(allocator->allocations);
 
     if (ptr == NULL) {
         LOG(ERROR, "tried to free a NULL pointer (%s:%d)", file, line);
         return;
     }
 
-    for (int i = 0; i < allocator->n_total; i++) {
-        allocation* this_allocation = &allocator->allocations[i];
-        if (ptr == this_allocation->ptr) {
-            assert(this_allocation->alive);
-            LOG(DEBUG,
-                "freeing pointer %p (originated in %s:%d, freed in %s:%d)", ptr,
-                this_allocation->file, this_allocation->line, file, line);
-            free(ptr);
-            this_allocation->ptr = NULL;
-            this_allocation->alive = 0;
-
-            allocator->n_alive--;
-            assert(allocator->n_alive >= 0);
-            LOG(DEBUG, "success");
-            return;
-        }
+    pthread_mutex_lock(&allocator->lock);
+    assert(allocator->allocations);
+    int bucket = find_bucket(allocator, ptr);
+    if (bucket >= 0) {
+        int slot = allocator->buckets[bucket] - 1;
+        allocation* this_allocation = &allocator->allocations[slot];
+        assert(this_allocation->alive);
+        LOG(DEBUG,
+            "freeing pointer %p (originated in %s:%d, freed in %s:%d)", ptr,
+            this_allocation->file, this_allocation->line, file, line);
+        remove_bucket(allocator, bucket);
+        this_allocation->ptr = NULL;
+        this_allocation->alive = 0;
+        allocator->alive_bytes -= this_allocation->sz;
+        allocator->dead[allocator->n_dead++] = slot;
+
+        allocator->n_alive--;
+        assert(allocator->n_alive >= 0);
+        pthread_mutex_unlock(&allocator->lock);
+        free(ptr);
+        LOG(DEBUG, "success");
+        return;
     }
+    pthread_mutex_unlock(&allocator->lock);
 
     LOG(ERROR,
         "tried to free pointer %p (%s:%d) in allocator %s but it doesn't exist",
@@ -287,6 +430,34 @@ void hq_allocator_free(hqAllocator allocator, void* ptr, const char* file,
     free(ptr);
 }
 
+/*!
+ * \brief Gets the number of pointers alive in `allocator`
+ *
+ * \param allocator The `allocator`.
+ * \return The number of allocations that were not freed yet.
+ */
+int hq_allocator_get_n_alive(hqAllocator allocator) {
+    assert(allocator);
+    pthread_mutex_lock(&allocator->lock);
+    int out = allocator->n_alive;
+    pthread_mutex_unlock(&allocator->lock);
+    return out;
+}
+
+/*!
+ * \brief Gets the number of bytes alive in `allocator`
+ *
+ * \param allocator The `allocator`.
+ * \return The total size of the allocations that were not freed yet.
+ */
+size_t hq_allocator_get_alive_bytes(hqAllocator allocator) {
+    assert(allocator);
+    pthread_mutex_lock(&allocator->lock);
+    size_t out = allocator->alive_bytes;
+    pthread_mutex_unlock(&allocator->lock);
+    return out;
+}
+
 hqAllocator hq_global_allocator;
 
 /*!
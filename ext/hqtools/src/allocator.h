@@ -23,6 +23,9 @@ void* hq_allocator_realloc(hqAllocator allocator, void* ptr, size_t sz,
 void hq_allocator_free(hqAllocator allocator, void* ptr, const char* file,
                        int line);
 
+int hq_allocator_get_n_alive(hqAllocator allocator);
+size_t hq_allocator_get_alive_bytes(hqAllocator allocator);
+
 void hq_allocator_init_global(void);
 void hq_allocator_delete_global(void);
 
@@ -87,6 +87,26 @@ hstr hstr_new(const char* input) {
     return out;
 }
 
+/*!
+ * \brief Constructs a `hstr` from the first `length` characters of a raw
+ * `const char*`, which need not be null terminated, with `0` references.
+ *
+ * \param input The raw characters to construct the `hstr` from.
+ * \param length The number of characters to copy.
+ * \return The allocated `hstr`.
+ */
+hstr hstr_new_n(const char* input, int length) {
+    LOG_FUNC_CALL();
+    assert(input);
+    assert(length >= 0);
+    hstr out = MALLOC(sizeof(hstrInternal));
+    out->raw = MALLOC(sizeof(char) * (length + 2));
+    memcpy(out->raw, input, length);
+    out->raw[length] = '\0';
+    out->references = 0;
+    return out;
+}
+
 /*!
  * \brief Increments the references on a `hstr`.
  *
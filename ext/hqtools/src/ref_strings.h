@@ -13,6 +13,7 @@ struct hstrArrayInternal;
 typedef struct hstrArrayInternal* hstrArray;
 
 hstr hstr_new(const char* input);
+hstr hstr_new_n(const char* input, int length);
 hstr hstr_incref(hstr str);
 void hstr_decref(hstr str);
 const char* hstr_unpack(hstr str);
@@ -13,6 +13,7 @@
 #include "raymath.h"
 #include "text_stuff.h"
 #include <assert.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -34,6 +35,8 @@ static char console_input[EDITOR_TEXT_INPUT_MAX_CHARS];
 static char* stack[EDITOR_CONSOLE_STACK_SIZE];
 static int message_type_stack[EDITOR_CONSOLE_STACK_SIZE];
 static int stack_ptr = 0;
+// assets stream in on worker threads, which log too
+static pthread_mutex_t stack_lock = PTHREAD_MUTEX_INITIALIZER;
 
 void editor_init_stack(void) {
     for (int i = 0; i < EDITOR_CONSOLE_STACK_SIZE; i++) {
@@ -52,14 +55,18 @@ void editor_delete_stack(void) {
 }
 
 static void append_stack(char* ptr, int type) {
-    if (stack[stack_ptr])
-        free(stack[stack_ptr]);
+    pthread_mutex_lock(&stack_lock);
+    char* old = stack[stack_ptr];
     stack[stack_ptr] = ptr;
     message_type_stack[stack_ptr] = type;
     stack_ptr++;
     if (stack_ptr >= EDITOR_CONSOLE_STACK_SIZE) {
         stack_ptr = 0;
     }
+    pthread_mutex_unlock(&stack_lock);
+    // freed outside the lock, as the allocator may log
+    if (old)
+        free(old);
 }
 
 static const char* read_stack(int i, int* type) {
@@ -188,12 +195,17 @@ static int line_start = 0;
 
 static void get_line_input(char* input, editorTextBox box) {
     int type;
+    pthread_mutex_lock(&stack_lock);
     const char* line = read_stack(line_count, &type);
+    if (line)
+        strcpy(input, line);
+    pthread_mutex_unlock(&stack_lock);
     line_count++;
     if (!line) {
         input[0] = '\0';
         return;
     }
+    line = input;
     Color col = WHITE;
 
     if (strstr(line, "GL:") || strstr(line, "GLAD:")) {
@@ -220,8 +232,6 @@ static void get_line_input(char* input, editorTextBox box) {
     }
 
     editor_set_text_box_text_color(box, col);
-    if (line)
-        strcpy(input, line);
 }
 
 void editor_add_console_command(const char* name,
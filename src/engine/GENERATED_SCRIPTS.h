@@ -0,0 +1,265 @@
+
+struct lightmanager_fluxData;
+#define FLUX_GAMEOBJECT_TYPE_ONLY
+#include "gameobject.h"
+#include "sceneallocator.h"
+#ifdef FLUX_SCRIPTS_IMPLEMENTATION
+#define SCRIPT lightmanager
+#include "fluxScript.h"
+
+script_data { float ka; };
+
+fluxCallback onInit(fluxGameObject obj, script_data* data, hstrArray args) {
+    data->ka = 0.2;
+
+    render_light_enable(0);
+    render_light_set_type(0, 0);
+    render_light_set_cL(0, WHITE);
+    render_light_set_kd(0, 0.7);
+    render_light_set_ks(0, 0.3);
+    render_light_set_L(0, Vector3One());
+    render_light_set_p(0, 200);
+    render_light_set_fov(0, 50);
+
+    render_light_enable(1);
+    render_light_set_type(1, 0);
+    render_light_set_cL(1, WHITE);
+    render_light_set_kd(1, 0.7);
+    render_light_set_ks(1, 0.3);
+    render_light_set_L(1, (Vector3){0, 2, -1});
+    render_light_set_p(1, 200);
+    render_light_set_fov(1, 50);
+
+    for (int i = 0; i < hstr_array_len(args); i++) {
+        hstr arg = hstr_incref(hstr_array_get(args, i));
+        hstrArray split = hstr_split(arg, ":");
+        if (hstr_array_len(split) == 2) {
+            const char* argument = hstr_unpack(hstr_array_get(split, 0));
+            const char* value = hstr_unpack(hstr_array_get(split, 1));
+            if (strcmp(argument, "ka") == 0) {
+                data->ka = atof(value);
+                TraceLog(LOG_INFO, "ka = %g", data->ka);
+            }
+            if (strcmp(argument, "skybox") == 0) {
+                render_load_skybox(value);
+            }
+        }
+        hstr_array_delete(split);
+        hstr_decref(arg);
+    }
+
+    render_set_ka(data->ka);
+}
+
+fluxCallback onUpdate(fluxGameObject obj, script_data* data) {
+    render_set_ka(data->ka);
+    render_enable_skybox();
+}
+
+fluxCallback afterUpdate(fluxGameObject obj, script_data* data){}
+fluxCallback onDestroy(fluxGameObject obj, script_data* data){}
+fluxCallback onDraw(fluxGameObject obj, script_data* data){}
+fluxCallback onDraw2D(fluxGameObject obj, script_data* data){}
+fluxCallback onSignal(fluxGameObject obj, script_data* data, int signal){}
+
+
+#endif
+
+enum fluxScriptID{fluxEmptyScript,fluxScript_lightmanager};
+
+
+struct fluxScriptStruct;
+typedef struct fluxScriptStruct* fluxScript;
+#ifdef FLUX_SCRIPTS_IMPLEMENTATION
+struct fluxScriptStruct{
+    enum fluxScriptID id;
+    union {
+        void* raw;
+        struct lightmanager_fluxData* lightmanager_fluxData;
+    };
+};
+#endif
+
+
+
+void fluxCallback_onUpdate(fluxGameObject obj, fluxScript script)
+#ifdef FLUX_SCRIPTS_IMPLEMENTATION
+{
+    switch(script->id){
+        
+        case fluxScript_lightmanager:
+            lightmanager_fluxCallback_onUpdate(obj,script->lightmanager_fluxData);
+            break;
+
+        default:
+            //assert((1 == 0) && "something terrible happened at compile time!");
+            break;
+    }
+}
+#else
+;
+#endif
+
+
+
+
+void fluxCallback_afterUpdate(fluxGameObject obj, fluxScript script)
+#ifdef FLUX_SCRIPTS_IMPLEMENTATION
+{
+    switch(script->id){
+        
+        case fluxScript_lightmanager:
+            lightmanager_fluxCallback_afterUpdate(obj,script->lightmanager_fluxData);
+            break;
+
+        default:
+            //assert((1 == 0) && "something terrible happened at compile time!");
+            break;
+    }
+}
+#else
+;
+#endif
+
+
+
+
+void fluxCallback_onInit(fluxGameObject obj, fluxScript script, hstrArray args)
+#ifdef FLUX_SCRIPTS_IMPLEMENTATION
+{
+    switch(script->id){
+        
+        case fluxScript_lightmanager:
+            lightmanager_fluxCallback_onInit(obj,script->lightmanager_fluxData,args);
+            break;
+
+        default:
+            //assert((1 == 0) && "something terrible happened at compile time!");
+            break;
+    }
+}
+#else
+;
+#endif
+
+
+
+
+void fluxCallback_onDestroy(fluxGameObject obj, fluxScript script)
+#ifdef FLUX_SCRIPTS_IMPLEMENTATION
+{
+    switch(script->id){
+        
+        case fluxScript_lightmanager:
+            lightmanager_fluxCallback_onDestroy(obj,script->lightmanager_fluxData);
+            break;
+
+        default:
+            //assert((1 == 0) && "something terrible happened at compile time!");
+            break;
+    }
+}
+#else
+;
+#endif
+
+
+
+
+void fluxCallback_onDraw(fluxGameObject obj, fluxScript script)
+#ifdef FLUX_SCRIPTS_IMPLEMENTATION
+{
+    switch(script->id){
+        
+        case fluxScript_lightmanager:
+            lightmanager_fluxCallback_onDraw(obj,script->lightmanager_fluxData);
+            break;
+
+        default:
+            //assert((1 == 0) && "something terrible happened at compile time!");
+            break;
+    }
+}
+#else
+;
+#endif
+
+
+
+
+void fluxCallback_onDraw2D(fluxGameObject obj, fluxScript script)
+#ifdef FLUX_SCRIPTS_IMPLEMENTATION
+{
+    switch(script->id){
+        
+        case fluxScript_lightmanager:
+            lightmanager_fluxCallback_onDraw2D(obj,script->lightmanager_fluxData);
+            break;
+
+        default:
+            //assert((1 == 0) && "something terrible happened at compile time!");
+            break;
+    }
+}
+#else
+;
+#endif
+
+
+
+
+void fluxCallback_onSignal(fluxGameObject obj, fluxScript script, int signal)
+#ifdef FLUX_SCRIPTS_IMPLEMENTATION
+{
+    switch(script->id){
+        
+        case fluxScript_lightmanager:
+            lightmanager_fluxCallback_onSignal(obj,script->lightmanager_fluxData,signal);
+            break;
+
+        default:
+            //assert((1 == 0) && "something terrible happened at compile time!");
+            break;
+    }
+}
+#else
+;
+#endif
+
+
+
+fluxScript flux_allocate_script(enum fluxScriptID id)
+#ifdef FLUX_SCRIPTS_IMPLEMENTATION
+{
+    fluxScript out = (fluxScript)flux_scene_alloc(sizeof(struct fluxScriptStruct));
+    out->id = id;
+    size_t sz = 0;
+    switch(id){
+        case fluxScript_lightmanager:
+            sz = sizeof(struct lightmanager_fluxData);
+            break;
+        default:
+            //assert((1 == 0) && "something terrible happened at build time!");
+            break;
+    }
+    out->raw = flux_scene_alloc(sz);
+    return out;
+}
+#else
+;
+#endif
+
+void flux_free_script(fluxScript script)
+#ifdef FLUX_SCRIPTS_IMPLEMENTATION
+{
+    flux_scene_free(script->raw);
+    flux_scene_free(script);
+}
+#else
+;
+#endif
+
+
+#ifdef FLUX_SCRIPTS_IMPLEMENTATION
+static const char* SCRIPT_NAME_TO_ENUM[2]={[fluxEmptyScript] = "empty_script",[fluxScript_lightmanager] = "lightmanager"};
+#endif
@@ -20,6 +20,8 @@
  * callbacks.
  */
 
+#include "asset_registry.h"
+#include "asset_stream.h"
 #include "console.h"
 #include "display_size.h"
 #include "editor.h"
@@ -28,6 +30,7 @@
 #include "pipeline.h"
 #include "scene.h"
 #include "text_stuff.h"
+#include "world.h"
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -59,6 +62,171 @@ static void set_fps_max_callback(int n_args, const char** args) {
     SetTargetFPS(atoi(args[1]));
 }
 
+static void draw_calls_callback(int n_args, const char** args) {
+    LOG_FUNC_CALL();
+    TraceLog(LOG_INFO, "draw calls: %d (%d instanced)",
+             render_get_draw_calls(), render_get_instanced_draw_calls());
+}
+
+static void cull_stats_callback(int n_args, const char** args) {
+    LOG_FUNC_CALL();
+    TraceLog(LOG_INFO, "visible meshes: %d, corner transforms saved: %lld",
+             render_get_visible_meshes(),
+             render_get_corner_transforms_saved());
+}
+
+static void instance_memory_callback(int n_args, const char** args) {
+    LOG_FUNC_CALL();
+    TraceLog(LOG_INFO, "instance memory: %.1f KB",
+             (float)render_get_instance_memory() / 1024.0f);
+}
+
+static void shadow_casters_callback(int n_args, const char** args) {
+    LOG_FUNC_CALL();
+    for (int i = 0; i < FLUX_MAX_LIGHTS; i++) {
+        if (!render_light_is_enabled(i))
+            continue;
+        TraceLog(LOG_INFO, "light %d: %d visible casters", i,
+                 render_light_get_visible_casters(i));
+    }
+}
+
+static void shadow_cache_callback(int n_args, const char** args) {
+    LOG_FUNC_CALL();
+    TraceLog(LOG_INFO, "shadow maps: %d rendered, %d cached",
+             render_get_shadow_maps_rendered(),
+             render_get_shadow_maps_cached());
+}
+
+static void shadow_atlas_callback(int n_args, const char** args) {
+    LOG_FUNC_CALL();
+    int res = render_get_shadow_atlas_res();
+    TraceLog(LOG_INFO, "shadow atlas %dx%d (%s), %.1f%% used", res, res,
+             render_shadow_atlas_is_loaded() ? "loaded" : "not loaded",
+             render_get_shadow_atlas_occupancy() * 100.0f);
+    for (int i = 0; i < FLUX_MAX_LIGHTS; i++) {
+        if (!render_light_is_enabled(i))
+            continue;
+        TraceLog(LOG_INFO, "light %d: %dx%d", i,
+                 render_light_get_shadow_res(i),
+                 render_light_get_shadow_res(i));
+    }
+}
+
+static void render_queue_callback(int n_args, const char** args) {
+    LOG_FUNC_CALL();
+    TraceLog(LOG_INFO, "render queue: %d items", render_get_queue_items());
+    TraceLog(LOG_INFO, "shader binds: %d (%d unsorted)",
+             render_get_shader_binds(), render_get_unsorted_shader_binds());
+    TraceLog(LOG_INFO, "texture binds: %d (%d unsorted)",
+             render_get_texture_binds(), render_get_unsorted_texture_binds());
+}
+
+static void cull_threads_callback(int n_args, const char** args) {
+    LOG_FUNC_CALL();
+    if (n_args >= 2)
+        render_set_cull_threads(atoi(args[1]));
+    TraceLog(LOG_INFO, "cull_threads = %d", render_get_cull_threads());
+}
+
+static void occlusion_callback(int n_args, const char** args) {
+    LOG_FUNC_CALL();
+    if (n_args >= 2)
+        render_set_occlusion(atoi(args[1]) != 0);
+    TraceLog(LOG_INFO, "occlusion = %d", render_get_occlusion());
+    TraceLog(LOG_INFO, "%d occluder triangles, %d occluded instances",
+             render_get_occluder_triangles(),
+             render_get_occluded_instances());
+}
+
+static void lod_stats_callback(int n_args, const char** args) {
+    LOG_FUNC_CALL();
+    long long drawn = render_get_triangles_drawn();
+    long long full = render_get_triangles_full();
+    TraceLog(LOG_INFO, "triangles: %lld drawn, %lld without lods (%.1f%%)",
+             drawn, full, full > 0 ? 100.0 * (double)drawn / (double)full : 0);
+}
+
+static void static_batches_callback(int n_args, const char** args) {
+    LOG_FUNC_CALL();
+    TraceLog(LOG_INFO, "static batches: %d objects (%d draws) in %d chunks",
+             flux_scene_get_static_objects(),
+             flux_scene_get_static_draws_merged(),
+             flux_scene_get_static_chunks());
+    TraceLog(LOG_INFO, "built in %.1f ms",
+             flux_scene_get_static_batch_time() * 1000.0);
+}
+
+static void scene_tree_callback(int n_args, const char** args) {
+    LOG_FUNC_CALL();
+    TraceLog(LOG_INFO, "scene tree: %d objects, height %d",
+             flux_scene_get_tree_proxies(), flux_scene_get_tree_height());
+    TraceLog(LOG_INFO, "last query: %d objects found, %d nodes visited",
+             flux_scene_get_visible_objects(),
+             flux_scene_get_tree_nodes_visited());
+}
+
+static void instancing_threshold_callback(int n_args, const char** args) {
+    LOG_FUNC_CALL();
+    if (n_args >= 2)
+        render_set_instancing_threshold(atoi(args[1]));
+    TraceLog(LOG_INFO, "instancing_threshold = %d",
+             render_get_instancing_threshold());
+}
+
+static void asset_cache_callback(int n_args, const char** args) {
+    LOG_FUNC_CALL();
+    if (n_args >= 2)
+        render_set_asset_cache_size((size_t)atoi(args[1]) * 1024 * 1024);
+    renderAssetStats stats = render_get_asset_stats();
+    TraceLog(LOG_INFO, "assets: %d models, %d textures, %d unused",
+             stats.n_models, stats.n_textures, stats.n_unused);
+    TraceLog(LOG_INFO, "resident %.1f MB, unused %.1f MB (budget %.1f MB)",
+             (float)stats.resident_bytes / (1024.0f * 1024.0f),
+             (float)stats.unused_bytes / (1024.0f * 1024.0f),
+             (float)render_get_asset_cache_size() / (1024.0f * 1024.0f));
+    TraceLog(LOG_INFO, "%lld hits, %lld misses, %lld evictions", stats.hits,
+             stats.misses, stats.evictions);
+}
+
+static void asset_stream_callback(int n_args, const char** args) {
+    LOG_FUNC_CALL();
+    if (n_args >= 2)
+        render_set_stream_budget(atof(args[1]) / 1000.0);
+    TraceLog(LOG_INFO, "%d models streaming, last upload %.2f ms (budget %.2f"
+                       " ms)",
+             render_get_stream_pending(),
+             render_get_stream_upload_time() * 1000.0,
+             render_get_stream_budget() * 1000.0);
+}
+
+static void scene_load_callback(int n_args, const char** args) {
+    LOG_FUNC_CALL();
+    if (n_args >= 2)
+        flux_set_scene_load_budget(atof(args[1]) / 1000.0);
+    if (flux_scene_is_loading())
+        TraceLog(LOG_INFO, "scene loading, %.0f%%",
+                 flux_get_scene_load_progress() * 100.0f);
+    TraceLog(LOG_INFO, "scene load budget %.2f ms",
+             flux_get_scene_load_budget() * 1000.0);
+}
+
+static void world_callback(int n_args, const char** args) {
+    LOG_FUNC_CALL();
+    if (n_args >= 2)
+        flux_set_world_budget(atof(args[1]) / 1000.0);
+    if (flux_world_is_open())
+        TraceLog(LOG_INFO,
+                 "world: %d/%d cells resident (%d pending), %d game "
+                 "objects, %d world prefabs",
+                 flux_world_get_resident_cells(), flux_world_get_n_cells(),
+                 flux_world_get_pending_cells(),
+                 flux_world_get_resident_objects(),
+                 flux_world_get_loaded_prefabs());
+    TraceLog(LOG_INFO, "world budget %.2f ms",
+             flux_get_world_budget() * 1000.0);
+}
+
 static void draw_splash_screen(float opacity) {
     float screen_width = GetDisplayWidth();
     float screen_height = GetDisplayHeight();
@@ -113,6 +281,24 @@ void flux_init(int width, int height, const char* name) {
 
     editor_add_console_command("quit", console_command_quit);
     editor_add_console_command("fps_max", set_fps_max_callback);
+    editor_add_console_command("draw_calls", draw_calls_callback);
+    editor_add_console_command("instancing_threshold",
+                               instancing_threshold_callback);
+    editor_add_console_command("asset_cache", asset_cache_callback);
+    editor_add_console_command("asset_stream", asset_stream_callback);
+    editor_add_console_command("scene_load", scene_load_callback);
+    editor_add_console_command("world", world_callback);
+    editor_add_console_command("cull_stats", cull_stats_callback);
+    editor_add_console_command("instance_memory", instance_memory_callback);
+    editor_add_console_command("shadow_casters", shadow_casters_callback);
+    editor_add_console_command("shadow_cache", shadow_cache_callback);
+    editor_add_console_command("shadow_atlas", shadow_atlas_callback);
+    editor_add_console_command("render_queue", render_queue_callback);
+    editor_add_console_command("cull_threads", cull_threads_callback);
+    editor_add_console_command("scene_tree", scene_tree_callback);
+    editor_add_console_command("occlusion", occlusion_callback);
+    editor_add_console_command("lod_stats", lod_stats_callback);
+    editor_add_console_command("static_batches", static_batches_callback);
 
     if (GetTime() > splash_screen_max_time)
         flux_draw_loading_screen("game", 0.3);
@@ -147,6 +333,7 @@ void flux_init(int width, int height, const char* name) {
  */
 void flux_close(void) {
     LOG_FUNC_CALL();
+    flux_cancel_scene_load();
     flux_close_scene();
     flux_game_close();
     render_close();
@@ -165,6 +352,11 @@ static void flux_loop(void) {
     LOG_FUNC_CALL();
     flux_flush_signals();
 
+    render_update_asset_stream();
+    flux_update_scene_load();
+    flux_scene_update_streaming();
+    flux_update_world();
+
     flux_scene_script_callback(ONUPDATE);
     flux_scene_script_callback(AFTERUPDATE);
 
@@ -27,11 +27,13 @@
 #include "raylib.h"
 #include "raymath.h"
 #include "rcamera.h"
+#include "scene.h"
 #include "sceneallocator.h"
 #include "transform.h"
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 /**
  * @struct fluxGameObjectStruct
@@ -53,6 +55,19 @@ struct fluxGameObjectStruct {
     int projection; ///< Camera projection type (e.g., orthographic or
                     ///< perspective).
     bool visible;
+    bool transform_dirty; ///< Set when `transform` changed since
+                          ///< `world_matrix`/`mesh_bounds` were computed.
+    Matrix world_matrix;  ///< Cached model matrix for `transform`.
+    BoundingBox* mesh_bounds; ///< Cached world space bounds of each mesh of
+                              ///< `model` (NULL if there is no model).
+    BoundingBox world_bounds; ///< Cached union of `mesh_bounds`.
+    unsigned char* lods; ///< Level of detail each mesh of `model` was last
+                         ///< drawn with, for the renderer's hysteresis.
+    int tree_proxy; ///< Proxy of the object in the scene's AABB tree, or -1.
+    bool tree_moved; ///< Set when the scene was told that the object moved
+                     ///< and has not updated its tree proxy yet.
+    bool batched; ///< Set when the object's model is drawn as part of a
+                  ///< static batch instead of on its own.
 };
 
 /**
@@ -86,7 +101,176 @@ void flux_gameobject_set_transform(fluxGameObject obj,
                                    fluxTransform transform) {
     LOG_FUNC_CALL();
     assert(obj);
+    if (obj->batched)
+        TraceLog(LOG_WARNING, "moving game object %d, which is in a static "
+                              "batch (the batch does not move)",
+                 obj->id);
     obj->transform = transform;
+    obj->transform_dirty = true;
+    if ((obj->tree_proxy >= 0) && !obj->tree_moved) {
+        obj->tree_moved = true;
+        flux_scene_gameobject_moved(obj);
+    }
+}
+
+/**
+ * @brief Recomputes the cached world matrix and mesh bounds of a game object
+ * if its transform changed.
+ * @param obj Pointer to the game object.
+ */
+static void update_cached_transform(fluxGameObject obj) {
+    LOG_FUNC_CALL();
+    if (!obj->transform_dirty)
+        return;
+    if (obj->model) {
+        obj->world_matrix =
+            render_model_get_transform(obj->model, obj->transform);
+        render_model_get_instance_bounds(obj->model, obj->world_matrix,
+                                         obj->mesh_bounds);
+        int n_meshes = render_model_get_mesh_count(obj->model);
+        obj->world_bounds = obj->mesh_bounds[0];
+        for (int i = 1; i < n_meshes; i++) {
+            obj->world_bounds.min = Vector3Min(obj->world_bounds.min,
+                                               obj->mesh_bounds[i].min);
+            obj->world_bounds.max = Vector3Max(obj->world_bounds.max,
+                                               obj->mesh_bounds[i].max);
+        }
+    }
+    obj->transform_dirty = false;
+}
+
+/**
+ * @brief Retrieves the world (model) matrix of a game object.
+ *
+ * The matrix is cached and only recomputed after
+ * `flux_gameobject_set_transform()`.
+ * @param obj Pointer to the game object, must have a model.
+ * @return The world matrix of the game object.
+ */
+Matrix flux_gameobject_get_world_matrix(fluxGameObject obj) {
+    LOG_FUNC_CALL();
+    assert(obj);
+    assert(obj->model);
+    update_cached_transform(obj);
+    return obj->world_matrix;
+}
+
+/**
+ * @brief Retrieves the world space bounds of each mesh of a game object's
+ * model.
+ *
+ * Cached like `flux_gameobject_get_world_matrix()`.
+ * @param obj Pointer to the game object, must have a model.
+ * @return Array of `render_model_get_mesh_count()` bounding boxes, owned by
+ * the game object.
+ */
+const BoundingBox* flux_gameobject_get_mesh_bounds(fluxGameObject obj) {
+    LOG_FUNC_CALL();
+    assert(obj);
+    assert(obj->model);
+    update_cached_transform(obj);
+    return obj->mesh_bounds;
+}
+
+/**
+ * @brief Retrieves the levels of detail the meshes of a game object's model
+ * were last drawn with.
+ *
+ * Passed to `render_add_model_instance_ex()`, so the level of each mesh stays
+ * with the object whichever instance slot it is drawn from.
+ * @param obj Pointer to the game object, must have a model.
+ * @return Array of `render_model_get_mesh_count()` levels, owned by the game
+ * object.
+ */
+unsigned char* flux_gameobject_get_lods(fluxGameObject obj) {
+    LOG_FUNC_CALL();
+    assert(obj);
+    assert(obj->model);
+    return obj->lods;
+}
+
+/**
+ * @brief Retrieves the world space bounds of a game object's whole model.
+ *
+ * Cached like `flux_gameobject_get_world_matrix()`.
+ * @param obj Pointer to the game object, must have a model.
+ * @return Bounding box enclosing every mesh of the model.
+ */
+BoundingBox flux_gameobject_get_world_bounds(fluxGameObject obj) {
+    LOG_FUNC_CALL();
+    assert(obj);
+    assert(obj->model);
+    update_cached_transform(obj);
+    return obj->world_bounds;
+}
+
+/**
+ * @brief Retrieves the proxy of a game object in the scene's AABB tree.
+ * @param obj Pointer to the game object.
+ * @return The proxy, or -1 if the object is not in the tree.
+ */
+int flux_gameobject_get_tree_proxy(fluxGameObject obj) {
+    LOG_FUNC_CALL();
+    assert(obj);
+    return obj->tree_proxy;
+}
+
+/**
+ * @brief Sets the proxy of a game object in the scene's AABB tree, and clears
+ * its moved flag.
+ *
+ * Called by the scene when it inserts the object or updates its proxy.
+ * @param obj Pointer to the game object.
+ * @param proxy The proxy, or -1 if the object is not in the tree.
+ */
+void flux_gameobject_set_tree_proxy(fluxGameObject obj, int proxy) {
+    LOG_FUNC_CALL();
+    assert(obj);
+    obj->tree_proxy = proxy;
+    obj->tree_moved = false;
+}
+
+/**
+ * @brief Replaces the model of a game object, e.g. when its prefab's streamed
+ * model comes in. The caller refits the object's proxy in the tree it is in,
+ * which need not be the current scene's (see `flux_update_scene_load()`).
+ * @param obj Pointer to the game object, must have a model.
+ * @param model The new model.
+ */
+void flux_gameobject_set_model(fluxGameObject obj, renderModel model) {
+    LOG_FUNC_CALL();
+    assert(obj);
+    assert(obj->model);
+    assert(model);
+    obj->model = model;
+    int n_meshes = render_model_get_mesh_count(model);
+    assert(obj->mesh_bounds =
+               realloc(obj->mesh_bounds, sizeof(BoundingBox) * n_meshes));
+    assert(obj->lods = realloc(obj->lods, sizeof(unsigned char) * n_meshes));
+    memset(obj->lods, 0, sizeof(unsigned char) * n_meshes);
+    obj->transform_dirty = true;
+}
+
+/**
+ * @brief Checks if a game object is drawn as part of a static batch.
+ * @param obj Pointer to the game object.
+ * @return True if the scene merged the object into a static batch.
+ */
+bool flux_gameobject_is_batched(fluxGameObject obj) {
+    LOG_FUNC_CALL();
+    assert(obj);
+    return obj->batched;
+}
+
+/**
+ * @brief Marks a game object as drawn by a static batch, so the scene does
+ * not draw it on its own. The object must not move after this.
+ * @param obj Pointer to the game object.
+ */
+void flux_gameobject_set_batched(fluxGameObject obj) {
+    LOG_FUNC_CALL();
+    assert(obj);
+    obj->batched = true;
 }
 
 /**
@@ -133,6 +317,18 @@ bool flux_gameobject_has_model(fluxGameObject obj) {
     return obj->model != NULL;
 }
 
+/**
+ * @brief Changes the ID of a game object. The ID is the object's index in the
+ * scene, which changes when the scene removes another game object.
+ * @param obj Pointer to the game object.
+ * @param id The new ID.
+ */
+void flux_gameobject_set_id(fluxGameObject obj, int id) {
+    LOG_FUNC_CALL();
+    assert(obj);
+    obj->id = id;
+}
+
 /**
  * @brief Retrieves a Camera3D structure initialized based on the game object's
  * properties.
@@ -157,39 +353,103 @@ Camera3D flux_gameobject_get_raylib_camera(fluxGameObject obj) {
 }
 
 /**
- * @brief Allocates and initializes a new game object from a prefab and
- * arguments.
- *
- * NOTE: This calls onInit on allocation(!!!)
+ * @brief Allocates a new game object from a prefab, without its scripts (see
+ * `flux_gameobject_init_scripts()`).
  *
+ * Scripts allocate from the scene allocator, so a scene loading in the
+ * background prepares its game objects with this and adds the scripts once
+ * it replaces the current scene.
  * @param id Unique identifier for the new game object.
  * @param transform Initial transformation settings.
  * @param prefab Prefab to initialize the game object from.
- * @param args Additional arguments for initializing scripts.
  * @return Pointer to the newly created game object.
  */
-fluxGameObject flux_allocate_gameobject(int id, fluxTransform transform,
-                                        fluxPrefab prefab, hstrArray args) {
+fluxGameObject flux_prepare_gameobject(int id, fluxTransform transform,
+                                       fluxPrefab prefab) {
     LOG_FUNC_CALL();
     fluxGameObject out;
     assert(out = malloc(sizeof(struct fluxGameObjectStruct)));
     out->id = id;
     out->transform = transform;
     out->model = flux_prefab_get_model(prefab);
-    out->n_scripts = flux_prefab_get_n_scripts(prefab);
+    out->n_scripts = 0;
     out->scripts = NULL;
     out->is_camera = flux_prefab_is_camera(prefab);
     out->fov = flux_prefab_get_fov(prefab);
     out->projection = flux_prefab_get_projection(prefab);
     out->visible = true;
-    if (out->n_scripts != 0) {
-        assert(out->scripts = malloc(sizeof(fluxScript) * out->n_scripts));
-        for (int i = 0; i < out->n_scripts; i++) {
-            out->scripts[i] =
+    out->transform_dirty = true;
+    out->mesh_bounds = NULL;
+    out->lods = NULL;
+    out->tree_proxy = -1;
+    out->tree_moved = false;
+    out->batched = false;
+    if (out->model) {
+        int n_meshes = render_model_get_mesh_count(out->model);
+        assert(out->mesh_bounds = malloc(sizeof(BoundingBox) * n_meshes));
+        assert(out->lods = malloc(sizeof(unsigned char) * n_meshes));
+        memset(out->lods, 0, sizeof(unsigned char) * n_meshes);
+    }
+    return out;
+}
+
+/**
+ * @brief Allocates the scripts of a prepared game object, and calls their
+ * onInit.
+ * @param obj Pointer to the game object, from `flux_prepare_gameobject()`.
+ * @param prefab Prefab the game object was prepared from.
+ * @param args Additional arguments for initializing scripts.
+ */
+void flux_gameobject_init_scripts(fluxGameObject obj, fluxPrefab prefab,
+                                  hstrArray args) {
+    LOG_FUNC_CALL();
+    assert(obj);
+    assert(obj->scripts == NULL);
+    obj->n_scripts = flux_prefab_get_n_scripts(prefab);
+    if (obj->n_scripts != 0) {
+        assert(obj->scripts = malloc(sizeof(fluxScript) * obj->n_scripts));
+        for (int i = 0; i < obj->n_scripts; i++) {
+            obj->scripts[i] =
                 flux_allocate_script(flux_prefab_get_scripts(prefab)[i]);
-            fluxCallback_onInit(out, out->scripts[i], args);
+            fluxCallback_onInit(obj, obj->scripts[i], args);
         }
     }
+}
+
+/**
+ * @brief Frees the scripts of a game object that leaves the scene before the
+ * scene closes (closing the scene frees every script).
+ * @param obj Pointer to the game object.
+ */
+void flux_gameobject_free_scripts(fluxGameObject obj) {
+    LOG_FUNC_CALL();
+    assert(obj);
+    for (int i = 0; i < obj->n_scripts; i++) {
+        flux_free_script(obj->scripts[i]);
+    }
+    if (obj->scripts)
+        free(obj->scripts);
+    obj->scripts = NULL;
+    obj->n_scripts = 0;
+}
+
+/**
+ * @brief Allocates and initializes a new game object from a prefab and
+ * arguments.
+ *
+ * NOTE: This calls onInit on allocation(!!!)
+ *
+ * @param id Unique identifier for the new game object.
+ * @param transform Initial transformation settings.
+ * @param prefab Prefab to initialize the game object from.
+ * @param args Additional arguments for initializing scripts.
+ * @return Pointer to the newly created game object.
+ */
+fluxGameObject flux_allocate_gameobject(int id, fluxTransform transform,
+                                        fluxPrefab prefab, hstrArray args) {
+    LOG_FUNC_CALL();
+    fluxGameObject out = flux_prepare_gameobject(id, transform, prefab);
+    flux_gameobject_init_scripts(out, prefab, args);
     return out;
 }
 
@@ -221,6 +481,10 @@ void flux_destroy_gameobject(fluxGameObject obj) {
     } else {
         assert(obj->n_scripts == 0);
     }
+    if (obj->mesh_bounds)
+        free(obj->mesh_bounds);
+    if (obj->lods)
+        free(obj->lods);
     free(obj);
 }
 
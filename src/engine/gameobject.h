@@ -35,16 +35,44 @@ void flux_gameobject_set_visible(fluxGameObject obj, bool visible);
 fluxGameObject flux_allocate_gameobject(int id, fluxTransform transform,
                                         fluxPrefab prefab, hstrArray args);
 
+fluxGameObject flux_prepare_gameobject(int id, fluxTransform transform,
+                                       fluxPrefab prefab);
+
+void flux_gameobject_init_scripts(fluxGameObject obj, fluxPrefab prefab,
+                                  hstrArray args);
+
+void flux_gameobject_free_scripts(fluxGameObject obj);
+
 void flux_destroy_gameobject(fluxGameObject obj);
 
 int flux_gameobject_get_id(fluxGameObject obj);
 
+void flux_gameobject_set_id(fluxGameObject obj, int id);
+
 int flux_gameobject_get_n_scripts(fluxGameObject obj);
 
 bool flux_gameobject_is_camera(fluxGameObject obj);
 
 renderModel flux_gameobject_get_model(fluxGameObject obj);
 
+void flux_gameobject_set_model(fluxGameObject obj, renderModel model);
+
+Matrix flux_gameobject_get_world_matrix(fluxGameObject obj);
+
+const BoundingBox* flux_gameobject_get_mesh_bounds(fluxGameObject obj);
+
+unsigned char* flux_gameobject_get_lods(fluxGameObject obj);
+
+BoundingBox flux_gameobject_get_world_bounds(fluxGameObject obj);
+
+int flux_gameobject_get_tree_proxy(fluxGameObject obj);
+
+void flux_gameobject_set_tree_proxy(fluxGameObject obj, int proxy);
+
+bool flux_gameobject_is_batched(fluxGameObject obj);
+
+void flux_gameobject_set_batched(fluxGameObject obj);
+
 bool flux_gameobject_has_model(fluxGameObject obj);
 
 Camera3D flux_gameobject_get_raylib_camera(fluxGameObject obj);
@@ -10,9 +10,19 @@
 #include "raylib.h"
 #include "text_stuff.h"
 
+/**
+ * @brief Shortest time between two loading screen frames, in seconds. Each
+ * frame waits for vsync, so drawing every percent would make loading
+ * screens slower than the loading.
+ */
+#ifndef FLUX_LOADING_SCREEN_INTERVAL
+#define FLUX_LOADING_SCREEN_INTERVAL 0.1
+#endif
+
 // this is so that we don't keep drawing to the screen if we repeatedly call
 // draw loading screen when its on the same %.
 static int last = -1;
+static double last_time = -1; ///< Time the last frame was drawn.
 
 /**
  * @brief Draws a loading screen with label.
@@ -23,8 +33,13 @@ void flux_draw_loading_screen(const char* text, float amount) {
     int next = (amount * 100.0f);
     if (next == last)
         return;
+    double now = GetTime();
+    if ((next < 100) && (last_time >= 0) &&
+        (now - last_time < FLUX_LOADING_SCREEN_INTERVAL))
+        return;
     TraceLog(LOG_INFO, "drawing loading screen");
     last = next;
+    last_time = now;
 
     BeginDrawing();
     ClearBackground(BLACK);
@@ -21,6 +21,8 @@
  */
 
 #include "prefabs.h"
+#include "asset_registry.h"
+#include "asset_stream.h"
 #include "hqtools/hqtools.h"
 #include "pipeline.h"
 #include "prefab_parser.h"
@@ -46,6 +48,11 @@ typedef struct fluxPrefabStruct {
     int projection; ///< Camera projection type (orthographic, perspective).
     float fov;      ///< Field of view, relevant if the prefab is a camera.
     Color tint;     ///< Tint of this prefab.
+    bool is_static; ///< Whether instances never move (see
+                    ///< `flux_prefab_is_static()`).
+    bool is_occluder; ///< Whether the prefab's model is an occluder.
+    float lod_bias;   ///< LOD bias of the prefab's model.
+    renderModelRequest request; ///< The streamed model, NULL once it is in.
 } fluxPrefabStruct;
 
 /**
@@ -169,6 +176,83 @@ enum fluxScriptID* flux_prefab_get_scripts(fluxPrefab prefab) {
     return prefab->scripts;
 }
 
+/**
+ * @brief Checks if a prefab is static. Instances of static prefabs created
+ * while a scene loads are merged into static batches, and must not move.
+ * @param prefab Pointer to the prefab.
+ * @return True if the prefab is static.
+ */
+bool flux_prefab_is_static(fluxPrefab prefab) {
+    LOG_FUNC_CALL();
+    assert(prefab);
+    return prefab->is_static;
+}
+
+/**
+ * @brief Checks if a prefab's model is an occluder.
+ * @param prefab Pointer to the prefab.
+ * @return True if the prefab's model hides other models.
+ */
+bool flux_prefab_is_occluder(fluxPrefab prefab) {
+    LOG_FUNC_CALL();
+    assert(prefab);
+    return prefab->is_occluder;
+}
+
+/**
+ * @brief Checks if a prefab's model is loaded. Until it is, the prefab uses a
+ * placeholder (a unit cube).
+ * @param prefab Pointer to the prefab.
+ * @return True if the prefab's model is in (or it has none).
+ */
+bool flux_prefab_is_ready(fluxPrefab prefab) {
+    LOG_FUNC_CALL();
+    assert(prefab);
+    return prefab->request == NULL;
+}
+
+/**
+ * @brief Makes the renderModel of a prefab from its raw model. Streamed
+ * models were simplified by the streaming threads, so their levels of detail
+ * are shared rather than made here.
+ */
+static void make_model(fluxPrefab prefab) {
+    LOG_FUNC_CALL();
+    prefab->model = render_make_model(prefab->raw_model);
+    render_model_set_occluder(prefab->model, prefab->is_occluder);
+    render_model_set_lod_bias(prefab->model, prefab->lod_bias);
+}
+
+/**
+ * @brief Swaps in a prefab's streamed model once it is loaded.
+ *
+ * Instances that use the old model (see `flux_prefab_get_model()`) must be
+ * moved to the new one before the old one is freed with
+ * `render_free_model()`.
+ * @param prefab Pointer to the prefab.
+ * @return The placeholder renderModel that was replaced, or NULL if nothing
+ * changed.
+ */
+renderModel flux_prefab_update_stream(fluxPrefab prefab) {
+    LOG_FUNC_CALL();
+    assert(prefab);
+    if (!prefab->request || !render_model_request_is_ready(prefab->request))
+        return NULL;
+    Model model = render_model_request_take(prefab->request);
+    render_model_request_free(prefab->request);
+    prefab->request = NULL;
+    if (!model.meshes) {
+        TraceLog(LOG_WARNING, "prefab %s keeps its placeholder model",
+                 hstr_unpack(prefab->name));
+        return NULL;
+    }
+    renderModel placeholder = prefab->model;
+    render_release_model(prefab->raw_model);
+    prefab->raw_model = model;
+    make_model(prefab);
+    return placeholder;
+}
+
 /**
  * @brief Retrieves the tint associated with the prefab.
  * @param prefab Pointer to the prefab.
@@ -197,16 +281,17 @@ fluxPrefab flux_load_prefab(fluxParsedPrefab parsed) {
         const char* model_path =
             hstr_unpack(parser_parsed_prefab_get_model_path(parsed));
         TraceLog(LOG_INFO, "loading model %s", model_path);
-        if (strcmp(model_path, "SPHERE") == 0) {
-            out->raw_model = LoadModelFromMesh(GenMeshSphere(1, 50, 50));
-        } else if (strcmp(model_path, "CUBE") == 0) {
-            out->raw_model = LoadModelFromMesh(GenMeshCube(1, 1, 1));
-        } else if (strcmp(model_path, "PLANE") == 0) {
-            out->raw_model = LoadModelFromMesh(GenMeshPlane(1, 1, 10, 10));
+        out->request = render_request_model(model_path);
+        if (render_model_request_is_ready(out->request)) {
+            out->raw_model = render_model_request_take(out->request);
+            render_model_request_free(out->request);
+            out->request = NULL;
         } else {
-            out->raw_model = LoadModel(model_path);
+            out->raw_model = render_acquire_model("CUBE");
         }
-        out->model = render_make_model(out->raw_model);
+        out->is_occluder = parser_parsed_prefab_is_occluder(parsed);
+        out->lod_bias = parser_parsed_prefab_get_lod_bias(parsed);
+        make_model(out);
     }
     out->is_camera = parser_parsed_prefab_is_camera(parsed);
     hstrArray scripts = parser_parsed_prefab_get_scripts(parsed);
@@ -219,6 +304,7 @@ fluxPrefab flux_load_prefab(fluxParsedPrefab parsed) {
     out->projection = parser_parsed_prefab_get_projection(parsed);
     out->fov = parser_parsed_prefab_get_fov(parsed);
     out->tint = parser_parsed_prefab_get_tint(parsed);
+    out->is_static = parser_parsed_prefab_is_static(parsed);
     return out;
 }
 
@@ -230,9 +316,11 @@ void flux_delete_prefab(fluxPrefab prefab) {
     LOG_FUNC_CALL();
     assert(prefab);
     hstr_decref(prefab->name);
+    if (prefab->request)
+        render_model_request_free(prefab->request);
     if (prefab->has_model) {
-        UnloadModel(prefab->raw_model);
         render_free_model(prefab->model);
+        render_release_model(prefab->raw_model);
     }
     if (prefab->scripts)
         free(prefab->scripts);
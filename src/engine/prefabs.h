@@ -49,6 +49,14 @@ enum fluxScriptID* flux_prefab_get_scripts(fluxPrefab prefab);
 
 Color flux_prefab_get_tint(fluxPrefab prefab);
 
+bool flux_prefab_is_static(fluxPrefab prefab);
+
+bool flux_prefab_is_occluder(fluxPrefab prefab);
+
+bool flux_prefab_is_ready(fluxPrefab prefab);
+
+renderModel flux_prefab_update_stream(fluxPrefab prefab);
+
 /** @} */
 
 #endif
\ No newline at end of file
@@ -11,6 +11,7 @@
  */
 
 #include "scene.h"
+#include "aabb_tree.h"
 #include "config.h"
 #include "gameobject.h"
 #include "hqtools/hqtools.h"
@@ -22,19 +23,101 @@
 #include "scene_parser.h"
 #include "sceneallocator.h"
 #include "scripts.h"
+#include "static_batch.h"
 #include "text_stuff.h"
 #include "transform.h"
+#include "world.h"
 #include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Margin added to each side of the boxes in the scene's AABB tree, so
+ * objects that move a little do not have to be reinserted.
+ */
+#ifndef FLUX_SCENE_TREE_MARGIN
+#define FLUX_SCENE_TREE_MARGIN 0.5f
+#endif
+
+/**
+ * @brief Size of the cubic chunks static objects are merged into.
+ */
+#ifndef FLUX_STATIC_BATCH_CHUNK_SIZE
+#define FLUX_STATIC_BATCH_CHUNK_SIZE 32.0f
+#endif
+
+/**
+ * @brief Default time spent per frame building a scene that loads in the
+ * background, in seconds (see `flux_set_scene_load_budget()`).
+ */
+#ifndef FLUX_SCENE_LOAD_BUDGET
+#define FLUX_SCENE_LOAD_BUDGET 0.002
+#endif
 
 static fluxGameObject*
     game_objects; ///< Array of game objects currently in the scene.
 static fluxPrefab* prefabs = NULL; ///< Array of prefabs used in the scene.
 static int n_prefabs = 0;          ///< Count of prefabs loaded into the scene.
 static int n_objects = 0; ///< Count of game objects currently in the scene.
+static int game_objects_size = 0; ///< Capacity of `game_objects`.
 static fluxGameObject active_camera = NULL; ///< Active camera game object.
 
+/**
+ * @var static fluxAABBTree scene_tree
+ * @brief Bounds of every game object with a model, for visibility and spatial
+ * queries. User data of a proxy is the id of its game object.
+ */
+static fluxAABBTree scene_tree = NULL;
+
+/**
+ * @var static fluxGameObject* moved_objects
+ * @brief Game objects whose transform changed since their tree proxy was last
+ * updated.
+ */
+static fluxGameObject* moved_objects = NULL;
+static int n_moved_objects = 0;    ///< Number of moved objects.
+static int moved_objects_size = 0; ///< Capacity of `moved_objects`.
+
+/**
+ * @var static int* query_ids
+ * @brief Ids of the game objects found by the last visibility query.
+ */
+static int* query_ids = NULL;
+static int n_query_ids = 0;    ///< Number of ids found by the last query.
+static int query_ids_size = 0; ///< Capacity of `query_ids`.
+
+/**
+ * @struct fluxStaticBatch
+ * @brief The static instances of a prefab, merged into chunks.
+ *
+ * @var Model model Merged model, one mesh per chunk and material.
+ * @var renderModel rmodel Render model of `model`, with a single identity
+ * instance.
+ * @var Color tint Tint of the prefab.
+ */
+typedef struct fluxStaticBatch {
+    Model model;
+    renderModel rmodel;
+    Color tint;
+} fluxStaticBatch;
+
+/**
+ * @var static fluxStaticBatch* static_batches
+ * @brief Static batches built when the scene was loaded.
+ */
+static fluxStaticBatch* static_batches = NULL;
+static int n_static_batches = 0; ///< Number of static batches.
+static int n_static_objects = 0; ///< Game objects merged into static batches.
+static int n_static_chunks = 0;  ///< Meshes of all static batches.
+static int static_draws_merged = 0; ///< Meshes of the merged game objects.
+static double static_batch_time = 0; ///< Seconds spent building the batches.
+static bool static_batches_pending = false; ///< Set while the static batches
+                                            ///< wait for streamed models.
+
 /**
  * @brief Resets the scene to its initial state.
  *
@@ -46,6 +129,9 @@ void flux_reset_scene(void) {
     flux_init_scene_allocator();
     n_objects = 0;
     active_camera = NULL;
+    if (!scene_tree)
+        scene_tree = flux_aabb_tree_create(FLUX_SCENE_TREE_MARGIN);
+    n_moved_objects = 0;
 }
 
 /**
@@ -56,6 +142,7 @@ void flux_reset_scene(void) {
  */
 void flux_close_scene(void) {
     LOG_FUNC_CALL();
+    flux_close_world();
     flux_scene_script_callback(ONDESTROY);
     if (prefabs) {
         for (int i = 0; i < n_prefabs; i++) {
@@ -73,19 +160,328 @@ void flux_close_scene(void) {
         game_objects = NULL;
         n_objects = 0;
     }
+    game_objects_size = 0;
+    if (scene_tree) {
+        flux_aabb_tree_destroy(scene_tree);
+        scene_tree = NULL;
+    }
+    if (moved_objects) {
+        free(moved_objects);
+        moved_objects = NULL;
+    }
+    n_moved_objects = 0;
+    moved_objects_size = 0;
+    if (query_ids) {
+        free(query_ids);
+        query_ids = NULL;
+    }
+    n_query_ids = 0;
+    query_ids_size = 0;
+    for (int i = 0; i < n_static_batches; i++) {
+        render_free_model(static_batches[i].rmodel);
+        UnloadModel(static_batches[i].model);
+    }
+    if (static_batches) {
+        free(static_batches);
+        static_batches = NULL;
+    }
+    n_static_batches = 0;
+    static_batches_pending = false;
+    n_static_objects = 0;
+    n_static_chunks = 0;
+    static_draws_merged = 0;
     render_unload_skybox();
     flux_close_scene_allocator();
 }
 
+/**
+ * @brief Records that a game object in the scene's AABB tree moved, so its
+ * proxy is updated before the next query.
+ *
+ * Called by `flux_gameobject_set_transform()`, at most once per object
+ * between updates.
+ * @param obj The game object that moved.
+ */
+void flux_scene_gameobject_moved(fluxGameObject obj) {
+    LOG_FUNC_CALL();
+    assert(obj);
+    if (n_moved_objects == moved_objects_size) {
+        moved_objects_size = moved_objects_size ? moved_objects_size * 2 : 64;
+        moved_objects = realloc(moved_objects,
+                                sizeof(fluxGameObject) * moved_objects_size);
+        assert(moved_objects);
+    }
+    moved_objects[n_moved_objects] = obj;
+    n_moved_objects++;
+}
+
+/**
+ * @brief Updates the tree proxies of every game object that moved since the
+ * last update. Proxies whose fat box still contains the object are kept.
+ */
+static void update_scene_tree(void) {
+    LOG_FUNC_CALL();
+    if (!scene_tree)
+        return;
+    for (int i = 0; i < n_moved_objects; i++) {
+        fluxGameObject obj = moved_objects[i];
+        int proxy = flux_gameobject_get_tree_proxy(obj);
+        flux_aabb_tree_move(scene_tree, proxy,
+                            flux_gameobject_get_world_bounds(obj));
+        flux_gameobject_set_tree_proxy(obj, proxy);
+    }
+    n_moved_objects = 0;
+}
+
+/**
+ * @brief Query callback that appends the id of each proxy found to
+ * `query_ids`.
+ */
+static bool collect_query_id(void* data, int proxy, void* user_data) {
+    LOG_FUNC_CALL();
+    if (n_query_ids == query_ids_size) {
+        query_ids_size = query_ids_size ? query_ids_size * 2 : 256;
+        query_ids = realloc(query_ids, sizeof(int) * query_ids_size);
+        assert(query_ids);
+    }
+    query_ids[n_query_ids] = (int)(intptr_t)user_data;
+    n_query_ids++;
+    return true;
+}
+
+/**
+ * @brief Compares two game object ids, for `qsort()`.
+ */
+static int compare_ids(const void* a, const void* b) {
+    int ia = *(const int*)a;
+    int ib = *(const int*)b;
+    return (ia > ib) - (ia < ib);
+}
+
+/**
+ * @brief Finds every game object with a model whose bounds (grown by
+ * `FLUX_SCENE_TREE_MARGIN`) overlap a box.
+ *
+ * @param box World space box to search.
+ * @param out Filled with up to `max_out` of the game objects found, ordered by
+ * id. May be NULL if `max_out` is 0.
+ * @param max_out Capacity of `out`.
+ * @return The number of game objects found, which may be more than `max_out`.
+ */
+int flux_scene_query_box(BoundingBox box, fluxGameObject* out, int max_out) {
+    LOG_FUNC_CALL();
+    if (!scene_tree)
+        return 0;
+    update_scene_tree();
+    n_query_ids = 0;
+    flux_aabb_tree_query_box(scene_tree, box, collect_query_id, NULL);
+    qsort(query_ids, n_query_ids, sizeof(int), compare_ids);
+    for (int i = 0; (i < n_query_ids) && (i < max_out); i++) {
+        out[i] = game_objects[query_ids[i]];
+    }
+    return n_query_ids;
+}
+
+/**
+ * @brief Returns the height of the scene's AABB tree.
+ * @return The height (0 for an empty tree).
+ */
+int flux_scene_get_tree_height(void) {
+    LOG_FUNC_CALL();
+    return scene_tree ? flux_aabb_tree_get_height(scene_tree) : 0;
+}
+
+/**
+ * @brief Returns the number of game objects in the scene's AABB tree.
+ * @return Number of proxies.
+ */
+int flux_scene_get_tree_proxies(void) {
+    LOG_FUNC_CALL();
+    return scene_tree ? flux_aabb_tree_get_n_proxies(scene_tree) : 0;
+}
+
+/**
+ * @brief Returns the number of tree nodes visited by the last query of the
+ * scene's AABB tree.
+ * @return Number of nodes visited.
+ */
+int flux_scene_get_tree_nodes_visited(void) {
+    LOG_FUNC_CALL();
+    return scene_tree ? flux_aabb_tree_get_nodes_visited(scene_tree) : 0;
+}
+
+/**
+ * @brief Returns the number of game objects found by the last visibility
+ * query of `flux_draw_scene()`.
+ * @return Number of game objects in the camera or light frustums.
+ */
+int flux_scene_get_visible_objects(void) {
+    LOG_FUNC_CALL();
+    return n_query_ids;
+}
+
+/**
+ * @brief Returns the number of game objects merged into static batches.
+ * @return Number of game objects.
+ */
+int flux_scene_get_static_objects(void) {
+    LOG_FUNC_CALL();
+    return n_static_objects;
+}
+
+/**
+ * @brief Returns the number of chunks (meshes) of the static batches, which
+ * is at most the number of draw calls they cost.
+ * @return Number of chunks.
+ */
+int flux_scene_get_static_chunks(void) {
+    LOG_FUNC_CALL();
+    return n_static_chunks;
+}
+
+/**
+ * @brief Returns the number of meshes of the game objects merged into static
+ * batches, i.e. the draw calls they would cost on their own.
+ * @return Number of meshes.
+ */
+int flux_scene_get_static_draws_merged(void) {
+    LOG_FUNC_CALL();
+    return static_draws_merged;
+}
+
+/**
+ * @brief Returns the time spent building the static batches of the scene.
+ * @return Time in seconds.
+ */
+double flux_scene_get_static_batch_time(void) {
+    LOG_FUNC_CALL();
+    return static_batch_time;
+}
+
+/**
+ * @brief Merges the visible instances of every static prefab into a static
+ * batch (see `render_build_static_batch()`), and marks them so they are not
+ * drawn on their own.
+ *
+ * Batched game objects stay in the scene's AABB tree, so spatial queries
+ * still find them.
+ */
+static void build_static_batches(void) {
+    LOG_FUNC_CALL();
+    double start = GetTime();
+    Matrix* transforms = NULL;
+    int transforms_size = 0;
+    for (int p = 0; p < n_prefabs; p++) {
+        fluxPrefab prefab = prefabs[p];
+        renderModel model = flux_prefab_get_model(prefab);
+        if (!flux_prefab_is_static(prefab) || flux_prefab_is_camera(prefab) ||
+            (model == NULL))
+            continue;
+        Model raw = flux_prefab_get_raw_model(prefab);
+        if (!render_static_batch_supported(raw)) {
+            TraceLog(LOG_WARNING, "prefab %s can not be batched",
+                     hstr_unpack(flux_prefab_get_name(prefab)));
+            continue;
+        }
+
+        int n = 0;
+        for (int i = 0; i < n_objects; i++) {
+            fluxGameObject obj = game_objects[i];
+            if ((flux_gameobject_get_model(obj) != model) ||
+                !flux_gameobject_is_visible(obj))
+                continue;
+            if (n == transforms_size) {
+                transforms_size = transforms_size ? transforms_size * 2 : 64;
+                transforms =
+                    realloc(transforms, sizeof(Matrix) * transforms_size);
+                assert(transforms);
+            }
+            transforms[n] = flux_gameobject_get_world_matrix(obj);
+            flux_gameobject_set_batched(obj);
+            n++;
+        }
+        if (n == 0)
+            continue;
+
+        fluxStaticBatch batch;
+        batch.model = render_build_static_batch(raw, transforms, n,
+                                                FLUX_STATIC_BATCH_CHUNK_SIZE);
+        for (int i = 0; i < batch.model.meshCount; i++) {
+            UploadMesh(&batch.model.meshes[i], false);
+        }
+        batch.rmodel = render_make_model_ex(batch.model, false);
+        render_model_set_occluder(batch.rmodel,
+                                  flux_prefab_is_occluder(prefab));
+        render_add_model_instance_ex(batch.rmodel, MatrixIdentity(), NULL,
+                                     NULL);
+        batch.tint = flux_prefab_get_tint(prefab);
+
+        static_batches = realloc(static_batches, sizeof(fluxStaticBatch) *
+                                                     (n_static_batches + 1));
+        assert(static_batches);
+        static_batches[n_static_batches] = batch;
+        n_static_batches++;
+        n_static_objects += n;
+        n_static_chunks += batch.model.meshCount;
+        static_draws_merged += n * raw.meshCount;
+        TraceLog(LOG_INFO, "static batch %s: %d objects in %d chunks",
+                 hstr_unpack(flux_prefab_get_name(prefab)), n,
+                 batch.model.meshCount);
+    }
+    if (transforms)
+        free(transforms);
+    static_batch_time = GetTime() - start;
+    if (n_static_batches > 0)
+        TraceLog(LOG_INFO,
+                 "static batching: %d objects (%d draws) merged into %d "
+                 "chunks in %.1f ms",
+                 n_static_objects, static_draws_merged, n_static_chunks,
+                 static_batch_time * 1000.0);
+}
+
+/**
+ * @brief Adds a game object with a model to an AABB tree.
+ * @param tree The tree.
+ * @param obj The game object.
+ * @param id Id of the game object, the user data of its proxy.
+ */
+static void insert_into_tree(fluxAABBTree tree, fluxGameObject obj, int id) {
+    LOG_FUNC_CALL();
+    if (!flux_gameobject_has_model(obj) || flux_gameobject_is_camera(obj))
+        return;
+    int proxy = flux_aabb_tree_insert(
+        tree, flux_gameobject_get_world_bounds(obj), (void*)(intptr_t)id);
+    flux_gameobject_set_tree_proxy(obj, proxy);
+}
+
+/**
+ * @brief Finds a prefab by name.
+ * @param list The prefabs to look in.
+ * @param n Number of prefabs.
+ * @param name Name of the prefab.
+ * @return The last prefab called `name`, or NULL.
+ */
+static fluxPrefab find_prefab(fluxPrefab* list, int n, const char* name) {
+    LOG_FUNC_CALL();
+    fluxPrefab found = NULL;
+    for (int j = 0; j < n; j++) {
+        if (strcmp(hstr_unpack(flux_prefab_get_name(list[j])), name) == 0)
+            found = list[j];
+    }
+    return found;
+}
+
 /**
  * @brief Instantiates a prefab in the current scene
  *
  * @param prefab the prefab to instantiate
  * @param transform transform
  * @param args extra args passed to onInit
+ * @return the new game object
  */
-void flux_instantiate_prefab(fluxPrefab prefab, fluxTransform transform,
-                             hstrArray args) {
+fluxGameObject flux_instantiate_prefab(fluxPrefab prefab,
+                                       fluxTransform transform,
+                                       hstrArray args) {
     int id = n_objects;
     fluxGameObject allocated =
         flux_allocate_gameobject(id, transform, prefab, args);
@@ -94,10 +490,129 @@ void flux_instantiate_prefab(fluxPrefab prefab, fluxTransform transform,
     }
     // TraceLog(INFO,"instantiate prefab transform %g %g %g, %g %g %g, %g %g
     // %g",transform.pos.x,transform.pos.y,transform.pos.z,transform.rot.x,transform.rot.y,transform.rot.z,transform.scale.x,transform.scale.y,transform.scale.z);
-    game_objects =
-        realloc(game_objects, sizeof(fluxGameObject) * (n_objects + 1));
+    if (n_objects == game_objects_size) {
+        game_objects_size = game_objects_size ? game_objects_size * 2 : 64;
+        game_objects =
+            realloc(game_objects, sizeof(fluxGameObject) * game_objects_size);
+        assert(game_objects);
+    }
     game_objects[n_objects] = allocated;
     n_objects++;
+    if (scene_tree)
+        insert_into_tree(scene_tree, allocated, id);
+    return allocated;
+}
+
+/**
+ * @brief Removes a game object from the current scene and destroys it.
+ *
+ * Calls onDestroy of its scripts and frees them. The last game object of the
+ * scene takes the removed object's place, so its id changes.
+ * @param obj The game object.
+ */
+void flux_scene_destroy_gameobject(fluxGameObject obj) {
+    LOG_FUNC_CALL();
+    assert(obj);
+    int id = flux_gameobject_get_id(obj);
+    assert((id >= 0) && (id < n_objects) && (game_objects[id] == obj));
+    if (flux_gameobject_is_batched(obj))
+        TraceLog(LOG_WARNING, "destroying game object %d, which is in a "
+                              "static batch (the batch still draws it)",
+                 id);
+
+    for (int j = 0; j < flux_gameobject_get_n_scripts(obj); j++) {
+        fluxCallback_onDestroy(obj, flux_gameobject_get_script(obj, j));
+    }
+    flux_gameobject_free_scripts(obj);
+
+    int proxy = flux_gameobject_get_tree_proxy(obj);
+    if (proxy >= 0) {
+        flux_aabb_tree_remove(scene_tree, proxy);
+        for (int i = 0; i < n_moved_objects; i++) {
+            if (moved_objects[i] == obj) {
+                moved_objects[i] = moved_objects[--n_moved_objects];
+                break;
+            }
+        }
+    }
+    if (active_camera == obj)
+        active_camera = NULL;
+
+    fluxGameObject last = game_objects[n_objects - 1];
+    game_objects[id] = last;
+    n_objects--;
+    if (last != obj) {
+        flux_gameobject_set_id(last, id);
+        int last_proxy = flux_gameobject_get_tree_proxy(last);
+        if (last_proxy >= 0)
+            flux_aabb_tree_set_user_data(scene_tree, last_proxy,
+                                         (void*)(intptr_t)id);
+    }
+    flux_destroy_gameobject(obj);
+}
+
+/**
+ * @brief Adds a prefab to the current scene, which then draws its instances
+ * and deletes it when it closes.
+ * @param prefab The prefab.
+ */
+void flux_scene_add_prefab(fluxPrefab prefab) {
+    LOG_FUNC_CALL();
+    assert(prefab);
+    prefabs = realloc(prefabs, sizeof(fluxPrefab) * (n_prefabs + 1));
+    assert(prefabs);
+    prefabs[n_prefabs] = prefab;
+    n_prefabs++;
+}
+
+/**
+ * @brief Removes a prefab from the current scene, without deleting it. The
+ * prefab must have no instances left.
+ * @param prefab The prefab.
+ */
+void flux_scene_remove_prefab(fluxPrefab prefab) {
+    LOG_FUNC_CALL();
+    assert(prefab);
+    for (int i = 0; i < n_prefabs; i++) {
+        if (prefabs[i] != prefab)
+            continue;
+        // keep the draw order of the other prefabs
+        memmove(&prefabs[i], &prefabs[i + 1],
+                sizeof(fluxPrefab) * (n_prefabs - i - 1));
+        n_prefabs--;
+        return;
+    }
+    assert((1 == 0) && "prefab is not in the scene");
+}
+
+/**
+ * @brief Finds a prefab of the current scene by name.
+ * @param name Name of the prefab.
+ * @return The prefab, or NULL.
+ */
+fluxPrefab flux_scene_find_prefab(const char* name) {
+    LOG_FUNC_CALL();
+    assert(name);
+    return find_prefab(prefabs, n_prefabs, name);
+}
+
+/**
+ * @brief Gets the camera the current scene is drawn from.
+ * @return The active camera game object, or NULL.
+ */
+fluxGameObject flux_scene_get_active_camera(void) {
+    LOG_FUNC_CALL();
+    return active_camera;
+}
+
+/**
+ * @brief Checks whether every model the scene file placed streamed in and the
+ * static batches are built.
+ * @return True once the scene is complete.
+ */
+bool flux_scene_is_ready(void) {
+    LOG_FUNC_CALL();
+    return !static_batches_pending;
 }
 
 /**
@@ -109,13 +624,7 @@ void flux_instantiate_prefab(fluxPrefab prefab, fluxTransform transform,
  */
 void flux_instantiate_prefab_by_name(const char* name, fluxTransform transform,
                                      hstrArray args) {
-    fluxPrefab to_instantiate = NULL;
-    for (int j = 0; j < n_prefabs; j++) {
-        fluxPrefab prefab = prefabs[j];
-        if (strcmp(hstr_unpack(flux_prefab_get_name(prefab)), name) != 0)
-            continue;
-        to_instantiate = prefab;
-    }
+    fluxPrefab to_instantiate = find_prefab(prefabs, n_prefabs, name);
 
     assert(to_instantiate != NULL);
 
@@ -179,9 +688,385 @@ void flux_load_scene(const char* path) {
                                               (float)total_to_load);
     }
 
+    // static batches copy the meshes, so they wait for the streamed models
+    static_batches_pending = true;
+    flux_scene_update_streaming();
+
+    if (parser_parsed_scene_get_n_cells(parsed_scene) > 0)
+        flux_open_world(parsed_scene);
+
     parser_delete_parsed_scene(parsed_scene);
 }
 
+/**
+ * @brief Swaps in the streamed models of prefabs that came in, and moves the
+ * game objects that use the prefabs to them.
+ *
+ * The proxies of the moved game objects are refitted to their new bounds
+ * right away, in the tree they are in: the objects of a scene loading in the
+ * background are not in the current scene's tree, so they cannot go through
+ * `flux_scene_gameobject_moved()`.
+ * @param tree The AABB tree the game objects are in.
+ * @param list The prefabs.
+ * @param n Number of prefabs.
+ * @param objects The game objects that may use the prefabs.
+ * @param n_objs Number of game objects.
+ * @return Whether every prefab's model is in.
+ */
+static bool update_prefab_streams(fluxAABBTree tree, fluxPrefab* list, int n,
+                                  fluxGameObject* objects, int n_objs) {
+    LOG_FUNC_CALL();
+    bool all_ready = true;
+    for (int p = 0; p < n; p++) {
+        renderModel placeholder = flux_prefab_update_stream(list[p]);
+        if (placeholder) {
+            renderModel model = flux_prefab_get_model(list[p]);
+            for (int i = 0; i < n_objs; i++) {
+                fluxGameObject obj = objects[i];
+                if (flux_gameobject_get_model(obj) != placeholder)
+                    continue;
+                flux_gameobject_set_model(obj, model);
+                int proxy = flux_gameobject_get_tree_proxy(obj);
+                if (proxy >= 0)
+                    flux_aabb_tree_move(tree, proxy,
+                                        flux_gameobject_get_world_bounds(obj));
+            }
+            render_free_model(placeholder);
+        }
+        all_ready = all_ready && flux_prefab_is_ready(list[p]);
+    }
+    return all_ready;
+}
+
+/**
+ * @brief Swaps in the streamed models of the scene's prefabs that came in
+ * (see `render_update_asset_stream()`), and builds the static batches once
+ * every model is in. Call once a frame.
+ */
+void flux_scene_update_streaming(void) {
+    LOG_FUNC_CALL();
+    bool all_ready = update_prefab_streams(scene_tree, prefabs, n_prefabs,
+                                           game_objects, n_objects);
+    if (static_batches_pending && all_ready) {
+        static_batches_pending = false;
+        build_static_batches();
+    }
+}
+
+/**
+ * @brief Stages of a scene loading in the background.
+ */
+typedef enum fluxSceneLoadStage {
+    SCENE_LOAD_NONE,    ///< No scene is loading.
+    SCENE_LOAD_PARSING, ///< The scene file is parsed on a worker thread.
+    SCENE_LOAD_PREFABS, ///< Prefabs are loaded, their models stream in.
+    SCENE_LOAD_OBJECTS, ///< Game objects are prepared.
+    SCENE_LOAD_MODELS,  ///< Waiting for the last streamed models.
+} fluxSceneLoadStage;
+
+/**
+ * @struct fluxSceneLoad
+ * @brief A scene loading in the background. It is built next to the current
+ * scene, which stays live until the loaded scene replaces it.
+ *
+ * @var fluxSceneLoadStage stage Current stage.
+ * @var char* path Path of the scene file.
+ * @var pthread_t parser Thread parsing the scene file.
+ * @var atomic_bool parsed Set by `parser` once `parsed_scene` is ready.
+ * @var fluxParsedScene parsed_scene The parsed scene file.
+ * @var fluxPrefab* prefabs Loaded prefabs.
+ * @var int n_prefabs Number of loaded prefabs.
+ * @var fluxGameObject* objects Prepared game objects, one per game object of
+ * `parsed_scene`.
+ * @var fluxPrefab* object_prefabs Prefab of each prepared game object.
+ * @var int next Next prefab or game object to load.
+ * @var fluxAABBTree tree The scene's AABB tree.
+ * @var void (*on_loaded)(void*) Called once the scene replaced the current
+ * one.
+ * @var void* user_data Passed to `on_loaded`.
+ * @var double start Time the load started.
+ */
+typedef struct fluxSceneLoad {
+    fluxSceneLoadStage stage;
+    char* path;
+    pthread_t parser;
+    atomic_bool parsed;
+    fluxParsedScene parsed_scene;
+    fluxPrefab* prefabs;
+    int n_prefabs;
+    fluxGameObject* objects;
+    fluxPrefab* object_prefabs;
+    int next;
+    fluxAABBTree tree;
+    void (*on_loaded)(void*);
+    void* user_data;
+    double start;
+} fluxSceneLoad;
+
+static fluxSceneLoad scene_load = {0}; ///< The scene loading in background.
+static double scene_load_budget = FLUX_SCENE_LOAD_BUDGET;
+
+/**
+ * @brief Body of the thread that parses a scene loading in the background.
+ */
+static void* parse_scene_thread(void* data) {
+    LOG_FUNC_CALL();
+    scene_load.parsed_scene = parser_read_scene(scene_load.path);
+    atomic_store(&scene_load.parsed, true);
+    return NULL;
+}
+
+/**
+ * @brief Starts loading a scene in the background.
+ *
+ * The scene file is parsed on a worker thread, then `flux_update_scene_load()`
+ * loads its prefabs and prepares its game objects a slice at a time, while the
+ * current scene keeps running. Once every model of the new scene streamed in,
+ * it replaces the current scene: the current scene is closed, the scripts of
+ * the new game objects are allocated and their onInit called, and `on_loaded`
+ * is called.
+ * @param path The file path of the scene to load.
+ * @param on_loaded Called once the scene is live, or NULL.
+ * @param user_data Passed to `on_loaded`.
+ */
+void flux_load_scene_async(const char* path, void (*on_loaded)(void*),
+                           void* user_data) {
+    LOG_FUNC_CALL();
+    assert(path);
+    assert(scene_load.stage == SCENE_LOAD_NONE);
+    TraceLog(LOG_INFO, "loading scene %s in the background", path);
+    scene_load = (fluxSceneLoad){0};
+    assert(scene_load.path = (char*)malloc(strlen(path) + 1));
+    strcpy(scene_load.path, path);
+    scene_load.on_loaded = on_loaded;
+    scene_load.user_data = user_data;
+    scene_load.start = GetTime();
+    atomic_init(&scene_load.parsed, false);
+    scene_load.stage = SCENE_LOAD_PARSING;
+    pthread_create(&scene_load.parser, NULL, parse_scene_thread, NULL);
+}
+
+/**
+ * @brief Replaces the current scene with the scene loaded in the background.
+ */
+static void swap_in_scene_load(void) {
+    LOG_FUNC_CALL();
+    fluxSceneLoad load = scene_load;
+    scene_load = (fluxSceneLoad){0};
+
+    flux_close_scene();
+    flux_reset_scene();
+    flux_aabb_tree_destroy(scene_tree);
+    scene_tree = load.tree;
+    prefabs = load.prefabs;
+    n_prefabs = load.n_prefabs;
+    game_objects = load.objects;
+    n_objects = parser_parsed_scene_get_n_gameobjects(load.parsed_scene);
+    game_objects_size = n_objects + 1;
+    active_camera = NULL;
+
+    // onInit may instantiate more game objects, which go after these
+    int n_loaded = n_objects;
+    for (int i = 0; i < n_loaded; i++) {
+        fluxGameObject obj = game_objects[i];
+        if (flux_gameobject_is_camera(obj) && (active_camera == NULL))
+            active_camera = obj;
+        // the moved list starts empty, so no object may wait on it
+        flux_gameobject_set_tree_proxy(obj,
+                                       flux_gameobject_get_tree_proxy(obj));
+        fluxParsedGameObject parsed_gameobject =
+            parser_parsed_scene_get_gameobject(load.parsed_scene, i);
+        flux_gameobject_init_scripts(
+            obj, load.object_prefabs[i],
+            parser_parsed_gameobject_get_args(parsed_gameobject));
+    }
+
+    static_batches_pending = true;
+    flux_scene_update_streaming();
+
+    if (parser_parsed_scene_get_n_cells(load.parsed_scene) > 0)
+        flux_open_world(load.parsed_scene);
+
+    parser_delete_parsed_scene(load.parsed_scene);
+    free(load.object_prefabs);
+    TraceLog(LOG_INFO, "loaded scene %s in the background in %.1f ms",
+             load.path, (GetTime() - load.start) * 1000.0);
+    free(load.path);
+    if (load.on_loaded)
+        load.on_loaded(load.user_data);
+}
+
+/**
+ * @brief Does the next step of the scene loading in the background: loads a
+ * prefab or prepares a game object.
+ * @return Whether there is more to do this frame.
+ */
+static bool scene_load_step(void) {
+    LOG_FUNC_CALL();
+    fluxParsedScene parsed = scene_load.parsed_scene;
+    switch (scene_load.stage) {
+    case SCENE_LOAD_NONE:
+        return false;
+    case SCENE_LOAD_PARSING: {
+        if (!atomic_load(&scene_load.parsed))
+            return false;
+        pthread_join(scene_load.parser, NULL);
+        parsed = scene_load.parsed_scene;
+        TraceLog(LOG_INFO, "parsed scene %s in %.1f ms", scene_load.path,
+                 (GetTime() - scene_load.start) * 1000.0);
+        int n_to_load = parser_parsed_scene_get_n_prefabs(parsed);
+        assert(scene_load.prefabs =
+                   (fluxPrefab*)malloc(sizeof(fluxPrefab) * (n_to_load + 1)));
+        scene_load.stage = SCENE_LOAD_PREFABS;
+        scene_load.next = 0;
+        return true;
+    }
+    case SCENE_LOAD_PREFABS: {
+        if (scene_load.next < parser_parsed_scene_get_n_prefabs(parsed)) {
+            fluxParsedPrefab parsed_prefab =
+                parser_parsed_scene_get_prefab(parsed, scene_load.next++);
+            scene_load.prefabs[scene_load.n_prefabs++] =
+                flux_load_prefab(parsed_prefab);
+            return true;
+        }
+        int n_to_load = parser_parsed_scene_get_n_gameobjects(parsed);
+        assert(scene_load.objects = (fluxGameObject*)malloc(
+                   sizeof(fluxGameObject) * (n_to_load + 1)));
+        assert(scene_load.object_prefabs =
+                   (fluxPrefab*)malloc(sizeof(fluxPrefab) * (n_to_load + 1)));
+        scene_load.tree = flux_aabb_tree_create(FLUX_SCENE_TREE_MARGIN);
+        scene_load.stage = SCENE_LOAD_OBJECTS;
+        scene_load.next = 0;
+        return true;
+    }
+    case SCENE_LOAD_OBJECTS: {
+        int i = scene_load.next;
+        if (i == parser_parsed_scene_get_n_gameobjects(parsed)) {
+            scene_load.stage = SCENE_LOAD_MODELS;
+            return true;
+        }
+        fluxParsedGameObject parsed_gameobject =
+            parser_parsed_scene_get_gameobject(parsed, i);
+        fluxPrefab prefab = find_prefab(
+            scene_load.prefabs, scene_load.n_prefabs,
+            hstr_unpack(
+                parser_parsed_gameobject_get_prefab_name(parsed_gameobject)));
+        assert(prefab != NULL);
+        fluxGameObject obj = flux_prepare_gameobject(
+            i, parser_parsed_gameobject_get_transform(parsed_gameobject),
+            prefab);
+        scene_load.objects[i] = obj;
+        scene_load.object_prefabs[i] = prefab;
+        insert_into_tree(scene_load.tree, obj, i);
+        scene_load.next++;
+        return true;
+    }
+    case SCENE_LOAD_MODELS:
+        if (!update_prefab_streams(scene_load.tree, scene_load.prefabs,
+                                   scene_load.n_prefabs, scene_load.objects,
+                                   scene_load.next))
+            return false;
+        swap_in_scene_load();
+        return false;
+    }
+    return false;
+}
+
+/**
+ * @brief Builds the scene loading in the background (see
+ * `flux_load_scene_async()`) until the frame's budget is spent. Call once a
+ * frame, after `render_update_asset_stream()`.
+ */
+void flux_update_scene_load(void) {
+    LOG_FUNC_CALL();
+    double start = GetTime();
+    while (scene_load_step() && (GetTime() - start < scene_load_budget)) {
+    }
+}
+
+/**
+ * @brief Drops the scene loading in the background, if there is one. The
+ * current scene is left as it is.
+ */
+void flux_cancel_scene_load(void) {
+    LOG_FUNC_CALL();
+    if (scene_load.stage == SCENE_LOAD_NONE)
+        return;
+    if (scene_load.stage == SCENE_LOAD_PARSING)
+        pthread_join(scene_load.parser, NULL);
+    for (int i = 0; i < scene_load.next; i++) {
+        if (scene_load.stage >= SCENE_LOAD_OBJECTS)
+            flux_destroy_gameobject(scene_load.objects[i]);
+    }
+    for (int i = 0; i < scene_load.n_prefabs; i++) {
+        flux_delete_prefab(scene_load.prefabs[i]);
+    }
+    if (scene_load.tree)
+        flux_aabb_tree_destroy(scene_load.tree);
+    if (scene_load.prefabs)
+        free(scene_load.prefabs);
+    if (scene_load.objects)
+        free(scene_load.objects);
+    if (scene_load.object_prefabs)
+        free(scene_load.object_prefabs);
+    parser_delete_parsed_scene(scene_load.parsed_scene);
+    TraceLog(LOG_INFO, "cancelled loading scene %s", scene_load.path);
+    free(scene_load.path);
+    scene_load = (fluxSceneLoad){0};
+}
+
+/**
+ * @brief Checks whether a scene is loading in the background.
+ * @return True between `flux_load_scene_async()` and the swap.
+ */
+bool flux_scene_is_loading(void) {
+    LOG_FUNC_CALL();
+    return scene_load.stage != SCENE_LOAD_NONE;
+}
+
+/**
+ * @brief Gets how far the scene loading in the background got.
+ * @return Fraction of its prefabs and game objects that are loaded, in
+ * [0, 1].
+ */
+float flux_get_scene_load_progress(void) {
+    LOG_FUNC_CALL();
+    switch (scene_load.stage) {
+    case SCENE_LOAD_NONE:
+    case SCENE_LOAD_MODELS:
+        return 1.0f;
+    case SCENE_LOAD_PARSING:
+        return 0.0f;
+    default:
+        break;
+    }
+    fluxParsedScene parsed = scene_load.parsed_scene;
+    int total = parser_parsed_scene_get_n_prefabs(parsed) +
+                parser_parsed_scene_get_n_gameobjects(parsed);
+    int done = scene_load.n_prefabs;
+    if (scene_load.stage == SCENE_LOAD_OBJECTS)
+        done += scene_load.next;
+    return total ? (float)done / (float)total : 1.0f;
+}
+
+/**
+ * @brief Sets how long `flux_update_scene_load()` may spend per frame.
+ * @param seconds The budget.
+ */
+void flux_set_scene_load_budget(double seconds) {
+    LOG_FUNC_CALL();
+    scene_load_budget = seconds;
+}
+
+/**
+ * @brief Gets the per-frame budget of scenes loading in the background.
+ * @return The budget in seconds.
+ */
+double flux_get_scene_load_budget(void) {
+    LOG_FUNC_CALL();
+    return scene_load_budget;
+}
+
 /**
  * @brief Executes a specific script callback for all scripts attached to all
  * game objects in the scene.
@@ -244,6 +1129,9 @@ void flux_scene_signal_handler(int signal) {
  *
  * This function manages the drawing of all renderable objects within the scene,
  * handles shadow calculation, and triggers rendering-related callbacks.
+ *
+ * Only game objects that the scene's AABB tree finds in the camera's frustum
+ * or in the frustum of an enabled light are handed to the renderer.
  */
 void flux_draw_scene(void) {
     LOG_FUNC_CALL();
@@ -256,19 +1144,46 @@ void flux_draw_scene(void) {
             render_reset_instances(flux_prefab_get_model(prefabs[i]));
         }
 
-        for (int i = 0; i < n_objects; i++) {
-            fluxGameObject obj = game_objects[i];
-            if (flux_gameobject_is_camera(obj))
-                continue;
-            if (!flux_gameobject_has_model(obj))
-                continue;
-            if (!flux_gameobject_is_visible(obj))
+        Camera3D cam = flux_gameobject_get_raylib_camera(active_camera);
+
+        // one hierarchical query for the camera and every light that casts
+        // shadows, so casters outside the view still reach the shadow pass
+        Vector4 planes[FLUX_AABB_TREE_MAX_VOLUMES * RENDER_FRUSTUM_N_PLANES];
+        int n_volumes = 0;
+        renderFrustum view = render_get_view_frustum(cam);
+        memcpy(planes, view.planes, sizeof(view.planes));
+        n_volumes++;
+        for (int i = 0; i < FLUX_MAX_LIGHTS; i++) {
+            if (!render_light_is_enabled(i))
                 continue;
-            render_add_model_instance(flux_gameobject_get_model(obj),
-                                      flux_gameobject_get_transform(obj));
+            if (n_volumes == FLUX_AABB_TREE_MAX_VOLUMES)
+                break;
+            renderFrustum light = render_light_get_frustum(i);
+            memcpy(&planes[n_volumes * RENDER_FRUSTUM_N_PLANES], light.planes,
+                   sizeof(light.planes));
+            n_volumes++;
         }
 
-        Camera3D cam = flux_gameobject_get_raylib_camera(active_camera);
+        update_scene_tree();
+        n_query_ids = 0;
+        flux_aabb_tree_query_volumes(scene_tree, planes,
+                                     RENDER_FRUSTUM_N_PLANES, n_volumes,
+                                     collect_query_id, NULL);
+        // tree order depends on insertion history, keep instance order stable
+        qsort(query_ids, n_query_ids, sizeof(int), compare_ids);
+
+        for (int i = 0; i < n_query_ids; i++) {
+            fluxGameObject obj = game_objects[query_ids[i]];
+            if (!flux_gameobject_is_visible(obj) ||
+                flux_gameobject_is_batched(obj))
+                continue;
+            // matrix and bounds are cached on the object, so this is free for
+            // objects that did not move
+            render_add_model_instance_ex(flux_gameobject_get_model(obj),
+                                         flux_gameobject_get_world_matrix(obj),
+                                         flux_gameobject_get_mesh_bounds(obj),
+                                         flux_gameobject_get_lods(obj));
+        }
 
         render_begin(cam);
 
@@ -280,6 +1195,10 @@ void flux_draw_scene(void) {
             render_rmodel(flux_prefab_get_model(prefabs[i]),
                           flux_prefab_get_tint(prefabs[i]));
         }
+        // static batches keep their single instance across frames
+        for (int i = 0; i < n_static_batches; i++) {
+            render_rmodel(static_batches[i].rmodel, static_batches[i].tint);
+        }
 
         render_calculate_shadows();
 
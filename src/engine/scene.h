@@ -6,8 +6,12 @@
 #define _FLUX_SCENE_H_
 
 #include "hqtools/hqtools.h"
+#include "raylib.h"
 #include "transform.h"
 
+struct fluxGameObjectStruct;
+struct fluxPrefabStruct;
+
 typedef enum {
     ONUPDATE,
     AFTERUPDATE,
@@ -23,25 +27,90 @@ typedef enum {
  * Then load a scene with `flux_load_scene()`.
  * Close the scene with `flux_close_scene()`, which should be called BEFORE
  * `flux_reset_scene()`.
+ * Instances of static prefabs (`prefabStatic`) placed by the scene file are
+ * merged into a few large chunked meshes once every model of the scene is
+ * loaded, and must not move after that.
+ * Models stream in on worker threads: until a prefab's model is in, its
+ * instances draw a unit cube, and `flux_scene_update_streaming()` swaps the
+ * model in.
+ * `flux_load_scene_async()` loads a scene in the background while the current
+ * scene keeps running, and replaces the current scene once it is loaded.
+ * A scene with `sceneCell` entries is a streamed world: once the scene is
+ * ready, `flux_update_world()` loads the cells near the active camera and
+ * unloads the cells it left behind (see world.h).
  *
  *  @{
  */
 
 void flux_load_scene(const char* path);
 
+void flux_load_scene_async(const char* path, void (*on_loaded)(void*),
+                           void* user_data);
+
+void flux_update_scene_load(void);
+
+void flux_cancel_scene_load(void);
+
+bool flux_scene_is_loading(void);
+
+float flux_get_scene_load_progress(void);
+
+void flux_set_scene_load_budget(double seconds);
+
+double flux_get_scene_load_budget(void);
+
 void flux_reset_scene(void);
 
 void flux_close_scene(void);
 
+void flux_scene_update_streaming(void);
+
+struct fluxGameObjectStruct*
+flux_instantiate_prefab(struct fluxPrefabStruct* prefab,
+                        fluxTransform transform, hstrArray args);
+
 void flux_instantiate_prefab_by_name(const char* name, fluxTransform transform,
                                      hstrArray args);
 
+void flux_scene_destroy_gameobject(struct fluxGameObjectStruct* obj);
+
+void flux_scene_add_prefab(struct fluxPrefabStruct* prefab);
+
+void flux_scene_remove_prefab(struct fluxPrefabStruct* prefab);
+
+struct fluxPrefabStruct* flux_scene_find_prefab(const char* name);
+
+struct fluxGameObjectStruct* flux_scene_get_active_camera(void);
+
+bool flux_scene_is_ready(void);
+
+int flux_scene_query_box(BoundingBox box, struct fluxGameObjectStruct** out,
+                         int max_out);
+
 /** @} */
 
 void flux_scene_signal_handler(int signal);
 
 void flux_draw_scene(void);
 
+void flux_scene_gameobject_moved(struct fluxGameObjectStruct* obj);
+
+int flux_scene_get_tree_height(void);
+
+int flux_scene_get_tree_proxies(void);
+
+int flux_scene_get_tree_nodes_visited(void);
+
+int flux_scene_get_visible_objects(void);
+
+int flux_scene_get_static_objects(void);
+
+int flux_scene_get_static_chunks(void);
+
+int flux_scene_get_static_draws_merged(void);
+
+double flux_scene_get_static_batch_time(void);
+
 void flux_scene_script_callback(script_callback_t callback);
 
 #endif
\ No newline at end of file
@@ -126,4 +126,27 @@ void* flux_scene_alloc(size_t sz) {
     n_allocations++;
     // finally return the malloced data
     return out;
+}
+
+/**
+ * @brief Frees memory from `flux_scene_alloc()` before the scene closes.
+ *
+ * Used for memory of game objects that leave the scene while it runs (e.g.
+ * the scripts of a world cell that streamed out). Recent allocations are
+ * searched first, as they are the most likely to be freed.
+ * @param ptr Pointer returned by `flux_scene_alloc()`.
+ */
+void flux_scene_free(void* ptr) {
+    LOG_FUNC_CALL();
+    for (int i = n_allocations - 1; i >= 0; i--) {
+        if (allocations[i] == ptr) {
+            allocations[i] = allocations[n_allocations - 1];
+            n_allocations--;
+            free(ptr);
+            return;
+        }
+    }
+    FLUX_ASSERT(false,
+                "FLUX<sceneallocator.c>: freed a pointer that was not "
+                "allocated by the sceneallocator");
 }
\ No newline at end of file
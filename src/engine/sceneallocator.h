@@ -19,4 +19,7 @@ void flux_close_scene_allocator(void);
 // allocates some heap space that will be cleared on scene close
 void* flux_scene_alloc(size_t sz);
 
+// frees heap space from flux_scene_alloc before scene close
+void flux_scene_free(void* ptr);
+
 #endif
\ No newline at end of file
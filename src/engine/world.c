@@ -0,0 +1,672 @@
+/**
+ * @file world.c
+ * @brief Streams the cells of a world scene in and out around the active
+ * camera.
+ *
+ * A world is a scene split into square cells on the xz plane. Cells near the
+ * camera are parsed on a worker thread and their game objects instantiated a
+ * slice at a time; cells the camera left behind are destroyed the same way.
+ * Prefabs only cells use are loaded while a resident game object uses them.
+ * Memory and per-frame work depend on the cells around the camera, not on the
+ * size of the world.
+ */
+
+#include "world.h"
+#include "config.h"
+#include "gameobject.h"
+#include "hqtools/hqtools.h"
+#include "prefab_parser.h"
+#include "prefabs.h"
+#include "raylib.h"
+#include "scene.h"
+#include "scene_parser.h"
+#include <assert.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Default time spent per frame instantiating and destroying the game
+ * objects of cells, in seconds (see `flux_set_world_budget()`).
+ */
+#ifndef FLUX_WORLD_BUDGET
+#define FLUX_WORLD_BUDGET 0.002
+#endif
+
+/**
+ * @brief States of a cell.
+ */
+typedef enum fluxCellState {
+    CELL_UNLOADED,  ///< Nothing of the cell is in memory.
+    CELL_PARSING,   ///< Queued for, or parsed on, the world's thread.
+    CELL_LOADING,   ///< Its game objects are instantiated.
+    CELL_LOADED,    ///< Every game object of the cell is in the scene.
+    CELL_UNLOADING, ///< Its game objects are destroyed.
+} fluxCellState;
+
+/**
+ * @struct fluxWorldCell
+ * @brief A cell of the world.
+ *
+ * @var int x Cell coordinate along x.
+ * @var int z Cell coordinate along z.
+ * @var char* path Path of the cell's scene file.
+ * @var fluxCellState state Current state.
+ * @var atomic_bool wanted Cleared when the camera leaves a cell that is still
+ * parsing, so the world's thread can skip it.
+ * @var atomic_bool parsed Set by the world's thread once `parsed_scene` is
+ * ready.
+ * @var fluxParsedScene parsed_scene The parsed cell file, NULL once every
+ * game object is in.
+ * @var fluxGameObject* objects The game objects of the cell in the scene.
+ * @var int* object_prefabs World prefab of each game object, or -1.
+ * @var int n_objects Number of game objects in the scene.
+ * @var int next Next game object of `parsed_scene` to instantiate.
+ * @var int resident Index of the cell in the world's resident cells.
+ */
+typedef struct fluxWorldCell {
+    int x;
+    int z;
+    char* path;
+    fluxCellState state;
+    atomic_bool wanted;
+    atomic_bool parsed;
+    fluxParsedScene parsed_scene;
+    fluxGameObject* objects;
+    int* object_prefabs;
+    int n_objects;
+    int next;
+    int resident;
+} fluxWorldCell;
+
+/**
+ * @struct fluxWorldPrefab
+ * @brief A prefab only cells use, loaded while game objects use it.
+ *
+ * @var fluxParsedPrefab parsed The parsed prefab file.
+ * @var fluxPrefab prefab The prefab, NULL while unused.
+ * @var int refs Number of game objects using `prefab`.
+ */
+typedef struct fluxWorldPrefab {
+    fluxParsedPrefab parsed;
+    fluxPrefab prefab;
+    int refs;
+} fluxWorldPrefab;
+
+/**
+ * @struct fluxWorld
+ * @brief The world streamed around the camera.
+ *
+ * @var bool open Set between `flux_open_world()` and `flux_close_world()`.
+ * @var float cell_size Edge length of the cells.
+ * @var float load_radius Cells closer to the camera load.
+ * @var float unload_radius Cells further from the camera unload.
+ * @var fluxWorldCell* cells The cells.
+ * @var int n_cells Number of cells.
+ * @var int* grid Index of the cell at each cell coordinate, or -1.
+ * @var int min_x Smallest cell coordinate along x.
+ * @var int min_z Smallest cell coordinate along z.
+ * @var int grid_width Number of cell coordinates along x.
+ * @var int grid_height Number of cell coordinates along z.
+ * @var fluxWorldPrefab* prefabs The world prefabs.
+ * @var int n_prefabs Number of world prefabs.
+ * @var int* resident Indices of the cells that are not unloaded.
+ * @var int n_resident Number of resident cells.
+ * @var int n_objects Game objects of cells in the scene.
+ * @var pthread_t parser The world's thread, parsing cell files.
+ * @var pthread_mutex_t lock Guards `queue` and `quit`.
+ * @var pthread_cond_t cond Signals `parser` when cells are queued.
+ * @var int* queue Ring of cells to parse, `n_cells` long.
+ * @var int queue_head Next cell of `queue` to parse.
+ * @var int queue_length Number of cells in `queue`.
+ * @var bool quit Tells `parser` to stop.
+ */
+typedef struct fluxWorld {
+    bool open;
+    float cell_size;
+    float load_radius;
+    float unload_radius;
+    fluxWorldCell* cells;
+    int n_cells;
+    int* grid;
+    int min_x;
+    int min_z;
+    int grid_width;
+    int grid_height;
+    fluxWorldPrefab* prefabs;
+    int n_prefabs;
+    int* resident;
+    int n_resident;
+    int n_objects;
+    pthread_t parser;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int* queue;
+    int queue_head;
+    int queue_length;
+    bool quit;
+} fluxWorld;
+
+static fluxWorld world = {0}; ///< The world of the current scene.
+static double world_budget = FLUX_WORLD_BUDGET;
+
+/**
+ * @brief Body of the world's thread: parses queued cells until the world
+ * closes.
+ */
+static void* parse_cells_thread(void* data) {
+    LOG_FUNC_CALL();
+    while (true) {
+        pthread_mutex_lock(&world.lock);
+        while (!world.quit && (world.queue_length == 0))
+            pthread_cond_wait(&world.cond, &world.lock);
+        if (world.quit) {
+            pthread_mutex_unlock(&world.lock);
+            return NULL;
+        }
+        fluxWorldCell* cell = &world.cells[world.queue[world.queue_head]];
+        world.queue_head = (world.queue_head + 1) % world.n_cells;
+        world.queue_length--;
+        pthread_mutex_unlock(&world.lock);
+
+        // cells the camera already left are not worth parsing
+        if (atomic_load(&cell->wanted))
+            cell->parsed_scene = parser_read_scene(cell->path);
+        atomic_store(&cell->parsed, true);
+    }
+}
+
+/**
+ * @brief Opens the world of a scene, from the cells of its parsed scene file.
+ * Called when a scene with cells loads.
+ * @param parsed The parsed scene.
+ */
+void flux_open_world(fluxParsedScene parsed) {
+    LOG_FUNC_CALL();
+    assert(parsed);
+    assert(!world.open);
+    world = (fluxWorld){0};
+    world.cell_size = parser_parsed_scene_get_cell_size(parsed);
+    world.load_radius = parser_parsed_scene_get_load_radius(parsed);
+    world.unload_radius = parser_parsed_scene_get_unload_radius(parsed);
+    assert(world.cell_size > 0);
+    if (world.unload_radius < world.load_radius) {
+        TraceLog(LOG_WARNING, "world unload radius %g is less than its load "
+                              "radius %g",
+                 world.unload_radius, world.load_radius);
+        world.unload_radius = world.load_radius;
+    }
+
+    world.n_cells = parser_parsed_scene_get_n_cells(parsed);
+    assert(world.n_cells > 0);
+    assert(world.cells = (fluxWorldCell*)malloc(sizeof(fluxWorldCell) *
+                                                world.n_cells));
+    int max_x = 0;
+    int max_z = 0;
+    for (int i = 0; i < world.n_cells; i++) {
+        fluxWorldCell* cell = &world.cells[i];
+        memset(cell, 0, sizeof(fluxWorldCell));
+        parser_parsed_scene_get_cell_coords(parsed, i, &cell->x, &cell->z);
+        const char* path =
+            hstr_unpack(parser_parsed_scene_get_cell_path(parsed, i));
+        assert(cell->path = (char*)malloc(strlen(path) + 1));
+        strcpy(cell->path, path);
+        cell->state = CELL_UNLOADED;
+        atomic_init(&cell->wanted, false);
+        atomic_init(&cell->parsed, false);
+        if ((i == 0) || (cell->x < world.min_x))
+            world.min_x = cell->x;
+        if ((i == 0) || (cell->z < world.min_z))
+            world.min_z = cell->z;
+        if ((i == 0) || (cell->x > max_x))
+            max_x = cell->x;
+        if ((i == 0) || (cell->z > max_z))
+            max_z = cell->z;
+    }
+
+    // dense grid, worlds are mostly filled rectangles of cells
+    world.grid_width = max_x - world.min_x + 1;
+    world.grid_height = max_z - world.min_z + 1;
+    assert(world.grid = (int*)malloc(sizeof(int) * world.grid_width *
+                                     world.grid_height));
+    for (int i = 0; i < world.grid_width * world.grid_height; i++) {
+        world.grid[i] = -1;
+    }
+    for (int i = 0; i < world.n_cells; i++) {
+        fluxWorldCell* cell = &world.cells[i];
+        int slot = (cell->z - world.min_z) * world.grid_width +
+                   (cell->x - world.min_x);
+        if (world.grid[slot] >= 0)
+            TraceLog(LOG_WARNING, "world has two cells at %d,%d", cell->x,
+                     cell->z);
+        world.grid[slot] = i;
+    }
+
+    hstrArray prefab_paths = parser_parsed_scene_get_world_prefabs(parsed);
+    world.n_prefabs = hstr_array_len(prefab_paths);
+    assert(world.prefabs = (fluxWorldPrefab*)malloc(
+               sizeof(fluxWorldPrefab) * (world.n_prefabs + 1)));
+    for (int i = 0; i < world.n_prefabs; i++) {
+        world.prefabs[i].parsed =
+            parser_read_prefab(hstr_unpack(hstr_array_get(prefab_paths, i)));
+        world.prefabs[i].prefab = NULL;
+        world.prefabs[i].refs = 0;
+    }
+
+    assert(world.resident = (int*)malloc(sizeof(int) * world.n_cells));
+    assert(world.queue = (int*)malloc(sizeof(int) * world.n_cells));
+    pthread_mutex_init(&world.lock, NULL);
+    pthread_cond_init(&world.cond, NULL);
+    world.open = true;
+    pthread_create(&world.parser, NULL, parse_cells_thread, NULL);
+    TraceLog(LOG_INFO, "opened world: %d cells of %g, %d world prefabs",
+             world.n_cells, world.cell_size, world.n_prefabs);
+}
+
+/**
+ * @brief Closes the world. Called when its scene closes, which destroys the
+ * game objects and prefabs the cells added to it.
+ */
+void flux_close_world(void) {
+    LOG_FUNC_CALL();
+    if (!world.open)
+        return;
+    pthread_mutex_lock(&world.lock);
+    world.quit = true;
+    pthread_cond_signal(&world.cond);
+    pthread_mutex_unlock(&world.lock);
+    pthread_join(world.parser, NULL);
+    pthread_mutex_destroy(&world.lock);
+    pthread_cond_destroy(&world.cond);
+
+    for (int i = 0; i < world.n_cells; i++) {
+        fluxWorldCell* cell = &world.cells[i];
+        if (cell->parsed_scene)
+            parser_delete_parsed_scene(cell->parsed_scene);
+        if (cell->objects)
+            free(cell->objects);
+        if (cell->object_prefabs)
+            free(cell->object_prefabs);
+        free(cell->path);
+    }
+    for (int i = 0; i < world.n_prefabs; i++) {
+        parser_delete_parsed_prefab(world.prefabs[i].parsed);
+    }
+    free(world.cells);
+    free(world.grid);
+    free(world.prefabs);
+    free(world.resident);
+    free(world.queue);
+    TraceLog(LOG_INFO, "closed world");
+    world = (fluxWorld){0};
+}
+
+/**
+ * @brief Distance on the xz plane from a point to the square of a cell.
+ */
+static float cell_distance(fluxWorldCell* cell, Vector3 pos) {
+    LOG_FUNC_CALL();
+    float x0 = cell->x * world.cell_size;
+    float z0 = cell->z * world.cell_size;
+    float dx = fmaxf(fmaxf(x0 - pos.x, pos.x - (x0 + world.cell_size)), 0);
+    float dz = fmaxf(fmaxf(z0 - pos.z, pos.z - (z0 + world.cell_size)), 0);
+    return sqrtf(dx * dx + dz * dz);
+}
+
+/**
+ * @brief Queues a parsing cell for the world's thread.
+ */
+static void queue_cell(int index) {
+    LOG_FUNC_CALL();
+    atomic_store(&world.cells[index].parsed, false);
+    pthread_mutex_lock(&world.lock);
+    world.queue[(world.queue_head + world.queue_length) % world.n_cells] =
+        index;
+    world.queue_length++;
+    pthread_cond_signal(&world.cond);
+    pthread_mutex_unlock(&world.lock);
+}
+
+/**
+ * @brief Queues a cell the camera got close to for parsing.
+ */
+static void start_loading(int index) {
+    LOG_FUNC_CALL();
+    fluxWorldCell* cell = &world.cells[index];
+    cell->state = CELL_PARSING;
+    cell->resident = world.n_resident;
+    world.resident[world.n_resident++] = index;
+    atomic_store(&cell->wanted, true);
+    queue_cell(index);
+}
+
+/**
+ * @brief Marks a cell as unloaded, and removes it from the resident cells.
+ */
+static void finish_unloading(fluxWorldCell* cell) {
+    LOG_FUNC_CALL();
+    cell->state = CELL_UNLOADED;
+    int last = world.resident[--world.n_resident];
+    world.resident[cell->resident] = last;
+    world.cells[last].resident = cell->resident;
+    cell->resident = -1;
+}
+
+/**
+ * @brief Starts unloading a cell the camera left behind.
+ */
+static void start_unloading(fluxWorldCell* cell) {
+    LOG_FUNC_CALL();
+    if (cell->state == CELL_PARSING) {
+        // the world's thread still owns it, drop it once it is parsed
+        atomic_store(&cell->wanted, false);
+        return;
+    }
+    if (cell->parsed_scene) {
+        parser_delete_parsed_scene(cell->parsed_scene);
+        cell->parsed_scene = NULL;
+    }
+    cell->state = CELL_UNLOADING;
+}
+
+/**
+ * @brief Loads the cells within the load radius of a position and unloads the
+ * resident cells beyond the unload radius.
+ * @param pos Position of the camera.
+ */
+static void update_cells(Vector3 pos) {
+    LOG_FUNC_CALL();
+    for (int i = 0; i < world.n_resident; i++) {
+        fluxWorldCell* cell = &world.cells[world.resident[i]];
+        float distance = cell_distance(cell, pos);
+        if ((distance > world.unload_radius) &&
+            ((cell->state == CELL_LOADING) || (cell->state == CELL_LOADED) ||
+             ((cell->state == CELL_PARSING) && atomic_load(&cell->wanted))))
+            start_unloading(cell);
+        else if ((distance <= world.load_radius) &&
+                 (cell->state == CELL_PARSING))
+            atomic_store(&cell->wanted, true);
+    }
+
+    int x0 = (int)floorf((pos.x - world.load_radius) / world.cell_size);
+    int x1 = (int)floorf((pos.x + world.load_radius) / world.cell_size);
+    int z0 = (int)floorf((pos.z - world.load_radius) / world.cell_size);
+    int z1 = (int)floorf((pos.z + world.load_radius) / world.cell_size);
+    x0 = (x0 > world.min_x) ? x0 : world.min_x;
+    z0 = (z0 > world.min_z) ? z0 : world.min_z;
+    x1 = (x1 < world.min_x + world.grid_width - 1)
+             ? x1
+             : world.min_x + world.grid_width - 1;
+    z1 = (z1 < world.min_z + world.grid_height - 1)
+             ? z1
+             : world.min_z + world.grid_height - 1;
+    for (int z = z0; z <= z1; z++) {
+        for (int x = x0; x <= x1; x++) {
+            int index = world.grid[(z - world.min_z) * world.grid_width +
+                                   (x - world.min_x)];
+            if ((index < 0) || (world.cells[index].state != CELL_UNLOADED))
+                continue;
+            if (cell_distance(&world.cells[index], pos) <= world.load_radius)
+                start_loading(index);
+        }
+    }
+}
+
+/**
+ * @brief Finds the prefab a game object of a cell uses, loading it if it is
+ * an unused world prefab.
+ * @param name Name of the prefab.
+ * @param world_prefab Set to the index of the world prefab, or -1 if the
+ * prefab belongs to the scene.
+ * @return The prefab, or NULL if there is none called `name`.
+ */
+static fluxPrefab acquire_prefab(const char* name, int* world_prefab) {
+    LOG_FUNC_CALL();
+    for (int i = 0; i < world.n_prefabs; i++) {
+        fluxWorldPrefab* wp = &world.prefabs[i];
+        if (strcmp(hstr_unpack(parser_parsed_prefab_get_name(wp->parsed)),
+                   name) != 0)
+            continue;
+        if (wp->refs == 0) {
+            wp->prefab = flux_load_prefab(wp->parsed);
+            flux_scene_add_prefab(wp->prefab);
+        }
+        wp->refs++;
+        *world_prefab = i;
+        return wp->prefab;
+    }
+    *world_prefab = -1;
+    return flux_scene_find_prefab(name);
+}
+
+/**
+ * @brief Drops a reference to a world prefab, deleting it once no game
+ * object uses it.
+ */
+static void release_prefab(int world_prefab) {
+    LOG_FUNC_CALL();
+    if (world_prefab < 0)
+        return;
+    fluxWorldPrefab* wp = &world.prefabs[world_prefab];
+    assert(wp->refs > 0);
+    wp->refs--;
+    if (wp->refs == 0) {
+        flux_scene_remove_prefab(wp->prefab);
+        flux_delete_prefab(wp->prefab);
+        wp->prefab = NULL;
+    }
+}
+
+/**
+ * @brief Takes in a parsed cell, drops it if the camera left it, or queues
+ * it again if the world's thread skipped it and the camera came back.
+ */
+static void finish_parsing(fluxWorldCell* cell) {
+    LOG_FUNC_CALL();
+    if (!atomic_load(&cell->wanted)) {
+        if (cell->parsed_scene)
+            parser_delete_parsed_scene(cell->parsed_scene);
+        cell->parsed_scene = NULL;
+        finish_unloading(cell);
+        return;
+    }
+    if (!cell->parsed_scene) {
+        // skipped while the camera was away, and wanted again since
+        queue_cell((int)(cell - world.cells));
+        return;
+    }
+    int n = parser_parsed_scene_get_n_gameobjects(cell->parsed_scene);
+    assert(cell->objects =
+               (fluxGameObject*)malloc(sizeof(fluxGameObject) * (n + 1)));
+    assert(cell->object_prefabs = (int*)malloc(sizeof(int) * (n + 1)));
+    cell->n_objects = 0;
+    cell->next = 0;
+    cell->state = CELL_LOADING;
+}
+
+/**
+ * @brief Instantiates the next game object of a loading cell.
+ */
+static void load_step(fluxWorldCell* cell) {
+    LOG_FUNC_CALL();
+    fluxParsedScene parsed = cell->parsed_scene;
+    if (cell->next == parser_parsed_scene_get_n_gameobjects(parsed)) {
+        parser_delete_parsed_scene(parsed);
+        cell->parsed_scene = NULL;
+        cell->state = CELL_LOADED;
+        TraceLog(LOG_INFO, "world cell %d,%d loaded: %d game objects",
+                 cell->x, cell->z, cell->n_objects);
+        return;
+    }
+    fluxParsedGameObject parsed_gameobject =
+        parser_parsed_scene_get_gameobject(parsed, cell->next++);
+    const char* name = hstr_unpack(
+        parser_parsed_gameobject_get_prefab_name(parsed_gameobject));
+    int world_prefab;
+    fluxPrefab prefab = acquire_prefab(name, &world_prefab);
+    if (!prefab) {
+        TraceLog(LOG_WARNING, "world cell %s uses unknown prefab %s",
+                 cell->path, name);
+        return;
+    }
+    cell->objects[cell->n_objects] = flux_instantiate_prefab(
+        prefab, parser_parsed_gameobject_get_transform(parsed_gameobject),
+        parser_parsed_gameobject_get_args(parsed_gameobject));
+    cell->object_prefabs[cell->n_objects] = world_prefab;
+    cell->n_objects++;
+    world.n_objects++;
+}
+
+/**
+ * @brief Destroys the last game object of an unloading cell.
+ */
+static void unload_step(fluxWorldCell* cell) {
+    LOG_FUNC_CALL();
+    if (cell->n_objects == 0) {
+        if (cell->objects)
+            free(cell->objects);
+        if (cell->object_prefabs)
+            free(cell->object_prefabs);
+        cell->objects = NULL;
+        cell->object_prefabs = NULL;
+        finish_unloading(cell);
+        return;
+    }
+    cell->n_objects--;
+    world.n_objects--;
+    flux_scene_destroy_gameobject(cell->objects[cell->n_objects]);
+    release_prefab(cell->object_prefabs[cell->n_objects]);
+}
+
+/**
+ * @brief Does the next piece of work on the resident cells. Unloading goes
+ * first, so memory is freed before more is used.
+ * @return Whether there may be more to do this frame.
+ */
+static bool world_step(void) {
+    LOG_FUNC_CALL();
+    for (int i = 0; i < world.n_resident; i++) {
+        fluxWorldCell* cell = &world.cells[world.resident[i]];
+        if (cell->state == CELL_UNLOADING) {
+            unload_step(cell);
+            return true;
+        }
+    }
+    for (int i = 0; i < world.n_resident; i++) {
+        fluxWorldCell* cell = &world.cells[world.resident[i]];
+        if ((cell->state == CELL_PARSING) && atomic_load(&cell->parsed)) {
+            finish_parsing(cell);
+            return true;
+        }
+    }
+    for (int i = 0; i < world.n_resident; i++) {
+        fluxWorldCell* cell = &world.cells[world.resident[i]];
+        if (cell->state == CELL_LOADING) {
+            load_step(cell);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Streams the world's cells around the active camera, and spends up to
+ * the world's budget instantiating and destroying their game objects. Call
+ * once a frame, after `flux_scene_update_streaming()`.
+ */
+void flux_update_world(void) {
+    LOG_FUNC_CALL();
+    if (!world.open || !flux_scene_is_ready())
+        return;
+    fluxGameObject camera = flux_scene_get_active_camera();
+    if (camera)
+        update_cells(flux_gameobject_get_transform(camera).pos);
+    double start = GetTime();
+    while (world_step() && (GetTime() - start < world_budget)) {
+    }
+}
+
+/**
+ * @brief Checks whether the current scene is a streamed world.
+ * @return True if the scene has cells.
+ */
+bool flux_world_is_open(void) {
+    LOG_FUNC_CALL();
+    return world.open;
+}
+
+/**
+ * @brief Sets how long `flux_update_world()` may spend per frame.
+ * @param seconds The budget.
+ */
+void flux_set_world_budget(double seconds) {
+    LOG_FUNC_CALL();
+    world_budget = seconds;
+}
+
+/**
+ * @brief Gets the per-frame budget of the world.
+ * @return The budget in seconds.
+ */
+double flux_get_world_budget(void) {
+    LOG_FUNC_CALL();
+    return world_budget;
+}
+
+/**
+ * @brief Gets the number of cells of the world.
+ * @return Number of cells, 0 if no world is open.
+ */
+int flux_world_get_n_cells(void) {
+    LOG_FUNC_CALL();
+    return world.n_cells;
+}
+
+/**
+ * @brief Gets the number of cells that are not unloaded.
+ * @return Number of resident cells.
+ */
+int flux_world_get_resident_cells(void) {
+    LOG_FUNC_CALL();
+    return world.n_resident;
+}
+
+/**
+ * @brief Gets the number of cells that are parsing, loading or unloading.
+ * @return Number of pending cells.
+ */
+int flux_world_get_pending_cells(void) {
+    LOG_FUNC_CALL();
+    int n = 0;
+    for (int i = 0; i < world.n_resident; i++) {
+        if (world.cells[world.resident[i]].state != CELL_LOADED)
+            n++;
+    }
+    return n;
+}
+
+/**
+ * @brief Gets the number of game objects cells added to the scene.
+ * @return Number of resident game objects of the world.
+ */
+int flux_world_get_resident_objects(void) {
+    LOG_FUNC_CALL();
+    return world.n_objects;
+}
+
+/**
+ * @brief Gets the number of world prefabs in use.
+ * @return Number of loaded world prefabs.
+ */
+int flux_world_get_loaded_prefabs(void) {
+    LOG_FUNC_CALL();
+    int n = 0;
+    for (int i = 0; i < world.n_prefabs; i++) {
+        if (world.prefabs[i].prefab)
+            n++;
+    }
+    return n;
+}
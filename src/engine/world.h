@@ -0,0 +1,56 @@
+/**
+ * @file world.h
+ **/
+
+#ifndef _FLUX_WORLD_H_
+#define _FLUX_WORLD_H_
+
+#include "hqtools/hqtools.h"
+#include "scene_parser.h"
+
+/** @addtogroup worldapi World API
+ *  @brief Streams the cells of a large scene in and out around the camera.
+ *
+ * A scene file that lists `sceneCell = x,z,path` entries is a streamed world.
+ * A cell is a scene file with only `sceneGameObject` lines, covering the
+ * square from (x, z) to (x + 1, z + 1) times `sceneCellSize` on the xz plane.
+ * `sceneCellRadius = load,unload` sets how close to the active camera a cell
+ * must get to load, and how far it must get to unload again; the gap keeps
+ * cells on the edge from loading and unloading every frame.
+ * `sceneWorldPrefabs` lists prefabs only cells use: they are loaded with the
+ * first cell that needs them and deleted with the last.
+ *
+ * Cell files are parsed on a worker thread, and their game objects are
+ * instantiated and destroyed a slice at a time, so a frame spends at most
+ * the world's budget on it. Cells start streaming once the scene file's own
+ * models are in (see `flux_scene_is_ready()`), and must not be moved or
+ * destroyed by scripts.
+ *
+ *  @{
+ */
+
+void flux_open_world(fluxParsedScene parsed);
+
+void flux_close_world(void);
+
+void flux_update_world(void);
+
+bool flux_world_is_open(void);
+
+void flux_set_world_budget(double seconds);
+
+double flux_get_world_budget(void);
+
+int flux_world_get_n_cells(void);
+
+int flux_world_get_resident_cells(void);
+
+int flux_world_get_pending_cells(void);
+
+int flux_world_get_resident_objects(void);
+
+int flux_world_get_loaded_prefabs(void);
+
+/** @} */
+
+#endif
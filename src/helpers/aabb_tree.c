@@ -0,0 +1,729 @@
+/**
+ * @file aabb_tree.c
+ * @brief Dynamic AABB tree (bounding volume hierarchy) for spatial queries.
+ *
+ * Leaves store "fat" boxes (the proxy's box grown by a margin), so proxies
+ * that move a little stay in their leaf and only proxies that leave their fat
+ * box are removed and reinserted. Insertion picks the sibling with the
+ * surface area heuristic and the tree is kept balanced with AVL style
+ * rotations, as in Box2D's `b2DynamicTree`.
+ *
+ * Queries walk the tree from the root and skip every subtree whose box misses
+ * the query, so they cost `O(log n + k)` for `k` results on a balanced tree.
+ **/
+
+#include "aabb_tree.h"
+#include "hqtools/hqtools.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Index used for "no node". */
+#define NULL_NODE (-1)
+
+/**
+ * @struct aabbNode
+ * @brief A node of the tree. Leaves are proxies, internal nodes have exactly
+ * two children and a box enclosing both.
+ */
+typedef struct aabbNode {
+    BoundingBox box;  ///< Fat box (leaves) or union of the children.
+    void* user_data;  ///< User data of a leaf.
+    int parent;       ///< Parent node, or next free node when free.
+    int child1;       ///< First child, `NULL_NODE` for leaves.
+    int child2;       ///< Second child, `NULL_NODE` for leaves.
+    int height;       ///< 0 for leaves, -1 for free nodes.
+} aabbNode;
+
+/**
+ * @struct aabbStackEntry
+ * @brief Pending node of a query, with the volumes it still has to be tested
+ * against.
+ */
+typedef struct aabbStackEntry {
+    int node;          ///< Node to visit.
+    unsigned int mask; ///< Volumes the node's parent straddles.
+    bool inside;       ///< Parent is fully inside a volume, report all leaves.
+} aabbStackEntry;
+
+/**
+ * @struct fluxAABBTreeInternal
+ * @brief A dynamic AABB tree. Not thread safe.
+ */
+struct fluxAABBTreeInternal {
+    aabbNode* nodes;        ///< Node pool.
+    int capacity;           ///< Allocated size of `nodes`.
+    int root;               ///< Root node.
+    int free_list;          ///< First free node.
+    int n_proxies;          ///< Number of leaves.
+    float margin;           ///< Fat box margin.
+    aabbStackEntry* stack;  ///< Query stack, kept across queries.
+    int stack_size;         ///< Allocated size of `stack`.
+    int nodes_visited;      ///< Nodes visited by the last query.
+};
+
+/**
+ * @brief Creates an empty tree.
+ * @param margin Leaves are enlarged by this much in every direction, so that
+ * small moves do not change the tree.
+ * @return The new tree.
+ */
+fluxAABBTree flux_aabb_tree_create(float margin) {
+    LOG_FUNC_CALL();
+    fluxAABBTree tree;
+    assert(tree = (fluxAABBTree)malloc(sizeof(fluxAABBTreeInternal)));
+    tree->nodes = NULL;
+    tree->capacity = 0;
+    tree->root = NULL_NODE;
+    tree->free_list = NULL_NODE;
+    tree->n_proxies = 0;
+    tree->margin = margin;
+    tree->stack = NULL;
+    tree->stack_size = 0;
+    tree->nodes_visited = 0;
+    return tree;
+}
+
+/**
+ * @brief Frees a tree.
+ * @param tree Tree to destroy.
+ */
+void flux_aabb_tree_destroy(fluxAABBTree tree) {
+    LOG_FUNC_CALL();
+    assert(tree);
+    if (tree->nodes)
+        free(tree->nodes);
+    if (tree->stack)
+        free(tree->stack);
+    free(tree);
+}
+
+/**
+ * @brief Returns the smallest box enclosing `a` and `b`.
+ */
+static BoundingBox box_union(BoundingBox a, BoundingBox b) {
+    LOG_FUNC_CALL();
+    BoundingBox out;
+    out.min.x = a.min.x < b.min.x ? a.min.x : b.min.x;
+    out.min.y = a.min.y < b.min.y ? a.min.y : b.min.y;
+    out.min.z = a.min.z < b.min.z ? a.min.z : b.min.z;
+    out.max.x = a.max.x > b.max.x ? a.max.x : b.max.x;
+    out.max.y = a.max.y > b.max.y ? a.max.y : b.max.y;
+    out.max.z = a.max.z > b.max.z ? a.max.z : b.max.z;
+    return out;
+}
+
+/**
+ * @brief Returns the surface area of a box (the insertion cost metric).
+ */
+static float box_area(BoundingBox box) {
+    LOG_FUNC_CALL();
+    float dx = box.max.x - box.min.x;
+    float dy = box.max.y - box.min.y;
+    float dz = box.max.z - box.min.z;
+    return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+/**
+ * @brief Checks whether `outer` contains `inner`.
+ */
+static bool box_contains(BoundingBox outer, BoundingBox inner) {
+    LOG_FUNC_CALL();
+    return (outer.min.x <= inner.min.x) && (outer.min.y <= inner.min.y) &&
+           (outer.min.z <= inner.min.z) && (outer.max.x >= inner.max.x) &&
+           (outer.max.y >= inner.max.y) && (outer.max.z >= inner.max.z);
+}
+
+/**
+ * @brief Checks whether two boxes overlap.
+ */
+static bool box_overlaps(BoundingBox a, BoundingBox b) {
+    LOG_FUNC_CALL();
+    return (a.min.x <= b.max.x) && (a.max.x >= b.min.x) &&
+           (a.min.y <= b.max.y) && (a.max.y >= b.min.y) &&
+           (a.min.z <= b.max.z) && (a.max.z >= b.min.z);
+}
+
+/**
+ * @brief Returns the larger of two ints.
+ */
+static int max_int(int a, int b) {
+    LOG_FUNC_CALL();
+    return a > b ? a : b;
+}
+
+/**
+ * @brief Takes a node from the free list, growing the pool if it is empty.
+ * @return Index of the node.
+ */
+static int allocate_node(fluxAABBTree tree) {
+    LOG_FUNC_CALL();
+    if (tree->free_list == NULL_NODE) {
+        int new_capacity = tree->capacity > 0 ? tree->capacity * 2 : 16;
+        aabbNode* nodes;
+        assert(nodes = (aabbNode*)malloc(sizeof(aabbNode) * new_capacity));
+        if (tree->nodes) {
+            memcpy(nodes, tree->nodes, sizeof(aabbNode) * tree->capacity);
+            free(tree->nodes);
+        }
+        for (int i = tree->capacity; i < new_capacity; i++) {
+            nodes[i].parent = i + 1 < new_capacity ? i + 1 : NULL_NODE;
+            nodes[i].height = -1;
+        }
+        tree->free_list = tree->capacity;
+        tree->nodes = nodes;
+        tree->capacity = new_capacity;
+    }
+    int index = tree->free_list;
+    aabbNode* node = &tree->nodes[index];
+    tree->free_list = node->parent;
+    node->parent = NULL_NODE;
+    node->child1 = NULL_NODE;
+    node->child2 = NULL_NODE;
+    node->height = 0;
+    node->user_data = NULL;
+    return index;
+}
+
+/**
+ * @brief Returns a node to the free list.
+ */
+static void free_node(fluxAABBTree tree, int index) {
+    LOG_FUNC_CALL();
+    tree->nodes[index].parent = tree->free_list;
+    tree->nodes[index].height = -1;
+    tree->free_list = index;
+}
+
+/**
+ * @brief Performs a left or right rotation if node `ia` is imbalanced.
+ * @return The index of the node that took the place of `ia`.
+ */
+static int balance(fluxAABBTree tree, int ia) {
+    LOG_FUNC_CALL();
+    aabbNode* nodes = tree->nodes;
+    aabbNode* a = &nodes[ia];
+    if ((a->child1 == NULL_NODE) || (a->height < 2))
+        return ia;
+
+    int ib = a->child1;
+    int ic = a->child2;
+    aabbNode* b = &nodes[ib];
+    aabbNode* c = &nodes[ic];
+    int diff = c->height - b->height;
+
+    if (diff > 1) {
+        // rotate c up
+        int i_f = c->child1;
+        int ig = c->child2;
+        aabbNode* f = &nodes[i_f];
+        aabbNode* g = &nodes[ig];
+
+        c->child1 = ia;
+        c->parent = a->parent;
+        a->parent = ic;
+        if (c->parent != NULL_NODE) {
+            if (nodes[c->parent].child1 == ia)
+                nodes[c->parent].child1 = ic;
+            else
+                nodes[c->parent].child2 = ic;
+        } else {
+            tree->root = ic;
+        }
+
+        if (f->height > g->height) {
+            c->child2 = i_f;
+            a->child2 = ig;
+            g->parent = ia;
+            a->box = box_union(b->box, g->box);
+            c->box = box_union(a->box, f->box);
+            a->height = 1 + max_int(b->height, g->height);
+            c->height = 1 + max_int(a->height, f->height);
+        } else {
+            c->child2 = ig;
+            a->child2 = i_f;
+            f->parent = ia;
+            a->box = box_union(b->box, f->box);
+            c->box = box_union(a->box, g->box);
+            a->height = 1 + max_int(b->height, f->height);
+            c->height = 1 + max_int(a->height, g->height);
+        }
+        return ic;
+    }
+
+    if (diff < -1) {
+        // rotate b up
+        int id = b->child1;
+        int ie = b->child2;
+        aabbNode* d = &nodes[id];
+        aabbNode* e = &nodes[ie];
+
+        b->child1 = ia;
+        b->parent = a->parent;
+        a->parent = ib;
+        if (b->parent != NULL_NODE) {
+            if (nodes[b->parent].child1 == ia)
+                nodes[b->parent].child1 = ib;
+            else
+                nodes[b->parent].child2 = ib;
+        } else {
+            tree->root = ib;
+        }
+
+        if (d->height > e->height) {
+            b->child2 = id;
+            a->child1 = ie;
+            e->parent = ia;
+            a->box = box_union(c->box, e->box);
+            b->box = box_union(a->box, d->box);
+            a->height = 1 + max_int(c->height, e->height);
+            b->height = 1 + max_int(a->height, d->height);
+        } else {
+            b->child2 = ie;
+            a->child1 = id;
+            d->parent = ia;
+            a->box = box_union(c->box, d->box);
+            b->box = box_union(a->box, e->box);
+            a->height = 1 + max_int(c->height, d->height);
+            b->height = 1 + max_int(a->height, e->height);
+        }
+        return ib;
+    }
+
+    return ia;
+}
+
+/**
+ * @brief Walks from `index` to the root, rebalancing and refitting the boxes
+ * and heights of the ancestors.
+ */
+static void refit_ancestors(fluxAABBTree tree, int index) {
+    LOG_FUNC_CALL();
+    while (index != NULL_NODE) {
+        index = balance(tree, index);
+        aabbNode* node = &tree->nodes[index];
+        aabbNode* child1 = &tree->nodes[node->child1];
+        aabbNode* child2 = &tree->nodes[node->child2];
+        node->height = 1 + max_int(child1->height, child2->height);
+        node->box = box_union(child1->box, child2->box);
+        index = node->parent;
+    }
+}
+
+/**
+ * @brief Returns the cost of descending into `child` to insert `box`.
+ */
+static float descend_cost(const aabbNode* child, BoundingBox box,
+                          float inheritance_cost) {
+    LOG_FUNC_CALL();
+    float area = box_area(box_union(box, child->box));
+    if (child->child1 == NULL_NODE)
+        return area + inheritance_cost;
+    return (area - box_area(child->box)) + inheritance_cost;
+}
+
+/**
+ * @brief Inserts a leaf, picking its sibling with the surface area heuristic.
+ */
+static void insert_leaf(fluxAABBTree tree, int leaf) {
+    LOG_FUNC_CALL();
+    if (tree->root == NULL_NODE) {
+        tree->root = leaf;
+        tree->nodes[leaf].parent = NULL_NODE;
+        return;
+    }
+
+    BoundingBox leaf_box = tree->nodes[leaf].box;
+    int index = tree->root;
+    while (tree->nodes[index].child1 != NULL_NODE) {
+        aabbNode* node = &tree->nodes[index];
+        float area = box_area(node->box);
+        float combined_area = box_area(box_union(node->box, leaf_box));
+
+        // cost of making a new parent for this node and the leaf
+        float cost = 2.0f * combined_area;
+        // minimum cost of pushing the leaf further down the tree
+        float inheritance_cost = 2.0f * (combined_area - area);
+
+        float cost1 = descend_cost(&tree->nodes[node->child1], leaf_box,
+                                   inheritance_cost);
+        float cost2 = descend_cost(&tree->nodes[node->child2], leaf_box,
+                                   inheritance_cost);
+        if ((cost < cost1) && (cost < cost2))
+            break;
+        index = cost1 < cost2 ? node->child1 : node->child2;
+    }
+    int sibling = index;
+
+    int old_parent = tree->nodes[sibling].parent;
+    int new_parent = allocate_node(tree);
+    aabbNode* nodes = tree->nodes;
+    nodes[new_parent].parent = old_parent;
+    nodes[new_parent].box = box_union(leaf_box, nodes[sibling].box);
+    nodes[new_parent].height = nodes[sibling].height + 1;
+    nodes[new_parent].child1 = sibling;
+    nodes[new_parent].child2 = leaf;
+    nodes[sibling].parent = new_parent;
+    nodes[leaf].parent = new_parent;
+    if (old_parent != NULL_NODE) {
+        if (nodes[old_parent].child1 == sibling)
+            nodes[old_parent].child1 = new_parent;
+        else
+            nodes[old_parent].child2 = new_parent;
+    } else {
+        tree->root = new_parent;
+    }
+
+    refit_ancestors(tree, new_parent);
+}
+
+/**
+ * @brief Removes a leaf, replacing its parent by its sibling.
+ */
+static void remove_leaf(fluxAABBTree tree, int leaf) {
+    LOG_FUNC_CALL();
+    if (leaf == tree->root) {
+        tree->root = NULL_NODE;
+        return;
+    }
+    aabbNode* nodes = tree->nodes;
+    int parent = nodes[leaf].parent;
+    int grand_parent = nodes[parent].parent;
+    int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2
+                                               : nodes[parent].child1;
+    if (grand_parent != NULL_NODE) {
+        if (nodes[grand_parent].child1 == parent)
+            nodes[grand_parent].child1 = sibling;
+        else
+            nodes[grand_parent].child2 = sibling;
+        nodes[sibling].parent = grand_parent;
+        free_node(tree, parent);
+        refit_ancestors(tree, grand_parent);
+    } else {
+        tree->root = sibling;
+        nodes[sibling].parent = NULL_NODE;
+        free_node(tree, parent);
+    }
+}
+
+/**
+ * @brief Returns `box` grown by the tree's margin.
+ */
+static BoundingBox fatten(fluxAABBTree tree, BoundingBox box) {
+    LOG_FUNC_CALL();
+    Vector3 m = {tree->margin, tree->margin, tree->margin};
+    box.min = (Vector3){box.min.x - m.x, box.min.y - m.y, box.min.z - m.z};
+    box.max = (Vector3){box.max.x + m.x, box.max.y + m.y, box.max.z + m.z};
+    return box;
+}
+
+/**
+ * @brief Adds a proxy to the tree.
+ * @param tree Tree to insert into.
+ * @param box Box of the proxy.
+ * @param user_data Returned by queries for this proxy.
+ * @return Id of the proxy, stays valid until it is removed.
+ */
+int flux_aabb_tree_insert(fluxAABBTree tree, BoundingBox box,
+                          void* user_data) {
+    LOG_FUNC_CALL();
+    assert(tree);
+    int proxy = allocate_node(tree);
+    tree->nodes[proxy].box = fatten(tree, box);
+    tree->nodes[proxy].user_data = user_data;
+    insert_leaf(tree, proxy);
+    tree->n_proxies++;
+    return proxy;
+}
+
+/**
+ * @brief Removes a proxy from the tree.
+ * @param tree Tree to remove from.
+ * @param proxy Id returned by `flux_aabb_tree_insert()`.
+ */
+void flux_aabb_tree_remove(fluxAABBTree tree, int proxy) {
+    LOG_FUNC_CALL();
+    assert(tree);
+    assert((proxy >= 0) && (proxy < tree->capacity));
+    assert(tree->nodes[proxy].height == 0);
+    remove_leaf(tree, proxy);
+    free_node(tree, proxy);
+    tree->n_proxies--;
+}
+
+/**
+ * @brief Updates the box of a proxy. The tree only changes if the new box is
+ * not inside the proxy's fat box.
+ * @param tree Tree the proxy is in.
+ * @param proxy Id returned by `flux_aabb_tree_insert()`.
+ * @param box New box of the proxy.
+ * @return True if the proxy was reinserted.
+ */
+bool flux_aabb_tree_move(fluxAABBTree tree, int proxy, BoundingBox box) {
+    LOG_FUNC_CALL();
+    assert(tree);
+    assert((proxy >= 0) && (proxy < tree->capacity));
+    assert(tree->nodes[proxy].height == 0);
+    if (box_contains(tree->nodes[proxy].box, box))
+        return false;
+    remove_leaf(tree, proxy);
+    tree->nodes[proxy].box = fatten(tree, box);
+    insert_leaf(tree, proxy);
+    return true;
+}
+
+/**
+ * @brief Returns the user data of a proxy.
+ * @param tree Tree the proxy is in.
+ * @param proxy Id returned by `flux_aabb_tree_insert()`.
+ * @return The user data passed to `flux_aabb_tree_insert()`.
+ */
+void* flux_aabb_tree_get_user_data(fluxAABBTree tree, int proxy) {
+    LOG_FUNC_CALL();
+    assert(tree);
+    assert((proxy >= 0) && (proxy < tree->capacity));
+    return tree->nodes[proxy].user_data;
+}
+
+/**
+ * @brief Replaces the user data of a proxy.
+ * @param tree Tree the proxy is in.
+ * @param proxy Id returned by `flux_aabb_tree_insert()`.
+ * @param user_data The new user data.
+ */
+void flux_aabb_tree_set_user_data(fluxAABBTree tree, int proxy,
+                                  void* user_data) {
+    LOG_FUNC_CALL();
+    assert(tree);
+    assert((proxy >= 0) && (proxy < tree->capacity));
+    tree->nodes[proxy].user_data = user_data;
+}
+
+/**
+ * @brief Returns the fat box stored for a proxy.
+ * @param tree Tree the proxy is in.
+ * @param proxy Id returned by `flux_aabb_tree_insert()`.
+ * @return The proxy's box grown by the tree's margin.
+ */
+BoundingBox flux_aabb_tree_get_fat_box(fluxAABBTree tree, int proxy) {
+    LOG_FUNC_CALL();
+    assert(tree);
+    assert((proxy >= 0) && (proxy < tree->capacity));
+    return tree->nodes[proxy].box;
+}
+
+/**
+ * @brief Pushes a node on the query stack, growing it if needed.
+ */
+static void push_stack(fluxAABBTree tree, int* top, int node,
+                       unsigned int mask, bool inside) {
+    LOG_FUNC_CALL();
+    if (*top >= tree->stack_size) {
+        int new_size = tree->stack_size > 0 ? tree->stack_size * 2 : 64;
+        aabbStackEntry* stack;
+        assert(stack =
+                   (aabbStackEntry*)malloc(sizeof(aabbStackEntry) * new_size));
+        if (tree->stack) {
+            memcpy(stack, tree->stack, sizeof(aabbStackEntry) * (*top));
+            free(tree->stack);
+        }
+        tree->stack = stack;
+        tree->stack_size = new_size;
+    }
+    tree->stack[*top].node = node;
+    tree->stack[*top].mask = mask;
+    tree->stack[*top].inside = inside;
+    (*top)++;
+}
+
+/**
+ * @brief Calls `func` for every proxy whose fat box overlaps `box`.
+ * @param tree Tree to query.
+ * @param box Query box.
+ * @param func Called for each proxy found, may stop the query.
+ * @param data Passed to `func`.
+ */
+void flux_aabb_tree_query_box(fluxAABBTree tree, BoundingBox box,
+                              fluxAABBTreeQueryFunc func, void* data) {
+    LOG_FUNC_CALL();
+    assert(tree);
+    assert(func);
+    tree->nodes_visited = 0;
+    if (tree->root == NULL_NODE)
+        return;
+    int top = 0;
+    push_stack(tree, &top, tree->root, 0, false);
+    while (top > 0) {
+        int index = tree->stack[--top].node;
+        const aabbNode* node = &tree->nodes[index];
+        tree->nodes_visited++;
+        if (!box_overlaps(node->box, box))
+            continue;
+        if (node->child1 == NULL_NODE) {
+            if (!func(data, index, node->user_data))
+                return;
+            continue;
+        }
+        push_stack(tree, &top, node->child2, 0, false);
+        push_stack(tree, &top, node->child1, 0, false);
+    }
+}
+
+/**
+ * @brief Classifies a box against a convex volume.
+ * @return -1 if the box is outside, 1 if it is fully inside, 0 if it
+ * straddles the volume's boundary.
+ */
+static int classify_box(BoundingBox box, const Vector4* planes,
+                        int n_planes) {
+    LOG_FUNC_CALL();
+    int result = 1;
+    for (int p = 0; p < n_planes; p++) {
+        Vector4 plane = planes[p];
+        // positive vertex: the corner furthest along the plane normal
+        float px = plane.x > 0 ? box.max.x : box.min.x;
+        float py = plane.y > 0 ? box.max.y : box.min.y;
+        float pz = plane.z > 0 ? box.max.z : box.min.z;
+        if (plane.x * px + plane.y * py + plane.z * pz + plane.w < 0)
+            return -1;
+        float nx = plane.x > 0 ? box.min.x : box.max.x;
+        float ny = plane.y > 0 ? box.min.y : box.max.y;
+        float nz = plane.z > 0 ? box.min.z : box.max.z;
+        if (plane.x * nx + plane.y * ny + plane.z * nz + plane.w < 0)
+            result = 0;
+    }
+    return result;
+}
+
+/**
+ * @brief Calls `func` for every proxy whose fat box touches at least one of a
+ * set of convex volumes (for example the camera and light frustums).
+ *
+ * A volume is the intersection of the positive half spaces
+ * `x * p.x + y * p.y + z * p.z + p.w >= 0` of its planes. Subtrees fully
+ * inside a volume are reported without further tests, and a subtree is only
+ * tested against the volumes its parent straddles. Each proxy is reported
+ * once, in the same order for the same tree.
+ * @param tree Tree to query.
+ * @param planes `n_planes * n_volumes` planes, volume by volume.
+ * @param n_planes Number of planes of each volume.
+ * @param n_volumes Number of volumes, at most `FLUX_AABB_TREE_MAX_VOLUMES`.
+ * @param func Called for each proxy found, may stop the query.
+ * @param data Passed to `func`.
+ */
+void flux_aabb_tree_query_volumes(fluxAABBTree tree, const Vector4* planes,
+                                  int n_planes, int n_volumes,
+                                  fluxAABBTreeQueryFunc func, void* data) {
+    LOG_FUNC_CALL();
+    assert(tree);
+    assert(func);
+    assert(planes || (n_volumes == 0));
+    assert((n_volumes >= 0) && (n_volumes <= FLUX_AABB_TREE_MAX_VOLUMES));
+    tree->nodes_visited = 0;
+    if ((tree->root == NULL_NODE) || (n_volumes == 0))
+        return;
+    unsigned int all = n_volumes == 32 ? 0xFFFFFFFFu : (1u << n_volumes) - 1;
+    int top = 0;
+    push_stack(tree, &top, tree->root, all, false);
+    while (top > 0) {
+        aabbStackEntry entry = tree->stack[--top];
+        const aabbNode* node = &tree->nodes[entry.node];
+        tree->nodes_visited++;
+        bool inside = entry.inside;
+        unsigned int mask = entry.mask;
+        for (int v = 0; (v < n_volumes) && !inside; v++) {
+            if (!(mask & (1u << v)))
+                continue;
+            int result = classify_box(node->box, planes + v * n_planes,
+                                      n_planes);
+            if (result < 0)
+                mask &= ~(1u << v);
+            else if (result > 0)
+                inside = true;
+        }
+        if (!inside && (mask == 0))
+            continue;
+        if (node->child1 == NULL_NODE) {
+            if (!func(data, entry.node, node->user_data))
+                return;
+            continue;
+        }
+        push_stack(tree, &top, node->child2, mask, inside);
+        push_stack(tree, &top, node->child1, mask, inside);
+    }
+}
+
+/**
+ * @brief Returns the number of proxies in a tree.
+ * @param tree Tree to query.
+ * @return Number of proxies.
+ */
+int flux_aabb_tree_get_n_proxies(fluxAABBTree tree) {
+    LOG_FUNC_CALL();
+    assert(tree);
+    return tree->n_proxies;
+}
+
+/**
+ * @brief Returns the height of a tree (0 for a single leaf).
+ * @param tree Tree to query.
+ * @return Height of the root, or -1 if the tree is empty.
+ */
+int flux_aabb_tree_get_height(fluxAABBTree tree) {
+    LOG_FUNC_CALL();
+    assert(tree);
+    if (tree->root == NULL_NODE)
+        return -1;
+    return tree->nodes[tree->root].height;
+}
+
+/**
+ * @brief Returns the number of nodes visited by the last query.
+ * @param tree Tree to query.
+ * @return Number of nodes.
+ */
+int flux_aabb_tree_get_nodes_visited(fluxAABBTree tree) {
+    LOG_FUNC_CALL();
+    assert(tree);
+    return tree->nodes_visited;
+}
+
+/**
+ * @brief Recursively checks the structure of a subtree.
+ * @return Number of leaves in the subtree, or -1 if it is invalid.
+ */
+static int validate_node(fluxAABBTree tree, int index, int parent) {
+    LOG_FUNC_CALL();
+    const aabbNode* node = &tree->nodes[index];
+    if (node->parent != parent)
+        return -1;
+    if (node->child1 == NULL_NODE) {
+        return ((node->child2 == NULL_NODE) && (node->height == 0)) ? 1 : -1;
+    }
+    const aabbNode* child1 = &tree->nodes[node->child1];
+    const aabbNode* child2 = &tree->nodes[node->child2];
+    if (node->height != 1 + max_int(child1->height, child2->height))
+        return -1;
+    if (!box_contains(node->box, child1->box) ||
+        !box_contains(node->box, child2->box))
+        return -1;
+    int n1 = validate_node(tree, node->child1, index);
+    int n2 = validate_node(tree, node->child2, index);
+    if ((n1 < 0) || (n2 < 0))
+        return -1;
+    return n1 + n2;
+}
+
+/**
+ * @brief Checks the structure of a tree (parent links, heights, enclosing
+ * boxes and proxy count). Used by the tests.
+ * @param tree Tree to check.
+ * @return True if the tree is valid.
+ */
+bool flux_aabb_tree_validate(fluxAABBTree tree) {
+    LOG_FUNC_CALL();
+    assert(tree);
+    if (tree->root == NULL_NODE)
+        return tree->n_proxies == 0;
+    return validate_node(tree, tree->root, NULL_NODE) == tree->n_proxies;
+}
@@ -0,0 +1,61 @@
+/**
+ * @file aabb_tree.h
+ **/
+
+#ifndef _FLUX_HELPERS_AABB_TREE_H_
+#define _FLUX_HELPERS_AABB_TREE_H_
+
+#include "raylib.h"
+#include <stdbool.h>
+
+/** Maximum number of volumes in one `flux_aabb_tree_query_volumes()`. */
+#define FLUX_AABB_TREE_MAX_VOLUMES 32
+
+/**
+ * @brief Called for every proxy found by a query.
+ * @param data Pointer passed to the query.
+ * @param proxy Id of the proxy.
+ * @param user_data User data of the proxy.
+ * @return False to stop the query.
+ */
+typedef bool (*fluxAABBTreeQueryFunc)(void* data, int proxy, void* user_data);
+
+/** @struct fluxAABBTreeInternal */
+typedef struct fluxAABBTreeInternal fluxAABBTreeInternal;
+
+/** @typedef fluxAABBTreeInternal* fluxAABBTree */
+typedef fluxAABBTreeInternal* fluxAABBTree;
+
+fluxAABBTree flux_aabb_tree_create(float margin);
+
+void flux_aabb_tree_destroy(fluxAABBTree tree);
+
+int flux_aabb_tree_insert(fluxAABBTree tree, BoundingBox box, void* user_data);
+
+void flux_aabb_tree_remove(fluxAABBTree tree, int proxy);
+
+bool flux_aabb_tree_move(fluxAABBTree tree, int proxy, BoundingBox box);
+
+void* flux_aabb_tree_get_user_data(fluxAABBTree tree, int proxy);
+
+void flux_aabb_tree_set_user_data(fluxAABBTree tree, int proxy,
+                                  void* user_data);
+
+BoundingBox flux_aabb_tree_get_fat_box(fluxAABBTree tree, int proxy);
+
+void flux_aabb_tree_query_box(fluxAABBTree tree, BoundingBox box,
+                              fluxAABBTreeQueryFunc func, void* data);
+
+void flux_aabb_tree_query_volumes(fluxAABBTree tree, const Vector4* planes,
+                                  int n_planes, int n_volumes,
+                                  fluxAABBTreeQueryFunc func, void* data);
+
+int flux_aabb_tree_get_n_proxies(fluxAABBTree tree);
+
+int flux_aabb_tree_get_height(fluxAABBTree tree);
+
+int flux_aabb_tree_get_nodes_visited(fluxAABBTree tree);
+
+bool flux_aabb_tree_validate(fluxAABBTree tree);
+
+#endif
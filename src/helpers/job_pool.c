@@ -0,0 +1,218 @@
+/**
+ * @file job_pool.c
+ * @brief Fixed size pool of worker threads for data-parallel loops.
+ *
+ * `flux_job_pool_run()` hands out job indices from an atomic counter to the
+ * workers and to the calling thread, and returns when every job is done.
+ * Which thread runs a job is not deterministic, so jobs should write their
+ * results to slots indexed by the job rather than to shared lists.
+ **/
+
+#include "job_pool.h"
+#include "hqtools/hqtools.h"
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+/**
+ * @struct fluxJobPoolInternal
+ * @brief A pool of worker threads.
+ *
+ * @var int n_threads Number of threads running jobs, including the caller of
+ * `flux_job_pool_run()`.
+ * @var pthread_t* workers The `n_threads - 1` worker threads.
+ * @var pthread_mutex_t lock Protects everything below except `next_job`.
+ * @var pthread_cond_t start Signalled when a run starts or the pool stops.
+ * @var pthread_cond_t done Signalled when the last worker finishes a run.
+ * @var unsigned long long generation Incremented for every run.
+ * @var int active Workers still busy with the current run.
+ * @var bool stop Set when the pool is destroyed.
+ * @var fluxJobFunc func Job of the current run.
+ * @var void* data Data of the current run.
+ * @var int n_jobs Number of jobs of the current run.
+ * @var atomic_int next_job Next job index to hand out.
+ */
+struct fluxJobPoolInternal {
+    int n_threads;
+    pthread_t* workers;
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    unsigned long long generation;
+    int active;
+    bool stop;
+    fluxJobFunc func;
+    void* data;
+    int n_jobs;
+    atomic_int next_job;
+};
+
+/**
+ * @brief Returns the number of online CPU cores.
+ * @return Number of cores (at least 1).
+ */
+int flux_get_n_cores(void) {
+    LOG_FUNC_CALL();
+#if defined(_WIN32)
+    int n = pthread_num_processors_np();
+#else
+    int n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return n > 0 ? n : 1;
+}
+
+/**
+ * @brief Runs jobs of the current run until there are none left.
+ */
+static void run_jobs(fluxJobPool pool) {
+    LOG_FUNC_CALL();
+    int job;
+    while ((job = atomic_fetch_add(&pool->next_job, 1)) < pool->n_jobs) {
+        pool->func(pool->data, job);
+    }
+}
+
+/**
+ * @brief Worker thread main loop: waits for a run, helps with it, and reports
+ * back.
+ */
+static void* worker_main(void* arg) {
+    LOG_FUNC_CALL();
+    fluxJobPool pool = (fluxJobPool)arg;
+    unsigned long long seen = 0;
+    while (true) {
+        pthread_mutex_lock(&pool->lock);
+        while (!pool->stop && (pool->generation == seen))
+            pthread_cond_wait(&pool->start, &pool->lock);
+        if (pool->stop) {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        run_jobs(pool);
+
+        pthread_mutex_lock(&pool->lock);
+        pool->active--;
+        if (pool->active == 0)
+            pthread_cond_signal(&pool->done);
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Creates a job pool.
+ * @param n_threads Number of threads that run jobs, including the thread
+ * calling `flux_job_pool_run()` (so `n_threads - 1` workers are started).
+ * Values `<= 0` use `flux_get_n_cores()`.
+ * @return The new pool.
+ */
+fluxJobPool flux_job_pool_create(int n_threads) {
+    LOG_FUNC_CALL();
+    if (n_threads <= 0)
+        n_threads = flux_get_n_cores();
+    fluxJobPool pool;
+    assert(pool = (fluxJobPool)malloc(sizeof(fluxJobPoolInternal)));
+    pool->n_threads = n_threads;
+    pool->generation = 0;
+    pool->active = 0;
+    pool->stop = false;
+    pool->func = NULL;
+    pool->data = NULL;
+    pool->n_jobs = 0;
+    atomic_init(&pool->next_job, 0);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    pool->workers = NULL;
+    if (n_threads > 1) {
+        assert(pool->workers =
+                   (pthread_t*)malloc(sizeof(pthread_t) * (n_threads - 1)));
+        for (int i = 0; i < n_threads - 1; i++) {
+            int err =
+                pthread_create(&pool->workers[i], NULL, worker_main, pool);
+            assert(err == 0);
+            (void)err;
+        }
+    }
+    TraceLog(LOG_INFO, "started job pool with %d threads", n_threads);
+    return pool;
+}
+
+/**
+ * @brief Stops the workers of a job pool and frees it.
+ * @param pool Pool to destroy, must not be running jobs.
+ */
+void flux_job_pool_destroy(fluxJobPool pool) {
+    LOG_FUNC_CALL();
+    assert(pool);
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = true;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->n_threads - 1; i++) {
+        pthread_join(pool->workers[i], NULL);
+    }
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->start);
+    pthread_mutex_destroy(&pool->lock);
+    if (pool->workers)
+        free(pool->workers);
+    free(pool);
+}
+
+/**
+ * @brief Returns the number of threads of a job pool, including the caller.
+ * @param pool Pool to query.
+ * @return Number of threads.
+ */
+int flux_job_pool_get_n_threads(fluxJobPool pool) {
+    LOG_FUNC_CALL();
+    assert(pool);
+    return pool->n_threads;
+}
+
+/**
+ * @brief Runs `func(data, job)` for every job in `[0, n_jobs)` on the pool and
+ * the calling thread, and waits for all of them to finish.
+ * @param pool Pool to run on. Runs must not be nested or issued from several
+ * threads at once.
+ * @param func Job to run.
+ * @param data Passed to every job.
+ * @param n_jobs Number of jobs.
+ */
+void flux_job_pool_run(fluxJobPool pool, fluxJobFunc func, void* data,
+                       int n_jobs) {
+    LOG_FUNC_CALL();
+    assert(pool);
+    assert(func);
+    if ((pool->n_threads <= 1) || (n_jobs <= 1)) {
+        for (int job = 0; job < n_jobs; job++) {
+            func(data, job);
+        }
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->func = func;
+    pool->data = data;
+    pool->n_jobs = n_jobs;
+    atomic_store(&pool->next_job, 0);
+    pool->active = pool->n_threads - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    run_jobs(pool);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->active > 0)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
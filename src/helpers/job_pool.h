@@ -0,0 +1,36 @@
+/**
+ * @file job_pool.h
+ **/
+
+#ifndef _FLUX_HELPERS_JOB_POOL_H_
+#define _FLUX_HELPERS_JOB_POOL_H_
+
+/**
+ * @brief A job: called once for every index in `[0, n_jobs)` of a
+ * `flux_job_pool_run()`.
+ *
+ * Jobs run on worker threads, so they must not touch GL state. The hqtools
+ * allocator and the log take a lock, so hot jobs should avoid them.
+ * @param data Pointer passed to `flux_job_pool_run()`.
+ * @param job Index of the job.
+ */
+typedef void (*fluxJobFunc)(void* data, int job);
+
+/** @struct fluxJobPoolInternal */
+typedef struct fluxJobPoolInternal fluxJobPoolInternal;
+
+/** @typedef fluxJobPoolInternal* fluxJobPool */
+typedef fluxJobPoolInternal* fluxJobPool;
+
+int flux_get_n_cores(void);
+
+fluxJobPool flux_job_pool_create(int n_threads);
+
+void flux_job_pool_destroy(fluxJobPool pool);
+
+int flux_job_pool_get_n_threads(fluxJobPool pool);
+
+void flux_job_pool_run(fluxJobPool pool, fluxJobFunc func, void* data,
+                       int n_jobs);
+
+#endif
@@ -0,0 +1,108 @@
+/**
+ * @file mapped_file.c
+ * @brief Read only memory mapped files, for text parsers that want the whole
+ * file without copying it.
+ *
+ * The parsers expect a `'\0'` after the last byte. A mapping gets that for
+ * free when the file does not end on a page boundary, as the rest of the
+ * last page reads as zeros. Otherwise (or when mapping is not available, as
+ * on Windows) the file is read into a heap buffer with room for the
+ * terminator.
+ **/
+
+#include "mapped_file.h"
+#include "hqtools/hqtools.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief Reads a whole file into a heap buffer, with a terminator.
+ * @param path The file.
+ * @return The contents, with `data` NULL if the file could not be read.
+ */
+static fluxMappedFile read_file(const char* path) {
+    LOG_FUNC_CALL();
+    fluxMappedFile out = {0};
+    FILE* fp = fopen(path, "rb");
+    if (!fp)
+        return out;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (size < 0) {
+        fclose(fp);
+        return out;
+    }
+    char* data;
+    assert(data = (char*)malloc(size + 1));
+    size_t n_read = fread(data, 1, size, fp);
+    fclose(fp);
+    data[n_read] = '\0';
+    out.data = data;
+    out.size = n_read;
+    return out;
+}
+
+/**
+ * @brief Maps a file for reading.
+ *
+ * The contents are followed by a `'\0'`, and must not be written to.
+ * @param path The file.
+ * @return The file, with `data` NULL if it could not be opened. Release it
+ * with `flux_unmap_file()`.
+ */
+fluxMappedFile flux_map_file(const char* path) {
+    LOG_FUNC_CALL();
+#if !defined(_WIN32)
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return (fluxMappedFile){0};
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return (fluxMappedFile){0};
+    }
+    size_t size = (size_t)st.st_size;
+    long page = sysconf(_SC_PAGESIZE);
+    if ((size > 0) && (page > 0) && ((size % (size_t)page) != 0)) {
+        void* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            close(fd);
+#if defined(MADV_SEQUENTIAL)
+            madvise(data, size, MADV_SEQUENTIAL);
+#endif
+            return (fluxMappedFile){
+                .data = (const char*)data, .size = size, .mapped = true};
+        }
+    }
+    close(fd);
+#endif
+    return read_file(path);
+}
+
+/**
+ * @brief Releases a file from `flux_map_file()`. Safe to call on a file that
+ * failed to open, or twice.
+ * @param file The file, reset to empty.
+ */
+void flux_unmap_file(fluxMappedFile* file) {
+    LOG_FUNC_CALL();
+    if (!file->data)
+        return;
+#if !defined(_WIN32)
+    if (file->mapped) {
+        munmap((void*)file->data, file->size);
+        *file = (fluxMappedFile){0};
+        return;
+    }
+#endif
+    free((void*)file->data);
+    *file = (fluxMappedFile){0};
+}
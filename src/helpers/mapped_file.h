@@ -0,0 +1,30 @@
+/**
+ * @file mapped_file.h
+ **/
+
+#ifndef _FLUX_HELPERS_MAPPED_FILE_H_
+#define _FLUX_HELPERS_MAPPED_FILE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @struct fluxMappedFile
+ * @brief A read only view of a whole file, followed by a `'\0'`.
+ *
+ * @var const char* data The contents, or NULL if the file could not be read.
+ * @var size_t size Size of the file in bytes, without the terminator.
+ * @var bool mapped Whether `data` is a memory mapping (otherwise it is a heap
+ * copy).
+ */
+typedef struct fluxMappedFile {
+    const char* data;
+    size_t size;
+    bool mapped;
+} fluxMappedFile;
+
+fluxMappedFile flux_map_file(const char* path);
+
+void flux_unmap_file(fluxMappedFile* file);
+
+#endif
@@ -0,0 +1,319 @@
+/**
+ * @file parse_number.c
+ * @brief Number parsing for the text asset and scene formats, rounding
+ * exactly like `strtod()`/`strtof()` but much faster on the short decimals
+ * these files are made of.
+ *
+ * Digits are read eight at a time where the buffer allows it, packed into a
+ * 64 bit mantissa and a decimal exponent. When both are small enough the
+ * value is exact after a single multiplication or division by an exact power
+ * of ten (Clinger's fast path), which covers nearly every number an exporter
+ * writes. Anything else (more than 19 significant digits, big exponents,
+ * hex, `inf`, `nan`, or floats that land on a rounding tie) is handed to
+ * libc, so the result is always the correctly rounded one.
+ *
+ * The text must be terminated by a `'\0'` (or anything that cannot continue
+ * a number). Leading whitespace is not skipped, except by `flux_atof()` and
+ * `flux_atoi()`.
+ **/
+
+#include "parse_number.h"
+#include <ctype.h>
+#include <float.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The fast path relies on doubles being evaluated in double precision
+#if defined(FLT_EVAL_METHOD) && (FLT_EVAL_METHOD == 0)
+#define FLUX_PARSE_FAST_PATH
+#endif
+
+#if (defined(__BYTE_ORDER__) &&                                                \
+     (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)) ||                           \
+    defined(_WIN32)
+#define FLUX_PARSE_EIGHT_DIGITS
+#endif
+
+/**
+ * @struct fluxDecimal
+ * @brief A number as read from text: `mantissa * 10^exponent`.
+ */
+typedef struct fluxDecimal {
+    uint64_t mantissa;
+    int exponent;
+    bool negative;
+} fluxDecimal;
+
+static const double exact_powers_of_ten[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+static bool is_digit(char c) { return (unsigned char)(c - '0') < 10; }
+
+#ifdef FLUX_PARSE_EIGHT_DIGITS
+static bool is_eight_digits(uint64_t block) {
+    return ((block & 0xF0F0F0F0F0F0F0F0ULL) |
+            (((block + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >>
+             4)) == 0x3333333333333333ULL;
+}
+
+static uint32_t parse_eight_digits(uint64_t block) {
+    const uint64_t mask = 0x000000FF000000FFULL;
+    const uint64_t mul1 = 0x000F424000000064ULL; // 100 + (1000000 << 32)
+    const uint64_t mul2 = 0x0000271000000001ULL; // 1 + (10000 << 32)
+    block -= 0x3030303030303030ULL;
+    block = (block * 10) + (block >> 8);
+    block = (((block & mask) * mul1) + (((block >> 16) & mask) * mul2)) >> 32;
+    return (uint32_t)block;
+}
+#endif
+
+/**
+ * @brief Appends a run of digits to `*value`.
+ *
+ * Wraps around past 19 digits; callers count the digits and give up on
+ * those.
+ * @param p First character.
+ * @param end Bound for reading eight bytes at once, or NULL.
+ * @param value The value so far, updated.
+ * @return The first character that is not a digit.
+ */
+static const char* read_digits(const char* p, const char* end,
+                               uint64_t* value) {
+    uint64_t v = *value;
+#ifdef FLUX_PARSE_EIGHT_DIGITS
+    if (end) {
+        while (end - p >= 8) {
+            uint64_t block;
+            memcpy(&block, p, sizeof(block));
+            if (!is_eight_digits(block))
+                break;
+            v = v * 100000000ULL + parse_eight_digits(block);
+            p += 8;
+        }
+    }
+#endif
+    for (; is_digit(*p); p++) {
+        v = v * 10 + (uint64_t)(*p - '0');
+    }
+    *value = v;
+    return p;
+}
+
+/**
+ * @brief Reads a decimal number (sign, digits, point, exponent), following
+ * the grammar of `strtod()`.
+ * @param str The text.
+ * @param end Bound for reading eight bytes at once, or NULL.
+ * @param out The number.
+ * @return The end of the number; `str` if there is none; NULL if the number
+ * has to be left to libc.
+ */
+static const char* parse_decimal(const char* str, const char* end,
+                                 fluxDecimal* out) {
+    const char* p = str;
+    out->negative = (*p == '-');
+    if ((*p == '-') || (*p == '+'))
+        p++;
+    if (!is_digit(*p) && !((*p == '.') && is_digit(p[1]))) {
+        char c = (char)(*p | 0x20);
+        return ((c == 'i') || (c == 'n')) ? NULL : str;
+    }
+    if ((p[0] == '0') && ((p[1] | 0x20) == 'x'))
+        return NULL;
+
+    while (*p == '0') {
+        p++;
+    }
+    uint64_t mantissa = 0;
+    const char* digits = p;
+    p = read_digits(p, end, &mantissa);
+    long n_digits = p - digits;
+    long exponent = 0;
+    if (*p == '.') {
+        p++;
+        const char* fraction = p;
+        if (n_digits == 0) {
+            while (*p == '0') {
+                p++;
+            }
+        }
+        digits = p;
+        p = read_digits(p, end, &mantissa);
+        n_digits += p - digits;
+        exponent = -(p - fraction);
+    }
+    if (n_digits > 19)
+        return NULL;
+
+    if ((*p | 0x20) == 'e') {
+        const char* e = p + 1;
+        bool negative = (*e == '-');
+        if ((*e == '-') || (*e == '+'))
+            e++;
+        if (is_digit(*e)) {
+            long value = 0;
+            for (; is_digit(*e); e++) {
+                if (value < 100000)
+                    value = value * 10 + (*e - '0');
+            }
+            exponent += negative ? -value : value;
+            p = e;
+        }
+    }
+    if ((exponent < INT_MIN / 2) || (exponent > INT_MAX / 2))
+        return NULL;
+
+    out->mantissa = mantissa;
+    out->exponent = (int)exponent;
+    return p;
+}
+
+/**
+ * @brief Converts a decimal to the nearest double, if that takes a single
+ * rounding.
+ * @param decimal The number.
+ * @param out The double.
+ * @return Whether the conversion was exact.
+ */
+static bool decimal_to_double(const fluxDecimal* decimal, double* out) {
+    if (decimal->mantissa == 0) {
+        *out = decimal->negative ? -0.0 : 0.0;
+        return true;
+    }
+#ifdef FLUX_PARSE_FAST_PATH
+    if ((decimal->mantissa > (1ULL << 53)) || (decimal->exponent < -22) ||
+        (decimal->exponent > 22))
+        return false;
+    double value = (double)decimal->mantissa;
+    if (decimal->exponent < 0)
+        value /= exact_powers_of_ten[-decimal->exponent];
+    else
+        value *= exact_powers_of_ten[decimal->exponent];
+    *out = decimal->negative ? -value : value;
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Parses a decimal number, rounding exactly like `strtod()`.
+ * @param str The text, which must start with the number (or its sign).
+ * @param end End of the buffer holding the text, if known (it is read ahead
+ * eight bytes at a time up to there), or NULL.
+ * @param out The number, or 0 if there is none.
+ * @return The end of the number, or `str` if there is none.
+ */
+const char* flux_parse_double(const char* str, const char* end, double* out) {
+    fluxDecimal decimal;
+    const char* p = parse_decimal(str, end, &decimal);
+    if (p == str) {
+        *out = 0;
+        return str;
+    }
+    if (p && decimal_to_double(&decimal, out))
+        return p;
+    char* libc_end;
+    *out = strtod(str, &libc_end);
+    return libc_end;
+}
+
+/**
+ * @brief Parses a decimal number, rounding exactly like `strtof()`.
+ *
+ * The double from the fast path rounds to the correct float unless it is
+ * exactly halfway between two floats (rounding twice can only go wrong
+ * there), or outside the range of normal floats.
+ * @param str The text, which must start with the number (or its sign).
+ * @param end End of the buffer holding the text, if known, or NULL.
+ * @param out The number, or 0 if there is none.
+ * @return The end of the number, or `str` if there is none.
+ */
+const char* flux_parse_float(const char* str, const char* end, float* out) {
+    fluxDecimal decimal;
+    const char* p = parse_decimal(str, end, &decimal);
+    if (p == str) {
+        *out = 0;
+        return str;
+    }
+    double value;
+    if (p && decimal_to_double(&decimal, &value)) {
+        double magnitude = value < 0 ? -value : value;
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        if (magnitude == 0) {
+            *out = (float)value;
+            return p;
+        }
+        if ((magnitude >= FLT_MIN) && (magnitude <= FLT_MAX) &&
+            ((bits & 0x1FFFFFFFULL) != 0x10000000ULL)) {
+            *out = (float)value;
+            return p;
+        }
+    }
+    char* libc_end;
+    *out = strtof(str, &libc_end);
+    return libc_end;
+}
+
+/**
+ * @brief Parses a decimal integer, clamping like `strtol()` (to the range of
+ * int).
+ * @param str The text, which must start with the number (or its sign).
+ * @param end End of the buffer holding the text, if known, or NULL.
+ * @param out The number, or 0 if there is none.
+ * @return The end of the number, or `str` if there is none.
+ */
+const char* flux_parse_int(const char* str, const char* end, int* out) {
+    const char* p = str;
+    bool negative = (*p == '-');
+    if ((*p == '-') || (*p == '+'))
+        p++;
+    if (!is_digit(*p)) {
+        *out = 0;
+        return str;
+    }
+    while (*p == '0') {
+        p++;
+    }
+    uint64_t value = 0;
+    const char* digits = p;
+    p = read_digits(p, end, &value);
+    uint64_t limit = negative ? -(uint64_t)INT_MIN : (uint64_t)INT_MAX;
+    if ((p - digits > 10) || (value > limit))
+        value = limit;
+    *out = negative ? (int)(-(int64_t)value) : (int)value;
+    return p;
+}
+
+/**
+ * @brief `atof()`, through `flux_parse_double()`.
+ * @param str The text; leading whitespace is skipped.
+ * @return The number, or 0 if there is none.
+ */
+double flux_atof(const char* str) {
+    while (isspace((unsigned char)*str)) {
+        str++;
+    }
+    double out;
+    flux_parse_double(str, NULL, &out);
+    return out;
+}
+
+/**
+ * @brief `atoi()`, through `flux_parse_int()`.
+ * @param str The text; leading whitespace is skipped.
+ * @return The number, or 0 if there is none.
+ */
+int flux_atoi(const char* str) {
+    while (isspace((unsigned char)*str)) {
+        str++;
+    }
+    int out;
+    flux_parse_int(str, NULL, &out);
+    return out;
+}
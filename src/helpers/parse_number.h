@@ -0,0 +1,18 @@
+/**
+ * @file parse_number.h
+ **/
+
+#ifndef _FLUX_HELPERS_PARSE_NUMBER_H_
+#define _FLUX_HELPERS_PARSE_NUMBER_H_
+
+const char* flux_parse_double(const char* str, const char* end, double* out);
+
+const char* flux_parse_float(const char* str, const char* end, float* out);
+
+const char* flux_parse_int(const char* str, const char* end, int* out);
+
+double flux_atof(const char* str);
+
+int flux_atoi(const char* str);
+
+#endif
@@ -5,9 +5,9 @@
  */
 
 #include "prefab_parser.h"
-#include "file_tools.h"
 #include "hqtools/hqtools.h"
 #include "raylib.h"
+#include "tokenizer.h"
 #include "transform.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -31,6 +31,11 @@ typedef struct fluxParsedPrefabStruct {
     hstrArray scripts;  /**< Array of script names attached to the prefab. */
     hstrArray children; /**< Array of child prefab names. */
     Color tint;
+    bool is_occluder; /**< Flag indicating whether the prefab's model hides
+                         other models for occlusion culling. */
+    float lod_bias; /**< Level of detail bias of the prefab's model. */
+    bool is_static; /**< Flag indicating whether instances of the prefab never
+                       move, so they can be merged into static batches. */
 } fluxParsedPrefabStruct;
 
 /**
@@ -154,6 +159,39 @@ Color parser_parsed_prefab_get_tint(fluxParsedPrefab parsed) {
     return parsed->tint;
 }
 
+/**
+ * @brief Checks if a prefab's model is an occluder.
+ * @param prefab A pointer to the fluxParsedPrefabStruct.
+ * @return True if the prefab is an occluder, otherwise false.
+ */
+bool parser_parsed_prefab_is_occluder(fluxParsedPrefab prefab) {
+    LOG_FUNC_CALL();
+    assert(prefab);
+    return prefab->is_occluder;
+}
+
+/**
+ * @brief Retrieves the level of detail bias of a prefab's model.
+ * @param prefab A pointer to the fluxParsedPrefabStruct.
+ * @return The level of detail bias (0 if not set).
+ */
+float parser_parsed_prefab_get_lod_bias(fluxParsedPrefab prefab) {
+    LOG_FUNC_CALL();
+    assert(prefab);
+    return prefab->lod_bias;
+}
+
+/**
+ * @brief Checks if a prefab is static.
+ * @param prefab A pointer to the fluxParsedPrefabStruct.
+ * @return True if instances of the prefab never move, otherwise false.
+ */
+bool parser_parsed_prefab_is_static(fluxParsedPrefab prefab) {
+    LOG_FUNC_CALL();
+    assert(prefab);
+    return prefab->is_static;
+}
+
 /**
  * @brief Allocates and initializes a new parsed prefab structure.
  * This function sets default values for a new prefab, including default camera
@@ -250,6 +288,40 @@ static void parsed_prefab_set_is_camera(fluxParsedPrefab prefab) {
     TraceLog(LOG_INFO, "setting prefab->is_camera = true");
 }
 
+/**
+ * @brief Sets whether a prefab's model is an occluder.
+ * @param prefab A pointer to the fluxParsedPrefabStruct to configure.
+ * @param occluder Whether the model is an occluder.
+ */
+static void parsed_prefab_set_occluder(fluxParsedPrefab prefab,
+                                       bool occluder) {
+    LOG_FUNC_CALL();
+    assert(prefab);
+    prefab->is_occluder = occluder;
+}
+
+/**
+ * @brief Sets the level of detail bias of a prefab's model.
+ * @param prefab A pointer to the fluxParsedPrefabStruct to configure.
+ * @param bias The level of detail bias.
+ */
+static void parsed_prefab_set_lod_bias(fluxParsedPrefab prefab, float bias) {
+    LOG_FUNC_CALL();
+    assert(prefab);
+    prefab->lod_bias = bias;
+}
+
+/**
+ * @brief Sets whether a prefab is static.
+ * @param prefab A pointer to the fluxParsedPrefabStruct to configure.
+ * @param is_static Whether instances of the prefab never move.
+ */
+static void parsed_prefab_set_static(fluxParsedPrefab prefab, bool is_static) {
+    LOG_FUNC_CALL();
+    assert(prefab);
+    prefab->is_static = is_static;
+}
+
 /**
  * @brief Adds a script to a prefab.
  * This function appends a new script name to the scripts array of a prefab and
@@ -334,94 +406,61 @@ fluxParsedPrefab parser_read_prefab(const char* raw_path) {
     hstr path = hstr_incref(hstr_new(raw_path));
     fluxParsedPrefab out = alloc_parsed_prefab_internal();
 
-    FILE* fptr;
-    TraceLog(LOG_INFO, "opening %s", hstr_unpack(path));
-    fptr = fopen(hstr_unpack(path), "r");
-    if (!fptr) {
-        TraceLog(LOG_ERROR, "could not open %s", hstr_unpack(path));
+    fluxTokenizer tokenizer;
+    if (!parser_open_tokenizer(&tokenizer, hstr_unpack(path)))
         goto cleanup;
-    }
-    TraceLog(LOG_INFO, "opened %s", hstr_unpack(path));
-
-    size_t sz = get_file_length(fptr);
-    TraceLog(LOG_INFO, "file is %lu bytes", sz);
-
-    hstr file_str = hstr_incref(read_whole_file(fptr));
-
-    hstrArray lines = hstr_split(file_str, "\n");
-
-    for (int i = 0; i < hstr_array_len(lines); i++) {
-        hstr line = hstr_incref(hstr_array_get(lines, i));
-
-        hstrArray arguments = hstr_split(line, "=");
-
-        if (hstr_array_len(arguments) == 2) {
-
-            hstr command =
-                hstr_incref(hstr_strip(hstr_array_get(arguments, 0)));
-            hstr argument =
-                hstr_incref(hstr_strip(hstr_array_get(arguments, 1)));
-
-            hstrArray argument_list = hstr_split(argument, ",");
-
-            if (strcmp(hstr_unpack(command), "prefabName") == 0) {
-                parsed_prefab_set_name(out, argument);
-            } else if (strcmp(hstr_unpack(command), "prefabModel") == 0) {
-                parsed_prefab_set_model_path(out, argument);
-            } else if (strcmp(hstr_unpack(command), "prefabScripts") == 0) {
-                for (int k = 0; k < hstr_array_len(argument_list); k++) {
-                    hstr script_name = hstr_incref(
-                        hstr_strip(hstr_array_get(argument_list, k)));
-                    parsed_prefab_add_script(out, script_name);
-                    hstr_decref(script_name);
-                }
-            } else if (strcmp(hstr_unpack(command), "prefabChildren") == 0) {
-                for (int k = 0; k < hstr_array_len(argument_list); k++) {
-                    hstr child_name = hstr_incref(
-                        hstr_strip(hstr_array_get(argument_list, k)));
-                    parsed_prefab_add_child(out, child_name);
-                    hstr_decref(child_name);
-                }
-            } else if (strcmp(hstr_unpack(command), "prefabIsCamera") == 0) {
-                if (strcmp(hstr_unpack(argument), "true") == 0) {
-                    parsed_prefab_set_is_camera(out);
-                }
-            } else if (strcmp(hstr_unpack(command), "prefabTint") == 0) {
-                assert(hstr_array_len(argument_list) == 4);
-                Color tint;
-                tint.r = atoi(hstr_unpack(hstr_array_get(argument_list, 0)));
-                tint.g = atoi(hstr_unpack(hstr_array_get(argument_list, 1)));
-                tint.b = atoi(hstr_unpack(hstr_array_get(argument_list, 2)));
-                tint.a = atoi(hstr_unpack(hstr_array_get(argument_list, 3)));
-                parsed_prefab_set_tint(out, tint);
-            }
 
-            hstr_array_delete(argument_list);
-            hstr_decref(command);
-            hstr_decref(argument);
-
-        } else {
-            TraceLog(LOG_ERROR, "malformed line %s", hstr_unpack(line));
+    while (parser_next_line(&tokenizer)) {
+        int n_values = parser_get_n_values(&tokenizer);
+        if (parser_key_is(&tokenizer, "prefabName")) {
+            hstr name = hstr_incref(parser_get_whole_value_hstr(&tokenizer));
+            parsed_prefab_set_name(out, name);
+            hstr_decref(name);
+        } else if (parser_key_is(&tokenizer, "prefabModel")) {
+            hstr model_path =
+                hstr_incref(parser_get_whole_value_hstr(&tokenizer));
+            parsed_prefab_set_model_path(out, model_path);
+            hstr_decref(model_path);
+        } else if (parser_key_is(&tokenizer, "prefabScripts")) {
+            for (int k = 0; k < n_values; k++) {
+                hstr script_name =
+                    hstr_incref(parser_get_value_hstr(&tokenizer, k));
+                parsed_prefab_add_script(out, script_name);
+                hstr_decref(script_name);
+            }
+        } else if (parser_key_is(&tokenizer, "prefabChildren")) {
+            for (int k = 0; k < n_values; k++) {
+                hstr child_name =
+                    hstr_incref(parser_get_value_hstr(&tokenizer, k));
+                parsed_prefab_add_child(out, child_name);
+                hstr_decref(child_name);
+            }
+        } else if (parser_key_is(&tokenizer, "prefabIsCamera")) {
+            if (parser_value_is(&tokenizer, "true")) {
+                parsed_prefab_set_is_camera(out);
+            }
+        } else if (parser_key_is(&tokenizer, "prefabOccluder")) {
+            parsed_prefab_set_occluder(out,
+                                       parser_value_is(&tokenizer, "true"));
+        } else if (parser_key_is(&tokenizer, "prefabLODBias")) {
+            parsed_prefab_set_lod_bias(out, parser_get_float(&tokenizer, 0));
+        } else if (parser_key_is(&tokenizer, "prefabStatic")) {
+            parsed_prefab_set_static(out, parser_value_is(&tokenizer, "true"));
+        } else if (parser_key_is(&tokenizer, "prefabTint")) {
+            assert(n_values == 4);
+            Color tint;
+            tint.r = parser_get_int(&tokenizer, 0);
+            tint.g = parser_get_int(&tokenizer, 1);
+            tint.b = parser_get_int(&tokenizer, 2);
+            tint.a = parser_get_int(&tokenizer, 3);
+            parsed_prefab_set_tint(out, tint);
         }
-        // TraceLog(LOG_INFO,"line %d: %s",i,hstr_unpack(line));
-
-        hstr_array_delete(arguments);
-        hstr_decref(line);
-    }
-
-    hstr_array_delete(lines);
-    hstr_decref(file_str);
-
-    TraceLog(LOG_INFO, "closing %s", hstr_unpack(path));
-    if (fclose(fptr)) {
-        TraceLog(LOG_ERROR, "close %s failed...", hstr_unpack(path));
-    } else {
-        TraceLog(LOG_INFO, "closed %s", hstr_unpack(path));
     }
 
     parsed_prefab_set_path(out, path);
 
 cleanup:
+    parser_close_tokenizer(&tokenizer);
     hstr_decref(path);
     return out;
-}
\ No newline at end of file
+}
@@ -23,6 +23,12 @@ hstr parser_parsed_prefab_get_model_path(fluxParsedPrefab prefab);
 
 bool parser_parsed_prefab_is_camera(fluxParsedPrefab prefab);
 
+bool parser_parsed_prefab_is_occluder(fluxParsedPrefab prefab);
+
+float parser_parsed_prefab_get_lod_bias(fluxParsedPrefab prefab);
+
+bool parser_parsed_prefab_is_static(fluxParsedPrefab prefab);
+
 hstrArray parser_parsed_prefab_get_scripts(fluxParsedPrefab prefab);
 
 float parser_parsed_prefab_get_fov(fluxParsedPrefab prefab);
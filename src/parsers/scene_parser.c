@@ -5,11 +5,11 @@
  */
 
 #include "scene_parser.h"
-#include "file_tools.h"
 #include "hqtools/hqtools.h"
 #include "loading_screens.h"
 #include "prefab_parser.h"
 #include "raylib.h"
+#include "tokenizer.h"
 #include "transform.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -30,32 +30,6 @@ typedef struct fluxParsedGameObjectStruct {
                        instance. */
 } fluxParsedGameObjectStruct;
 
-/**
- * @brief Creates a parsed game object.
- *
- * Allocates and initializes a game object structure with the specified prefab
- * name, transformation, and arguments.
- * @param prefab_name Name of the prefab to associate with the game object.
- * @param transform Transformation data for the game object.
- * @param args Additional instantiation arguments.
- * @return Pointer to the newly created parsed game object structure.
- */
-static fluxParsedGameObject make_parsed_gameobject(hstr prefab_name,
-                                                   fluxTransform transform,
-                                                   hstrArray args) {
-    LOG_FUNC_CALL();
-    assert(prefab_name);
-    TraceLog(LOG_INFO, "making gameobject from %s", hstr_unpack(prefab_name));
-    fluxParsedGameObject out;
-    assert(
-        out = (fluxParsedGameObject)malloc(sizeof(fluxParsedGameObjectStruct)));
-    memset(out, 0, sizeof(fluxParsedGameObjectStruct));
-    out->prefab_name = hstr_incref(prefab_name);
-    out->transform = transform;
-    out->args = args;
-    return out;
-}
-
 /**
  * @brief Retrieves the additional arguments of a parsed game object.
  * @param gameobject Pointer to the parsed game object.
@@ -68,18 +42,18 @@ hstrArray parser_parsed_gameobject_get_args(fluxParsedGameObject gameobject) {
 }
 
 /**
- * @brief Deletes a parsed game object.
- *
- * Frees the memory allocated for the parsed game object and decrements
- * reference counts for any held strings.
- * @param gameobject Pointer to the parsed game object to delete.
+ * @brief Releases the strings held by a parsed game object.
+ * @param gameobject Pointer to the parsed game object.
+ * @param no_args The scene's shared empty argument array, which is not
+ * deleted.
  */
-static void delete_parsed_gameobject(fluxParsedGameObject gameobject) {
+static void release_parsed_gameobject(fluxParsedGameObject gameobject,
+                                      hstrArray no_args) {
     LOG_FUNC_CALL();
     assert(gameobject);
     hstr_decref(gameobject->prefab_name);
-    hstr_array_delete(gameobject->args);
-    free(gameobject);
+    if (gameobject->args != no_args)
+        hstr_array_delete(gameobject->args);
 }
 
 /**
@@ -105,6 +79,25 @@ parser_parsed_gameobject_get_transform(fluxParsedGameObject gameobject) {
     return gameobject->transform;
 }
 
+/**
+ * @brief Default edge length of the square cells of a streamed world (see
+ * `sceneCellSize`).
+ */
+#ifndef PARSER_SCENE_CELL_SIZE
+#define PARSER_SCENE_CELL_SIZE 64.0f
+#endif
+
+/**
+ * @struct fluxParsedCell
+ * @brief A cell of a streamed world: a scene file with only game objects,
+ * loaded while the camera is near it.
+ */
+typedef struct fluxParsedCell {
+    int x;     /**< Cell coordinate along x, in cells. */
+    int z;     /**< Cell coordinate along z, in cells. */
+    hstr path; /**< Path to the cell's scene file. */
+} fluxParsedCell;
+
 /**
  * @struct fluxParsedSceneStruct
  * @brief Represents a parsed scene containing multiple game objects and
@@ -119,8 +112,17 @@ typedef struct fluxParsedSceneStruct {
     int n_prefabs;             /**< Number of prefabs included in the scene. */
     fluxParsedPrefab* prefabs; /**< Array of pointers to parsed prefabs. */
     int n_gameobjects; /**< Number of game objects included in the scene. */
-    fluxParsedGameObject*
-        gameobjects; /**< Array of pointers to parsed game objects. */
+    int gameobjects_size; /**< Capacity of `gameobjects`. */
+    fluxParsedGameObjectStruct*
+        gameobjects; /**< Array of parsed game objects. */
+    hstrArray no_args;   /**< Arguments of the game objects without any. */
+    float cell_size;     /**< Edge length of the world's cells. */
+    float load_radius;   /**< Cells closer to the camera are loaded. */
+    float unload_radius; /**< Cells further from the camera are unloaded. */
+    int n_cells;         /**< Number of cells of the world. */
+    int cells_size;      /**< Capacity of `cells`. */
+    fluxParsedCell* cells; /**< The world's cells. */
+    hstrArray world_prefabs; /**< Paths of the prefabs only cells use. */
 } fluxParsedSceneStruct;
 
 /**
@@ -134,6 +136,11 @@ static fluxParsedScene alloc_parsed_scene_internal(void) {
     memset(out, 0, sizeof(fluxParsedSceneStruct));
     out->n_prefabs = 0;
     out->prefabs = NULL;
+    out->cell_size = PARSER_SCENE_CELL_SIZE;
+    out->load_radius = 2.0f * PARSER_SCENE_CELL_SIZE;
+    out->unload_radius = 2.5f * PARSER_SCENE_CELL_SIZE;
+    out->world_prefabs = hstr_array_make();
+    out->no_args = hstr_array_make();
     return out;
 }
 
@@ -184,20 +191,56 @@ static void parsed_scene_add_prefab(fluxParsedScene scene,
 
 /**
  * @brief Adds a game object to a parsed scene.
+ *
+ * Game objects are stored by value, in an array that doubles as it fills up,
+ * so a scene with many of them costs one allocation per doubling rather than
+ * one per game object.
  * @param scene Pointer to the parsed scene.
- * @param gameobject Pointer to the game object to add.
+ * @param prefab_name Name of the prefab to instantiate, which is incref'd.
+ * @param transform Transform of the game object.
+ * @param args Additional arguments, owned by the scene from now on.
  */
 static void parsed_scene_add_gameobject(fluxParsedScene scene,
-                                        fluxParsedGameObject gameobject) {
+                                        hstr prefab_name,
+                                        fluxTransform transform,
+                                        hstrArray args) {
     LOG_FUNC_CALL();
     assert(scene);
-    assert(gameobject);
+    assert(prefab_name);
+    assert(args);
     assert(scene->n_gameobjects >= 0);
-    scene->n_gameobjects++;
-    scene->gameobjects =
-        realloc(scene->gameobjects,
-                sizeof(fluxParsedGameObject) * scene->n_gameobjects);
-    scene->gameobjects[scene->n_gameobjects - 1] = gameobject;
+    if (scene->n_gameobjects == scene->gameobjects_size) {
+        scene->gameobjects_size =
+            scene->gameobjects_size ? 2 * scene->gameobjects_size : 16;
+        assert(scene->gameobjects = (fluxParsedGameObjectStruct*)realloc(
+                   scene->gameobjects, sizeof(fluxParsedGameObjectStruct) *
+                                           scene->gameobjects_size));
+    }
+    fluxParsedGameObject gameobject =
+        &scene->gameobjects[scene->n_gameobjects++];
+    gameobject->prefab_name = hstr_incref(prefab_name);
+    gameobject->transform = transform;
+    gameobject->args = args;
+}
+
+/**
+ * @brief Adds a cell to a parsed scene.
+ * @param scene Pointer to the parsed scene.
+ * @param x Cell coordinate along x.
+ * @param z Cell coordinate along z.
+ * @param path Path to the cell's scene file.
+ */
+static void parsed_scene_add_cell(fluxParsedScene scene, int x, int z,
+                                  hstr path) {
+    LOG_FUNC_CALL();
+    assert(scene);
+    assert(path);
+    if (scene->n_cells == scene->cells_size) {
+        scene->cells_size = scene->cells_size ? 2 * scene->cells_size : 16;
+        assert(scene->cells = (fluxParsedCell*)realloc(
+                   scene->cells, sizeof(fluxParsedCell) * scene->cells_size));
+    }
+    scene->cells[scene->n_cells++] = (fluxParsedCell){x, z, hstr_incref(path)};
 }
 
 /**
@@ -218,12 +261,19 @@ void parser_delete_parsed_scene(fluxParsedScene scene) {
         parser_delete_parsed_prefab(scene->prefabs[i]);
     }
     for (int i = 0; i < scene->n_gameobjects; i++) {
-        delete_parsed_gameobject(scene->gameobjects[i]);
+        release_parsed_gameobject(&scene->gameobjects[i], scene->no_args);
     }
     if (scene->gameobjects)
         free(scene->gameobjects);
     if (scene->prefabs)
         free(scene->prefabs);
+    for (int i = 0; i < scene->n_cells; i++) {
+        hstr_decref(scene->cells[i].path);
+    }
+    if (scene->cells)
+        free(scene->cells);
+    hstr_array_delete(scene->world_prefabs);
+    hstr_array_delete(scene->no_args);
     free(scene);
 }
 
@@ -286,14 +336,130 @@ fluxParsedGameObject parser_parsed_scene_get_gameobject(fluxParsedScene scene,
     assert(scene);
     assert(i >= 0);
     assert(i < scene->n_gameobjects);
-    return scene->gameobjects[i];
+    return &scene->gameobjects[i];
+}
+
+/**
+ * @brief Retrieves the edge length of the cells of a parsed scene's world.
+ * @param scene Pointer to the parsed scene.
+ * @return The cell size, in world units.
+ */
+float parser_parsed_scene_get_cell_size(fluxParsedScene scene) {
+    LOG_FUNC_CALL();
+    assert(scene);
+    return scene->cell_size;
+}
+
+/**
+ * @brief Retrieves the distance from the camera within which cells load.
+ * @param scene Pointer to the parsed scene.
+ * @return The load radius, in world units.
+ */
+float parser_parsed_scene_get_load_radius(fluxParsedScene scene) {
+    LOG_FUNC_CALL();
+    assert(scene);
+    return scene->load_radius;
+}
+
+/**
+ * @brief Retrieves the distance from the camera beyond which cells unload.
+ * @param scene Pointer to the parsed scene.
+ * @return The unload radius, in world units.
+ */
+float parser_parsed_scene_get_unload_radius(fluxParsedScene scene) {
+    LOG_FUNC_CALL();
+    assert(scene);
+    return scene->unload_radius;
+}
+
+/**
+ * @brief Retrieves the number of cells in a parsed scene's world.
+ * @param scene Pointer to the parsed scene.
+ * @return Number of cells (0 if the scene is not a streamed world).
+ */
+int parser_parsed_scene_get_n_cells(fluxParsedScene scene) {
+    LOG_FUNC_CALL();
+    assert(scene);
+    return scene->n_cells;
+}
+
+/**
+ * @brief Retrieves the coordinates of a cell of a parsed scene's world.
+ * @param scene Pointer to the parsed scene.
+ * @param i Index of the cell.
+ * @param x Set to the cell coordinate along x.
+ * @param z Set to the cell coordinate along z.
+ */
+void parser_parsed_scene_get_cell_coords(fluxParsedScene scene, int i, int* x,
+                                         int* z) {
+    LOG_FUNC_CALL();
+    assert(scene);
+    assert((i >= 0) && (i < scene->n_cells));
+    *x = scene->cells[i].x;
+    *z = scene->cells[i].z;
+}
+
+/**
+ * @brief Retrieves the path of the scene file of a cell.
+ * @param scene Pointer to the parsed scene.
+ * @param i Index of the cell.
+ * @return Path to the cell's scene file.
+ */
+hstr parser_parsed_scene_get_cell_path(fluxParsedScene scene, int i) {
+    LOG_FUNC_CALL();
+    assert(scene);
+    assert((i >= 0) && (i < scene->n_cells));
+    return scene->cells[i].path;
+}
+
+/**
+ * @brief Retrieves the paths of the prefabs that are loaded only while a cell
+ * uses them.
+ * @param scene Pointer to the parsed scene.
+ * @return Paths of the world prefabs.
+ */
+hstrArray parser_parsed_scene_get_world_prefabs(fluxParsedScene scene) {
+    LOG_FUNC_CALL();
+    assert(scene);
+    return scene->world_prefabs;
+}
+
+/**
+ * @brief Number of distinct prefab names the scene parser remembers, so game
+ * objects of the same prefab share one `hstr`.
+ */
+#ifndef PARSER_SCENE_RECENT_NAMES
+#define PARSER_SCENE_RECENT_NAMES 8
+#endif
+
+/**
+ * @brief Finds the `hstr` for a prefab name among the recently seen ones, or
+ * makes one and remembers it in place of the oldest.
+ * @param recent The recently seen names, each holding a reference.
+ * @param next_recent Index of the oldest name, advanced when it is replaced.
+ * @param name The name.
+ * @return The name, owned by `recent`.
+ */
+static hstr find_recent_name(hstr* recent, int* next_recent,
+                             fluxStringView name) {
+    for (int i = 0; i < PARSER_SCENE_RECENT_NAMES; i++) {
+        if (recent[i] && parser_view_equals(name, hstr_unpack(recent[i])))
+            return recent[i];
+    }
+    hstr* slot = &recent[*next_recent];
+    *next_recent = (*next_recent + 1) % PARSER_SCENE_RECENT_NAMES;
+    if (*slot)
+        hstr_decref(*slot);
+    *slot = hstr_incref(hstr_new_n(name.data, name.length));
+    return *slot;
 }
 
 /**
  * @brief Parses a scene from a specified file path.
  *
  * Reads a scene file and creates a parsed scene structure populated with data
- * extracted from the file.
+ * extracted from the file. The file is tokenized in place (see
+ * tokenizer.c), so parsing allocates only what the parsed scene keeps.
  * @param raw_path Path to the scene file to parse.
  * @return Pointer to the newly parsed scene structure.
  */
@@ -303,100 +469,80 @@ fluxParsedScene parser_read_scene(const char* raw_path) {
     fluxParsedScene out = alloc_parsed_scene_internal();
     parsed_scene_set_path(out, path);
 
-    FILE* fptr;
-    TraceLog(LOG_INFO, "opening %s", hstr_unpack(path));
-    fptr = fopen(hstr_unpack(path), "r");
-    if (!fptr) {
-        TraceLog(LOG_ERROR, "could not open %s", hstr_unpack(path));
-        goto cleanup;
-    }
-    TraceLog(LOG_INFO, "opened %s", hstr_unpack(path));
-
-    size_t sz = get_file_length(fptr);
-    TraceLog(LOG_INFO, "file is %lu bytes", sz);
-
-    hstr file_str = hstr_incref(read_whole_file(fptr));
-    hstrArray lines = hstr_split(file_str, "\n");
-
-    for (int i = 0; i < hstr_array_len(lines); i++) {
-        hstr line = hstr_incref(hstr_array_get(lines, i));
-
-        hstrArray arguments = hstr_split(line, "=");
+    hstr recent_names[PARSER_SCENE_RECENT_NAMES] = {0};
+    int next_recent = 0;
 
-        if (hstr_array_len(arguments) == 2) {
-
-            hstr command =
-                hstr_incref(hstr_strip(hstr_array_get(arguments, 0)));
-            hstr argument =
-                hstr_incref(hstr_strip(hstr_array_get(arguments, 1)));
-
-            hstrArray argument_list = hstr_split(argument, ",");
+    fluxTokenizer tokenizer;
+    if (!parser_open_tokenizer(&tokenizer, hstr_unpack(path)))
+        goto cleanup;
 
-            if (strcmp(hstr_unpack(command), "sceneName") == 0) {
-                parsed_scene_set_name(out, argument);
-            } else if (strcmp(hstr_unpack(command), "scenePrefabs") == 0) {
-                for (int k = 0; k < hstr_array_len(argument_list); k++) {
-                    hstr prefab_path = hstr_incref(
-                        hstr_strip(hstr_array_get(argument_list, k)));
-                    fluxParsedPrefab prefab =
-                        parser_read_prefab(hstr_unpack(prefab_path));
-                    parsed_scene_add_prefab(out, prefab);
-                    hstr_decref(prefab_path);
-                }
-            } else if (strcmp(hstr_unpack(command), "sceneGameObject") == 0) {
-                assert(hstr_array_len(argument_list) >= 10);
-                hstr prefab_name =
-                    hstr_incref(hstr_array_get(argument_list, 0));
-                fluxTransform transform;
-                transform.pos.x =
-                    atof(hstr_unpack(hstr_array_get(argument_list, 1)));
-                transform.pos.y =
-                    atof(hstr_unpack(hstr_array_get(argument_list, 2)));
-                transform.pos.z =
-                    atof(hstr_unpack(hstr_array_get(argument_list, 3)));
-                transform.rot.x =
-                    atof(hstr_unpack(hstr_array_get(argument_list, 4)));
-                transform.rot.y =
-                    atof(hstr_unpack(hstr_array_get(argument_list, 5)));
-                transform.rot.z =
-                    atof(hstr_unpack(hstr_array_get(argument_list, 6)));
-                transform.scale.x =
-                    atof(hstr_unpack(hstr_array_get(argument_list, 7)));
-                transform.scale.y =
-                    atof(hstr_unpack(hstr_array_get(argument_list, 8)));
-                transform.scale.z =
-                    atof(hstr_unpack(hstr_array_get(argument_list, 9)));
-                hstrArray args = hstr_array_make();
-                for (int m = 10; m < hstr_array_len(argument_list); m++) {
-                    hstr_array_append(args, hstr_array_get(argument_list, m));
+    while (parser_next_line(&tokenizer)) {
+        int n_values = parser_get_n_values(&tokenizer);
+        if (parser_key_is(&tokenizer, "sceneGameObject")) {
+            assert(n_values >= 10);
+            hstr prefab_name = find_recent_name(
+                recent_names, &next_recent, parser_get_value(&tokenizer, 0));
+            fluxTransform transform;
+            transform.pos.x = parser_get_float(&tokenizer, 1);
+            transform.pos.y = parser_get_float(&tokenizer, 2);
+            transform.pos.z = parser_get_float(&tokenizer, 3);
+            transform.rot.x = parser_get_float(&tokenizer, 4);
+            transform.rot.y = parser_get_float(&tokenizer, 5);
+            transform.rot.z = parser_get_float(&tokenizer, 6);
+            transform.scale.x = parser_get_float(&tokenizer, 7);
+            transform.scale.y = parser_get_float(&tokenizer, 8);
+            transform.scale.z = parser_get_float(&tokenizer, 9);
+            hstrArray args = out->no_args;
+            if (n_values > 10) {
+                args = hstr_array_make();
+                for (int m = 10; m < n_values; m++) {
+                    hstr_array_append(args,
+                                      parser_get_value_hstr(&tokenizer, m));
                 }
-                parsed_scene_add_gameobject(
-                    out, make_parsed_gameobject(prefab_name, transform, args));
-                hstr_decref(prefab_name);
             }
-
-            hstr_array_delete(argument_list);
-            hstr_decref(command);
-            hstr_decref(argument);
-
-        } else {
-            TraceLog(LOG_ERROR, "malformed line %s", hstr_unpack(line));
+            parsed_scene_add_gameobject(out, prefab_name, transform, args);
+        } else if (parser_key_is(&tokenizer, "sceneName")) {
+            hstr name = hstr_incref(parser_get_whole_value_hstr(&tokenizer));
+            parsed_scene_set_name(out, name);
+            hstr_decref(name);
+        } else if (parser_key_is(&tokenizer, "scenePrefabs")) {
+            for (int k = 0; k < n_values; k++) {
+                hstr prefab_path =
+                    hstr_incref(parser_get_value_hstr(&tokenizer, k));
+                fluxParsedPrefab prefab =
+                    parser_read_prefab(hstr_unpack(prefab_path));
+                parsed_scene_add_prefab(out, prefab);
+                hstr_decref(prefab_path);
+            }
+        } else if (parser_key_is(&tokenizer, "sceneCellSize")) {
+            out->cell_size = parser_get_float(&tokenizer, 0);
+        } else if (parser_key_is(&tokenizer, "sceneCellRadius")) {
+            assert(n_values == 2);
+            out->load_radius = parser_get_float(&tokenizer, 0);
+            out->unload_radius = parser_get_float(&tokenizer, 1);
+        } else if (parser_key_is(&tokenizer, "sceneWorldPrefabs")) {
+            for (int k = 0; k < n_values; k++) {
+                hstr_array_append(out->world_prefabs,
+                                  parser_get_value_hstr(&tokenizer, k));
+            }
+        } else if (parser_key_is(&tokenizer, "sceneCell")) {
+            assert(n_values == 3);
+            hstr cell_path =
+                hstr_incref(parser_get_value_hstr(&tokenizer, 2));
+            parsed_scene_add_cell(out, parser_get_int(&tokenizer, 0),
+                                  parser_get_int(&tokenizer, 1), cell_path);
+            hstr_decref(cell_path);
         }
-
-        hstr_array_delete(arguments);
-        hstr_decref(line);
     }
+    TraceLog(LOG_INFO, "parsed %d game objects from %s", out->n_gameobjects,
+             hstr_unpack(path));
 
-    hstr_array_delete(lines);
-    hstr_decref(file_str);
-
-    TraceLog(LOG_INFO, "closing %s", hstr_unpack(path));
-    if (fclose(fptr)) {
-        TraceLog(LOG_ERROR, "close %s failed...", hstr_unpack(path));
-    } else {
-        TraceLog(LOG_INFO, "closed %s", hstr_unpack(path));
-    }
 cleanup:
+    parser_close_tokenizer(&tokenizer);
+    for (int i = 0; i < PARSER_SCENE_RECENT_NAMES; i++) {
+        if (recent_names[i])
+            hstr_decref(recent_names[i]);
+    }
     hstr_decref(path);
     return out;
-}
\ No newline at end of file
+}
@@ -29,6 +29,21 @@ int parser_parsed_scene_get_n_gameobjects(fluxParsedScene scene);
 fluxParsedGameObject parser_parsed_scene_get_gameobject(fluxParsedScene scene,
                                                         int i);
 
+float parser_parsed_scene_get_cell_size(fluxParsedScene scene);
+
+float parser_parsed_scene_get_load_radius(fluxParsedScene scene);
+
+float parser_parsed_scene_get_unload_radius(fluxParsedScene scene);
+
+int parser_parsed_scene_get_n_cells(fluxParsedScene scene);
+
+void parser_parsed_scene_get_cell_coords(fluxParsedScene scene, int i, int* x,
+                                         int* z);
+
+hstr parser_parsed_scene_get_cell_path(fluxParsedScene scene, int i);
+
+hstrArray parser_parsed_scene_get_world_prefabs(fluxParsedScene scene);
+
 hstr parser_parsed_gameobject_get_prefab_name(fluxParsedGameObject gameobject);
 
 fluxTransform
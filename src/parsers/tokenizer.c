@@ -0,0 +1,281 @@
+/**
+ * @file tokenizer.c
+ * @brief Splits `.scene` and `.prefab` files into keys and values in a single
+ * pass over the mapped file.
+ *
+ * Nothing is copied: keys and values are views of the mapping, and the only
+ * allocation is the array of value views, which is reused from line to line.
+ * The parsers turn the views they keep into `hstr`s, and read numbers
+ * straight out of the mapping.
+ *
+ * Lines are split at their `=` and the value at its commas, like the old
+ * `hstr_split()` based parsers did: empty lines and empty values are
+ * skipped, and a line without exactly one `=` and a key and value on either
+ * side of it is reported as malformed and skipped.
+ **/
+
+#include "tokenizer.h"
+#include "hqtools/hqtools.h"
+#include "mapped_file.h"
+#include "parse_number.h"
+#include "raylib.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Initial capacity of a tokenizer's array of value views.
+ */
+#ifndef PARSER_TOKENIZER_VALUES
+#define PARSER_TOKENIZER_VALUES 16
+#endif
+
+/**
+ * @brief Checks for whitespace within a line.
+ * @param c The character.
+ * @return Whether the character is stripped from keys and values.
+ */
+static bool is_blank(char c) {
+    return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\v') ||
+           (c == '\f');
+}
+
+/**
+ * @brief Makes a view of some characters, without the whitespace around them.
+ * @param start The first character.
+ * @param end One past the last character.
+ * @return The stripped view.
+ */
+static fluxStringView strip(const char* start, const char* end) {
+    while ((start < end) && is_blank(*start))
+        start++;
+    while ((end > start) && is_blank(end[-1]))
+        end--;
+    return (fluxStringView){start, (int)(end - start)};
+}
+
+/**
+ * @brief Adds a value view to the current line.
+ * @param tokenizer The tokenizer.
+ * @param view The value.
+ */
+static void add_value(fluxTokenizer* tokenizer, fluxStringView view) {
+    if (tokenizer->n_values == tokenizer->values_size) {
+        tokenizer->values_size *= 2;
+        assert(tokenizer->values = (fluxStringView*)realloc(
+                   tokenizer->values,
+                   sizeof(fluxStringView) * tokenizer->values_size));
+    }
+    tokenizer->values[tokenizer->n_values++] = view;
+}
+
+/**
+ * @brief Splits the current line's value at its commas.
+ * @param tokenizer The tokenizer.
+ */
+static void split_values(fluxTokenizer* tokenizer) {
+    const char* p = tokenizer->value.data;
+    const char* end = p + tokenizer->value.length;
+    tokenizer->n_values = 0;
+    while (p <= end) {
+        const char* comma = (const char*)memchr(p, ',', end - p);
+        if (!comma)
+            comma = end;
+        fluxStringView view = strip(p, comma);
+        if (view.length > 0)
+            add_value(tokenizer, view);
+        p = comma + 1;
+    }
+}
+
+/**
+ * @brief Maps a `.scene` or `.prefab` file for tokenizing.
+ * @param tokenizer The tokenizer to set up.
+ * @param path Path of the file, which must outlive the tokenizer.
+ * @return Whether the file could be opened. Either way, close the tokenizer
+ * with `parser_close_tokenizer()`.
+ */
+bool parser_open_tokenizer(fluxTokenizer* tokenizer, const char* path) {
+    LOG_FUNC_CALL();
+    assert(tokenizer);
+    assert(path);
+    memset(tokenizer, 0, sizeof(fluxTokenizer));
+    tokenizer->path = path;
+    tokenizer->values_size = PARSER_TOKENIZER_VALUES;
+    assert(tokenizer->values = (fluxStringView*)malloc(
+               sizeof(fluxStringView) * tokenizer->values_size));
+    tokenizer->file = flux_map_file(path);
+    if (!tokenizer->file.data) {
+        TraceLog(LOG_ERROR, "could not open %s", path);
+        return false;
+    }
+    tokenizer->next = tokenizer->file.data;
+    tokenizer->end = tokenizer->file.data + tokenizer->file.size;
+    TraceLog(LOG_INFO, "opened %s (%lu bytes)", path,
+             (unsigned long)tokenizer->file.size);
+    return true;
+}
+
+/**
+ * @brief Unmaps a tokenizer's file and frees its views.
+ * @param tokenizer The tokenizer.
+ */
+void parser_close_tokenizer(fluxTokenizer* tokenizer) {
+    LOG_FUNC_CALL();
+    assert(tokenizer);
+    if (tokenizer->file.data)
+        flux_unmap_file(&tokenizer->file);
+    free(tokenizer->values);
+    tokenizer->values = NULL;
+    tokenizer->n_values = 0;
+}
+
+/**
+ * @brief Advances to the next `key = value` line.
+ *
+ * Malformed lines are logged and skipped.
+ * @param tokenizer The tokenizer.
+ * @return False at the end of the file.
+ */
+bool parser_next_line(fluxTokenizer* tokenizer) {
+    LOG_FUNC_CALL();
+    assert(tokenizer);
+    while (tokenizer->next && (tokenizer->next < tokenizer->end)) {
+        const char* start = tokenizer->next;
+        const char* end =
+            (const char*)memchr(start, '\n', tokenizer->end - start);
+        if (!end)
+            end = tokenizer->end;
+        tokenizer->next = end + 1;
+        tokenizer->line++;
+
+        fluxStringView line = strip(start, end);
+        if (line.length == 0)
+            continue;
+
+        const char* equals = (const char*)memchr(line.data, '=', line.length);
+        const char* line_end = line.data + line.length;
+        if (equals && !memchr(equals + 1, '=', line_end - (equals + 1))) {
+            tokenizer->key = strip(line.data, equals);
+            tokenizer->value = strip(equals + 1, line_end);
+            if ((tokenizer->key.length > 0) &&
+                (tokenizer->value.length > 0)) {
+                split_values(tokenizer);
+                return true;
+            }
+        }
+        TraceLog(LOG_ERROR, "%s:%d: malformed line %.*s", tokenizer->path,
+                 tokenizer->line, line.length, line.data);
+    }
+    tokenizer->key = (fluxStringView){0};
+    tokenizer->value = (fluxStringView){0};
+    tokenizer->n_values = 0;
+    return false;
+}
+
+/**
+ * @brief Checks whether a view holds exactly a string.
+ * @param view The view.
+ * @param str The null terminated string.
+ * @return Whether they are equal.
+ */
+bool parser_view_equals(fluxStringView view, const char* str) {
+    assert(str);
+    return ((int)strlen(str) == view.length) &&
+           (memcmp(view.data, str, view.length) == 0);
+}
+
+/**
+ * @brief Checks the key of the current line.
+ * @param tokenizer The tokenizer.
+ * @param key The key to compare with.
+ * @return Whether the current line has that key.
+ */
+bool parser_key_is(const fluxTokenizer* tokenizer, const char* key) {
+    assert(tokenizer);
+    return parser_view_equals(tokenizer->key, key);
+}
+
+/**
+ * @brief Checks the whole value of the current line.
+ * @param tokenizer The tokenizer.
+ * @param value The value to compare with.
+ * @return Whether everything after the `=` is that value.
+ */
+bool parser_value_is(const fluxTokenizer* tokenizer, const char* value) {
+    assert(tokenizer);
+    return parser_view_equals(tokenizer->value, value);
+}
+
+/**
+ * @brief Gets the number of comma separated values on the current line.
+ * @param tokenizer The tokenizer.
+ * @return The number of values.
+ */
+int parser_get_n_values(const fluxTokenizer* tokenizer) {
+    assert(tokenizer);
+    return tokenizer->n_values;
+}
+
+/**
+ * @brief Gets a comma separated value of the current line.
+ * @param tokenizer The tokenizer.
+ * @param i Index of the value.
+ * @return A view of the value, valid until the next line.
+ */
+fluxStringView parser_get_value(const fluxTokenizer* tokenizer, int i) {
+    assert(tokenizer);
+    assert((i >= 0) && (i < tokenizer->n_values));
+    return tokenizer->values[i];
+}
+
+/**
+ * @brief Copies a comma separated value of the current line.
+ * @param tokenizer The tokenizer.
+ * @param i Index of the value.
+ * @return A new `hstr` with 0 references.
+ */
+hstr parser_get_value_hstr(const fluxTokenizer* tokenizer, int i) {
+    LOG_FUNC_CALL();
+    fluxStringView view = parser_get_value(tokenizer, i);
+    return hstr_new_n(view.data, view.length);
+}
+
+/**
+ * @brief Copies everything after the `=` of the current line, commas and
+ * all.
+ * @param tokenizer The tokenizer.
+ * @return A new `hstr` with 0 references.
+ */
+hstr parser_get_whole_value_hstr(const fluxTokenizer* tokenizer) {
+    LOG_FUNC_CALL();
+    assert(tokenizer);
+    return hstr_new_n(tokenizer->value.data, tokenizer->value.length);
+}
+
+/**
+ * @brief Reads a comma separated value of the current line as a float.
+ * @param tokenizer The tokenizer.
+ * @param i Index of the value.
+ * @return The number, or 0 if the value does not start with one.
+ */
+float parser_get_float(const fluxTokenizer* tokenizer, int i) {
+    fluxStringView view = parser_get_value(tokenizer, i);
+    float out = 0.0f;
+    if (flux_parse_float(view.data, tokenizer->end, &out) == view.data)
+        return 0.0f;
+    return out;
+}
+
+/**
+ * @brief Reads a comma separated value of the current line as an int.
+ * @param tokenizer The tokenizer.
+ * @param i Index of the value.
+ * @return The number, or 0 if the value does not start with one.
+ */
+int parser_get_int(const fluxTokenizer* tokenizer, int i) {
+    fluxStringView view = parser_get_value(tokenizer, i);
+    int out = 0;
+    if (flux_parse_int(view.data, tokenizer->end, &out) == view.data)
+        return 0;
+    return out;
+}
@@ -0,0 +1,70 @@
+/**
+ * @file tokenizer.h
+ **/
+
+#ifndef _PARSER_TOKENIZER_H_
+#define _PARSER_TOKENIZER_H_
+
+#include "hqtools/hqtools.h"
+#include "mapped_file.h"
+#include <stdbool.h>
+
+/**
+ * @struct fluxStringView
+ * @brief Characters of a tokenizer's file, which are not null terminated.
+ *
+ * @var const char* data The first character.
+ * @var int length Number of characters.
+ */
+typedef struct fluxStringView {
+    const char* data;
+    int length;
+} fluxStringView;
+
+/**
+ * @struct fluxTokenizer
+ * @brief Reads the `key = value,value,...` lines of a `.scene` or `.prefab`
+ * file, in place.
+ *
+ * The key, the whole value and its comma separated values are views of the
+ * mapped file, with the whitespace around them stripped. They are only valid
+ * until the next call to `parser_next_line()`.
+ */
+typedef struct fluxTokenizer {
+    const char* path;     /**< Path of the file, for error messages. */
+    fluxMappedFile file;  /**< The file's contents. */
+    const char* next;     /**< Start of the next line. */
+    const char* end;      /**< End of the contents. */
+    int line;             /**< Number of the current line, from 1. */
+    fluxStringView key;   /**< Key of the current line. */
+    fluxStringView value; /**< Everything after the `=`. */
+    int n_values;         /**< Number of comma separated values. */
+    int values_size;      /**< Capacity of `values`. */
+    fluxStringView* values; /**< The comma separated values. */
+} fluxTokenizer;
+
+bool parser_open_tokenizer(fluxTokenizer* tokenizer, const char* path);
+
+void parser_close_tokenizer(fluxTokenizer* tokenizer);
+
+bool parser_next_line(fluxTokenizer* tokenizer);
+
+bool parser_key_is(const fluxTokenizer* tokenizer, const char* key);
+
+bool parser_value_is(const fluxTokenizer* tokenizer, const char* value);
+
+int parser_get_n_values(const fluxTokenizer* tokenizer);
+
+fluxStringView parser_get_value(const fluxTokenizer* tokenizer, int i);
+
+hstr parser_get_value_hstr(const fluxTokenizer* tokenizer, int i);
+
+hstr parser_get_whole_value_hstr(const fluxTokenizer* tokenizer);
+
+float parser_get_float(const fluxTokenizer* tokenizer, int i);
+
+int parser_get_int(const fluxTokenizer* tokenizer, int i);
+
+bool parser_view_equals(fluxStringView view, const char* str);
+
+#endif
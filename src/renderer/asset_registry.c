@@ -0,0 +1,464 @@
+/**
+ * @file asset_registry.c
+ * @brief Shared, reference counted models and textures.
+ *
+ * Assets are keyed by their canonical path (or, for the generated models,
+ * by `"SPHERE"`, `"CUBE"` or `"PLANE"`), so every prefab and material that
+ * names the same file shares one copy. An asset whose last reference is
+ * released stays loaded while the unused assets fit in the cache budget, and
+ * the least recently released ones are unloaded first. That way the assets
+ * a scene shares with the next one survive a scene switch.
+ *
+ * The registry is only used from the main thread (it loads and unloads GL
+ * resources).
+ **/
+
+#include "asset_registry.h"
+#include "hqtools/hqtools.h"
+#include "mesh_cache.h"
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+/**
+ * @enum renderAssetType
+ * @brief Kinds of assets in the registry.
+ */
+typedef enum renderAssetType {
+    RENDER_ASSET_MODEL,
+    RENDER_ASSET_TEXTURE
+} renderAssetType;
+
+/**
+ * @struct renderAsset
+ * @brief A loaded asset.
+ *
+ * @var renderAssetType type Kind of the asset.
+ * @var char* key Canonical path, or name of a generated model.
+ * @var int refs Number of references, 0 if the asset is only cached.
+ * @var unsigned long long last_used When the last reference was released.
+ * @var size_t bytes Estimated size of the asset.
+ * @var Model model The model, for models.
+ * @var Texture2D texture The texture, for textures.
+ */
+typedef struct renderAsset {
+    renderAssetType type;
+    char* key;
+    int refs;
+    unsigned long long last_used;
+    size_t bytes;
+    Model model;
+    Texture2D texture;
+} renderAsset;
+
+static renderAsset* assets = NULL;
+static int n_assets = 0;
+static int assets_capacity = 0;
+
+/** Counts releases, to order unused assets. */
+static unsigned long long asset_clock = 0;
+
+static size_t cache_size = RENDER_ASSET_CACHE_DEFAULT_SIZE;
+
+static long long n_hits = 0;
+static long long n_misses = 0;
+static long long n_evictions = 0;
+
+/**
+ * @brief Gets the registry key of a path.
+ * @param path Path of the asset, or name of a generated model.
+ * @return The key, to free with `free()`.
+ */
+static char* asset_key(const char* path) {
+    LOG_FUNC_CALL();
+    char canonical[PATH_MAX];
+    const char* key = path;
+    if ((strcmp(path, "SPHERE") != 0) && (strcmp(path, "CUBE") != 0) &&
+        (strcmp(path, "PLANE") != 0)) {
+#if defined(_WIN32)
+        if (_fullpath(canonical, path, sizeof(canonical)))
+            key = canonical;
+#else
+        if (realpath(path, canonical))
+            key = canonical;
+#endif
+    }
+    char* out;
+    assert(out = (char*)malloc(strlen(key) + 1));
+    strcpy(out, key);
+    return out;
+}
+
+/**
+ * @brief Finds an asset by key.
+ * @return Index of the asset, or -1.
+ */
+static int find_asset(renderAssetType type, const char* key) {
+    LOG_FUNC_CALL();
+    for (int i = 0; i < n_assets; i++) {
+        if ((assets[i].type == type) && (strcmp(assets[i].key, key) == 0))
+            return i;
+    }
+    return -1;
+}
+
+/**
+ * @brief Estimates the memory used by a model's meshes.
+ */
+static size_t model_bytes(Model model) {
+    LOG_FUNC_CALL();
+    size_t bytes = 0;
+    for (int i = 0; i < model.meshCount; i++) {
+        Mesh mesh = model.meshes[i];
+        size_t floats = (mesh.vertices ? 3 : 0) + (mesh.normals ? 3 : 0) +
+                        (mesh.texcoords ? 2 : 0) + (mesh.texcoords2 ? 2 : 0) +
+                        (mesh.tangents ? 4 : 0);
+        bytes += (size_t)mesh.vertexCount *
+                 (sizeof(float) * floats + (mesh.colors ? 4 : 0));
+        if (mesh.indices)
+            bytes += sizeof(unsigned short) * 3 * (size_t)mesh.triangleCount;
+    }
+    return bytes;
+}
+
+/**
+ * @brief Estimates the memory used by a texture and its mipmaps.
+ */
+static size_t texture_bytes(Texture2D texture) {
+    LOG_FUNC_CALL();
+    size_t bytes = 0;
+    int width = texture.width;
+    int height = texture.height;
+    for (int level = 0; level < (texture.mipmaps > 0 ? texture.mipmaps : 1);
+         level++) {
+        bytes += (size_t)GetPixelDataSize(width, height, texture.format);
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    return bytes;
+}
+
+/**
+ * @brief Adds a loaded asset with one reference.
+ */
+static void add_asset(renderAsset asset) {
+    LOG_FUNC_CALL();
+    if (n_assets == assets_capacity) {
+        assets_capacity = assets_capacity ? assets_capacity * 2 : 16;
+        renderAsset* grown;
+        assert(grown = (renderAsset*)malloc(sizeof(renderAsset) *
+                                            assets_capacity));
+        if (assets) {
+            memcpy(grown, assets, sizeof(renderAsset) * n_assets);
+            free(assets);
+        }
+        assets = grown;
+    }
+    asset.refs = 1;
+    assets[n_assets++] = asset;
+}
+
+/**
+ * @brief Unloads an asset and removes it from the registry.
+ * @param i Index of the asset.
+ */
+static void remove_asset(int i) {
+    LOG_FUNC_CALL();
+    renderAsset asset = assets[i];
+    assets[i] = assets[--n_assets];
+    if (asset.type == RENDER_ASSET_MODEL)
+        render_unload_model_file(asset.model);
+    else
+        UnloadTexture(asset.texture);
+    free(asset.key);
+    if (n_assets == 0) {
+        free(assets);
+        assets = NULL;
+        assets_capacity = 0;
+    }
+}
+
+/**
+ * @brief Unloads the least recently released unused assets until the rest
+ * fit in the budget.
+ */
+static void evict_assets(void) {
+    LOG_FUNC_CALL();
+    for (;;) {
+        size_t unused_bytes = 0;
+        int oldest = -1;
+        for (int i = 0; i < n_assets; i++) {
+            if (assets[i].refs > 0)
+                continue;
+            unused_bytes += assets[i].bytes;
+            if ((oldest < 0) ||
+                (assets[i].last_used < assets[oldest].last_used))
+                oldest = i;
+        }
+        if ((oldest < 0) || (unused_bytes <= cache_size))
+            return;
+        TraceLog(LOG_INFO, "ASSETS: evicting [%s]", assets[oldest].key);
+        n_evictions++;
+        remove_asset(oldest);
+    }
+}
+
+/**
+ * @brief Loads a model, or takes another reference to it if it is already
+ * loaded.
+ *
+ * Files are loaded through their cooked mesh files (see
+ * `render_load_model_file()`).
+ * @param path Path of the model, or `"SPHERE"`, `"CUBE"` or `"PLANE"` for a
+ * generated one.
+ * @return The model, to release with `render_release_model()`.
+ */
+Model render_acquire_model(const char* path) {
+    LOG_FUNC_CALL();
+    char* key = asset_key(path);
+    int i = find_asset(RENDER_ASSET_MODEL, key);
+    if (i >= 0) {
+        free(key);
+        n_hits++;
+        assets[i].refs++;
+        return assets[i].model;
+    }
+    n_misses++;
+    Model model;
+    if (strcmp(path, "SPHERE") == 0) {
+        model = LoadModelFromMesh(GenMeshSphere(1, 50, 50));
+    } else if (strcmp(path, "CUBE") == 0) {
+        model = LoadModelFromMesh(GenMeshCube(1, 1, 1));
+    } else if (strcmp(path, "PLANE") == 0) {
+        model = LoadModelFromMesh(GenMeshPlane(1, 1, 10, 10));
+    } else {
+        model = render_load_model_file(path);
+    }
+    if (!model.meshes) {
+        // a failed OBJ load still has its default material
+        UnloadModel(model);
+        free(key);
+        return (Model){0};
+    }
+    add_asset((renderAsset){.type = RENDER_ASSET_MODEL,
+                            .key = key,
+                            .bytes = model_bytes(model),
+                            .model = model});
+    return model;
+}
+
+/**
+ * @brief Checks whether a model is loaded, so that acquiring it is cheap.
+ * @param path Path of the model, or the name of a generated one.
+ * @return Whether the registry has the model.
+ */
+bool render_model_is_loaded(const char* path) {
+    LOG_FUNC_CALL();
+    char* key = asset_key(path);
+    int i = find_asset(RENDER_ASSET_MODEL, key);
+    free(key);
+    return i >= 0;
+}
+
+/**
+ * @brief Adds a model that was loaded elsewhere (e.g. streamed in), with one
+ * reference. If the registry already has a model for the path, the given one
+ * is unloaded and the registered one is acquired instead.
+ * @param path Path of the model.
+ * @param model The model, owned by the registry from now on.
+ * @return The model, to release with `render_release_model()`.
+ */
+Model render_add_model(const char* path, Model model) {
+    LOG_FUNC_CALL();
+    char* key = asset_key(path);
+    int i = find_asset(RENDER_ASSET_MODEL, key);
+    if (i >= 0) {
+        free(key);
+        render_unload_model_file(model);
+        n_hits++;
+        assets[i].refs++;
+        return assets[i].model;
+    }
+    n_misses++;
+    add_asset((renderAsset){.type = RENDER_ASSET_MODEL,
+                            .key = key,
+                            .bytes = model_bytes(model),
+                            .model = model});
+    return model;
+}
+
+/**
+ * @brief Releases a reference to a model from `render_acquire_model()`. The
+ * model stays loaded for later acquires while the cache has room for it.
+ * @param model The model.
+ */
+void render_release_model(Model model) {
+    LOG_FUNC_CALL();
+    for (int i = 0; i < n_assets; i++) {
+        if ((assets[i].type != RENDER_ASSET_MODEL) ||
+            (assets[i].model.meshes != model.meshes))
+            continue;
+        assert(assets[i].refs > 0);
+        if (--assets[i].refs == 0) {
+            assets[i].last_used = ++asset_clock;
+            evict_assets();
+        }
+        return;
+    }
+    if (model.meshes)
+        render_unload_model_file(model);
+}
+
+/**
+ * @brief Loads a texture, or takes another reference to it if it is already
+ * loaded.
+ * @param path Path of the texture.
+ * @return The texture (with id 0 if it could not be loaded), to release with
+ * `render_release_texture()`.
+ */
+Texture2D render_acquire_texture(const char* path) {
+    LOG_FUNC_CALL();
+    char* key = asset_key(path);
+    int i = find_asset(RENDER_ASSET_TEXTURE, key);
+    if (i >= 0) {
+        free(key);
+        n_hits++;
+        assets[i].refs++;
+        return assets[i].texture;
+    }
+    n_misses++;
+    Texture2D texture = LoadTexture(path);
+    if (texture.id == 0) {
+        free(key);
+        return texture;
+    }
+    add_asset((renderAsset){.type = RENDER_ASSET_TEXTURE,
+                            .key = key,
+                            .bytes = texture_bytes(texture),
+                            .texture = texture});
+    return texture;
+}
+
+/**
+ * @brief Like `render_acquire_texture()`, but with the image already decoded
+ * (e.g. on a streaming thread), so only the upload is left.
+ * @param path Path of the texture.
+ * @param image The decoded image, or an image without data if it could not
+ * be read. It is unloaded either way.
+ * @return The texture (with id 0 if it could not be loaded), to release with
+ * `render_release_texture()`.
+ */
+Texture2D render_acquire_texture_image(const char* path, Image image) {
+    LOG_FUNC_CALL();
+    char* key = asset_key(path);
+    int i = find_asset(RENDER_ASSET_TEXTURE, key);
+    if (i >= 0) {
+        free(key);
+        UnloadImage(image);
+        n_hits++;
+        assets[i].refs++;
+        return assets[i].texture;
+    }
+    n_misses++;
+    Texture2D texture = {0};
+    if (image.data) {
+        texture = LoadTextureFromImage(image);
+        UnloadImage(image);
+    }
+    if (texture.id == 0) {
+        free(key);
+        return texture;
+    }
+    add_asset((renderAsset){.type = RENDER_ASSET_TEXTURE,
+                            .key = key,
+                            .bytes = texture_bytes(texture),
+                            .texture = texture});
+    return texture;
+}
+
+/**
+ * @brief Releases a reference to a texture from `render_acquire_texture()`.
+ * The texture stays loaded for later acquires while the cache has room for
+ * it.
+ * @param texture The texture.
+ */
+void render_release_texture(Texture2D texture) {
+    LOG_FUNC_CALL();
+    if (texture.id == 0)
+        return;
+    for (int i = 0; i < n_assets; i++) {
+        if ((assets[i].type != RENDER_ASSET_TEXTURE) ||
+            (assets[i].texture.id != texture.id))
+            continue;
+        assert(assets[i].refs > 0);
+        if (--assets[i].refs == 0) {
+            assets[i].last_used = ++asset_clock;
+            evict_assets();
+        }
+        return;
+    }
+    UnloadTexture(texture);
+}
+
+/**
+ * @brief Sets how much memory unused assets may keep, unloading the least
+ * recently used ones if they no longer fit.
+ * @param bytes The budget, 0 to unload assets as soon as they are released.
+ */
+void render_set_asset_cache_size(size_t bytes) {
+    LOG_FUNC_CALL();
+    cache_size = bytes;
+    evict_assets();
+}
+
+/**
+ * @brief Gets the budget for unused assets.
+ * @return The budget in bytes.
+ */
+size_t render_get_asset_cache_size(void) {
+    LOG_FUNC_CALL();
+    return cache_size;
+}
+
+/**
+ * @brief Unloads every unused asset. Assets that are still referenced are
+ * left alone, with a warning.
+ */
+void render_clear_asset_cache(void) {
+    LOG_FUNC_CALL();
+    for (int i = n_assets - 1; i >= 0; i--) {
+        if (assets[i].refs == 0)
+            remove_asset(i);
+    }
+    for (int i = 0; i < n_assets; i++) {
+        TraceLog(LOG_WARNING, "ASSETS: [%s] still has %d references",
+                 assets[i].key, assets[i].refs);
+    }
+}
+
+/**
+ * @brief Gets the counters of the registry.
+ * @return The counters.
+ */
+renderAssetStats render_get_asset_stats(void) {
+    LOG_FUNC_CALL();
+    renderAssetStats stats = {
+        .hits = n_hits, .misses = n_misses, .evictions = n_evictions};
+    for (int i = 0; i < n_assets; i++) {
+        if (assets[i].type == RENDER_ASSET_MODEL)
+            stats.n_models++;
+        else
+            stats.n_textures++;
+        stats.resident_bytes += assets[i].bytes;
+        if (assets[i].refs == 0) {
+            stats.n_unused++;
+            stats.unused_bytes += assets[i].bytes;
+        }
+    }
+    return stats;
+}
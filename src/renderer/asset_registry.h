@@ -0,0 +1,68 @@
+/**
+ * @file asset_registry.h
+ **/
+
+#ifndef _FLUX_RENDERER_ASSET_REGISTRY_H_
+#define _FLUX_RENDERER_ASSET_REGISTRY_H_
+
+#include "raylib.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/** @addtogroup group1 Renderer API
+ *  @{
+ */
+
+/** Default budget for assets that are loaded but no longer used (see
+ * `render_set_asset_cache_size()`). */
+#define RENDER_ASSET_CACHE_DEFAULT_SIZE ((size_t)256 * 1024 * 1024)
+
+/**
+ * @struct renderAssetStats
+ * @brief Counters of the asset registry.
+ *
+ * @var long long hits Acquires of assets that were already loaded.
+ * @var long long misses Acquires that had to load the asset.
+ * @var long long evictions Unused assets unloaded to stay within the budget.
+ * @var int n_models Models loaded (used or not).
+ * @var int n_textures Textures loaded (used or not).
+ * @var int n_unused Loaded assets with no references, kept for later.
+ * @var size_t resident_bytes Estimated size of every loaded asset.
+ * @var size_t unused_bytes Estimated size of the unused assets.
+ */
+typedef struct renderAssetStats {
+    long long hits;
+    long long misses;
+    long long evictions;
+    int n_models;
+    int n_textures;
+    int n_unused;
+    size_t resident_bytes;
+    size_t unused_bytes;
+} renderAssetStats;
+
+Model render_acquire_model(const char* path);
+
+void render_release_model(Model model);
+
+bool render_model_is_loaded(const char* path);
+
+Model render_add_model(const char* path, Model model);
+
+Texture2D render_acquire_texture(const char* path);
+
+Texture2D render_acquire_texture_image(const char* path, Image image);
+
+void render_release_texture(Texture2D texture);
+
+void render_set_asset_cache_size(size_t bytes);
+
+size_t render_get_asset_cache_size(void);
+
+void render_clear_asset_cache(void);
+
+renderAssetStats render_get_asset_stats(void);
+
+/** @} */ // end of group1
+
+#endif
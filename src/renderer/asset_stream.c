@@ -0,0 +1,556 @@
+/**
+ * @file asset_stream.c
+ * @brief Loads models in the background.
+ *
+ * Streaming threads read requested models without touching the GPU (see
+ * `render_read_model_file()`), simplify their levels of detail, decode their
+ * textures, and queue the results.
+ * The main thread drains the queue in `render_update_asset_stream()` once a
+ * frame, uploading one texture or mesh at a time until the frame's budget is
+ * spent, and adds finished models to the asset registry. The queue is
+ * bounded, so the threads do not read far ahead of the uploads.
+ *
+ * Requests for the same path share one load. Models that cannot be read off
+ * the main thread (anything but OBJ files) are loaded with
+ * `render_acquire_model()` when their turn comes.
+ **/
+
+#include "asset_stream.h"
+#include "asset_registry.h"
+#include "hqtools/hqtools.h"
+#include "mesh_cache.h"
+#include "pipeline.h"
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @struct streamJob
+ * @brief The load of a model.
+ *
+ * @var char* path Path of the model.
+ * @var renderModelRequest* requests Requests waiting for the model. Changed
+ * on the main thread with `stream_lock` held.
+ * @var int n_requests Number of requests, 0 if they were all freed.
+ * @var bool read Set by the streaming thread if `data` holds the model.
+ * @var renderModelData data The model read by the streaming thread.
+ * @var Image* images Decoded textures, one per map of `data.textures`.
+ * @var int next_texture Next map whose texture to upload.
+ * @var int next_mesh Next mesh to upload.
+ * @var int next_lod Next level of detail to upload, counting
+ * `RENDER_MAX_LODS - 1` per mesh.
+ * @var struct streamJob* next Next job in its queue.
+ */
+typedef struct streamJob {
+    char* path;
+    renderModelRequest* requests;
+    int n_requests;
+    int requests_capacity;
+    bool read;
+    renderModelData data;
+    Image* images;
+    int next_texture;
+    int next_mesh;
+    int next_lod;
+    struct streamJob* next;
+} streamJob;
+
+/**
+ * @struct renderModelRequestInternal
+ * @brief A request for a model.
+ *
+ * @var streamJob* job The load of the model, NULL once it is ready.
+ * @var Model model The model, once it is ready.
+ * @var bool taken Set once the model was taken by the caller.
+ */
+struct renderModelRequestInternal {
+    streamJob* job;
+    Model model;
+    bool taken;
+};
+
+/**
+ * @brief A queue of jobs.
+ */
+typedef struct streamQueue {
+    streamJob* head;
+    streamJob* tail;
+    int size;
+} streamQueue;
+
+static pthread_t threads[RENDER_STREAM_THREADS];
+static bool threads_running = false;
+
+/** Protects the queues, `stop` and the requests of the jobs. */
+static pthread_mutex_t stream_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t room_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t decoded_cond = PTHREAD_COND_INITIALIZER;
+static bool stop = false;
+
+/** Jobs waiting for a streaming thread. */
+static streamQueue pending = {0};
+/** Jobs read by a streaming thread, waiting for their upload. */
+static streamQueue decoded = {0};
+
+/** The job being uploaded (main thread only). */
+static streamJob* uploading = NULL;
+
+/** Every unfinished job (main thread only). */
+static streamJob** jobs = NULL;
+static int n_jobs = 0;
+static int jobs_capacity = 0;
+
+static double budget = RENDER_STREAM_DEFAULT_BUDGET;
+static double upload_time = 0;
+
+/**
+ * @brief Adds a job at the back of a queue.
+ */
+static void queue_push(streamQueue* queue, streamJob* job) {
+    LOG_FUNC_CALL();
+    job->next = NULL;
+    if (queue->tail)
+        queue->tail->next = job;
+    else
+        queue->head = job;
+    queue->tail = job;
+    queue->size++;
+}
+
+/**
+ * @brief Takes the job at the front of a queue.
+ * @return The job, or NULL if the queue is empty.
+ */
+static streamJob* queue_pop(streamQueue* queue) {
+    LOG_FUNC_CALL();
+    streamJob* job = queue->head;
+    if (!job)
+        return NULL;
+    queue->head = job->next;
+    if (!queue->head)
+        queue->tail = NULL;
+    queue->size--;
+    return job;
+}
+
+/**
+ * @brief Reads a model, simplifies its levels of detail and decodes its
+ * textures, on a streaming thread.
+ */
+static void read_job(streamJob* job) {
+    LOG_FUNC_CALL();
+    job->read = render_read_model_file(job->path, &job->data);
+    if (!job->read)
+        return;
+    render_simplify_model_data(&job->data);
+    int n_maps = job->data.model.materialCount * MAX_MATERIAL_MAPS;
+    assert(job->images = (Image*)malloc(sizeof(Image) * (n_maps + 1)));
+    memset(job->images, 0, sizeof(Image) * (n_maps + 1));
+    for (int i = 0; i < n_maps; i++) {
+        const char* texture = job->data.textures[i];
+        if (!texture)
+            continue;
+        // maps that share a texture decode it once, the registry shares it
+        bool seen = false;
+        for (int j = 0; (j < i) && !seen; j++) {
+            seen = job->data.textures[j] &&
+                   (strcmp(job->data.textures[j], texture) == 0);
+        }
+        if (!seen)
+            job->images[i] = LoadImage(texture);
+    }
+}
+
+/**
+ * @brief Body of a streaming thread: reads pending jobs, and queues them for
+ * their upload.
+ */
+static void* stream_thread(void* data) {
+    LOG_FUNC_CALL();
+    pthread_mutex_lock(&stream_lock);
+    for (;;) {
+        while (!stop && !pending.head) {
+            pthread_cond_wait(&work_cond, &stream_lock);
+        }
+        if (stop)
+            break;
+        streamJob* job = queue_pop(&pending);
+        bool cancelled = job->n_requests == 0;
+        pthread_mutex_unlock(&stream_lock);
+        if (!cancelled)
+            read_job(job);
+        pthread_mutex_lock(&stream_lock);
+        while (!stop && (decoded.size >= RENDER_STREAM_QUEUE_SIZE)) {
+            pthread_cond_wait(&room_cond, &stream_lock);
+        }
+        queue_push(&decoded, job);
+        pthread_cond_signal(&decoded_cond);
+    }
+    pthread_mutex_unlock(&stream_lock);
+    return NULL;
+}
+
+/**
+ * @brief Starts the streaming threads, if they are not running yet.
+ */
+static void start_threads(void) {
+    LOG_FUNC_CALL();
+    if (threads_running)
+        return;
+    stop = false;
+    for (int i = 0; i < RENDER_STREAM_THREADS; i++) {
+        pthread_create(&threads[i], NULL, stream_thread, NULL);
+    }
+    threads_running = true;
+}
+
+/**
+ * @brief Frees a job and removes it from `jobs`.
+ */
+static void free_job(streamJob* job) {
+    LOG_FUNC_CALL();
+    for (int i = 0; i < n_jobs; i++) {
+        if (jobs[i] == job) {
+            jobs[i] = jobs[--n_jobs];
+            break;
+        }
+    }
+    if (job->images)
+        free(job->images);
+    if (job->requests)
+        free(job->requests);
+    free(job->path);
+    free(job);
+}
+
+/**
+ * @brief Drops a job none of whose textures or meshes are uploaded yet.
+ */
+static void discard_job(streamJob* job) {
+    LOG_FUNC_CALL();
+    assert((job->next_texture == 0) && (job->next_mesh == 0) &&
+           (job->next_lod == 0));
+    if (job->read) {
+        int n_maps = job->data.model.materialCount * MAX_MATERIAL_MAPS;
+        for (int i = 0; i < n_maps; i++) {
+            if (job->images[i].data)
+                UnloadImage(job->images[i]);
+        }
+        render_free_model_data(&job->data);
+    }
+    free_job(job);
+}
+
+/**
+ * @brief Hands the loaded model of a job to its requests, and frees the job.
+ * @param job The job.
+ * @param model The model, with one reference for the job.
+ */
+static void complete_job(streamJob* job, Model model) {
+    LOG_FUNC_CALL();
+    if ((job->n_requests == 0) && model.meshes)
+        render_release_model(model);
+    for (int i = 0; i < job->n_requests; i++) {
+        renderModelRequest request = job->requests[i];
+        if ((i == 0) || !model.meshes)
+            request->model = model;
+        else
+            request->model = render_acquire_model(job->path);
+        request->job = NULL;
+    }
+    free_job(job);
+}
+
+/**
+ * @brief Uploads the next texture, mesh or level of detail of a job, or
+ * finishes it.
+ * @return Whether the job is finished (and freed).
+ */
+static bool upload_step(streamJob* job) {
+    LOG_FUNC_CALL();
+    if (!job->read) {
+        complete_job(job, render_acquire_model(job->path));
+        return true;
+    }
+    Model* model = &job->data.model;
+    int n_maps = model->materialCount * MAX_MATERIAL_MAPS;
+    while ((job->next_texture < n_maps) &&
+           !job->data.textures[job->next_texture]) {
+        job->next_texture++;
+    }
+    if (job->next_texture < n_maps) {
+        int i = job->next_texture++;
+        const char* path = job->data.textures[i];
+        Texture2D texture = job->images[i].data
+                                ? render_acquire_texture_image(path,
+                                                               job->images[i])
+                                : render_acquire_texture(path);
+        job->images[i] = (Image){0};
+        model->materials[i / MAX_MATERIAL_MAPS]
+            .maps[i % MAX_MATERIAL_MAPS]
+            .texture = texture;
+        return false;
+    }
+    if (job->next_mesh < model->meshCount) {
+        UploadMesh(&model->meshes[job->next_mesh++], false);
+        return false;
+    }
+    int n_lods = model->meshCount * (RENDER_MAX_LODS - 1);
+    while ((job->next_lod < n_lods) &&
+           ((job->next_lod % (RENDER_MAX_LODS - 1)) + 1 >=
+            job->data.n_lods[job->next_lod / (RENDER_MAX_LODS - 1)])) {
+        job->next_lod++;
+    }
+    if (job->next_lod < n_lods) {
+        UploadMesh(&job->data.lods[job->next_lod++], false);
+        return false;
+    }
+    TraceLog(LOG_INFO, "STREAM: [%s] loaded %d meshes", job->path,
+             model->meshCount);
+    Model loaded = render_finish_model_data(&job->data);
+    complete_job(job, render_add_model(job->path, loaded));
+    return true;
+}
+
+/**
+ * @brief Checks whether a path names one of the generated models, which are
+ * made on the main thread right away.
+ */
+static bool is_generated(const char* path) {
+    LOG_FUNC_CALL();
+    return (strcmp(path, "SPHERE") == 0) || (strcmp(path, "CUBE") == 0) ||
+           (strcmp(path, "PLANE") == 0);
+}
+
+/**
+ * @brief Requests a model, which is loaded in the background unless the
+ * asset registry already has it.
+ * @param path Path of the model, or `"SPHERE"`, `"CUBE"` or `"PLANE"`.
+ * @return The request, to free with `render_model_request_free()`.
+ */
+renderModelRequest render_request_model(const char* path) {
+    LOG_FUNC_CALL();
+    renderModelRequest request;
+    assert(request = (renderModelRequest)malloc(
+               sizeof(renderModelRequestInternal)));
+    memset(request, 0, sizeof(renderModelRequestInternal));
+    if (is_generated(path) || render_model_is_loaded(path)) {
+        request->model = render_acquire_model(path);
+        return request;
+    }
+
+    streamJob* job = NULL;
+    for (int i = 0; (i < n_jobs) && !job; i++) {
+        if (strcmp(jobs[i]->path, path) == 0)
+            job = jobs[i];
+    }
+    bool new_job = job == NULL;
+    if (new_job) {
+        assert(job = (streamJob*)malloc(sizeof(streamJob)));
+        memset(job, 0, sizeof(streamJob));
+        assert(job->path = (char*)malloc(strlen(path) + 1));
+        strcpy(job->path, path);
+        if (n_jobs == jobs_capacity) {
+            jobs_capacity = jobs_capacity ? jobs_capacity * 2 : 16;
+            assert(jobs = (streamJob**)realloc(
+                       jobs, sizeof(streamJob*) * jobs_capacity));
+        }
+        jobs[n_jobs++] = job;
+        start_threads();
+    }
+
+    pthread_mutex_lock(&stream_lock);
+    if (job->n_requests == job->requests_capacity) {
+        job->requests_capacity =
+            job->requests_capacity ? job->requests_capacity * 2 : 4;
+        assert(job->requests = (renderModelRequest*)realloc(
+                   job->requests,
+                   sizeof(renderModelRequest) * job->requests_capacity));
+    }
+    job->requests[job->n_requests++] = request;
+    if (new_job) {
+        queue_push(&pending, job);
+        pthread_cond_signal(&work_cond);
+    }
+    pthread_mutex_unlock(&stream_lock);
+    request->job = job;
+    return request;
+}
+
+/**
+ * @brief Checks whether a requested model is loaded.
+ * @param request The request.
+ * @return Whether `render_model_request_take()` can be called.
+ */
+bool render_model_request_is_ready(renderModelRequest request) {
+    LOG_FUNC_CALL();
+    assert(request);
+    return request->job == NULL;
+}
+
+/**
+ * @brief Takes the model of a ready request.
+ * @param request The request, which must be ready.
+ * @return The model (with no meshes if it could not be loaded), to release
+ * with `render_release_model()`.
+ */
+Model render_model_request_take(renderModelRequest request) {
+    LOG_FUNC_CALL();
+    assert(request);
+    assert(request->job == NULL);
+    assert(!request->taken);
+    request->taken = true;
+    return request->model;
+}
+
+/**
+ * @brief Frees a request. If its model was not taken it is released, and if
+ * it is still loading the load is dropped once no request waits for it.
+ * @param request The request.
+ */
+void render_model_request_free(renderModelRequest request) {
+    LOG_FUNC_CALL();
+    assert(request);
+    streamJob* job = request->job;
+    if (job) {
+        pthread_mutex_lock(&stream_lock);
+        for (int i = 0; i < job->n_requests; i++) {
+            if (job->requests[i] == request) {
+                job->requests[i] = job->requests[--job->n_requests];
+                break;
+            }
+        }
+        pthread_mutex_unlock(&stream_lock);
+    } else if (!request->taken && request->model.meshes) {
+        render_release_model(request->model);
+    }
+    free(request);
+}
+
+/**
+ * @brief Uploads streamed models until the frame's budget is spent (at least
+ * one texture or mesh if there is any), and completes the requests of the
+ * finished ones. Call once a frame from the main thread.
+ */
+void render_update_asset_stream(void) {
+    LOG_FUNC_CALL();
+    double start = GetTime();
+    for (;;) {
+        if (!uploading) {
+            pthread_mutex_lock(&stream_lock);
+            uploading = queue_pop(&decoded);
+            if (uploading)
+                pthread_cond_signal(&room_cond);
+            pthread_mutex_unlock(&stream_lock);
+            if (!uploading)
+                break;
+            if (uploading->n_requests == 0) {
+                discard_job(uploading);
+                uploading = NULL;
+                continue;
+            }
+        }
+        if (upload_step(uploading))
+            uploading = NULL;
+        if (GetTime() - start >= budget)
+            break;
+    }
+    upload_time = GetTime() - start;
+}
+
+/**
+ * @brief Waits until every requested model is loaded.
+ */
+void render_finish_asset_stream(void) {
+    LOG_FUNC_CALL();
+    double frame_budget = budget;
+    budget = 1e30;
+    for (;;) {
+        render_update_asset_stream();
+        if (n_jobs == 0)
+            break;
+        pthread_mutex_lock(&stream_lock);
+        while (!decoded.head) {
+            pthread_cond_wait(&decoded_cond, &stream_lock);
+        }
+        pthread_mutex_unlock(&stream_lock);
+    }
+    budget = frame_budget;
+}
+
+/**
+ * @brief Stops the streaming threads and drops the loads in progress.
+ * Requests that were not ready are left with a model without meshes.
+ */
+void render_close_asset_stream(void) {
+    LOG_FUNC_CALL();
+    if (threads_running) {
+        pthread_mutex_lock(&stream_lock);
+        stop = true;
+        pthread_cond_broadcast(&work_cond);
+        pthread_cond_broadcast(&room_cond);
+        pthread_mutex_unlock(&stream_lock);
+        for (int i = 0; i < RENDER_STREAM_THREADS; i++) {
+            pthread_join(threads[i], NULL);
+        }
+        threads_running = false;
+    }
+    pending = (streamQueue){0};
+    decoded = (streamQueue){0};
+    if (uploading) {
+        // some of it is on the GPU already, so it goes to the registry
+        while (!upload_step(uploading)) {
+        }
+        uploading = NULL;
+    }
+    while (n_jobs > 0) {
+        streamJob* job = jobs[n_jobs - 1];
+        for (int i = 0; i < job->n_requests; i++) {
+            job->requests[i]->job = NULL;
+        }
+        discard_job(job);
+    }
+    if (jobs)
+        free(jobs);
+    jobs = NULL;
+    jobs_capacity = 0;
+}
+
+/**
+ * @brief Sets how long the main thread may spend uploading streamed models
+ * per frame.
+ * @param seconds The budget.
+ */
+void render_set_stream_budget(double seconds) {
+    LOG_FUNC_CALL();
+    budget = seconds;
+}
+
+/**
+ * @brief Gets the per-frame upload budget of streamed models.
+ * @return The budget in seconds.
+ */
+double render_get_stream_budget(void) {
+    LOG_FUNC_CALL();
+    return budget;
+}
+
+/**
+ * @brief Gets the number of models still loading.
+ * @return Number of loads in progress.
+ */
+int render_get_stream_pending(void) {
+    LOG_FUNC_CALL();
+    return n_jobs;
+}
+
+/**
+ * @brief Gets the time the last `render_update_asset_stream()` spent.
+ * @return Time in seconds.
+ */
+double render_get_stream_upload_time(void) {
+    LOG_FUNC_CALL();
+    return upload_time;
+}
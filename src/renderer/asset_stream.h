@@ -0,0 +1,56 @@
+/**
+ * @file asset_stream.h
+ **/
+
+#ifndef _FLUX_RENDERER_ASSET_STREAM_H_
+#define _FLUX_RENDERER_ASSET_STREAM_H_
+
+#include "raylib.h"
+#include <stdbool.h>
+
+/** @addtogroup group1 Renderer API
+ *  @{
+ */
+
+/** Number of threads that read and decode streamed models. */
+#define RENDER_STREAM_THREADS 2
+
+/** Number of read models that may wait for their upload; the streaming
+ * threads wait when the queue is full. */
+#define RENDER_STREAM_QUEUE_SIZE 4
+
+/** Default time the main thread spends uploading streamed models per frame,
+ * in seconds (see `render_set_stream_budget()`). */
+#define RENDER_STREAM_DEFAULT_BUDGET 0.002
+
+/** @struct renderModelRequestInternal */
+typedef struct renderModelRequestInternal renderModelRequestInternal;
+
+/** @typedef renderModelRequestInternal* renderModelRequest */
+typedef renderModelRequestInternal* renderModelRequest;
+
+renderModelRequest render_request_model(const char* path);
+
+bool render_model_request_is_ready(renderModelRequest request);
+
+Model render_model_request_take(renderModelRequest request);
+
+void render_model_request_free(renderModelRequest request);
+
+void render_update_asset_stream(void);
+
+void render_finish_asset_stream(void);
+
+void render_close_asset_stream(void);
+
+void render_set_stream_budget(double seconds);
+
+double render_get_stream_budget(void);
+
+int render_get_stream_pending(void);
+
+double render_get_stream_upload_time(void);
+
+/** @} */ // end of group1
+
+#endif
@@ -0,0 +1,486 @@
+/**
+ * @file frustum.c
+ * @brief View frustum extraction and frustum vs. axis aligned bounding box
+ * culling. This module only does CPU work (no raylib/GL calls), so it can be
+ * tested and benchmarked without a window.
+ *
+ * The box tests run on structure-of-arrays bounds (`renderBounds`), testing 8
+ * boxes per instruction with AVX, 4 with SSE or NEON, with a scalar fallback
+ * (and scalar tail) for everything else.
+ **/
+
+#include "frustum.h"
+#include "hqtools/hqtools.h"
+#include "rlgl.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define FLUX_FRUSTUM_AVX
+#elif defined(__SSE__) || defined(_M_X64) ||                                  \
+    (defined(_M_IX86_FP) && (_M_IX86_FP >= 1))
+#include <xmmintrin.h>
+#define FLUX_FRUSTUM_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FLUX_FRUSTUM_NEON
+#endif
+
+/**
+ * @brief Builds the plane `a + sign * b` from two matrix rows.
+ * @param a First row.
+ * @param b Second row.
+ * @param sign 1 or -1.
+ * @return The (unnormalized) plane.
+ */
+static Vector4 combine_rows(Vector4 a, Vector4 b, float sign) {
+    LOG_FUNC_CALL();
+    return (Vector4){a.x + sign * b.x, a.y + sign * b.y, a.z + sign * b.z,
+                     a.w + sign * b.w};
+}
+
+/**
+ * @brief Normalizes a plane so that its normal has unit length.
+ * @param plane Plane `(a, b, c, d)` to normalize.
+ * @return The normalized plane.
+ */
+static Vector4 normalize_plane(Vector4 plane) {
+    LOG_FUNC_CALL();
+    float len =
+        sqrtf(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+    if (len == 0.0f)
+        return plane;
+    float inv = 1.0f / len;
+    return (Vector4){plane.x * inv, plane.y * inv, plane.z * inv,
+                     plane.w * inv};
+}
+
+/**
+ * @brief Extracts the six frustum planes from a view-projection matrix
+ * (Gribb/Hartmann).
+ *
+ * `vp` should be `MatrixMultiply(view, projection)` in raylib's convention,
+ * so that clip space coordinates are `Vector4Transform(p, vp)` and a point is
+ * visible if `-w <= x, y, z <= w`.
+ * @param vp Combined view and projection matrix.
+ * @return The frustum, with normalized inward facing planes.
+ */
+renderFrustum render_frustum_from_matrix(Matrix vp) {
+    LOG_FUNC_CALL();
+    // rows of the matrix as it is applied to column vectors
+    Vector4 r0 = {vp.m0, vp.m4, vp.m8, vp.m12};
+    Vector4 r1 = {vp.m1, vp.m5, vp.m9, vp.m13};
+    Vector4 r2 = {vp.m2, vp.m6, vp.m10, vp.m14};
+    Vector4 r3 = {vp.m3, vp.m7, vp.m11, vp.m15};
+
+    renderFrustum out;
+    out.planes[RENDER_FRUSTUM_LEFT] =
+        normalize_plane(combine_rows(r3, r0, 1));
+    out.planes[RENDER_FRUSTUM_RIGHT] =
+        normalize_plane(combine_rows(r3, r0, -1));
+    out.planes[RENDER_FRUSTUM_BOTTOM] =
+        normalize_plane(combine_rows(r3, r1, 1));
+    out.planes[RENDER_FRUSTUM_TOP] =
+        normalize_plane(combine_rows(r3, r1, -1));
+    out.planes[RENDER_FRUSTUM_NEAR] =
+        normalize_plane(combine_rows(r3, r2, 1));
+    out.planes[RENDER_FRUSTUM_FAR] =
+        normalize_plane(combine_rows(r3, r2, -1));
+    return out;
+}
+
+/**
+ * @brief Builds the frustum of a camera, with the same projection as
+ * `BeginMode3D()` uses for a render target of the given aspect ratio.
+ *
+ * Unlike reading the matrices back from rlgl, this works outside of
+ * `BeginMode3D()`, e.g. to query the scene before rendering.
+ * @param camera Camera to build the frustum of.
+ * @param aspect Width over height of the render target.
+ * @return The frustum.
+ */
+renderFrustum render_frustum_from_camera(Camera3D camera, float aspect) {
+    LOG_FUNC_CALL();
+    Matrix proj;
+    if (camera.projection == CAMERA_ORTHOGRAPHIC) {
+        double top = camera.fovy / 2.0;
+        double right = top * aspect;
+        proj = MatrixOrtho(-right, right, -top, top, RL_CULL_DISTANCE_NEAR,
+                           RL_CULL_DISTANCE_FAR);
+    } else {
+        double top = RL_CULL_DISTANCE_NEAR * tan(camera.fovy * 0.5 * DEG2RAD);
+        double right = top * aspect;
+        proj = MatrixFrustum(-right, right, -top, top, RL_CULL_DISTANCE_NEAR,
+                             RL_CULL_DISTANCE_FAR);
+    }
+    Matrix view = MatrixLookAt(camera.position, camera.target, camera.up);
+    return render_frustum_from_matrix(MatrixMultiply(view, proj));
+}
+
+/**
+ * @brief Replaces a plane of a frustum with one that every point passes, e.g.
+ * to extend a light frustum towards the light by dropping its near plane.
+ * @param frustum Frustum to modify.
+ * @param plane Index of the plane (`renderFrustumPlane`).
+ */
+void render_frustum_disable_plane(renderFrustum* frustum, int plane) {
+    LOG_FUNC_CALL();
+    assert(frustum);
+    assert((plane >= 0) && (plane < RENDER_FRUSTUM_N_PLANES));
+    frustum->planes[plane] = (Vector4){0.0f, 0.0f, 0.0f, 1.0f};
+}
+
+/**
+ * @brief Tests a single box against all planes of a frustum.
+ *
+ * For each plane only the corner furthest along the plane normal (the
+ * "positive vertex") is tested; if that is behind the plane, the whole box is.
+ * @return False if the box is fully outside any plane, true otherwise.
+ */
+static inline bool test_aabb(const renderFrustum* frustum, float min_x,
+                             float min_y, float min_z, float max_x,
+                             float max_y, float max_z) {
+    for (int p = 0; p < RENDER_FRUSTUM_N_PLANES; p++) {
+        Vector4 plane = frustum->planes[p];
+        float x = plane.x > 0 ? max_x : min_x;
+        float y = plane.y > 0 ? max_y : min_y;
+        float z = plane.z > 0 ? max_z : min_z;
+        if (plane.x * x + plane.y * y + plane.z * z + plane.w < 0)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Tests whether an axis aligned bounding box intersects a frustum.
+ * @param frustum Frustum to test against.
+ * @param min Minimum corner of the box.
+ * @param max Maximum corner of the box.
+ * @return False if the box is definitely outside the frustum, true otherwise
+ * (conservative: boxes near frustum corners may pass).
+ */
+bool render_frustum_test_aabb(const renderFrustum* frustum, Vector3 min,
+                              Vector3 max) {
+    LOG_FUNC_CALL();
+    assert(frustum);
+    return test_aabb(frustum, min.x, min.y, min.z, max.x, max.y, max.z);
+}
+
+/**
+ * @brief Scalar culling of the boxes `[start, end)`.
+ * @return The number of indices written to `visible`.
+ */
+static int cull_scalar_range(const renderFrustum* frustum,
+                             const renderBounds* bounds, int start, int end,
+                             int* visible) {
+    LOG_FUNC_CALL();
+    int count = 0;
+    for (int i = start; i < end; i++) {
+        visible[count] = i;
+        count += test_aabb(frustum, bounds->min_x[i], bounds->min_y[i],
+                           bounds->min_z[i], bounds->max_x[i],
+                           bounds->max_y[i], bounds->max_z[i]);
+    }
+    return count;
+}
+
+/**
+ * @brief Culls a list of boxes against a frustum with the scalar path only.
+ *
+ * Same result as `render_frustum_cull()`, used for testing and benchmarking
+ * the SIMD paths.
+ * @param frustum Frustum to test against.
+ * @param bounds Boxes to test.
+ * @param visible Output, receives the indices of the visible boxes in
+ * increasing order. Must have space for `bounds->n` ints.
+ * @return Number of visible boxes.
+ */
+int render_frustum_cull_scalar(const renderFrustum* frustum,
+                               const renderBounds* bounds, int* visible) {
+    LOG_FUNC_CALL();
+    assert(frustum);
+    assert(bounds);
+    assert(visible || (bounds->n == 0));
+    return cull_scalar_range(frustum, bounds, 0, bounds->n, visible);
+}
+
+/**
+ * @brief Culls a list of boxes against a frustum.
+ *
+ * Uses the widest SIMD path available at compile time (see
+ * `render_frustum_simd_name()`). Indices are written branch-free: every lane
+ * writes its index and the write position only advances for visible boxes.
+ * @param frustum Frustum to test against.
+ * @param bounds Boxes to test.
+ * @param visible Output, receives the indices of the visible boxes in
+ * increasing order. Must have space for `bounds->n` ints.
+ * @return Number of visible boxes.
+ */
+int render_frustum_cull(const renderFrustum* frustum,
+                        const renderBounds* bounds, int* visible) {
+    LOG_FUNC_CALL();
+    assert(bounds);
+    return render_frustum_cull_range(frustum, bounds, 0, bounds->n, visible);
+}
+
+/**
+ * @brief Culls the boxes `[start, end)` of a list against a frustum.
+ *
+ * Only reads the boxes of the range and only writes the first `end - start`
+ * ints of `visible`, so disjoint ranges of the same list can be culled from
+ * different threads. Does not allocate or log.
+ * @param frustum Frustum to test against.
+ * @param bounds Boxes to test.
+ * @param start First box to test.
+ * @param end One past the last box to test.
+ * @param visible Output, receives the indices (into `bounds`) of the visible
+ * boxes in increasing order. Must have space for `end - start` ints.
+ * @return Number of visible boxes.
+ */
+int render_frustum_cull_range(const renderFrustum* frustum,
+                              const renderBounds* bounds, int start, int end,
+                              int* visible) {
+    LOG_FUNC_CALL();
+    assert(frustum);
+    assert(bounds);
+    assert((start >= 0) && (start <= end) && (end <= bounds->n));
+    assert(visible || (start == end));
+
+    int n = end;
+    int i = start;
+    int count = 0;
+
+    // for each plane, whether the positive vertex uses max (1) or min (0)
+    int use_max[RENDER_FRUSTUM_N_PLANES][3];
+    for (int p = 0; p < RENDER_FRUSTUM_N_PLANES; p++) {
+        use_max[p][0] = frustum->planes[p].x > 0;
+        use_max[p][1] = frustum->planes[p].y > 0;
+        use_max[p][2] = frustum->planes[p].z > 0;
+    }
+
+#if defined(FLUX_FRUSTUM_AVX)
+    __m256 zero = _mm256_setzero_ps();
+    for (; i + 8 <= n; i += 8) {
+        __m256 mn_x = _mm256_loadu_ps(bounds->min_x + i);
+        __m256 mn_y = _mm256_loadu_ps(bounds->min_y + i);
+        __m256 mn_z = _mm256_loadu_ps(bounds->min_z + i);
+        __m256 mx_x = _mm256_loadu_ps(bounds->max_x + i);
+        __m256 mx_y = _mm256_loadu_ps(bounds->max_y + i);
+        __m256 mx_z = _mm256_loadu_ps(bounds->max_z + i);
+        __m256 outside = zero;
+        for (int p = 0; p < RENDER_FRUSTUM_N_PLANES; p++) {
+            Vector4 plane = frustum->planes[p];
+            __m256 x = use_max[p][0] ? mx_x : mn_x;
+            __m256 y = use_max[p][1] ? mx_y : mn_y;
+            __m256 z = use_max[p][2] ? mx_z : mn_z;
+            __m256 dist =
+                _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.x), x),
+                              _mm256_mul_ps(_mm256_set1_ps(plane.y), y));
+            dist = _mm256_add_ps(
+                dist, _mm256_mul_ps(_mm256_set1_ps(plane.z), z));
+            dist = _mm256_add_ps(dist, _mm256_set1_ps(plane.w));
+            outside =
+                _mm256_or_ps(outside, _mm256_cmp_ps(dist, zero, _CMP_LT_OQ));
+        }
+        int mask = ~_mm256_movemask_ps(outside);
+        for (int lane = 0; lane < 8; lane++) {
+            visible[count] = i + lane;
+            count += (mask >> lane) & 1;
+        }
+    }
+#elif defined(FLUX_FRUSTUM_SSE)
+    __m128 zero = _mm_setzero_ps();
+    for (; i + 4 <= n; i += 4) {
+        __m128 mn_x = _mm_loadu_ps(bounds->min_x + i);
+        __m128 mn_y = _mm_loadu_ps(bounds->min_y + i);
+        __m128 mn_z = _mm_loadu_ps(bounds->min_z + i);
+        __m128 mx_x = _mm_loadu_ps(bounds->max_x + i);
+        __m128 mx_y = _mm_loadu_ps(bounds->max_y + i);
+        __m128 mx_z = _mm_loadu_ps(bounds->max_z + i);
+        __m128 outside = zero;
+        for (int p = 0; p < RENDER_FRUSTUM_N_PLANES; p++) {
+            Vector4 plane = frustum->planes[p];
+            __m128 x = use_max[p][0] ? mx_x : mn_x;
+            __m128 y = use_max[p][1] ? mx_y : mn_y;
+            __m128 z = use_max[p][2] ? mx_z : mn_z;
+            __m128 dist = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), x),
+                                     _mm_mul_ps(_mm_set1_ps(plane.y), y));
+            dist = _mm_add_ps(dist, _mm_mul_ps(_mm_set1_ps(plane.z), z));
+            dist = _mm_add_ps(dist, _mm_set1_ps(plane.w));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(dist, zero));
+        }
+        int mask = ~_mm_movemask_ps(outside);
+        for (int lane = 0; lane < 4; lane++) {
+            visible[count] = i + lane;
+            count += (mask >> lane) & 1;
+        }
+    }
+#elif defined(FLUX_FRUSTUM_NEON)
+    float32x4_t zero = vdupq_n_f32(0.0f);
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t mn_x = vld1q_f32(bounds->min_x + i);
+        float32x4_t mn_y = vld1q_f32(bounds->min_y + i);
+        float32x4_t mn_z = vld1q_f32(bounds->min_z + i);
+        float32x4_t mx_x = vld1q_f32(bounds->max_x + i);
+        float32x4_t mx_y = vld1q_f32(bounds->max_y + i);
+        float32x4_t mx_z = vld1q_f32(bounds->max_z + i);
+        uint32x4_t outside = vdupq_n_u32(0);
+        for (int p = 0; p < RENDER_FRUSTUM_N_PLANES; p++) {
+            Vector4 plane = frustum->planes[p];
+            float32x4_t x = use_max[p][0] ? mx_x : mn_x;
+            float32x4_t y = use_max[p][1] ? mx_y : mn_y;
+            float32x4_t z = use_max[p][2] ? mx_z : mn_z;
+            float32x4_t dist = vaddq_f32(vmulq_n_f32(x, plane.x),
+                                         vmulq_n_f32(y, plane.y));
+            dist = vaddq_f32(dist, vmulq_n_f32(z, plane.z));
+            dist = vaddq_f32(dist, vdupq_n_f32(plane.w));
+            outside = vorrq_u32(outside, vcltq_f32(dist, zero));
+        }
+        uint32_t lanes[4];
+        vst1q_u32(lanes, outside);
+        for (int lane = 0; lane < 4; lane++) {
+            visible[count] = i + lane;
+            count += lanes[lane] == 0;
+        }
+    }
+#endif
+
+    count += cull_scalar_range(frustum, bounds, i, n, visible + count);
+    return count;
+}
+
+/**
+ * @brief Returns the name of the SIMD path used by `render_frustum_cull()`.
+ * @return One of "avx", "sse", "neon" or "scalar".
+ */
+const char* render_frustum_simd_name(void) {
+    LOG_FUNC_CALL();
+#if defined(FLUX_FRUSTUM_AVX)
+    return "avx";
+#elif defined(FLUX_FRUSTUM_SSE)
+    return "sse";
+#elif defined(FLUX_FRUSTUM_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+/**
+ * @brief Transforms an axis aligned box, returning the axis aligned box that
+ * contains the transformed box (Arvo's method).
+ *
+ * Works on the center/extent form of the box, so it costs one matrix-vector
+ * product and one absolute matrix-vector product instead of transforming all
+ * 8 corners.
+ * @param box Box to transform.
+ * @param transform Affine transform to apply.
+ * @return The transformed box.
+ */
+BoundingBox render_transform_aabb(BoundingBox box, Matrix transform) {
+    LOG_FUNC_CALL();
+    Matrix m = transform;
+    Vector3 c = Vector3Scale(Vector3Add(box.min, box.max), 0.5f);
+    Vector3 e = Vector3Scale(Vector3Subtract(box.max, box.min), 0.5f);
+    Vector3 center = {m.m0 * c.x + m.m4 * c.y + m.m8 * c.z + m.m12,
+                      m.m1 * c.x + m.m5 * c.y + m.m9 * c.z + m.m13,
+                      m.m2 * c.x + m.m6 * c.y + m.m10 * c.z + m.m14};
+    Vector3 extent = {
+        fabsf(m.m0) * e.x + fabsf(m.m4) * e.y + fabsf(m.m8) * e.z,
+        fabsf(m.m1) * e.x + fabsf(m.m5) * e.y + fabsf(m.m9) * e.z,
+        fabsf(m.m2) * e.x + fabsf(m.m6) * e.y + fabsf(m.m10) * e.z};
+    BoundingBox out;
+    out.min = Vector3Subtract(center, extent);
+    out.max = Vector3Add(center, extent);
+    return out;
+}
+
+/**
+ * @brief Initializes an empty bounds list.
+ * @param bounds Bounds list to initialize.
+ */
+void render_bounds_init(renderBounds* bounds) {
+    LOG_FUNC_CALL();
+    assert(bounds);
+    memset(bounds, 0, sizeof(renderBounds));
+}
+
+/**
+ * @brief Grows a bounds list so that it can hold at least `capacity` boxes,
+ * keeping its contents.
+ * @param bounds Bounds list to grow.
+ * @param capacity Number of boxes needed.
+ */
+void render_bounds_reserve(renderBounds* bounds, int capacity) {
+    LOG_FUNC_CALL();
+    assert(bounds);
+    if (capacity <= bounds->capacity)
+        return;
+    int new_capacity = bounds->capacity > 0 ? bounds->capacity : 64;
+    while (new_capacity < capacity)
+        new_capacity *= 2;
+    float** arrays[6] = {&bounds->min_x, &bounds->min_y, &bounds->min_z,
+                         &bounds->max_x, &bounds->max_y, &bounds->max_z};
+    for (int i = 0; i < 6; i++) {
+        float* grown;
+        assert(grown = (float*)malloc(sizeof(float) * new_capacity));
+        if (*arrays[i]) {
+            memcpy(grown, *arrays[i], sizeof(float) * bounds->n);
+            free(*arrays[i]);
+        }
+        *arrays[i] = grown;
+    }
+    bounds->capacity = new_capacity;
+}
+
+/**
+ * @brief Removes all boxes from a bounds list (keeps the allocation).
+ * @param bounds Bounds list to clear.
+ */
+void render_bounds_clear(renderBounds* bounds) {
+    LOG_FUNC_CALL();
+    assert(bounds);
+    bounds->n = 0;
+}
+
+/**
+ * @brief Appends a box to a bounds list, growing it if needed.
+ * @param bounds Bounds list to append to.
+ * @param min Minimum corner of the box.
+ * @param max Maximum corner of the box.
+ */
+void render_bounds_push(renderBounds* bounds, Vector3 min, Vector3 max) {
+    LOG_FUNC_CALL();
+    assert(bounds);
+    if (bounds->n >= bounds->capacity)
+        render_bounds_reserve(bounds, bounds->n + 1);
+    int i = bounds->n;
+    bounds->min_x[i] = min.x;
+    bounds->min_y[i] = min.y;
+    bounds->min_z[i] = min.z;
+    bounds->max_x[i] = max.x;
+    bounds->max_y[i] = max.y;
+    bounds->max_z[i] = max.z;
+    bounds->n++;
+}
+
+/**
+ * @brief Frees the arrays of a bounds list and resets it to empty.
+ * @param bounds Bounds list to free.
+ */
+void render_bounds_free(renderBounds* bounds) {
+    LOG_FUNC_CALL();
+    assert(bounds);
+    if (bounds->capacity > 0) {
+        free(bounds->min_x);
+        free(bounds->min_y);
+        free(bounds->min_z);
+        free(bounds->max_x);
+        free(bounds->max_y);
+        free(bounds->max_z);
+    }
+    render_bounds_init(bounds);
+}
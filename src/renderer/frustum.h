@@ -0,0 +1,98 @@
+/**
+ * @file frustum.h
+ **/
+
+#ifndef _FLUX_RENDERER_FRUSTUM_H_
+#define _FLUX_RENDERER_FRUSTUM_H_
+
+#include "raylib.h"
+#include "raymath.h"
+#include <stdbool.h>
+
+/** @addtogroup group1 Renderer API
+ *  @{
+ */
+
+/**
+ * @brief Frustum plane indices, in the order they are stored in a
+ * `renderFrustum`.
+ */
+enum renderFrustumPlane {
+    RENDER_FRUSTUM_LEFT = 0,
+    RENDER_FRUSTUM_RIGHT,
+    RENDER_FRUSTUM_BOTTOM,
+    RENDER_FRUSTUM_TOP,
+    RENDER_FRUSTUM_NEAR,
+    RENDER_FRUSTUM_FAR,
+    RENDER_FRUSTUM_N_PLANES
+};
+
+/**
+ * @struct renderFrustum
+ * @brief The six planes of a view frustum in world space.
+ *
+ * Each plane is stored as `(a, b, c, d)` with a normalized, inward facing
+ * normal `(a, b, c)`, so a point `p` is inside the plane if
+ * `a*p.x + b*p.y + c*p.z + d >= 0`.
+ */
+typedef struct renderFrustum {
+    Vector4 planes[RENDER_FRUSTUM_N_PLANES];
+} renderFrustum;
+
+/**
+ * @struct renderBounds
+ * @brief A list of world space axis aligned bounding boxes stored
+ * structure-of-arrays, so that the SIMD culling paths can test several boxes
+ * per instruction.
+ *
+ * @var float* min_x Minimum x of each box (same for the other five arrays).
+ * @var int n Number of boxes in the list.
+ * @var int capacity Number of boxes the arrays can hold.
+ */
+typedef struct renderBounds {
+    float* min_x;
+    float* min_y;
+    float* min_z;
+    float* max_x;
+    float* max_y;
+    float* max_z;
+    int n;
+    int capacity;
+} renderBounds;
+
+renderFrustum render_frustum_from_matrix(Matrix vp);
+
+renderFrustum render_frustum_from_camera(Camera3D camera, float aspect);
+
+void render_frustum_disable_plane(renderFrustum* frustum, int plane);
+
+bool render_frustum_test_aabb(const renderFrustum* frustum, Vector3 min,
+                              Vector3 max);
+
+int render_frustum_cull(const renderFrustum* frustum,
+                        const renderBounds* bounds, int* visible);
+
+int render_frustum_cull_range(const renderFrustum* frustum,
+                              const renderBounds* bounds, int start, int end,
+                              int* visible);
+
+int render_frustum_cull_scalar(const renderFrustum* frustum,
+                               const renderBounds* bounds, int* visible);
+
+const char* render_frustum_simd_name(void);
+
+BoundingBox render_transform_aabb(BoundingBox box, Matrix transform);
+
+void render_bounds_init(renderBounds* bounds);
+
+void render_bounds_reserve(renderBounds* bounds, int capacity);
+
+void render_bounds_clear(renderBounds* bounds);
+
+void render_bounds_push(renderBounds* bounds, Vector3 min, Vector3 max);
+
+void render_bounds_free(renderBounds* bounds);
+
+/** @} */ // end of group1
+
+#endif
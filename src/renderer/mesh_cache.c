@@ -0,0 +1,1060 @@
+/**
+ * @file mesh_cache.c
+ * @brief Cooked binary meshes (`.fluxmesh`), so models are parsed and
+ * processed once instead of on every start.
+ *
+ * A cooked file holds the vertex and index streams of every mesh, its
+ * bounds, and the materials of the model with the paths of their textures.
+ * Loading one maps the file and points the meshes straight into the mapping,
+ * so the GPU upload reads from the page cache without any parsing or copying.
+ * The meshes stay mapped (read only) for as long as the model is loaded, so
+ * their CPU side data is there for occlusion culling, LODs and batching.
+ *
+ * A cooked file remembers the path, size, modification time and a hash of
+ * the contents of its source. It is used while the source has the same size
+ * and either the same time or the same contents (so a fresh checkout does
+ * not cook everything again), or when the source is missing (e.g. in a
+ * packaged build). Otherwise the source is loaded with raylib and cooked
+ * again.
+ *
+ * Only OBJ sources are cooked: their texture paths are read from the MTL
+ * file, while other formats may embed textures that cannot be referenced.
+ *
+ * `render_read_model_file()` does the CPU side of a load (cooking with rlobj
+ * if needed) on any thread, for the asset stream to upload the result on the
+ * main thread later.
+ **/
+
+#include "mesh_cache.h"
+#include "asset_registry.h"
+#include "hqtools/hqtools.h"
+#include "mapped_file.h"
+#include "pipeline.h"
+#include "rlgl.h"
+#include "rlobj.h"
+#include "simplify.h"
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/** Alignment of the streams in a cooked file. */
+#define MESH_CACHE_ALIGNMENT 16
+
+/** Magic bytes at the start of a cooked file. */
+#define MESH_CACHE_MAGIC "FLUXMESH"
+
+/**
+ * @enum meshCacheStream
+ * @brief The arrays of a mesh stored in a cooked file.
+ */
+typedef enum meshCacheStream {
+    MESH_CACHE_VERTICES,
+    MESH_CACHE_TEXCOORDS,
+    MESH_CACHE_TEXCOORDS2,
+    MESH_CACHE_NORMALS,
+    MESH_CACHE_TANGENTS,
+    MESH_CACHE_COLORS,
+    MESH_CACHE_INDICES,
+    MESH_CACHE_N_STREAMS
+} meshCacheStream;
+
+/**
+ * @struct meshCacheHeader
+ * @brief Start of a cooked file. Offsets are from the start of the file.
+ */
+typedef struct meshCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t mesh_count;
+    uint32_t material_count;
+    uint32_t source_length; ///< Length of the source path.
+    uint64_t file_size;
+    uint64_t source_size;
+    int64_t source_mtime;
+    uint64_t source_hash;
+    uint64_t source_offset; ///< Source path, with a terminator.
+    uint64_t meshes_offset; ///< `mesh_count` meshCacheMesh.
+    uint64_t materials_offset; ///< `material_count` meshCacheMaterial.
+    uint64_t mesh_material_offset; ///< `mesh_count` int32_t.
+} meshCacheHeader;
+
+/**
+ * @struct meshCacheMesh
+ * @brief A mesh in a cooked file.
+ */
+typedef struct meshCacheMesh {
+    int32_t vertex_count;
+    int32_t triangle_count;
+    uint64_t streams[MESH_CACHE_N_STREAMS]; ///< Offsets, 0 if absent.
+    BoundingBox bounds;
+} meshCacheMesh;
+
+/**
+ * @struct meshCacheMap
+ * @brief A material map in a cooked file.
+ */
+typedef struct meshCacheMap {
+    unsigned char color[4];
+    float value;
+    uint64_t texture; ///< Offset of the texture path, 0 if none.
+} meshCacheMap;
+
+/**
+ * @struct meshCacheMaterial
+ * @brief A material in a cooked file.
+ */
+typedef struct meshCacheMaterial {
+    meshCacheMap maps[MAX_MATERIAL_MAPS];
+    float params[4];
+} meshCacheMaterial;
+
+/**
+ * @struct meshCacheEntry
+ * @brief A model loaded from a cooked file, found by its meshes.
+ */
+typedef struct meshCacheEntry {
+    Mesh* meshes;
+    fluxMappedFile file;
+    BoundingBox* bounds;
+    int* n_lods;
+    Mesh* lods;
+} meshCacheEntry;
+
+/** Directory of cooked files, NULL to cook next to the sources. */
+static char* mesh_cache_dir = NULL;
+
+static meshCacheEntry* loaded_models = NULL;
+static int n_loaded_models = 0;
+static int loaded_models_capacity = 0;
+
+/**
+ * @brief Sets where cooked files go. By default they are written next to
+ * their source (`model.obj` is cooked to `model.obj.fluxmesh`); in a
+ * directory they are named after a hash of the source path.
+ * @param dir An existing directory, or NULL to cook next to the sources.
+ */
+void render_set_mesh_cache_dir(const char* dir) {
+    LOG_FUNC_CALL();
+    if (mesh_cache_dir)
+        free(mesh_cache_dir);
+    mesh_cache_dir = NULL;
+    if (dir) {
+        assert(mesh_cache_dir = (char*)malloc(strlen(dir) + 1));
+        strcpy(mesh_cache_dir, dir);
+    }
+}
+
+/**
+ * @brief Hashes bytes, a word at a time.
+ * @param data Bytes to hash.
+ * @param size Number of bytes.
+ * @return The hash.
+ */
+static uint64_t hash_bytes(const char* data, size_t size) {
+    LOG_FUNC_CALL();
+    uint64_t hash = 0xCBF29CE484222325ULL ^ size;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * 0x9E3779B97F4A7C15ULL;
+        hash ^= hash >> 29;
+    }
+    uint64_t word = 0;
+    memcpy(&word, data + i, size - i);
+    hash = (hash ^ word) * 0x9E3779B97F4A7C15ULL;
+    return hash ^ (hash >> 29);
+}
+
+/**
+ * @brief Hashes the contents of a file.
+ * @param path The file.
+ * @param hash The hash.
+ * @return `false` if the file could not be read.
+ */
+static bool hash_file(const char* path, uint64_t* hash) {
+    LOG_FUNC_CALL();
+    fluxMappedFile file = flux_map_file(path);
+    if (!file.data)
+        return false;
+    *hash = hash_bytes(file.data, file.size);
+    flux_unmap_file(&file);
+    return true;
+}
+
+/**
+ * @brief Gets the path of the cooked file of a source.
+ * @param source Path of the source.
+ * @return The path, to free with `free()`.
+ */
+static char* get_cache_path(const char* source) {
+    LOG_FUNC_CALL();
+    char* path;
+    if (!mesh_cache_dir) {
+        size_t size = strlen(source) + strlen(RENDER_MESH_CACHE_EXTENSION) + 1;
+        assert(path = (char*)malloc(size));
+        snprintf(path, size, "%s%s", source, RENDER_MESH_CACHE_EXTENSION);
+        return path;
+    }
+    size_t size = strlen(mesh_cache_dir) + 1 + 16 +
+                  strlen(RENDER_MESH_CACHE_EXTENSION) + 1;
+    assert(path = (char*)malloc(size));
+    snprintf(path, size, "%s/%016llx%s", mesh_cache_dir,
+             (unsigned long long)hash_bytes(source, strlen(source)),
+             RENDER_MESH_CACHE_EXTENSION);
+    return path;
+}
+
+/**
+ * @brief Gets the size in bytes of a stream of a mesh.
+ */
+static size_t stream_size(meshCacheStream stream, int vertex_count,
+                          int triangle_count) {
+    LOG_FUNC_CALL();
+    switch (stream) {
+    case MESH_CACHE_VERTICES:
+    case MESH_CACHE_NORMALS:
+        return sizeof(float) * 3 * (size_t)vertex_count;
+    case MESH_CACHE_TEXCOORDS:
+    case MESH_CACHE_TEXCOORDS2:
+        return sizeof(float) * 2 * (size_t)vertex_count;
+    case MESH_CACHE_TANGENTS:
+        return sizeof(float) * 4 * (size_t)vertex_count;
+    case MESH_CACHE_COLORS:
+        return sizeof(unsigned char) * 4 * (size_t)vertex_count;
+    case MESH_CACHE_INDICES:
+        return sizeof(unsigned short) * 3 * (size_t)triangle_count;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * @brief Gets the field of a mesh that points to a stream.
+ */
+static void** stream_field(Mesh* mesh, meshCacheStream stream) {
+    LOG_FUNC_CALL();
+    switch (stream) {
+    case MESH_CACHE_VERTICES:
+        return (void**)&mesh->vertices;
+    case MESH_CACHE_TEXCOORDS:
+        return (void**)&mesh->texcoords;
+    case MESH_CACHE_TEXCOORDS2:
+        return (void**)&mesh->texcoords2;
+    case MESH_CACHE_NORMALS:
+        return (void**)&mesh->normals;
+    case MESH_CACHE_TANGENTS:
+        return (void**)&mesh->tangents;
+    case MESH_CACHE_COLORS:
+        return (void**)&mesh->colors;
+    default:
+        return (void**)&mesh->indices;
+    }
+}
+
+/**
+ * @brief Checks whether a path names an OBJ file. Unlike raylib's path
+ * helpers, this and `get_directory()` use no static buffers, so models can be
+ * read on streaming threads.
+ */
+static bool is_obj_file(const char* path) {
+    LOG_FUNC_CALL();
+    const char* extension = strrchr(path, '.');
+    return extension && ((strcmp(extension, ".obj") == 0) ||
+                         (strcmp(extension, ".OBJ") == 0));
+}
+
+/**
+ * @brief Gets the directory of a file, like `GetDirectoryPath()`.
+ * @param path Path of the file.
+ * @param dir Set to the directory (`"."` if the path has none).
+ * @param size Size of `dir`.
+ */
+static void get_directory(const char* path, char* dir, size_t size) {
+    LOG_FUNC_CALL();
+    const char* slash = strrchr(path, '/');
+    const char* backslash = strrchr(path, '\\');
+    if (backslash && (!slash || (backslash > slash)))
+        slash = backslash;
+    if (!slash) {
+        snprintf(dir, size, ".");
+    } else if (slash == path) {
+        snprintf(dir, size, "/");
+    } else {
+        snprintf(dir, size, "%.*s", (int)(slash - path), path);
+    }
+}
+
+/**
+ * @brief Reads the texture paths of the materials of an OBJ file from its
+ * MTL file, the way raylib's loader does: the last `mtllib` of the OBJ file,
+ * with paths relative to its directory, and one material per `newmtl`.
+ * @param source Path of the OBJ file.
+ * @param material_count Number of materials of the loaded model.
+ * @param textures `material_count * MAX_MATERIAL_MAPS` paths, set to the
+ * texture of each map or NULL (to free with `free()`).
+ * @return `false` if the MTL file does not have `material_count` materials.
+ */
+static bool read_texture_paths(const char* source, int material_count,
+                               char** textures) {
+    LOG_FUNC_CALL();
+    memset(textures, 0, sizeof(char*) * material_count * MAX_MATERIAL_MAPS);
+    fluxMappedFile obj = flux_map_file(source);
+    if (!obj.data)
+        return false;
+    char dir[1024];
+    get_directory(source, dir, sizeof(dir));
+    char mtl_path[2048] = {0};
+    for (const char* line = obj.data; *line;) {
+        while ((*line == ' ') || (*line == '\t')) {
+            line++;
+        }
+        const char* end = strchr(line, '\n');
+        if (!end)
+            end = line + strlen(line);
+        if ((strncmp(line, "mtllib", 6) == 0) &&
+            ((line[6] == ' ') || (line[6] == '\t'))) {
+            const char* name = line + 7;
+            int length = (int)(end - name);
+            while ((length > 0) && ((name[length - 1] == '\r') ||
+                                    (name[length - 1] == ' ')))
+                length--;
+            snprintf(mtl_path, sizeof(mtl_path), "%s/", dir);
+            size_t room = sizeof(mtl_path) - strlen(mtl_path) - 1;
+            strncat(mtl_path, name,
+                    (size_t)length < room ? (size_t)length : room);
+        }
+        line = *end ? end + 1 : end;
+    }
+    flux_unmap_file(&obj);
+    if (!mtl_path[0])
+        return material_count <= 1;
+
+    fluxMappedFile mtl = flux_map_file(mtl_path);
+    if (!mtl.data)
+        return material_count <= 1;
+    static const struct {
+        const char* keyword;
+        int map;
+    } keywords[] = {{"map_Kd", MATERIAL_MAP_DIFFUSE},
+                    {"map_Ks", MATERIAL_MAP_SPECULAR},
+                    {"map_bump", MATERIAL_MAP_NORMAL},
+                    {"bump", MATERIAL_MAP_NORMAL},
+                    {"disp", MATERIAL_MAP_HEIGHT}};
+    int n_keywords = sizeof(keywords) / sizeof(keywords[0]);
+    int material = -1;
+    for (const char* line = mtl.data; *line;) {
+        while ((*line == ' ') || (*line == '\t')) {
+            line++;
+        }
+        const char* end = strchr(line, '\n');
+        if (!end)
+            end = line + strlen(line);
+        if ((strncmp(line, "newmtl", 6) == 0) &&
+            ((line[6] == ' ') || (line[6] == '\t'))) {
+            material++;
+        }
+        for (int k = 0; (k < n_keywords) && (material >= 0) &&
+                        (material < material_count);
+             k++) {
+            size_t length = strlen(keywords[k].keyword);
+            if ((strncmp(line, keywords[k].keyword, length) != 0) ||
+                ((line[length] != ' ') && (line[length] != '\t')))
+                continue;
+            const char* name = line + length + 1;
+            int name_length = (int)(end - name);
+            while ((name_length > 0) && ((name[name_length - 1] == '\r') ||
+                                         (name[name_length - 1] == ' ')))
+                name_length--;
+            char** texture =
+                &textures[material * MAX_MATERIAL_MAPS + keywords[k].map];
+            if (*texture)
+                free(*texture);
+            bool absolute = (name[0] == '/') || (name[0] == '\\') ||
+                            ((name_length > 1) && (name[1] == ':'));
+            size_t size = strlen(dir) + 1 + (size_t)name_length + 1;
+            assert(*texture = (char*)malloc(size));
+            if (absolute)
+                snprintf(*texture, size, "%.*s", name_length, name);
+            else
+                snprintf(*texture, size, "%s/%.*s", dir, name_length, name);
+            break;
+        }
+        line = *end ? end + 1 : end;
+    }
+    flux_unmap_file(&mtl);
+    return material + 1 == material_count;
+}
+
+/**
+ * @brief Writes bytes to a cooked file, padded to the stream alignment.
+ * @param fp The file.
+ * @param data Bytes to write.
+ * @param size Number of bytes.
+ * @param offset Offset in the file, advanced.
+ * @return Offset of the bytes.
+ */
+static uint64_t write_aligned(FILE* fp, const void* data, size_t size,
+                              uint64_t* offset) {
+    LOG_FUNC_CALL();
+    static const char zeros[MESH_CACHE_ALIGNMENT] = {0};
+    uint64_t start = *offset;
+    fwrite(data, 1, size, fp);
+    size_t padding = (MESH_CACHE_ALIGNMENT - size % MESH_CACHE_ALIGNMENT) %
+                     MESH_CACHE_ALIGNMENT;
+    fwrite(zeros, 1, padding, fp);
+    *offset += size + padding;
+    return start;
+}
+
+/** Numbers the temporary files of cooks, which may run on several threads. */
+static atomic_int n_cooks = 0;
+
+/**
+ * @brief Cooks a model to a file.
+ * @param model The model.
+ * @param source Path of the source of the model.
+ * @param path Path of the cooked file.
+ * @param textures_loaded Whether the model's materials have their textures,
+ * in which case only the maps with a texture get the path from the MTL file.
+ * Otherwise every map named in the MTL file gets its path.
+ * @return `false` if the model cannot be cooked or the file cannot be
+ * written.
+ */
+static bool cook_model(Model model, const char* source, const char* path,
+                       bool textures_loaded) {
+    LOG_FUNC_CALL();
+    if ((model.meshCount == 0) || (model.boneCount > 0) ||
+        !is_obj_file(source))
+        return false;
+    for (int i = 0; i < model.meshCount; i++) {
+        Mesh mesh = model.meshes[i];
+        if (!mesh.vertices || mesh.boneIds || mesh.animVertices)
+            return false;
+    }
+    struct stat st;
+    meshCacheHeader header = {0};
+    if ((stat(source, &st) != 0) || !hash_file(source, &header.source_hash))
+        return false;
+
+    char** textures;
+    size_t n_maps = (size_t)model.materialCount * MAX_MATERIAL_MAPS;
+    assert(textures = (char**)malloc(sizeof(char*) * (n_maps + 1)));
+    bool textures_known =
+        read_texture_paths(source, model.materialCount, textures);
+    bool ok = true;
+    for (int m = 0; m < model.materialCount; m++) {
+        for (int k = 0; k < MAX_MATERIAL_MAPS; k++) {
+            unsigned int id = model.materials[m].maps[k].texture.id;
+            if ((id != 0) && (id != rlGetTextureIdDefault()) &&
+                (!textures_known || !textures[m * MAX_MATERIAL_MAPS + k]))
+                ok = false;
+        }
+    }
+
+    size_t tmp_size = strlen(path) + 16;
+    char* tmp;
+    assert(tmp = (char*)malloc(tmp_size));
+    snprintf(tmp, tmp_size, "%s.%d.tmp", path,
+             atomic_fetch_add(&n_cooks, 1) % 100000);
+    FILE* fp = ok ? fopen(tmp, "wb") : NULL;
+    if (!fp) {
+        for (size_t i = 0; i < n_maps; i++) {
+            if (textures[i])
+                free(textures[i]);
+        }
+        free(textures);
+        free(tmp);
+        return false;
+    }
+
+    memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+    header.version = RENDER_MESH_CACHE_VERSION;
+    header.mesh_count = (uint32_t)model.meshCount;
+    header.material_count = (uint32_t)model.materialCount;
+    header.source_length = (uint32_t)strlen(source);
+    header.source_size = (uint64_t)st.st_size;
+    header.source_mtime = (int64_t)st.st_mtime;
+    uint64_t offset = 0;
+    write_aligned(fp, &header, sizeof(header), &offset);
+    header.source_offset =
+        write_aligned(fp, source, header.source_length + 1, &offset);
+
+    meshCacheMesh* meshes;
+    assert(meshes = (meshCacheMesh*)malloc(sizeof(meshCacheMesh) *
+                                           model.meshCount));
+    for (int i = 0; i < model.meshCount; i++) {
+        Mesh mesh = model.meshes[i];
+        meshes[i] = (meshCacheMesh){.vertex_count = mesh.vertexCount,
+                                    .triangle_count = mesh.triangleCount,
+                                    .bounds = GetMeshBoundingBox(mesh)};
+        for (int s = 0; s < MESH_CACHE_N_STREAMS; s++) {
+            void* data = *stream_field(&mesh, (meshCacheStream)s);
+            if (data)
+                meshes[i].streams[s] = write_aligned(
+                    fp, data,
+                    stream_size((meshCacheStream)s, mesh.vertexCount,
+                                mesh.triangleCount),
+                    &offset);
+        }
+    }
+    header.meshes_offset = write_aligned(
+        fp, meshes, sizeof(meshCacheMesh) * model.meshCount, &offset);
+    free(meshes);
+
+    meshCacheMaterial* materials;
+    assert(materials = (meshCacheMaterial*)malloc(
+               sizeof(meshCacheMaterial) * (model.materialCount + 1)));
+    for (int m = 0; m < model.materialCount; m++) {
+        Material material = model.materials[m];
+        memset(&materials[m], 0, sizeof(meshCacheMaterial));
+        memcpy(materials[m].params, material.params, sizeof(float) * 4);
+        for (int k = 0; k < MAX_MATERIAL_MAPS; k++) {
+            meshCacheMap* map = &materials[m].maps[k];
+            Color color = material.maps[k].color;
+            map->color[0] = color.r;
+            map->color[1] = color.g;
+            map->color[2] = color.b;
+            map->color[3] = color.a;
+            map->value = material.maps[k].value;
+            unsigned int id = material.maps[k].texture.id;
+            char* texture = textures[m * MAX_MATERIAL_MAPS + k];
+            if (texture && (!textures_loaded ||
+                            ((id != 0) && (id != rlGetTextureIdDefault()))))
+                map->texture =
+                    write_aligned(fp, texture, strlen(texture) + 1, &offset);
+        }
+    }
+    header.materials_offset = write_aligned(
+        fp, materials, sizeof(meshCacheMaterial) * model.materialCount,
+        &offset);
+    free(materials);
+
+    int32_t* mesh_material;
+    assert(mesh_material =
+               (int32_t*)malloc(sizeof(int32_t) * model.meshCount));
+    for (int i = 0; i < model.meshCount; i++) {
+        mesh_material[i] = model.meshMaterial ? model.meshMaterial[i] : 0;
+    }
+    header.mesh_material_offset = write_aligned(
+        fp, mesh_material, sizeof(int32_t) * model.meshCount, &offset);
+    free(mesh_material);
+
+    header.file_size = offset;
+    fseek(fp, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, fp);
+    ok = (ferror(fp) == 0);
+    ok = (fclose(fp) == 0) && ok;
+    remove(path);
+    ok = ok && (rename(tmp, path) == 0);
+    if (!ok)
+        remove(tmp);
+
+    for (size_t i = 0; i < n_maps; i++) {
+        if (textures[i])
+            free(textures[i]);
+    }
+    free(textures);
+    free(tmp);
+    return ok;
+}
+
+/**
+ * @brief Cooks a loaded model to a file.
+ *
+ * The file is written next to its final path and renamed into place, so a
+ * reader never sees a partial file.
+ * @param model The model, as loaded from `source` by raylib.
+ * @param source Path of the source of the model.
+ * @param path Path of the cooked file.
+ * @return `false` if the model cannot be cooked (skinned models, textures
+ * that are not in an MTL file) or the file cannot be written.
+ */
+bool render_cook_model(Model model, const char* source, const char* path) {
+    LOG_FUNC_CALL();
+    return cook_model(model, source, path, true);
+}
+
+/**
+ * @brief Checks that a range of a cooked file is inside it.
+ */
+static bool in_file(const fluxMappedFile* file, uint64_t offset,
+                    uint64_t size) {
+    LOG_FUNC_CALL();
+    return (offset <= file->size) && (size <= file->size - offset);
+}
+
+/**
+ * @brief Checks that a cooked file is whole and up to date with its source.
+ * @param file The cooked file.
+ * @param source Path of the source, or NULL to only check the file.
+ * @param header The header of the file.
+ * @return Whether the file can be loaded.
+ */
+static bool check_cooked_file(const fluxMappedFile* file, const char* source,
+                              meshCacheHeader* header) {
+    LOG_FUNC_CALL();
+    if (!in_file(file, 0, sizeof(meshCacheHeader)))
+        return false;
+    memcpy(header, file->data, sizeof(meshCacheHeader));
+    if ((memcmp(header->magic, MESH_CACHE_MAGIC, sizeof(header->magic)) !=
+         0) ||
+        (header->version != RENDER_MESH_CACHE_VERSION) ||
+        (header->file_size != file->size) ||
+        !in_file(file, header->source_offset, header->source_length + 1) ||
+        !in_file(file, header->meshes_offset,
+                 sizeof(meshCacheMesh) * (uint64_t)header->mesh_count) ||
+        !in_file(file, header->materials_offset,
+                 sizeof(meshCacheMaterial) *
+                     (uint64_t)header->material_count) ||
+        !in_file(file, header->mesh_material_offset,
+                 sizeof(int32_t) * (uint64_t)header->mesh_count))
+        return false;
+    for (uint32_t i = 0; i < header->mesh_count; i++) {
+        meshCacheMesh mesh;
+        memcpy(&mesh, file->data + header->meshes_offset + i * sizeof(mesh),
+               sizeof(mesh));
+        if ((mesh.vertex_count < 0) || (mesh.triangle_count < 0))
+            return false;
+        for (int s = 0; s < MESH_CACHE_N_STREAMS; s++) {
+            if (mesh.streams[s] &&
+                (((mesh.streams[s] % MESH_CACHE_ALIGNMENT) != 0) ||
+                 !in_file(file, mesh.streams[s],
+                          stream_size((meshCacheStream)s, mesh.vertex_count,
+                                      mesh.triangle_count))))
+                return false;
+        }
+    }
+    if (!source)
+        return true;
+
+    const char* cooked_source = file->data + header->source_offset;
+    if ((cooked_source[header->source_length] != '\0') ||
+        (strcmp(cooked_source, source) != 0))
+        return false;
+    struct stat st;
+    if (stat(source, &st) != 0)
+        return true; // shipped without its source
+    if ((uint64_t)st.st_size != header->source_size)
+        return false;
+    if ((int64_t)st.st_mtime == header->source_mtime)
+        return true;
+    uint64_t hash;
+    return hash_file(source, &hash) && (hash == header->source_hash);
+}
+
+/**
+ * @brief Reads a cooked model without touching the GPU.
+ * @param path Path of the cooked file.
+ * @param source Path of its source, to check that it is up to date, or NULL.
+ * @param data Set to the model, if it could be read.
+ * @return `false` if the file is missing, invalid or out of date.
+ */
+static bool read_cooked_model(const char* path, const char* source,
+                              renderModelData* data) {
+    LOG_FUNC_CALL();
+    fluxMappedFile file = flux_map_file(path);
+    meshCacheHeader header;
+    if (!file.data || !check_cooked_file(&file, source, &header)) {
+        flux_unmap_file(&file);
+        return false;
+    }
+
+    Model model = {0};
+    model.transform = (Matrix){1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+                               0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f};
+    model.meshCount = (int)header.mesh_count;
+    model.materialCount = (int)header.material_count;
+    model.meshes = (Mesh*)RL_CALLOC(model.meshCount, sizeof(Mesh));
+    model.materials =
+        (Material*)RL_CALLOC(model.materialCount, sizeof(Material));
+    model.meshMaterial = (int*)RL_CALLOC(model.meshCount, sizeof(int));
+
+    BoundingBox* bounds;
+    assert(bounds = (BoundingBox*)malloc(sizeof(BoundingBox) *
+                                         (model.meshCount + 1)));
+    for (int i = 0; i < model.meshCount; i++) {
+        meshCacheMesh cooked;
+        memcpy(&cooked, file.data + header.meshes_offset + i * sizeof(cooked),
+               sizeof(cooked));
+        Mesh* mesh = &model.meshes[i];
+        mesh->vertexCount = cooked.vertex_count;
+        mesh->triangleCount = cooked.triangle_count;
+        for (int s = 0; s < MESH_CACHE_N_STREAMS; s++) {
+            if (cooked.streams[s])
+                *stream_field(mesh, (meshCacheStream)s) =
+                    (void*)(file.data + cooked.streams[s]);
+        }
+        bounds[i] = cooked.bounds;
+
+        int32_t material;
+        memcpy(&material,
+               file.data + header.mesh_material_offset + i * sizeof(material),
+               sizeof(material));
+        model.meshMaterial[i] =
+            ((material >= 0) && (material < model.materialCount)) ? material
+                                                                   : 0;
+    }
+
+    size_t n_maps = (size_t)model.materialCount * MAX_MATERIAL_MAPS;
+    char** textures;
+    assert(textures = (char**)malloc(sizeof(char*) * (n_maps + 1)));
+    memset(textures, 0, sizeof(char*) * (n_maps + 1));
+    for (int m = 0; m < model.materialCount; m++) {
+        meshCacheMaterial cooked;
+        memcpy(&cooked,
+               file.data + header.materials_offset + m * sizeof(cooked),
+               sizeof(cooked));
+        Material material = LoadMaterialDefault();
+        memcpy(material.params, cooked.params, sizeof(float) * 4);
+        for (int k = 0; k < MAX_MATERIAL_MAPS; k++) {
+            meshCacheMap map = cooked.maps[k];
+            material.maps[k].color =
+                (Color){map.color[0], map.color[1], map.color[2], map.color[3]};
+            material.maps[k].value = map.value;
+            if (map.texture && in_file(&file, map.texture, 1) &&
+                memchr(file.data + map.texture, '\0',
+                       file.size - map.texture)) {
+                const char* texture = file.data + map.texture;
+                char** copy = &textures[m * MAX_MATERIAL_MAPS + k];
+                assert(*copy = (char*)malloc(strlen(texture) + 1));
+                strcpy(*copy, texture);
+            }
+        }
+        model.materials[m] = material;
+    }
+
+    *data = (renderModelData){
+        .model = model, .textures = textures, .file = file, .bounds = bounds};
+    return true;
+}
+
+/**
+ * @brief Frees a model that was loaded without touching the GPU.
+ */
+static void free_model_arrays(Model model) {
+    LOG_FUNC_CALL();
+    // the arrays come from raylib's allocator
+    for (int i = 0; i < model.meshCount; i++) {
+        for (int s = 0; s < MESH_CACHE_N_STREAMS; s++) {
+            void* data = *stream_field(&model.meshes[i], (meshCacheStream)s);
+            if (data)
+                MemFree(data);
+        }
+    }
+    for (int m = 0; m < model.materialCount; m++) {
+        MemFree(model.materials[m].maps);
+    }
+    MemFree(model.materials);
+    MemFree(model.meshMaterial);
+    MemFree(model.meshes);
+}
+
+/**
+ * @brief Frees the texture paths of a model's data.
+ */
+static void free_texture_paths(renderModelData* data) {
+    LOG_FUNC_CALL();
+    size_t n_maps = (size_t)data->model.materialCount * MAX_MATERIAL_MAPS;
+    for (size_t i = 0; i < n_maps; i++) {
+        if (data->textures[i])
+            free(data->textures[i]);
+    }
+    free(data->textures);
+    data->textures = NULL;
+}
+
+/**
+ * @brief Simplifies the levels of detail of a model read with
+ * `render_read_model_file()` (see `render_simplify_lods()`), without
+ * uploading them. Can be called from any thread, so that streamed models are
+ * not simplified on the main thread; render models made from the loaded model
+ * share these levels (see `render_model_file_get_lods()`).
+ * @param data The model's data.
+ */
+void render_simplify_model_data(renderModelData* data) {
+    LOG_FUNC_CALL();
+    assert(data);
+    assert(data->n_lods == NULL);
+    int n_meshes = data->model.meshCount;
+    assert(data->n_lods = (int*)malloc(sizeof(int) * (n_meshes + 1)));
+    assert(data->lods = (Mesh*)malloc(sizeof(Mesh) *
+                                      (n_meshes * (RENDER_MAX_LODS - 1) + 1)));
+    for (int i = 0; i < n_meshes; i++) {
+        data->n_lods[i] = render_simplify_lods(
+            data->model.meshes[i], &data->lods[i * (RENDER_MAX_LODS - 1)]);
+    }
+}
+
+/**
+ * @brief Uploads the meshes of a model read with `render_read_model_file()`
+ * that are not uploaded yet, and frees its texture paths. Must be called from
+ * the main thread.
+ *
+ * Set the textures of its materials first (from `data->textures`), as the
+ * model owns them from now on. Unload the model with
+ * `render_unload_model_file()`.
+ * @param data The model's data, consumed.
+ * @return The model.
+ */
+Model render_finish_model_data(renderModelData* data) {
+    LOG_FUNC_CALL();
+    Model model = data->model;
+    for (int i = 0; i < model.meshCount; i++) {
+        if (!model.meshes[i].vboId)
+            UploadMesh(&model.meshes[i], false);
+        for (int l = 1; data->n_lods && (l < data->n_lods[i]); l++) {
+            Mesh* lod = &data->lods[i * (RENDER_MAX_LODS - 1) + l - 1];
+            if (!lod->vboId)
+                UploadMesh(lod, false);
+        }
+    }
+    free_texture_paths(data);
+
+    if (n_loaded_models == loaded_models_capacity) {
+        loaded_models_capacity =
+            loaded_models_capacity ? loaded_models_capacity * 2 : 8;
+        meshCacheEntry* grown;
+        assert(grown = (meshCacheEntry*)malloc(sizeof(meshCacheEntry) *
+                                               loaded_models_capacity));
+        if (loaded_models) {
+            memcpy(grown, loaded_models,
+                   sizeof(meshCacheEntry) * n_loaded_models);
+            free(loaded_models);
+        }
+        loaded_models = grown;
+    }
+    loaded_models[n_loaded_models++] =
+        (meshCacheEntry){.meshes = model.meshes,
+                         .file = data->file,
+                         .bounds = data->bounds,
+                         .n_lods = data->n_lods,
+                         .lods = data->lods};
+    *data = (renderModelData){0};
+    return model;
+}
+
+/**
+ * @brief Frees a model read with `render_read_model_file()` without loading
+ * it. None of its meshes may be uploaded. Can be called from any thread.
+ * @param data The model's data.
+ */
+void render_free_model_data(renderModelData* data) {
+    LOG_FUNC_CALL();
+    free_texture_paths(data);
+    for (int i = 0; data->n_lods && (i < data->model.meshCount); i++) {
+        for (int l = 1; l < data->n_lods[i]; l++) {
+            render_free_simplified_mesh(
+                data->lods[i * (RENDER_MAX_LODS - 1) + l - 1]);
+        }
+    }
+    if (data->n_lods) {
+        free(data->n_lods);
+        free(data->lods);
+    }
+    // the streams belong to the mapping
+    for (int i = 0; i < data->model.meshCount; i++) {
+        for (int s = 0; s < MESH_CACHE_N_STREAMS; s++) {
+            *stream_field(&data->model.meshes[i], (meshCacheStream)s) = NULL;
+        }
+    }
+    free_model_arrays(data->model);
+    flux_unmap_file(&data->file);
+    free(data->bounds);
+    *data = (renderModelData){0};
+}
+
+/**
+ * @brief Loads a cooked model, and uploads its meshes.
+ *
+ * The CPU side data of the meshes points into the mapped file and must not
+ * be written to. Unload the model with `render_unload_model_file()`.
+ * @param path Path of the cooked file.
+ * @param source Path of its source, to check that it is up to date, or NULL.
+ * @return The model, with no meshes if the file is missing, invalid or out
+ * of date.
+ */
+Model render_load_cooked_model(const char* path, const char* source) {
+    LOG_FUNC_CALL();
+    renderModelData data;
+    if (!read_cooked_model(path, source, &data))
+        return (Model){0};
+    for (int m = 0; m < data.model.materialCount; m++) {
+        for (int k = 0; k < MAX_MATERIAL_MAPS; k++) {
+            const char* texture = data.textures[m * MAX_MATERIAL_MAPS + k];
+            if (texture)
+                data.model.materials[m].maps[k].texture =
+                    render_acquire_texture(texture);
+        }
+    }
+    size_t size = data.file.size;
+    Model model = render_finish_model_data(&data);
+    TraceLog(LOG_INFO, "MESH CACHE: [%s] loaded %d meshes (%zu bytes)", path,
+             model.meshCount, size);
+    return model;
+}
+
+/**
+ * @brief Finds the cooked model a model was loaded from.
+ * @return Index in `loaded_models`, or -1 if the model was not cooked.
+ */
+static int find_loaded_model(Model model) {
+    LOG_FUNC_CALL();
+    for (int i = 0; i < n_loaded_models; i++) {
+        if (model.meshes && (loaded_models[i].meshes == model.meshes))
+            return i;
+    }
+    return -1;
+}
+
+/**
+ * @brief Releases the textures of a model, which `UnloadModel()` leaves
+ * alone.
+ */
+static void release_textures(Model model) {
+    LOG_FUNC_CALL();
+    for (int m = 0; m < model.materialCount; m++) {
+        for (int k = 0; k < MAX_MATERIAL_MAPS; k++) {
+            Texture2D texture = model.materials[m].maps[k].texture;
+            if ((texture.id != 0) && (texture.id != rlGetTextureIdDefault()))
+                render_release_texture(texture);
+        }
+    }
+}
+
+/**
+ * @brief Loads a model through its cooked file, cooking it first if it is
+ * missing or out of date (see `render_set_mesh_cache_dir()`).
+ *
+ * Sources that cannot be cooked are loaded with `LoadModel()`. Either way,
+ * unload the model with `render_unload_model_file()`.
+ * @param source Path of the model.
+ * @return The model.
+ */
+Model render_load_model_file(const char* source) {
+    LOG_FUNC_CALL();
+    char* path = get_cache_path(source);
+    Model model = render_load_cooked_model(path, source);
+    if (model.meshCount > 0) {
+        free(path);
+        return model;
+    }
+
+    Model loaded = LoadModel(source);
+    if (render_cook_model(loaded, source, path)) {
+        model = render_load_cooked_model(path, source);
+        if (model.meshCount > 0) {
+            TraceLog(LOG_INFO, "MESH CACHE: cooked [%s] to [%s]", source,
+                     path);
+            release_textures(loaded);
+            UnloadModel(loaded);
+            free(path);
+            return model;
+        }
+    }
+    free(path);
+    return loaded;
+}
+
+/**
+ * @brief Reads a model through its cooked file without touching the GPU,
+ * cooking it first if it is missing or out of date. Can be called from any
+ * thread (but not while `render_set_mesh_cache_dir()` runs).
+ *
+ * Load the result on the main thread with `render_finish_model_data()`, or
+ * drop it with `render_free_model_data()`.
+ * @param source Path of the model.
+ * @param data Set to the model, if it could be read.
+ * @return `false` if the model cannot be cooked (only OBJ files can), in
+ * which case it has to be loaded with `render_load_model_file()`.
+ */
+bool render_read_model_file(const char* source, renderModelData* data) {
+    LOG_FUNC_CALL();
+    char* path = get_cache_path(source);
+    bool ok = read_cooked_model(path, source, data);
+    if (!ok && is_obj_file(source)) {
+        Model loaded = LoadObjData(source);
+        if (cook_model(loaded, source, path, false)) {
+            ok = read_cooked_model(path, source, data);
+            if (ok)
+                TraceLog(LOG_INFO, "MESH CACHE: cooked [%s] to [%s]", source,
+                         path);
+        }
+        free_model_arrays(loaded);
+    }
+    free(path);
+    return ok;
+}
+
+/**
+ * @brief Gets the bounds of the meshes of a cooked model.
+ * @param model The model.
+ * @return `model.meshCount` bounding boxes, or NULL if the model was not
+ * loaded from a cooked file.
+ */
+const BoundingBox* render_model_file_get_bounds(Model model) {
+    LOG_FUNC_CALL();
+    int i = find_loaded_model(model);
+    return (i < 0) ? NULL : loaded_models[i].bounds;
+}
+
+/**
+ * @brief Gets the levels of detail of the meshes of a cooked model, if they
+ * were simplified before it was loaded (see `render_simplify_model_data()`).
+ * They belong to the model, and are unloaded with it.
+ * @param model The model.
+ * @param n_lods Set to the number of levels of each mesh, including the mesh
+ * itself.
+ * @return `RENDER_MAX_LODS - 1` meshes per mesh, or NULL if the model was not
+ * simplified.
+ */
+const Mesh* render_model_file_get_lods(Model model, const int** n_lods) {
+    LOG_FUNC_CALL();
+    assert(n_lods);
+    int i = find_loaded_model(model);
+    *n_lods = (i < 0) ? NULL : loaded_models[i].n_lods;
+    return *n_lods ? loaded_models[i].lods : NULL;
+}
+
+/**
+ * @brief Unloads a model from `render_load_model_file()` (or
+ * `render_load_cooked_model()`), like `UnloadModel()`, and releases its
+ * textures (see `render_release_texture()`).
+ * @param model The model.
+ */
+void render_unload_model_file(Model model) {
+    LOG_FUNC_CALL();
+    release_textures(model);
+    int i = find_loaded_model(model);
+    if (i >= 0) {
+        // the streams belong to the mapping, raylib frees the rest
+        for (int m = 0; m < model.meshCount; m++) {
+            for (int s = 0; s < MESH_CACHE_N_STREAMS; s++) {
+                *stream_field(&model.meshes[m], (meshCacheStream)s) = NULL;
+            }
+        }
+        meshCacheEntry* entry = &loaded_models[i];
+        for (int m = 0; entry->n_lods && (m < model.meshCount); m++) {
+            for (int l = 1; l < entry->n_lods[m]; l++) {
+                UnloadMesh(entry->lods[m * (RENDER_MAX_LODS - 1) + l - 1]);
+            }
+        }
+        if (entry->n_lods) {
+            free(entry->n_lods);
+            free(entry->lods);
+        }
+        flux_unmap_file(&entry->file);
+        free(entry->bounds);
+        loaded_models[i] = loaded_models[--n_loaded_models];
+        if (n_loaded_models == 0) {
+            free(loaded_models);
+            loaded_models = NULL;
+            loaded_models_capacity = 0;
+        }
+    }
+    UnloadModel(model);
+}
@@ -0,0 +1,78 @@
+/**
+ * @file mesh_cache.h
+ **/
+
+#ifndef _FLUX_RENDERER_MESH_CACHE_H_
+#define _FLUX_RENDERER_MESH_CACHE_H_
+
+#include "mapped_file.h"
+#include "raylib.h"
+#include <stdbool.h>
+
+/** @addtogroup group1 Renderer API
+ *  @{
+ */
+
+/** Extension of cooked mesh files. */
+#define RENDER_MESH_CACHE_EXTENSION ".fluxmesh"
+
+/** Version of the cooked mesh format, files of other versions are cooked
+ * again. */
+#define RENDER_MESH_CACHE_VERSION 1
+
+#ifndef MAX_MATERIAL_MAPS
+/** Number of maps of a raylib material (see raylib's config.h). */
+#define MAX_MATERIAL_MAPS 12
+#endif
+
+/**
+ * @struct renderModelData
+ * @brief The CPU side of a cooked model, read without touching the GPU (see
+ * `render_read_model_file()`).
+ *
+ * @var Model model The model. Its meshes point into `file` and are not
+ * uploaded yet, and its materials have no textures.
+ * @var char** textures `model.materialCount * MAX_MATERIAL_MAPS` paths of
+ * the textures of the material maps, NULL for maps without one.
+ * @var fluxMappedFile file The cooked file.
+ * @var BoundingBox* bounds Bounds of the meshes.
+ * @var int* n_lods Per mesh, number of levels of detail including the mesh
+ * itself, or NULL if the model was not simplified (see
+ * `render_simplify_model_data()`).
+ * @var Mesh* lods Per mesh, `RENDER_MAX_LODS - 1` simplified meshes, of which
+ * the first `n_lods - 1` are used.
+ */
+typedef struct renderModelData {
+    Model model;
+    char** textures;
+    fluxMappedFile file;
+    BoundingBox* bounds;
+    int* n_lods;
+    Mesh* lods;
+} renderModelData;
+
+void render_set_mesh_cache_dir(const char* dir);
+
+bool render_cook_model(Model model, const char* source, const char* path);
+
+Model render_load_cooked_model(const char* path, const char* source);
+
+Model render_load_model_file(const char* source);
+
+bool render_read_model_file(const char* source, renderModelData* data);
+
+void render_simplify_model_data(renderModelData* data);
+
+Model render_finish_model_data(renderModelData* data);
+
+void render_free_model_data(renderModelData* data);
+
+const BoundingBox* render_model_file_get_bounds(Model model);
+
+const Mesh* render_model_file_get_lods(Model model, const int** n_lods);
+
+void render_unload_model_file(Model model);
+
+/** @} */ // end of group1
+
+#endif
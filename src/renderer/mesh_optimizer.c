@@ -0,0 +1,438 @@
+/**
+ * @file mesh_optimizer.c
+ * @brief Index buffer optimizations for the post-transform vertex cache and
+ * for overdraw. This module only does CPU work (no raylib/GL calls), so it
+ * can be tested without a window.
+ *
+ * `render_optimize_vertex_cache()` reorders triangles with Tom Forsyth's
+ * linear-speed algorithm: each vertex is scored by its position in a
+ * simulated LRU cache and by how many triangles still use it, and the next
+ * triangle is always the best scored one among those touching the cache.
+ *
+ * `render_optimize_overdraw()` then splits that order into clusters where the
+ * cache would mostly restart anyway, and draws the outward facing clusters
+ * first (Sander, Nehab and Barczak, "Fast triangle reordering for vertex
+ * locality and reduced overdraw"), so that they tend to occlude the rest.
+ *
+ * Both keep the winding of every triangle, and neither touches the vertices.
+ **/
+
+#include "mesh_optimizer.h"
+#include "hqtools/hqtools.h"
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Size of the LRU cache that Forsyth's scores are tuned for. */
+#define OPTIMIZER_CACHE_SIZE 32
+
+/** Score of the vertices of the last triangle drawn. These are penalized a
+ * little so that strips do not keep turning back on themselves. */
+#define OPTIMIZER_LAST_TRIANGLE_SCORE 0.75f
+
+/** Vertex valences with a precomputed score; higher ones use `powf()`. */
+#define OPTIMIZER_VALENCE_TABLE 32
+
+/** A soft cluster boundary is placed once the ACMR of the cluster so far is
+ * within this factor of the ACMR of its hard cluster. */
+#define OPTIMIZER_OVERDRAW_THRESHOLD 1.05f
+
+/**
+ * @struct optimizerCluster
+ * @brief A run of triangles `[start, end)` that is moved as a whole by
+ * `render_optimize_overdraw()`.
+ *
+ * @var int start First triangle.
+ * @var int end One past the last triangle.
+ * @var float sort_key How much the cluster faces away from the mesh center.
+ */
+typedef struct optimizerCluster {
+    int start;
+    int end;
+    float sort_key;
+} optimizerCluster;
+
+/**
+ * @brief Score of a vertex, from its position in the LRU cache (-1 if it is
+ * not cached) and its number of triangles not drawn yet.
+ */
+static float vertex_score(const float* cache_table, const float* valence_table,
+                          int position, int live) {
+    LOG_FUNC_CALL();
+    if (live == 0)
+        return -1.0f;
+    float score = (position >= 0) ? cache_table[position] : 0.0f;
+    if (live < OPTIMIZER_VALENCE_TABLE)
+        return score + valence_table[live];
+    return score + 2.0f * powf((float)live, -0.5f);
+}
+
+/**
+ * @brief Reorders triangles for the post-transform vertex cache.
+ *
+ * Runs in time linear in the number of triangles (times the cache size).
+ * @param indices Triangle list, reordered in place.
+ * @param n_indices Number of indices (a multiple of 3).
+ * @param n_vertices Number of vertices the indices refer to.
+ */
+void render_optimize_vertex_cache(unsigned int* indices, int n_indices,
+                                  int n_vertices) {
+    LOG_FUNC_CALL();
+    int n_triangles = n_indices / 3;
+    if (n_triangles < 2)
+        return;
+
+    float cache_table[OPTIMIZER_CACHE_SIZE];
+    for (int i = 0; i < OPTIMIZER_CACHE_SIZE; i++) {
+        if (i < 3) {
+            cache_table[i] = OPTIMIZER_LAST_TRIANGLE_SCORE;
+        } else {
+            float s = 1.0f - (float)(i - 3) / (float)(OPTIMIZER_CACHE_SIZE - 3);
+            cache_table[i] = powf(s, 1.5f);
+        }
+    }
+    float valence_table[OPTIMIZER_VALENCE_TABLE];
+    valence_table[0] = 0.0f;
+    for (int i = 1; i < OPTIMIZER_VALENCE_TABLE; i++) {
+        valence_table[i] = 2.0f * powf((float)i, -0.5f);
+    }
+
+    int* live;
+    int* offsets;
+    int* adjacency;
+    int* position;
+    float* vscore;
+    float* tscore;
+    bool* emitted;
+    unsigned int* out;
+    assert(live = (int*)malloc(sizeof(int) * n_vertices));
+    assert(offsets = (int*)malloc(sizeof(int) * (n_vertices + 1)));
+    assert(adjacency = (int*)malloc(sizeof(int) * n_triangles * 3));
+    assert(position = (int*)malloc(sizeof(int) * n_vertices));
+    assert(vscore = (float*)malloc(sizeof(float) * n_vertices));
+    assert(tscore = (float*)malloc(sizeof(float) * n_triangles));
+    assert(emitted = (bool*)malloc(sizeof(bool) * n_triangles));
+    assert(out = (unsigned int*)malloc(sizeof(unsigned int) * n_indices));
+
+    // triangles of each vertex, as one array with an offset per vertex
+    memset(live, 0, sizeof(int) * n_vertices);
+    for (int i = 0; i < n_triangles * 3; i++) {
+        live[indices[i]]++;
+    }
+    offsets[0] = 0;
+    for (int v = 0; v < n_vertices; v++) {
+        offsets[v + 1] = offsets[v] + live[v];
+        position[v] = offsets[v];
+    }
+    for (int i = 0; i < n_triangles * 3; i++) {
+        adjacency[position[indices[i]]++] = i / 3;
+    }
+
+    for (int v = 0; v < n_vertices; v++) {
+        position[v] = -1;
+        vscore[v] = vertex_score(cache_table, valence_table, -1, live[v]);
+    }
+    for (int t = 0; t < n_triangles; t++) {
+        const unsigned int* tri = indices + t * 3;
+        tscore[t] = vscore[tri[0]] + vscore[tri[1]] + vscore[tri[2]];
+        emitted[t] = false;
+    }
+
+    int cache[OPTIMIZER_CACHE_SIZE + 3];
+    int new_cache[OPTIMIZER_CACHE_SIZE + 3];
+    int n_cache = 0;
+    int cursor = 0;
+    int best = -1;
+    for (int k = 0; k < n_triangles; k++) {
+        // nothing left around the cache: restart at the next triangle in
+        // input order, which keeps the restart cheap and the result stable
+        if (best < 0) {
+            while (emitted[cursor])
+                cursor++;
+            best = cursor;
+        }
+        const unsigned int* tri = indices + best * 3;
+        memcpy(out + k * 3, tri, sizeof(unsigned int) * 3);
+        emitted[best] = true;
+
+        // the live triangles of a vertex are the first `live` of its list
+        for (int c = 0; c < 3; c++) {
+            int v = tri[c];
+            int* list = adjacency + offsets[v];
+            for (int i = 0; i < live[v]; i++) {
+                if (list[i] == best) {
+                    list[i] = list[live[v] - 1];
+                    list[live[v] - 1] = best;
+                    live[v]--;
+                    break;
+                }
+            }
+        }
+
+        // the triangle moves to the front of the cache
+        int n_new = 0;
+        for (int c = 0; c < 3; c++) {
+            int v = tri[c];
+            if (((c > 0) && (v == (int)tri[0])) ||
+                ((c > 1) && (v == (int)tri[1])))
+                continue;
+            new_cache[n_new++] = v;
+        }
+        for (int i = 0; i < n_cache; i++) {
+            int v = cache[i];
+            if ((v != (int)tri[0]) && (v != (int)tri[1]) &&
+                (v != (int)tri[2]))
+                new_cache[n_new++] = v;
+        }
+
+        // rescore everything that moved, including what fell out
+        for (int i = 0; i < n_new; i++) {
+            int v = new_cache[i];
+            position[v] = (i < OPTIMIZER_CACHE_SIZE) ? i : -1;
+            float score =
+                vertex_score(cache_table, valence_table, position[v], live[v]);
+            float delta = score - vscore[v];
+            vscore[v] = score;
+            const int* list = adjacency + offsets[v];
+            for (int j = 0; j < live[v]; j++) {
+                tscore[list[j]] += delta;
+            }
+        }
+        n_cache = (n_new < OPTIMIZER_CACHE_SIZE) ? n_new : OPTIMIZER_CACHE_SIZE;
+        memcpy(cache, new_cache, sizeof(int) * n_cache);
+
+        best = -1;
+        float best_score = -1.0f;
+        for (int i = 0; i < n_cache; i++) {
+            int v = cache[i];
+            const int* list = adjacency + offsets[v];
+            for (int j = 0; j < live[v]; j++) {
+                if (tscore[list[j]] > best_score) {
+                    best_score = tscore[list[j]];
+                    best = list[j];
+                }
+            }
+        }
+    }
+
+    memcpy(indices, out, sizeof(unsigned int) * n_triangles * 3);
+    free(out);
+    free(emitted);
+    free(tscore);
+    free(vscore);
+    free(position);
+    free(adjacency);
+    free(offsets);
+    free(live);
+}
+
+/**
+ * @brief Simulates a triangle going through a FIFO cache.
+ * @param tri The three vertex indices.
+ * @param stamps Per vertex, the value of `*time` when it was last loaded.
+ * @param time Incremented on every miss.
+ * @param cache_size Number of vertices the cache holds.
+ * @return Number of vertices of the triangle that missed.
+ */
+static int cache_misses(const unsigned int* tri, unsigned int* stamps,
+                        unsigned int* time, int cache_size) {
+    LOG_FUNC_CALL();
+    int misses = 0;
+    for (int c = 0; c < 3; c++) {
+        unsigned int v = tri[c];
+        if (*time - stamps[v] > (unsigned int)cache_size) {
+            stamps[v] = (*time)++;
+            misses++;
+        }
+    }
+    return misses;
+}
+
+/**
+ * @brief Allocates the stamps and clock of a FIFO cache simulation, with
+ * every vertex out of the cache.
+ */
+static unsigned int* new_cache_stamps(int n_vertices, unsigned int* time,
+                                      int cache_size) {
+    LOG_FUNC_CALL();
+    unsigned int* stamps;
+    assert(stamps = (unsigned int*)malloc(sizeof(unsigned int) * n_vertices));
+    memset(stamps, 0, sizeof(unsigned int) * n_vertices);
+    *time = (unsigned int)cache_size + 1;
+    return stamps;
+}
+
+/**
+ * @brief Average cache miss ratio: vertex shader invocations per triangle
+ * with a FIFO post-transform cache. 3 is an unindexed mesh, and 0.5 is the
+ * best possible for a large regular grid.
+ * @param indices Triangle list.
+ * @param n_indices Number of indices (a multiple of 3).
+ * @param n_vertices Number of vertices the indices refer to.
+ * @param cache_size Number of vertices the cache holds (for example
+ * `RENDER_VERTEX_CACHE_SIZE`).
+ * @return The ACMR, or 0 if there are no triangles.
+ */
+float render_vertex_cache_acmr(const unsigned int* indices, int n_indices,
+                               int n_vertices, int cache_size) {
+    LOG_FUNC_CALL();
+    int n_triangles = n_indices / 3;
+    if (n_triangles == 0)
+        return 0.0f;
+    unsigned int time;
+    unsigned int* stamps = new_cache_stamps(n_vertices, &time, cache_size);
+    long long misses = 0;
+    for (int t = 0; t < n_triangles; t++) {
+        misses += cache_misses(indices + t * 3, stamps, &time, cache_size);
+    }
+    free(stamps);
+    return (float)misses / (float)n_triangles;
+}
+
+/**
+ * @brief Orders clusters by decreasing sort key.
+ */
+static int compare_clusters(const void* a, const void* b) {
+    LOG_FUNC_CALL();
+    float ka = ((const optimizerCluster*)a)->sort_key;
+    float kb = ((const optimizerCluster*)b)->sort_key;
+    return (ka < kb) - (ka > kb);
+}
+
+/**
+ * @brief Reorders triangles to reduce overdraw, keeping most of the vertex
+ * cache locality of their current order.
+ *
+ * Call this after `render_optimize_vertex_cache()`. The triangles are split
+ * into clusters where the cache restarts (hard boundaries), or where the
+ * running ACMR gets close to that of the cluster (soft boundaries). Clusters
+ * are then sorted so that the ones facing away from the center of the mesh,
+ * which are most likely to be in front, are drawn first.
+ * @param indices Triangle list, reordered in place.
+ * @param n_indices Number of indices (a multiple of 3).
+ * @param positions Vertex positions, 3 floats per vertex.
+ * @param n_vertices Number of vertices.
+ */
+void render_optimize_overdraw(unsigned int* indices, int n_indices,
+                              const float* positions, int n_vertices) {
+    LOG_FUNC_CALL();
+    int n_triangles = n_indices / 3;
+    if (n_triangles < 2)
+        return;
+
+    int* misses;
+    assert(misses = (int*)malloc(sizeof(int) * n_triangles));
+    unsigned int time;
+    unsigned int* stamps =
+        new_cache_stamps(n_vertices, &time, RENDER_VERTEX_CACHE_SIZE);
+    for (int t = 0; t < n_triangles; t++) {
+        misses[t] = cache_misses(indices + t * 3, stamps, &time,
+                                 RENDER_VERTEX_CACHE_SIZE);
+    }
+    free(stamps);
+
+    // at most one cluster per triangle
+    optimizerCluster* clusters;
+    assert(clusters = (optimizerCluster*)malloc(sizeof(optimizerCluster) *
+                                                n_triangles));
+    int n_clusters = 0;
+    int hard_start = 0;
+    while (hard_start < n_triangles) {
+        int hard_end = hard_start + 1;
+        int hard_misses = misses[hard_start];
+        while ((hard_end < n_triangles) && (misses[hard_end] < 3)) {
+            hard_misses += misses[hard_end++];
+        }
+        float threshold = OPTIMIZER_OVERDRAW_THRESHOLD * (float)hard_misses /
+                          (float)(hard_end - hard_start);
+
+        int start = hard_start;
+        int running = 0;
+        for (int t = hard_start; t < hard_end; t++) {
+            running += misses[t];
+            if ((t + 1 == hard_end) ||
+                ((float)running <= threshold * (float)(t + 1 - start))) {
+                clusters[n_clusters].start = start;
+                clusters[n_clusters].end = t + 1;
+                n_clusters++;
+                start = t + 1;
+                running = 0;
+            }
+        }
+        hard_start = hard_end;
+    }
+
+    // area weighted centroid of the mesh
+    float center[3] = {0, 0, 0};
+    float total_area = 0;
+    for (int t = 0; t < n_triangles; t++) {
+        const float* p0 = positions + indices[t * 3] * 3;
+        const float* p1 = positions + indices[t * 3 + 1] * 3;
+        const float* p2 = positions + indices[t * 3 + 2] * 3;
+        float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+        float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+        float n[3] = {e1[1] * e2[2] - e1[2] * e2[1],
+                      e1[2] * e2[0] - e1[0] * e2[2],
+                      e1[0] * e2[1] - e1[1] * e2[0]};
+        float area = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        for (int a = 0; a < 3; a++) {
+            center[a] += area * (p0[a] + p1[a] + p2[a]) / 3.0f;
+        }
+        total_area += area;
+    }
+    if (total_area > 0) {
+        for (int a = 0; a < 3; a++) {
+            center[a] /= total_area;
+        }
+    }
+
+    for (int c = 0; c < n_clusters; c++) {
+        float centroid[3] = {0, 0, 0};
+        float normal[3] = {0, 0, 0};
+        float area = 0;
+        for (int t = clusters[c].start; t < clusters[c].end; t++) {
+            const float* p0 = positions + indices[t * 3] * 3;
+            const float* p1 = positions + indices[t * 3 + 1] * 3;
+            const float* p2 = positions + indices[t * 3 + 2] * 3;
+            float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+            float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+            float n[3] = {e1[1] * e2[2] - e1[2] * e2[1],
+                          e1[2] * e2[0] - e1[0] * e2[2],
+                          e1[0] * e2[1] - e1[1] * e2[0]};
+            float w = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (int a = 0; a < 3; a++) {
+                centroid[a] += w * (p0[a] + p1[a] + p2[a]) / 3.0f;
+                normal[a] += n[a];
+            }
+            area += w;
+        }
+        float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] +
+                             normal[2] * normal[2]);
+        float key = 0;
+        if ((area > 0) && (length > 0)) {
+            for (int a = 0; a < 3; a++) {
+                key += (centroid[a] / area - center[a]) * normal[a] / length;
+            }
+        }
+        clusters[c].sort_key = key;
+    }
+
+    qsort(clusters, n_clusters, sizeof(optimizerCluster), compare_clusters);
+
+    unsigned int* out;
+    assert(out = (unsigned int*)malloc(sizeof(unsigned int) * n_triangles * 3));
+    int k = 0;
+    for (int c = 0; c < n_clusters; c++) {
+        int n = (clusters[c].end - clusters[c].start) * 3;
+        memcpy(out + k, indices + clusters[c].start * 3,
+               sizeof(unsigned int) * n);
+        k += n;
+    }
+    memcpy(indices, out, sizeof(unsigned int) * n_triangles * 3);
+
+    free(out);
+    free(clusters);
+    free(misses);
+}
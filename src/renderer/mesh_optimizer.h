@@ -0,0 +1,28 @@
+/**
+ * @file mesh_optimizer.h
+ **/
+
+#ifndef _FLUX_RENDERER_MESH_OPTIMIZER_H_
+#define _FLUX_RENDERER_MESH_OPTIMIZER_H_
+
+/** @addtogroup group1 Renderer API
+ *  @{
+ */
+
+/** Size of the FIFO post-transform cache used to report ACMR. Typical of
+ * desktop GPUs, and what most tools report against.
+ */
+#define RENDER_VERTEX_CACHE_SIZE 16
+
+void render_optimize_vertex_cache(unsigned int* indices, int n_indices,
+                                  int n_vertices);
+
+void render_optimize_overdraw(unsigned int* indices, int n_indices,
+                              const float* positions, int n_vertices);
+
+float render_vertex_cache_acmr(const unsigned int* indices, int n_indices,
+                               int n_vertices, int cache_size);
+
+/** @} */ // end of group1
+
+#endif
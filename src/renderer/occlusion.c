@@ -0,0 +1,531 @@
+/**
+ * @file occlusion.c
+ * @brief Software occlusion culling against a low resolution CPU depth
+ * buffer, in the spirit of Masked Occlusion Culling. This module only does
+ * CPU work (no raylib/GL calls), so it can be tested and benchmarked without
+ * a window.
+ *
+ * A few large occluders are rasterized into a small depth buffer, 8 pixels
+ * per instruction with AVX, 4 with SSE, with a scalar fallback. A pixel is
+ * covered by a triangle if its center is, and gets the farthest depth the
+ * triangle has inside the pixel. The buffer is then reduced into a
+ * hierarchical-Z pyramid of maximum depths, and the screen space rectangle of
+ * a box is tested against the level where it covers at most 2x2 texels.
+ *
+ * Depths are conservative, coverage is not: as with any sample based
+ * rasterizer, an occluder may cover up to half a pixel more than its exact
+ * outline. At the default resolution that is well below what shows up on
+ * screen.
+ **/
+
+#include "occlusion.h"
+#include "hqtools/hqtools.h"
+#include "raymath.h"
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define FLUX_OCCLUSION_AVX
+#elif defined(__SSE__) || defined(_M_X64) ||                                  \
+    (defined(_M_IX86_FP) && (_M_IX86_FP >= 1))
+#include <xmmintrin.h>
+#define FLUX_OCCLUSION_SSE
+#endif
+
+/** Widths of the depth buffer are rounded up to a multiple of this. */
+#define OCCLUSION_ALIGN 8
+
+/**
+ * @brief Smallest clip space w of a projected point. Triangles with a vertex
+ * closer to the eye plane are not rasterized, and boxes with such a corner are
+ * reported visible.
+ */
+#define OCCLUSION_MIN_W 1e-4f
+
+/**
+ * @struct occlusionVertex
+ * @brief A vertex in screen space: pixel coordinates and depth in `[0, 1]`.
+ */
+typedef struct occlusionVertex {
+    float x;
+    float y;
+    float z;
+} occlusionVertex;
+
+/**
+ * @brief Minimum of two floats (`fminf` is a libm call unless NaNs are ruled
+ * out, this compiles to a single instruction).
+ */
+static inline float min_f(float a, float b) { return a < b ? a : b; }
+
+/**
+ * @brief Maximum of two floats, see `min_f()`.
+ */
+static inline float max_f(float a, float b) { return a > b ? a : b; }
+
+/**
+ * @brief Allocates the depth buffer and its pyramid.
+ * @param buffer Buffer to initialize.
+ * @param width Width in pixels, rounded up to a multiple of 8.
+ * @param height Height in pixels.
+ */
+void render_occlusion_init(renderOcclusionBuffer* buffer, int width,
+                           int height) {
+    LOG_FUNC_CALL();
+    assert(buffer);
+    assert((width > 0) && (height > 0));
+    width = (width + OCCLUSION_ALIGN - 1) / OCCLUSION_ALIGN * OCCLUSION_ALIGN;
+    buffer->width = width;
+    buffer->height = height;
+    buffer->vp = MatrixIdentity();
+    buffer->n_levels = 0;
+    buffer->occluder_triangles = 0;
+    for (int i = 0; i < RENDER_OCCLUSION_MAX_LEVELS; i++) {
+        buffer->level_width[i] = 0;
+        buffer->level_height[i] = 0;
+        buffer->levels[i] = NULL;
+    }
+    int w = width;
+    int h = height;
+    for (int i = 0; i < RENDER_OCCLUSION_MAX_LEVELS; i++) {
+        buffer->level_width[i] = w;
+        buffer->level_height[i] = h;
+        assert(buffer->levels[i] =
+                   (float*)malloc(sizeof(float) * (size_t)w * (size_t)h));
+        if ((w == 1) && (h == 1))
+            break;
+        w = (w + 1) / 2;
+        h = (h + 1) / 2;
+    }
+}
+
+/**
+ * @brief Frees the depth buffer and its pyramid.
+ * @param buffer Buffer to free.
+ */
+void render_occlusion_free(renderOcclusionBuffer* buffer) {
+    LOG_FUNC_CALL();
+    assert(buffer);
+    for (int i = 0; i < RENDER_OCCLUSION_MAX_LEVELS; i++) {
+        if (buffer->levels[i])
+            free(buffer->levels[i]);
+        buffer->levels[i] = NULL;
+    }
+    buffer->width = 0;
+    buffer->height = 0;
+    buffer->n_levels = 0;
+}
+
+/**
+ * @brief Clears the depth buffer (no occluders) and sets the view-projection
+ * matrix for the frame. The pyramid is empty (every box is visible) until
+ * `render_occlusion_build_hiz()`.
+ * @param buffer Buffer to clear.
+ * @param vp `MatrixMultiply(view, projection)` of the camera.
+ */
+void render_occlusion_begin(renderOcclusionBuffer* buffer, Matrix vp) {
+    LOG_FUNC_CALL();
+    assert(buffer);
+    assert(buffer->levels[0]);
+    buffer->vp = vp;
+    buffer->n_levels = 0;
+    buffer->occluder_triangles = 0;
+    float* depth = buffer->levels[0];
+    for (int i = 0; i < buffer->width * buffer->height; i++) {
+        depth[i] = 1.0f;
+    }
+}
+
+/**
+ * @brief Projects a point with a (column major) matrix.
+ * @return Clip space coordinates of the point.
+ */
+static Vector4 project(Matrix m, Vector3 p) {
+    LOG_FUNC_CALL();
+    return (Vector4){m.m0 * p.x + m.m4 * p.y + m.m8 * p.z + m.m12,
+                     m.m1 * p.x + m.m5 * p.y + m.m9 * p.z + m.m13,
+                     m.m2 * p.x + m.m6 * p.y + m.m10 * p.z + m.m14,
+                     m.m3 * p.x + m.m7 * p.y + m.m11 * p.z + m.m15};
+}
+
+/**
+ * @brief Converts clip space coordinates to screen space.
+ * @param buffer Buffer the screen belongs to.
+ * @param clip Clip space point.
+ * @param out Screen space point.
+ * @return False if the point is too close to (or behind) the eye.
+ */
+static bool to_screen(const renderOcclusionBuffer* buffer, Vector4 clip,
+                      occlusionVertex* out) {
+    LOG_FUNC_CALL();
+    if (clip.w < OCCLUSION_MIN_W)
+        return false;
+    float inv_w = 1.0f / clip.w;
+    out->x = (clip.x * inv_w * 0.5f + 0.5f) * (float)buffer->width;
+    out->y = (clip.y * inv_w * 0.5f + 0.5f) * (float)buffer->height;
+    out->z = clip.z * inv_w * 0.5f + 0.5f;
+    return true;
+}
+
+/**
+ * @brief Edge function `a * x + b * y + c` of a triangle edge, positive inside
+ * a counter clockwise triangle.
+ */
+typedef struct occlusionEdge {
+    float a;
+    float b;
+    float c;
+} occlusionEdge;
+
+/**
+ * @brief Sets up the edge function of the edge from `v0` to `v1`.
+ */
+static occlusionEdge make_edge(occlusionVertex v0, occlusionVertex v1) {
+    LOG_FUNC_CALL();
+    occlusionEdge e;
+    e.a = v0.y - v1.y;
+    e.b = v1.x - v0.x;
+    e.c = -(e.a * v0.x + e.b * v0.y);
+    return e;
+}
+
+/**
+ * @brief Rasterizes a screen space triangle into the depth buffer.
+ */
+static void rasterize_triangle(renderOcclusionBuffer* buffer,
+                               occlusionVertex v0, occlusionVertex v1,
+                               occlusionVertex v2) {
+    LOG_FUNC_CALL();
+    float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+    if (area == 0.0f)
+        return;
+    if (area < 0.0f) {
+        occlusionVertex tmp = v1;
+        v1 = v2;
+        v2 = tmp;
+        area = -area;
+    }
+
+    int x0 = (int)floorf(min_f(v0.x, min_f(v1.x, v2.x)));
+    int x1 = (int)ceilf(max_f(v0.x, max_f(v1.x, v2.x))) - 1;
+    int y0 = (int)floorf(min_f(v0.y, min_f(v1.y, v2.y)));
+    int y1 = (int)ceilf(max_f(v0.y, max_f(v1.y, v2.y))) - 1;
+    if (x0 < 0)
+        x0 = 0;
+    if (y0 < 0)
+        y0 = 0;
+    if (x1 > buffer->width - 1)
+        x1 = buffer->width - 1;
+    if (y1 > buffer->height - 1)
+        y1 = buffer->height - 1;
+    if ((x0 > x1) || (y0 > y1))
+        return;
+    buffer->occluder_triangles++;
+
+    occlusionEdge e0 = make_edge(v1, v2);
+    occlusionEdge e1 = make_edge(v2, v0);
+    occlusionEdge e2 = make_edge(v0, v1);
+
+    // depth plane z = dzdx * x + dzdy * y + zc, pushed to the farthest depth
+    // inside each pixel and never beyond the farthest vertex
+    float dzdx =
+        ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+    float dzdy =
+        ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+    float zc = v0.z - dzdx * v0.x - dzdy * v0.y +
+               0.5f * (fabsf(dzdx) + fabsf(dzdy));
+    float z_max = max_f(v0.z, max_f(v1.z, v2.z));
+
+    float* depth = buffer->levels[0];
+    int width = buffer->width;
+
+#if defined(FLUX_OCCLUSION_AVX)
+    x0 &= ~7;
+    __m256 lane = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f,
+                                 7.5f);
+    __m256 zero = _mm256_setzero_ps();
+    __m256 a0 = _mm256_set1_ps(e0.a);
+    __m256 a1 = _mm256_set1_ps(e1.a);
+    __m256 a2 = _mm256_set1_ps(e2.a);
+    __m256 dx = _mm256_set1_ps(dzdx);
+    __m256 zm = _mm256_set1_ps(z_max);
+    for (int y = y0; y <= y1; y++) {
+        float cy = (float)y + 0.5f;
+        __m256 r0 = _mm256_set1_ps(e0.b * cy + e0.c);
+        __m256 r1 = _mm256_set1_ps(e1.b * cy + e1.c);
+        __m256 r2 = _mm256_set1_ps(e2.b * cy + e2.c);
+        __m256 rz = _mm256_set1_ps(dzdy * cy + zc);
+        float* row = depth + y * width;
+        for (int x = x0; x <= x1; x += 8) {
+            __m256 px = _mm256_add_ps(_mm256_set1_ps((float)x), lane);
+            __m256 inside = _mm256_and_ps(
+                _mm256_and_ps(
+                    _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(a0, px), r0),
+                                  zero, _CMP_GE_OQ),
+                    _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(a1, px), r1),
+                                  zero, _CMP_GE_OQ)),
+                _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(a2, px), r2), zero,
+                              _CMP_GE_OQ));
+            if (!_mm256_movemask_ps(inside))
+                continue;
+            __m256 z =
+                _mm256_min_ps(_mm256_add_ps(_mm256_mul_ps(dx, px), rz), zm);
+            __m256 old = _mm256_loadu_ps(row + x);
+            __m256 nearest = _mm256_min_ps(old, z);
+            _mm256_storeu_ps(row + x, _mm256_blendv_ps(old, nearest, inside));
+        }
+    }
+#elif defined(FLUX_OCCLUSION_SSE)
+    x0 &= ~3;
+    __m128 lane = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    __m128 zero = _mm_setzero_ps();
+    __m128 a0 = _mm_set1_ps(e0.a);
+    __m128 a1 = _mm_set1_ps(e1.a);
+    __m128 a2 = _mm_set1_ps(e2.a);
+    __m128 dx = _mm_set1_ps(dzdx);
+    __m128 zm = _mm_set1_ps(z_max);
+    for (int y = y0; y <= y1; y++) {
+        float cy = (float)y + 0.5f;
+        __m128 r0 = _mm_set1_ps(e0.b * cy + e0.c);
+        __m128 r1 = _mm_set1_ps(e1.b * cy + e1.c);
+        __m128 r2 = _mm_set1_ps(e2.b * cy + e2.c);
+        __m128 rz = _mm_set1_ps(dzdy * cy + zc);
+        float* row = depth + y * width;
+        for (int x = x0; x <= x1; x += 4) {
+            __m128 px = _mm_add_ps(_mm_set1_ps((float)x), lane);
+            __m128 inside = _mm_and_ps(
+                _mm_and_ps(
+                    _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, px), r0), zero),
+                    _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, px), r1), zero)),
+                _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, px), r2), zero));
+            if (!_mm_movemask_ps(inside))
+                continue;
+            __m128 z = _mm_min_ps(_mm_add_ps(_mm_mul_ps(dx, px), rz), zm);
+            __m128 old = _mm_loadu_ps(row + x);
+            __m128 nearest = _mm_min_ps(old, z);
+            _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest),
+                                             _mm_andnot_ps(inside, old)));
+        }
+    }
+#else
+    for (int y = y0; y <= y1; y++) {
+        float cy = (float)y + 0.5f;
+        float* row = depth + y * width;
+        for (int x = x0; x <= x1; x++) {
+            float cx = (float)x + 0.5f;
+            if ((e0.a * cx + e0.b * cy + e0.c < 0.0f) ||
+                (e1.a * cx + e1.b * cy + e1.c < 0.0f) ||
+                (e2.a * cx + e2.b * cy + e2.c < 0.0f))
+                continue;
+            float z = min_f(dzdx * cx + dzdy * cy + zc, z_max);
+            if (z < row[x])
+                row[x] = z;
+        }
+    }
+#endif
+}
+
+/**
+ * @brief Rasterizes occluder triangles into the depth buffer.
+ *
+ * Triangles that are partly behind the eye are skipped (which only makes the
+ * occluder smaller), back faces are rasterized like front faces.
+ * @param buffer Buffer to rasterize into, after `render_occlusion_begin()`.
+ * @param vertices Vertex positions (3 floats per vertex).
+ * @param indices 3 indices per triangle, or NULL if every 3 consecutive
+ * vertices form a triangle.
+ * @param n_triangles Number of triangles.
+ * @param transform Model matrix of the occluder.
+ */
+void render_occlusion_rasterize(renderOcclusionBuffer* buffer,
+                                const float* vertices,
+                                const unsigned short* indices,
+                                int n_triangles, Matrix transform) {
+    LOG_FUNC_CALL();
+    assert(buffer);
+    assert(vertices);
+    Matrix mvp = MatrixMultiply(transform, buffer->vp);
+    for (int t = 0; t < n_triangles; t++) {
+        occlusionVertex v[3];
+        bool in_front = true;
+        for (int j = 0; j < 3; j++) {
+            int index = indices ? indices[t * 3 + j] : t * 3 + j;
+            const float* p = vertices + index * 3;
+            Vector4 clip = project(mvp, (Vector3){p[0], p[1], p[2]});
+            if (!to_screen(buffer, clip, &v[j])) {
+                in_front = false;
+                break;
+            }
+        }
+        if (in_front)
+            rasterize_triangle(buffer, v[0], v[1], v[2]);
+    }
+}
+
+/**
+ * @brief Rasterizes every triangle of a raylib mesh into the depth buffer.
+ * @param buffer Buffer to rasterize into, after `render_occlusion_begin()`.
+ * @param mesh Occluder mesh, must have CPU side vertices.
+ * @param transform Model matrix of the occluder.
+ */
+void render_occlusion_rasterize_mesh(renderOcclusionBuffer* buffer, Mesh mesh,
+                                     Matrix transform) {
+    LOG_FUNC_CALL();
+    if (!mesh.vertices)
+        return;
+    int n_triangles = mesh.indices ? mesh.triangleCount : mesh.vertexCount / 3;
+    render_occlusion_rasterize(buffer, mesh.vertices, mesh.indices,
+                               n_triangles, transform);
+}
+
+/**
+ * @brief Builds the hierarchical-Z pyramid from the depth buffer. Must be
+ * called after the last occluder and before testing boxes.
+ * @param buffer Buffer to build the pyramid of.
+ */
+void render_occlusion_build_hiz(renderOcclusionBuffer* buffer) {
+    LOG_FUNC_CALL();
+    assert(buffer);
+    int level = 0;
+    while ((level + 1 < RENDER_OCCLUSION_MAX_LEVELS) &&
+           buffer->levels[level + 1]) {
+        const float* src = buffer->levels[level];
+        float* dst = buffer->levels[level + 1];
+        int sw = buffer->level_width[level];
+        int sh = buffer->level_height[level];
+        int dw = buffer->level_width[level + 1];
+        int dh = buffer->level_height[level + 1];
+        for (int y = 0; y < dh; y++) {
+            int sy0 = 2 * y;
+            int sy1 = (sy0 + 1 < sh) ? sy0 + 1 : sy0;
+            for (int x = 0; x < dw; x++) {
+                int sx0 = 2 * x;
+                int sx1 = (sx0 + 1 < sw) ? sx0 + 1 : sx0;
+                const float* r0 = src + sy0 * sw;
+                const float* r1 = src + sy1 * sw;
+                dst[y * dw + x] = max_f(max_f(r0[sx0], r0[sx1]),
+                                        max_f(r1[sx0], r1[sx1]));
+            }
+        }
+        level++;
+    }
+    buffer->n_levels = level + 1;
+}
+
+/**
+ * @brief Tests whether an axis aligned box may be visible behind the
+ * occluders.
+ * @param buffer Buffer to test against, after `render_occlusion_build_hiz()`.
+ * @param min Minimum corner of the world space box.
+ * @param max Maximum corner of the world space box.
+ * @return False only if the box is hidden by the occluders. Boxes that cross
+ * the eye plane or are off screen are reported visible.
+ */
+bool render_occlusion_test_aabb(const renderOcclusionBuffer* buffer,
+                                Vector3 min, Vector3 max) {
+    LOG_FUNC_CALL();
+    if (buffer->n_levels == 0)
+        return true;
+    float sx0 = FLT_MAX;
+    float sy0 = FLT_MAX;
+    float sx1 = -FLT_MAX;
+    float sy1 = -FLT_MAX;
+    float z_min = FLT_MAX;
+    // clip coordinates of the corners are sums of one term per axis
+    Matrix m = buffer->vp;
+    Vector4 xs[2] = {{m.m0 * min.x, m.m1 * min.x, m.m2 * min.x, m.m3 * min.x},
+                     {m.m0 * max.x, m.m1 * max.x, m.m2 * max.x, m.m3 * max.x}};
+    Vector4 ys[2] = {{m.m4 * min.y, m.m5 * min.y, m.m6 * min.y, m.m7 * min.y},
+                     {m.m4 * max.y, m.m5 * max.y, m.m6 * max.y, m.m7 * max.y}};
+    Vector4 zs[2] = {
+        {m.m8 * min.z + m.m12, m.m9 * min.z + m.m13, m.m10 * min.z + m.m14,
+         m.m11 * min.z + m.m15},
+        {m.m8 * max.z + m.m12, m.m9 * max.z + m.m13, m.m10 * max.z + m.m14,
+         m.m11 * max.z + m.m15}};
+    for (int c = 0; c < 8; c++) {
+        Vector4 x = xs[c & 1];
+        Vector4 y = ys[(c >> 1) & 1];
+        Vector4 z = zs[(c >> 2) & 1];
+        Vector4 clip = {x.x + y.x + z.x, x.y + y.y + z.y, x.z + y.z + z.z,
+                        x.w + y.w + z.w};
+        occlusionVertex v;
+        if (!to_screen(buffer, clip, &v))
+            return true;
+        sx0 = min_f(sx0, v.x);
+        sy0 = min_f(sy0, v.y);
+        sx1 = max_f(sx1, v.x);
+        sy1 = max_f(sy1, v.y);
+        z_min = min_f(z_min, v.z);
+    }
+    if ((sx1 < 0.0f) || (sy1 < 0.0f) || (sx0 >= (float)buffer->width) ||
+        (sy0 >= (float)buffer->height))
+        return true;
+
+    int x0 = sx0 < 0.0f ? 0 : (int)sx0;
+    int y0 = sy0 < 0.0f ? 0 : (int)sy0;
+    int x1 = sx1 >= (float)buffer->width ? buffer->width - 1 : (int)sx1;
+    int y1 = sy1 >= (float)buffer->height ? buffer->height - 1 : (int)sy1;
+
+    // coarsest level where the rectangle covers at most 2x2 texels
+    int level = 0;
+    while ((level + 1 < buffer->n_levels) &&
+           (((x1 >> level) - (x0 >> level) > 1) ||
+            ((y1 >> level) - (y0 >> level) > 1)))
+        level++;
+
+    const float* depth = buffer->levels[level];
+    int w = buffer->level_width[level];
+    for (int y = y0 >> level; y <= y1 >> level; y++) {
+        for (int x = x0 >> level; x <= x1 >> level; x++) {
+            if (z_min <= depth[y * w + x])
+                return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Removes the occluded boxes from a list of (frustum visible) boxes.
+ *
+ * Only reads the buffer, so several threads may cull against it at once.
+ * @param buffer Buffer to test against, after `render_occlusion_build_hiz()`.
+ * @param bounds Boxes to test.
+ * @param visible Indices into `bounds` of the boxes to test, compacted in
+ * place to the boxes that may be visible (in the same order).
+ * @param n_visible Number of indices in `visible`.
+ * @return Number of indices left in `visible`.
+ */
+int render_occlusion_cull(const renderOcclusionBuffer* buffer,
+                          const renderBounds* bounds, int* visible,
+                          int n_visible) {
+    LOG_FUNC_CALL();
+    assert(buffer);
+    assert(bounds);
+    int n = 0;
+    for (int j = 0; j < n_visible; j++) {
+        int k = visible[j];
+        Vector3 min = {bounds->min_x[k], bounds->min_y[k], bounds->min_z[k]};
+        Vector3 max = {bounds->max_x[k], bounds->max_y[k], bounds->max_z[k]};
+        if (render_occlusion_test_aabb(buffer, min, max))
+            visible[n++] = k;
+    }
+    return n;
+}
+
+/**
+ * @brief Returns the name of the instruction set used to rasterize occluders.
+ * @return "avx", "sse" or "scalar".
+ */
+const char* render_occlusion_simd_name(void) {
+    LOG_FUNC_CALL();
+#if defined(FLUX_OCCLUSION_AVX)
+    return "avx";
+#elif defined(FLUX_OCCLUSION_SSE)
+    return "sse";
+#else
+    return "scalar";
+#endif
+}
@@ -0,0 +1,80 @@
+/**
+ * @file occlusion.h
+ **/
+
+#ifndef _FLUX_RENDERER_OCCLUSION_H_
+#define _FLUX_RENDERER_OCCLUSION_H_
+
+#include "frustum.h"
+#include "raylib.h"
+#include <stdbool.h>
+
+/** @addtogroup group1 Renderer API
+ *  @{
+ */
+
+/** Maximum number of levels of the hierarchical depth pyramid. */
+#define RENDER_OCCLUSION_MAX_LEVELS 16
+
+/**
+ * @struct renderOcclusionBuffer
+ * @brief A low resolution CPU depth buffer that occluders are rasterized into,
+ * and its hierarchical-Z pyramid that boxes are tested against.
+ *
+ * Depths are in `[0, 1]` (0 at the near plane). Level 0 holds, per pixel, the
+ * depth of the nearest occluder that fully covers the pixel (1 if there is
+ * none). Every other level holds the maximum of the 2x2 texels below it.
+ *
+ * @var int width Width of level 0 in pixels (a multiple of 4).
+ * @var int height Height of level 0 in pixels.
+ * @var Matrix vp View-projection matrix occluders and boxes are projected
+ * with.
+ * @var int n_levels Number of levels of the pyramid, after
+ * `render_occlusion_build_hiz()`.
+ * @var int level_width Width of each level.
+ * @var int level_height Height of each level.
+ * @var float* levels Depths of each level, row by row. `levels[0]` is the
+ * depth buffer.
+ * @var int occluder_triangles Number of triangles rasterized since
+ * `render_occlusion_begin()`.
+ */
+typedef struct renderOcclusionBuffer {
+    int width;
+    int height;
+    Matrix vp;
+    int n_levels;
+    int level_width[RENDER_OCCLUSION_MAX_LEVELS];
+    int level_height[RENDER_OCCLUSION_MAX_LEVELS];
+    float* levels[RENDER_OCCLUSION_MAX_LEVELS];
+    int occluder_triangles;
+} renderOcclusionBuffer;
+
+void render_occlusion_init(renderOcclusionBuffer* buffer, int width,
+                           int height);
+
+void render_occlusion_free(renderOcclusionBuffer* buffer);
+
+void render_occlusion_begin(renderOcclusionBuffer* buffer, Matrix vp);
+
+void render_occlusion_rasterize(renderOcclusionBuffer* buffer,
+                                const float* vertices,
+                                const unsigned short* indices,
+                                int n_triangles, Matrix transform);
+
+void render_occlusion_rasterize_mesh(renderOcclusionBuffer* buffer, Mesh mesh,
+                                     Matrix transform);
+
+void render_occlusion_build_hiz(renderOcclusionBuffer* buffer);
+
+bool render_occlusion_test_aabb(const renderOcclusionBuffer* buffer,
+                                Vector3 min, Vector3 max);
+
+int render_occlusion_cull(const renderOcclusionBuffer* buffer,
+                          const renderBounds* bounds, int* visible,
+                          int n_visible);
+
+const char* render_occlusion_simd_name(void);
+
+/** @} */ // end of group1
+
+#endif
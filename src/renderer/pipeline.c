@@ -9,15 +9,25 @@
  **/
 
 #include "pipeline.h"
+#include "asset_registry.h"
+#include "asset_stream.h"
+#include "frustum.h"
 #include "hqtools/hqtools.h"
+#include "job_pool.h"
+#include "mesh_cache.h"
+#include "occlusion.h"
 #include "raylib.h"
 #include "raymath.h"
+#include "render_queue.h"
 #include "rlgl.h"
 #include "shader_manager.h"
+#include "simplify.h"
 #include "transform.h"
 #include <assert.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 /**
  * @brief Converts a Vector3 to an array format, typically for OpenGL
@@ -27,40 +37,27 @@
 #define Vec32Array(vec)                                                        \
     { vec.x, vec.y, vec.z }
 
+#ifndef MAX_MATERIAL_MAPS
+/** Number of maps of a raylib material (see raylib's config.h). */
+#define MAX_MATERIAL_MAPS 12
+#endif
+
 // Current camera view in the 3D scene, typically updated per frame or on event.
 static Camera3D current_camera;
 
 /**
- * @struct render_object
- * @brief Represents a 3D object including its model data and transformation
- * attributes.
+ * @struct renderTintVariant
+ * @brief The materials of a model with a tint applied to their diffuse
+ * colors.
  *
- * @var Model model
- * @var Vector3 pos Position vector.
- * @var Vector3 scale Scaling vector.
- * @var Color tint Color tinting.
- * @var Vector3 rotation_axis Axis of rotation.
- * @var float rotation_amount Amount of rotation.
- * @var Matrix transform Transformation matrix applied to the object.
- */
-struct render_object {
-    Model model;
-    Vector3 pos;
-    Vector3 scale;
-    Color tint;
-    Vector3 rotation_axis;
-    float rotation_amount;
-    Matrix transform;
-};
-
-/**
- * @typedef betterBBox
- * @brief Enhanced bounding box structure with eight corners defined in 4D
- * space.
+ * @var Color tint Tint of this variant.
+ * @var Material* materials One tinted copy of each material of the model
+ * (sharing its textures and shader), or the model's own materials for `WHITE`.
  */
-typedef struct betterBBox {
-    Vector4 c1, c2, c3, c4, c5, c6, c7, c8;
-} betterBBox;
+typedef struct renderTintVariant {
+    Color tint;
+    Material* materials;
+} renderTintVariant;
 
 /**
  * @struct renderModelInternal
@@ -69,183 +66,132 @@ typedef struct betterBBox {
  *
  * @var Model model
  * @var int n_instances Number of instances of the model.
- * @var Color tint Color tint applied to all instances.
- * @var Matrix transforms Array of transformation matrices for each instance.
- * @var betterBBox* mesh_bounding_boxes Pointer to bounding boxes for each mesh
- * in the model.
+ * @var int instance_capacity Number of instances `transforms` and
+ * `instance_bounds` can hold. Grows on demand and is kept across frames.
+ * @var renderTintVariant* tint_variants Tinted materials, made the first time
+ * the model is registered with a tint and kept until the model is freed.
+ * @var int n_tint_variants Number of tint variants.
+ * @var int tint_variants_size Allocated size of `tint_variants`.
+ * @var Matrix* transforms Array of transformation matrices for each instance.
+ * @var BoundingBox* mesh_bounding_boxes Pointer to the (model space) bounding
+ * boxes of each mesh in the model.
+ * @var renderBounds* instance_bounds Per mesh, the world space bounds of every
+ * instance, computed once in `render_add_model_instance()` and shared by all
+ * passes.
+ * @var unsigned long long instance_hash Hash of the instance transforms added
+ * since the last `render_reset_instances()`.
+ * @var bool occluder Whether the visible instances of the model are
+ * rasterized into the occlusion buffer (see `render_model_set_occluder()`).
+ * @var int* n_lods Per mesh, number of levels of detail, including the mesh
+ * itself (1 if the mesh was not simplified).
+ * @var Mesh* lods Per mesh, `RENDER_MAX_LODS - 1` simplified meshes, of which
+ * the first `n_lods - 1` are used.
+ * @var bool owns_lods Whether `lods` were made for this model, or belong to
+ * its streamed model file (see `render_model_file_get_lods()`).
+ * @var bool has_lods Whether any mesh has more than one level of detail.
+ * @var float lod_bias Level of detail bias (see `render_model_set_lod_bias()`).
+ * @var float lod_scale `2^lod_bias`, applied to the projected size of
+ * instances.
+ * @var unsigned char* instance_lods Per mesh, the level of detail each
+ * instance slot was drawn with in the last main pass (`instance_capacity` per
+ * mesh), for hysteresis of the instances added without their own levels.
+ * Only allocated if `has_lods`.
+ * @var unsigned char** instance_lod_states Per instance, the caller owned
+ * levels of detail it was drawn with, one per mesh (see
+ * `render_add_model_instance_ex()`), or NULL to use its slot of
+ * `instance_lods`. Only allocated if `has_lods`.
  */
 typedef struct renderModelInternal {
     Model model;
     int n_instances;
-    Color tint;
-    Matrix transforms[RENDER_MAX_INSTANCES];
-    betterBBox* mesh_bounding_boxes;
+    int instance_capacity;
+    renderTintVariant* tint_variants;
+    int n_tint_variants;
+    int tint_variants_size;
+    Matrix* transforms;
+    BoundingBox* mesh_bounding_boxes;
+    renderBounds* instance_bounds;
+    unsigned long long instance_hash;
+    bool occluder;
+    int* n_lods;
+    Mesh* lods;
+    bool owns_lods;
+    bool has_lods;
+    float lod_bias;
+    float lod_scale;
+    unsigned char* instance_lods;
+    unsigned char** instance_lod_states;
 } renderModelInternal;
 
 /**
- * @brief Converts a Vector3 to a Vector4 by adding a w component set to 1.
- * @param vec Vector3 to convert.
- * @return Vector4 with added w component.
+ * @brief Mixes a 64 bit word into a running hash.
+ * @param hash Running hash.
+ * @param word Word to mix in.
+ * @return The updated hash.
  */
-static Vector4 Vector32Vector4(Vector3 vec) {
+static unsigned long long hash_mix(unsigned long long hash,
+                                   unsigned long long word) {
     LOG_FUNC_CALL();
-    Vector4 out;
-    out.x = vec.x;
-    out.y = vec.y;
-    out.z = vec.z;
-    out.w = 1;
-    return out;
+    hash = (hash ^ word) * 0x9E3779B97F4A7C15ULL;
+    return hash ^ (hash >> 29);
 }
 
 /**
- * @brief Converts a Vector4 back to a Vector3 by dropping the w component.
- * @param vec Vector4 to convert.
- * @return Vector3 resulting from dropping w.
+ * @brief Mixes the bits of a matrix into a running hash.
+ * @param hash Running hash.
+ * @param matrix Matrix to mix in.
+ * @return The updated hash.
  */
-static Vector3 Vector4toVector3(Vector4 vec) {
+static unsigned long long hash_matrix(unsigned long long hash,
+                                      Matrix matrix) {
     LOG_FUNC_CALL();
-    Vector3 out;
-    out.x = vec.x;
-    out.y = vec.y;
-    out.z = vec.z;
-    return out;
-}
-
-/**
- * @brief Converts a standard BoundingBox to a betterBBox format with corners
- * defined in 4D space.
- * @param bbox Standard BoundingBox to convert.
- * @return Converted betterBBox structure.
- */
-static betterBBox bbox2better(BoundingBox bbox) {
-    LOG_FUNC_CALL();
-    betterBBox out;
-    out.c1 = Vector32Vector4(bbox.min);
-    out.c2 = Vector32Vector4(bbox.min);
-    out.c2.z = bbox.max.z;
-    out.c3 = Vector32Vector4(bbox.min);
-    out.c3.x = bbox.max.x;
-    out.c4 = Vector32Vector4(bbox.min);
-    out.c4.y = bbox.max.y;
-    out.c5 = Vector32Vector4(bbox.min);
-    out.c5.x = bbox.max.x;
-    out.c5.z = bbox.max.z;
-    out.c6 = Vector32Vector4(bbox.min);
-    out.c6.y = bbox.max.y;
-    out.c6.z = bbox.max.z;
-    out.c7 = Vector32Vector4(bbox.min);
-    out.c7.y = bbox.max.y;
-    out.c7.x = bbox.max.x;
-    out.c8 = Vector32Vector4(bbox.max);
-    return out;
-}
-
-/**
- * @brief Transforms a Vector4 using a specified matrix.
- * @param v Vector4 to transform.
- * @param mat Matrix used for transformation.
- * @return Transformed Vector4.
- */
-static Vector4 Vector4Transform(Vector4 v, Matrix mat) {
-    LOG_FUNC_CALL();
-    Vector4 result = {0};
-
-    float x = v.x;
-    float y = v.y;
-    float z = v.z;
-    float w = v.w;
-
-    result.x = mat.m0 * x + mat.m4 * y + mat.m8 * z + mat.m12;
-    result.y = mat.m1 * x + mat.m5 * y + mat.m9 * z + mat.m13;
-    result.z = mat.m2 * x + mat.m6 * y + mat.m10 * z + mat.m14;
-    result.w = mat.m3 * x + mat.m7 * y + mat.m11 * z + mat.m15 * w;
-
-    return result;
-}
-
-/**
- * @brief Transforms a betterBBox using a specified matrix.
- * @param bbox betterBBox to transform.
- * @param transform Matrix used for transformation.
- * @return Transformed betterBBox.
- */
-static betterBBox bboxTransform(betterBBox bbox, Matrix transform) {
-    LOG_FUNC_CALL();
-    betterBBox out;
-    out.c1 = Vector4Transform(bbox.c1, transform);
-    out.c2 = Vector4Transform(bbox.c2, transform);
-    out.c3 = Vector4Transform(bbox.c3, transform);
-    out.c4 = Vector4Transform(bbox.c4, transform);
-    out.c5 = Vector4Transform(bbox.c5, transform);
-    out.c6 = Vector4Transform(bbox.c6, transform);
-    out.c7 = Vector4Transform(bbox.c7, transform);
-    out.c8 = Vector4Transform(bbox.c8, transform);
-    return out;
-}
-
-/**
- * @brief Draws a 3D bounding box in the scene.
- * @param bbox betterBBox to draw.
- */
-static void drawBBox(betterBBox bbox) {
-    LOG_FUNC_CALL();
-    DrawLine3D(Vector4toVector3(bbox.c1), Vector4toVector3(bbox.c2), GREEN);
-    DrawLine3D(Vector4toVector3(bbox.c1), Vector4toVector3(bbox.c3), GREEN);
-    DrawLine3D(Vector4toVector3(bbox.c1), Vector4toVector3(bbox.c4), GREEN);
-    DrawLine3D(Vector4toVector3(bbox.c8), Vector4toVector3(bbox.c5), GREEN);
-    DrawLine3D(Vector4toVector3(bbox.c8), Vector4toVector3(bbox.c6), GREEN);
-    DrawLine3D(Vector4toVector3(bbox.c8), Vector4toVector3(bbox.c7), GREEN);
-    DrawLine3D(Vector4toVector3(bbox.c5), Vector4toVector3(bbox.c3), GREEN);
-    DrawLine3D(Vector4toVector3(bbox.c5), Vector4toVector3(bbox.c2), GREEN);
-    DrawLine3D(Vector4toVector3(bbox.c6), Vector4toVector3(bbox.c4), GREEN);
-    DrawLine3D(Vector4toVector3(bbox.c6), Vector4toVector3(bbox.c2), GREEN);
-    DrawLine3D(Vector4toVector3(bbox.c7), Vector4toVector3(bbox.c4), GREEN);
-    DrawLine3D(Vector4toVector3(bbox.c7), Vector4toVector3(bbox.c3), GREEN);
+    unsigned long long words[sizeof(Matrix) / sizeof(unsigned long long)];
+    memcpy(words, &matrix, sizeof(Matrix));
+    for (int i = 0; i < (int)(sizeof(words) / sizeof(words[0])); i++) {
+        hash = hash_mix(hash, words[i]);
+    }
+    return hash;
 }
 
 /**
- * @brief Checks if any part of a bounding box is visible within the view.
- * @param bbox betterBBox to check for visibility.
- * @return True if visible, false otherwise.
+ * @var static int n_rmodels
+ * @brief Counter for the number of render models currently registered for
+ * rendering.
  */
-static bool bboxVisible(betterBBox bbox) {
-    LOG_FUNC_CALL();
-    Vector4* points = (Vector4*)&bbox;
-    bool out = false;
-    for (int i = 0; i < 8; i++) {
-        if (points[i].z <= 0)
-            return true;
-    }
-    return out;
-}
+static int n_rmodels = 0;
 
 /**
- * @var static int n_objects
- * @brief Counter for the number of render objects currently managed by the
- * pipeline.
+ * @struct renderRegistration
+ * @brief A render model registered for this frame, with the materials
+ * (tint variant) to draw it with.
+ *
+ * @var renderModel rmodel The registered model.
+ * @var const Material* materials Tinted materials of the model.
  */
-static int n_objects = 0;
+typedef struct renderRegistration {
+    renderModel rmodel;
+    const Material* materials;
+} renderRegistration;
 
 /**
- * @var static int n_rmodels
- * @brief Counter for the number of render models currently registered for
- * rendering.
+ * @var static renderRegistration* rmodels
+ * @brief Array of the render models registered for this frame. Grows on demand
+ * and is kept across frames.
  */
-static int n_rmodels = 0;
+static renderRegistration* rmodels = NULL;
 
 /**
- * @var static struct render_object objects[RENDERER_MAX_OBJECTS]
- * @brief Array of render objects, storing up to RENDERER_MAX_OBJECTS items for
- * rendering.
+ * @var static int rmodels_size
+ * @brief Allocated size of `rmodels`.
  */
-static struct render_object objects[RENDERER_MAX_OBJECTS];
+static int rmodels_size = 0;
 
 /**
- * @var static renderModel rmodels[RENDERER_MAX_OBJECTS]
- * @brief Array of render models, capable of storing up to RENDERER_MAX_OBJECTS
- * models for batch rendering.
+ * @var static size_t instance_memory
+ * @brief Bytes currently allocated by the renderer for per-instance data
+ * (instance transforms, instance bounds and per-pass scratch buffers).
  */
-static renderModel rmodels[RENDERER_MAX_OBJECTS];
+static size_t instance_memory = 0;
 
 /**
  * @var static Shader default_shader
@@ -279,27 +225,363 @@ static float spacing_grid;
  */
 static int visible_meshes = 0;
 
+/**
+ * @var static int draw_calls
+ * @brief Number of draw calls (`DrawMesh` + `DrawMeshInstanced`) issued since
+ * the last `render_begin()`, across the main and shadow passes.
+ */
+static int draw_calls = 0;
+
+/**
+ * @var static int instanced_draw_calls
+ * @brief Number of `DrawMeshInstanced` calls issued since the last
+ * `render_begin()`.
+ */
+static int instanced_draw_calls = 0;
+
+/**
+ * @var static int instancing_threshold
+ * @brief Meshes with at least this many visible instances in a pass are drawn
+ * with a single `DrawMeshInstanced`. Values `<= 0` disable instancing.
+ */
+static int instancing_threshold = RENDER_DEFAULT_INSTANCING_THRESHOLD;
+
+/**
+ * @var static Matrix* visible_transforms
+ * @brief Scratch buffer holding the transforms of the visible instances of the
+ * mesh currently being drawn (uploaded as the instance buffer).
+ */
+static Matrix* visible_transforms = NULL;
+
+/**
+ * @var static int visible_transforms_size
+ * @brief Allocated size (in instances) of `visible_transforms`.
+ */
+static int visible_transforms_size = 0;
+
+/**
+ * @var static int* visible_instances
+ * @brief Scratch buffer receiving the indices of the instances that pass the
+ * frustum test. Every culling job writes to its own slice.
+ */
+static int* visible_instances = NULL;
+
+/**
+ * @var static int visible_instances_size
+ * @brief Allocated size of `visible_instances`.
+ */
+static int visible_instances_size = 0;
+
+/**
+ * @var static long long corner_transforms_saved
+ * @brief Number of bounding box corner transforms skipped since the last
+ * `render_begin()` by reusing the cached instance bounds (the old per-pass
+ * test transformed all 8 corners twice, for every mesh of every instance).
+ */
+static long long corner_transforms_saved = 0;
+
+/**
+ * @var static long long triangles_drawn
+ * @brief Number of triangles submitted since the last `render_begin()`, across
+ * the main and shadow passes.
+ */
+static long long triangles_drawn = 0;
+
+/**
+ * @var static long long triangles_full
+ * @brief Number of triangles the same draws would have cost without levels of
+ * detail.
+ */
+static long long triangles_full = 0;
+
+/**
+ * @struct renderBatch
+ * @brief A model mesh with instances in the current pass. Queue items refer to
+ * their batch by index (stored in the sort key).
+ *
+ * @var renderModel rmodel Model the mesh belongs to.
+ * @var int mesh Index of the mesh in the model.
+ * @var int lod Level of detail drawn, 0 for the mesh itself. The levels of a
+ * mesh are consecutive batches, starting at level 0.
+ * @var const Material* material Tinted material of the mesh.
+ * @var unsigned int texture Id of the diffuse texture of the material.
+ * @var bool translucent Whether the tinted diffuse color has alpha < 255.
+ * @var int n_visible Number of instances that passed the frustum test.
+ */
+typedef struct renderBatch {
+    renderModel rmodel;
+    int mesh;
+    int lod;
+    const Material* material;
+    unsigned int texture;
+    bool translucent;
+    int n_visible;
+} renderBatch;
+
+/**
+ * @struct renderCullJob
+ * @brief A range of instances of a mesh, culled by one job of the cull pool.
+ *
+ * @var int batch Level 0 batch of the mesh the instances belong to.
+ * @var int start First instance of the range.
+ * @var int end One past the last instance of the range.
+ * @var int offset Start of the job's slice of `visible_instances` and of the
+ * render queue items.
+ * @var int n_visible Output, number of visible instances in the range.
+ * @var int n_lod Output, number of visible instances drawn with each level of
+ * detail.
+ * @var int n_occluded Output, number of instances in the range that passed
+ * the frustum test but were hidden by the occluders.
+ */
+typedef struct renderCullJob {
+    int batch;
+    int start;
+    int end;
+    int offset;
+    int n_visible;
+    int n_lod[RENDER_MAX_LODS];
+    int n_occluded;
+} renderCullJob;
+
+/**
+ * @struct renderCullPass
+ * @brief Data shared by all the culling jobs of a pass.
+ *
+ * @var const renderFrustum* frustum Frustum to cull against, or NULL.
+ * @var const renderOcclusionBuffer* occlusion Occluders to cull against, or
+ * NULL.
+ * @var Vector3 eye Position the depth of the instances is measured from.
+ * @var Vector3 lod_eye Position levels of detail are chosen from (the main
+ * camera's, in every pass, so shadows match what is seen).
+ * @var float lod_projection Projected size of an object of radius 1 at
+ * distance 1 (perspective), or of radius 1 (orthographic), relative to half
+ * the screen height.
+ * @var bool lod_orthographic Whether the main camera is orthographic.
+ * @var bool lod_update Whether the chosen levels are stored for hysteresis
+ * (main pass only).
+ */
+typedef struct renderCullPass {
+    const renderFrustum* frustum;
+    const renderOcclusionBuffer* occlusion;
+    Vector3 eye;
+    Vector3 lod_eye;
+    float lod_projection;
+    bool lod_orthographic;
+    bool lod_update;
+} renderCullPass;
+
+/**
+ * @var static fluxJobPool cull_pool
+ * @brief Worker threads used to cull instances and build the queue items.
+ */
+static fluxJobPool cull_pool = NULL;
+
+/**
+ * @var static int cull_threads
+ * @brief Number of threads `cull_pool` is created with (`<= 0` for one per
+ * core).
+ */
+static int cull_threads = 0;
+
+/**
+ * @var static renderCullJob* cull_jobs
+ * @brief Culling jobs of the current pass. Grows on demand and is kept across
+ * frames.
+ */
+static renderCullJob* cull_jobs = NULL;
+
+/**
+ * @var static int n_cull_jobs
+ * @brief Number of culling jobs in the current pass.
+ */
+static int n_cull_jobs = 0;
+
+/**
+ * @var static int cull_jobs_size
+ * @brief Allocated size of `cull_jobs`.
+ */
+static int cull_jobs_size = 0;
+
+/**
+ * @var static renderQueue queue
+ * @brief Draws of the current pass, sorted by state before submission.
+ */
+static renderQueue queue = {0};
+
+/**
+ * @var static renderBatch* batches
+ * @brief Batches of the current pass. Grows on demand and is kept across
+ * frames.
+ */
+static renderBatch* batches = NULL;
+
+/**
+ * @var static int n_batches
+ * @brief Number of batches in the current pass.
+ */
+static int n_batches = 0;
+
+/**
+ * @var static int batches_size
+ * @brief Allocated size of `batches`.
+ */
+static int batches_size = 0;
+
+/**
+ * @var static int queue_items
+ * @brief Number of render queue items submitted since the last
+ * `render_begin()`.
+ */
+static int queue_items = 0;
+
+/**
+ * @var static bool occlusion_enabled
+ * @brief Whether the main pass culls instances hidden by occluder models (see
+ * `render_set_occlusion()`).
+ */
+static bool occlusion_enabled = false;
+
+/**
+ * @var static renderOcclusionBuffer occlusion_buffer
+ * @brief CPU depth buffer the occluders of the main pass are rasterized into.
+ * Allocated the first time occlusion culling runs.
+ */
+static renderOcclusionBuffer occlusion_buffer;
+
+/**
+ * @var static int occluded_instances
+ * @brief Number of mesh instances that passed the frustum test but were
+ * hidden by occluders since the last `render_begin()`.
+ */
+static int occluded_instances = 0;
+
+/**
+ * @var static int shader_binds
+ * @brief Number of shader changes between submissions since the last
+ * `render_begin()`.
+ */
+static int shader_binds = 0;
+
+/**
+ * @var static int texture_binds
+ * @brief Number of diffuse texture changes between submissions since the last
+ * `render_begin()`.
+ */
+static int texture_binds = 0;
+
+/**
+ * @var static int unsorted_shader_binds
+ * @brief Number of shader changes the same draws would have cost in
+ * registration order (without the render queue).
+ */
+static int unsorted_shader_binds = 0;
+
+/**
+ * @var static int unsorted_texture_binds
+ * @brief Number of texture changes the same draws would have cost in
+ * registration order (without the render queue).
+ */
+static int unsorted_texture_binds = 0;
+
+/**
+ * @brief Generates the levels of detail of every mesh of a render model (see
+ * `render_simplify_lods()`).
+ *
+ * Models streamed in with `render_request_model()` were simplified on a
+ * streaming thread, and share the levels of their model file. Other models
+ * are simplified here, which takes a while for large meshes.
+ * @param rmodel Render model to generate the levels of.
+ * @param simplify If false, every mesh only gets level 0.
+ */
+static void make_lods(renderModel rmodel, bool simplify) {
+    LOG_FUNC_CALL();
+    Model model = rmodel->model;
+    assert(rmodel->n_lods = (int*)malloc(sizeof(int) * model.meshCount));
+    assert(rmodel->lods = (Mesh*)malloc(sizeof(Mesh) * model.meshCount *
+                                        (RENDER_MAX_LODS - 1)));
+    const int* file_n_lods = NULL;
+    const Mesh* file_lods =
+        simplify ? render_model_file_get_lods(model, &file_n_lods) : NULL;
+    rmodel->owns_lods = file_lods == NULL;
+    for (int i = 0; i < model.meshCount; i++) {
+        Mesh* lods = &rmodel->lods[i * (RENDER_MAX_LODS - 1)];
+        int n_lods = 1;
+        if (file_lods) {
+            n_lods = file_n_lods[i];
+            memcpy(lods, &file_lods[i * (RENDER_MAX_LODS - 1)],
+                   sizeof(Mesh) * (n_lods - 1));
+        } else if (simplify) {
+            n_lods = render_simplify_lods(model.meshes[i], lods);
+            for (int l = 1; l < n_lods; l++) {
+                UploadMesh(&lods[l - 1], false);
+                TraceLog(LOG_INFO, "mesh %d lod %d: %d -> %d triangles", i,
+                         l, model.meshes[i].triangleCount,
+                         lods[l - 1].triangleCount);
+            }
+        }
+        rmodel->n_lods[i] = n_lods;
+        if (n_lods > 1)
+            rmodel->has_lods = true;
+    }
+}
+
 /**
  * @brief Creates a new render model from a given model, initializing its
  * bounding boxes and setting instance count to zero.
+ *
+ * Meshes with enough triangles also get simplified levels of detail (see
+ * `render_model_get_lod_count()`), which are drawn for instances that are
+ * small on screen.
+ * @param model The base model from which to create the render model.
+ * @return Newly created renderModel.
+ */
+renderModel render_make_model(Model model) {
+    LOG_FUNC_CALL();
+    return render_make_model_ex(model, true);
+}
+
+/**
+ * @brief Creates a new render model from a given model, optionally without
+ * levels of detail (e.g. for static batches, whose meshes are large merged
+ * chunks rather than single objects).
  * @param model The base model from which to create the render model.
+ * @param lods Whether to generate levels of detail.
  * @return Newly created renderModel with initialized fields and allocated
  * bounding boxes for each mesh.
  * @note This function asserts that memory allocation succeeds and logs the
  * creation process.
  */
-renderModel render_make_model(Model model) {
+renderModel render_make_model_ex(Model model, bool lods) {
     LOG_FUNC_CALL();
     renderModel out;
     assert(out = (renderModel)malloc(sizeof(renderModelInternal)));
     out->n_instances = 0;
+    out->instance_capacity = 0;
+    out->transforms = NULL;
+    out->instance_hash = 0;
+    out->occluder = false;
+    out->owns_lods = true;
+    out->has_lods = false;
+    out->lod_bias = 0.0f;
+    out->lod_scale = 1.0f;
+    out->instance_lods = NULL;
+    out->instance_lod_states = NULL;
+    out->tint_variants = NULL;
+    out->n_tint_variants = 0;
+    out->tint_variants_size = 0;
     out->model = model;
     assert(out->mesh_bounding_boxes =
-               (betterBBox*)malloc(sizeof(betterBBox) * model.meshCount));
+               (BoundingBox*)malloc(sizeof(BoundingBox) * model.meshCount));
+    assert(out->instance_bounds =
+               (renderBounds*)malloc(sizeof(renderBounds) * model.meshCount));
+    // cooked models come with their bounds
+    const BoundingBox* bounds = render_model_file_get_bounds(model);
     for (int i = 0; i < model.meshCount; i++) {
         out->mesh_bounding_boxes[i] =
-            bbox2better(GetMeshBoundingBox(model.meshes[i]));
+            bounds ? bounds[i] : GetMeshBoundingBox(model.meshes[i]);
+        render_bounds_init(&out->instance_bounds[i]);
     }
+    make_lods(out, lods);
     TraceLog(LOG_INFO, "made model, %d meshes", model.meshCount);
     return out;
 }
@@ -307,7 +589,10 @@ renderModel render_make_model(Model model) {
 /**
  * @brief Computes the transformation matrix for a model based on specified
  * rotation, scale, and translation parameters.
- * @param model The model to transform.
+ *
+ * The result only depends on its arguments, so callers that keep the same
+ * transform across frames can cache it (see `render_add_model_instance_ex()`).
+ * @param model The render model to transform.
  * @param transform The fluxTransform structure containing rotation (in
  * radians), scale, and translation vectors.
  * @return The combined transformation matrix resulting from applying the scale,
@@ -317,8 +602,9 @@ renderModel render_make_model(Model model) {
  * translation, and finally combines them in the correct order (scale, then
  * rotation, then translation) to form the final transformation matrix.
  */
-static Matrix get_mesh_transform(Model model, fluxTransform transform) {
+Matrix render_model_get_transform(renderModel model, fluxTransform transform) {
     LOG_FUNC_CALL();
+    assert(model);
     // Calculate transformation matrix from function parameters
     // Get transform matrix (rotation -> scale -> translation)
     Vector3 rotationAxis;
@@ -338,7 +624,194 @@ static Matrix get_mesh_transform(Model model, fluxTransform transform) {
 
     // Combine model transformation matrix (model.transform) with matrix
     // generated by function parameters (matTransform)
-    return MatrixMultiply(model.transform, matTransform);
+    return MatrixMultiply(model->model.transform, matTransform);
+}
+
+/**
+ * @brief Returns the number of meshes in a render model.
+ * @param model Render model to query.
+ * @return Number of meshes.
+ */
+int render_model_get_mesh_count(renderModel model) {
+    LOG_FUNC_CALL();
+    assert(model);
+    return model->model.meshCount;
+}
+
+/**
+ * @brief Marks a model as an occluder (or not). When occlusion culling is
+ * enabled (`render_set_occlusion()`), the visible instances of occluders are
+ * rasterized into a low resolution CPU depth buffer, and instances of other
+ * models hidden behind them are not drawn.
+ *
+ * Occluders should be few, large and solid (e.g. buildings or terrain), with
+ * CPU side vertices: every triangle of every visible instance is rasterized.
+ * @param model Render model to mark.
+ * @param occluder Whether the model is an occluder.
+ */
+void render_model_set_occluder(renderModel model, bool occluder) {
+    LOG_FUNC_CALL();
+    assert(model);
+    model->occluder = occluder;
+}
+
+/**
+ * @brief Returns whether a model is an occluder.
+ * @param model Render model to query.
+ * @return `true` if the model is rasterized into the occlusion buffer.
+ */
+bool render_model_is_occluder(renderModel model) {
+    LOG_FUNC_CALL();
+    assert(model);
+    return model->occluder;
+}
+
+/**
+ * @brief Sets the level of detail bias of a model. Positive values keep the
+ * detailed levels further away (each unit doubles the distance the levels
+ * switch at), negative values switch to the simplified levels sooner.
+ * @param model Render model to set the bias of.
+ * @param bias Level of detail bias, 0 by default.
+ */
+void render_model_set_lod_bias(renderModel model, float bias) {
+    LOG_FUNC_CALL();
+    assert(model);
+    model->lod_bias = bias;
+    model->lod_scale = exp2f(bias);
+}
+
+/**
+ * @brief Returns the level of detail bias of a model.
+ * @param model Render model to query.
+ * @return Level of detail bias.
+ */
+float render_model_get_lod_bias(renderModel model) {
+    LOG_FUNC_CALL();
+    assert(model);
+    return model->lod_bias;
+}
+
+/**
+ * @brief Returns the number of levels of detail of a mesh of a model.
+ * @param model Render model to query.
+ * @param mesh Index of the mesh.
+ * @return Number of levels, including the mesh itself.
+ */
+int render_model_get_lod_count(renderModel model, int mesh) {
+    LOG_FUNC_CALL();
+    assert(model);
+    assert((mesh >= 0) && (mesh < model->model.meshCount));
+    return model->n_lods[mesh];
+}
+
+/**
+ * @brief Returns a level of detail of a mesh of a model.
+ * @param model Render model to query.
+ * @param mesh Index of the mesh.
+ * @param lod Level, 0 for the mesh itself.
+ * @return The mesh of that level.
+ */
+Mesh render_model_get_lod_mesh(renderModel model, int mesh, int lod) {
+    LOG_FUNC_CALL();
+    assert(model);
+    assert((mesh >= 0) && (mesh < model->model.meshCount));
+    assert((lod >= 0) && (lod < model->n_lods[mesh]));
+    if (lod == 0)
+        return model->model.meshes[mesh];
+    return model->lods[mesh * (RENDER_MAX_LODS - 1) + lod - 1];
+}
+
+/**
+ * @brief Computes the world space bounding box of every mesh of a model for a
+ * given transformation matrix.
+ * @param model Render model to compute the bounds of.
+ * @param transform Transformation matrix (see `render_model_get_transform()`).
+ * @param out Output, must have space for `render_model_get_mesh_count()` boxes.
+ */
+void render_model_get_instance_bounds(renderModel model, Matrix transform,
+                                      BoundingBox* out) {
+    LOG_FUNC_CALL();
+    assert(model);
+    assert(out);
+    for (int i = 0; i < model->model.meshCount; i++) {
+        out[i] =
+            render_transform_aabb(model->mesh_bounding_boxes[i], transform);
+    }
+}
+
+/**
+ * @brief Returns the bytes of per-instance storage of a render model.
+ * @param model Render model to query.
+ * @return Bytes used by the instance transforms, bounds and levels of detail.
+ */
+static size_t model_instance_memory(renderModel model) {
+    LOG_FUNC_CALL();
+    size_t per_mesh = sizeof(float) * 6;
+    size_t per_instance = sizeof(Matrix);
+    if (model->has_lods) {
+        per_mesh += sizeof(unsigned char);
+        per_instance += sizeof(unsigned char*);
+    }
+    return (size_t)model->instance_capacity *
+           (per_instance + per_mesh * model->model.meshCount);
+}
+
+/**
+ * @brief Grows the instance storage of a render model so that it can hold at
+ * least `n` instances. Storage grows geometrically and is never shrunk, so a
+ * model that draws the same number of instances every frame only allocates
+ * on its first frames.
+ * @param model Render model to grow.
+ * @param n Number of instances needed.
+ */
+static void reserve_instances(renderModel model, int n) {
+    LOG_FUNC_CALL();
+    if (n <= model->instance_capacity)
+        return;
+    instance_memory -= model_instance_memory(model);
+    int new_capacity =
+        model->instance_capacity > 0 ? model->instance_capacity : 16;
+    while (new_capacity < n)
+        new_capacity *= 2;
+    Matrix* transforms;
+    assert(transforms = (Matrix*)malloc(sizeof(Matrix) * new_capacity));
+    if (model->transforms) {
+        memcpy(transforms, model->transforms,
+               sizeof(Matrix) * model->n_instances);
+        free(model->transforms);
+    }
+    model->transforms = transforms;
+    for (int i = 0; i < model->model.meshCount; i++) {
+        render_bounds_reserve(&model->instance_bounds[i], new_capacity);
+    }
+    if (model->has_lods) {
+        unsigned char** states;
+        assert(states = (unsigned char**)malloc(sizeof(unsigned char*) *
+                                                new_capacity));
+        if (model->instance_lod_states) {
+            memcpy(states, model->instance_lod_states,
+                   sizeof(unsigned char*) * model->n_instances);
+            free(model->instance_lod_states);
+        }
+        model->instance_lod_states = states;
+        // levels kept by slot last across frames, so keep them when growing
+        unsigned char* lods;
+        int n_meshes = model->model.meshCount;
+        assert(lods = (unsigned char*)malloc(sizeof(unsigned char) *
+                                             new_capacity * n_meshes));
+        memset(lods, 0, sizeof(unsigned char) * new_capacity * n_meshes);
+        if (model->instance_lods) {
+            for (int i = 0; i < n_meshes; i++) {
+                memcpy(lods + i * new_capacity,
+                       model->instance_lods + i * model->instance_capacity,
+                       sizeof(unsigned char) * model->instance_capacity);
+            }
+            free(model->instance_lods);
+        }
+        model->instance_lods = lods;
+    }
+    model->instance_capacity = new_capacity;
+    instance_memory += model_instance_memory(model);
 }
 
 /**
@@ -349,6 +822,10 @@ void render_reset_instances(renderModel model) {
     LOG_FUNC_CALL();
     assert(model);
     model->n_instances = 0;
+    model->instance_hash = 0;
+    for (int i = 0; i < model->model.meshCount; i++) {
+        render_bounds_clear(&model->instance_bounds[i]);
+    }
 }
 
 /**
@@ -359,29 +836,160 @@ void render_reset_instances(renderModel model) {
  */
 void render_add_model_instance(renderModel model, fluxTransform transform) {
     LOG_FUNC_CALL();
+    render_add_model_instance_ex(
+        model, render_model_get_transform(model, transform), NULL, NULL);
+}
+
+/**
+ * @brief Adds a model instance to the rendering queue with a precomputed
+ * transformation matrix and, optionally, precomputed world space bounds.
+ *
+ * This lets callers that cache their matrices skip all per-frame transform
+ * work for instances that did not move.
+ * @param model Render model to modify.
+ * @param transform Transformation matrix, as returned by
+ * `render_model_get_transform()`.
+ * @param mesh_bounds World space bounds of each mesh for this transform, as
+ * returned by `render_model_get_instance_bounds()`, or NULL to compute them.
+ * @param lods Levels of detail the instance was last drawn with, one per mesh
+ * (zeroed before the first frame), which the main pass reads for hysteresis
+ * and updates. Owned by the caller and kept with the object the instance
+ * draws, so the levels follow it whatever order instances are added in. If
+ * NULL, the levels are kept by instance slot, which is only right if the
+ * same instances are added in the same order every frame.
+ */
+void render_add_model_instance_ex(renderModel model, Matrix transform,
+                                  const BoundingBox* mesh_bounds,
+                                  unsigned char* lods) {
+    LOG_FUNC_CALL();
     assert(model);
-    assert(model->n_instances < RENDER_MAX_INSTANCES);
-    model->transforms[model->n_instances] =
-        get_mesh_transform(model->model, transform);
+    reserve_instances(model, model->n_instances + 1);
+    if (model->has_lods)
+        model->instance_lod_states[model->n_instances] = lods;
+    model->transforms[model->n_instances] = transform;
     model->n_instances++;
-    // TraceLog(LOG_INFO,"adding model instances, %g %g %g, %g %g %g, %g %g
-    // %g",transform.pos.x,transform.pos.y,transform.pos.z,transform.rot.x,transform.rot.y,transform.rot.z,transform.scale.x,transform.scale.y,transform.scale.z);
+    model->instance_hash = hash_matrix(model->instance_hash, transform);
+    for (int i = 0; i < model->model.meshCount; i++) {
+        BoundingBox world =
+            mesh_bounds ? mesh_bounds[i]
+                        : render_transform_aabb(model->mesh_bounding_boxes[i],
+                                                transform);
+        render_bounds_push(&model->instance_bounds[i], world.min, world.max);
+    }
+}
+
+/**
+ * @brief Multiplies a material color by a model tint.
+ * @param color Material color.
+ * @param tint Tint of the model.
+ * @return The tinted color.
+ */
+static Color tint_color(Color color, Color tint) {
+    LOG_FUNC_CALL();
+    Color out;
+    out.r = (unsigned char)((((float)color.r / 255.0f) *
+                             ((float)tint.r / 255.0f)) *
+                            255.0f);
+    out.g = (unsigned char)((((float)color.g / 255.0f) *
+                             ((float)tint.g / 255.0f)) *
+                            255.0f);
+    out.b = (unsigned char)((((float)color.b / 255.0f) *
+                             ((float)tint.b / 255.0f)) *
+                            255.0f);
+    out.a = (unsigned char)((((float)color.a / 255.0f) *
+                             ((float)tint.a / 255.0f)) *
+                            255.0f);
+    return out;
+}
+
+/**
+ * @brief Returns the materials of a model tinted by `tint`, making them the
+ * first time the tint is used.
+ *
+ * Models are usually drawn with a single tint (their prefab's), so this is a
+ * short linear search, and no material is written while drawing.
+ * @param rmodel Render model to get the materials of.
+ * @param tint Tint to apply to the diffuse colors.
+ * @return One material per material of the model.
+ */
+static const Material* get_tint_variant(renderModel rmodel, Color tint) {
+    LOG_FUNC_CALL();
+    for (int i = 0; i < rmodel->n_tint_variants; i++) {
+        Color other = rmodel->tint_variants[i].tint;
+        if ((other.r == tint.r) && (other.g == tint.g) &&
+            (other.b == tint.b) && (other.a == tint.a))
+            return rmodel->tint_variants[i].materials;
+    }
+    if (rmodel->n_tint_variants >= rmodel->tint_variants_size) {
+        int new_size =
+            rmodel->tint_variants_size > 0 ? rmodel->tint_variants_size * 2 : 2;
+        renderTintVariant* grown;
+        assert(grown = (renderTintVariant*)malloc(sizeof(renderTintVariant) *
+                                                  new_size));
+        if (rmodel->tint_variants) {
+            memcpy(grown, rmodel->tint_variants,
+                   sizeof(renderTintVariant) * rmodel->n_tint_variants);
+            free(rmodel->tint_variants);
+        }
+        rmodel->tint_variants = grown;
+        rmodel->tint_variants_size = new_size;
+    }
+    Model model = rmodel->model;
+    renderTintVariant* variant =
+        &rmodel->tint_variants[rmodel->n_tint_variants];
+    variant->tint = tint;
+    if ((tint.r == 255) && (tint.g == 255) && (tint.b == 255) &&
+        (tint.a == 255)) {
+        variant->materials = model.materials;
+    } else {
+        assert(variant->materials =
+                   (Material*)malloc(sizeof(Material) * model.materialCount));
+        for (int i = 0; i < model.materialCount; i++) {
+            variant->materials[i] = model.materials[i];
+            assert(variant->materials[i].maps = (MaterialMap*)malloc(
+                       sizeof(MaterialMap) * MAX_MATERIAL_MAPS));
+            memcpy(variant->materials[i].maps, model.materials[i].maps,
+                   sizeof(MaterialMap) * MAX_MATERIAL_MAPS);
+            MaterialMap* diffuse =
+                &variant->materials[i].maps[MATERIAL_MAP_DIFFUSE];
+            diffuse->color = tint_color(diffuse->color, tint);
+        }
+    }
+    rmodel->n_tint_variants++;
+    TraceLog(LOG_INFO, "made tint variant %d (%d %d %d %d), %d materials",
+             rmodel->n_tint_variants, tint.r, tint.g, tint.b, tint.a,
+             model.materialCount);
+    return variant->materials;
 }
 
 /**
  * @brief Registers a render model for rendering, setting its tint color and
  * adding it to the rendering queue.
+ *
+ * The tinted materials are made the first time a model is registered with a
+ * given tint and reused after that. Registering the same model several times
+ * with different tints draws its instances once per tint.
  * @param rmodel The render model to be rendered.
  * @param tint The color tint to apply to the model.
- * @note Asserts that the render model is not NULL and that the total number of
- * render models does not exceed the maximum allowed.
+ * @note Asserts that the render model is not NULL.
  */
 void render_rmodel(renderModel rmodel, Color tint) {
     LOG_FUNC_CALL();
     assert(rmodel);
-    assert(n_rmodels < RENDERER_MAX_OBJECTS);
-    rmodel->tint = tint;
-    rmodels[n_rmodels] = rmodel;
+    if (n_rmodels >= rmodels_size) {
+        int new_size = rmodels_size > 0 ? rmodels_size * 2 : 64;
+        renderRegistration* grown;
+        assert(grown = (renderRegistration*)malloc(sizeof(renderRegistration) *
+                                                   new_size));
+        if (rmodels) {
+            memcpy(grown, rmodels, sizeof(renderRegistration) * n_rmodels);
+            free(rmodels);
+        }
+        rmodels = grown;
+        rmodels_size = new_size;
+    }
+    rmodels[n_rmodels].rmodel = rmodel;
+    rmodels[n_rmodels].materials = get_tint_variant(rmodel, tint);
     n_rmodels++;
 }
 
@@ -393,6 +1001,36 @@ void render_free_model(renderModel model) {
     LOG_FUNC_CALL();
     assert(model);
     assert(model->mesh_bounding_boxes);
+    assert(model->instance_bounds);
+    instance_memory -= model_instance_memory(model);
+    for (int i = 0; i < model->model.meshCount; i++) {
+        render_bounds_free(&model->instance_bounds[i]);
+    }
+    for (int i = 0; i < model->n_tint_variants; i++) {
+        Material* materials = model->tint_variants[i].materials;
+        if (materials == model->model.materials)
+            continue;
+        for (int j = 0; j < model->model.materialCount; j++) {
+            free(materials[j].maps);
+        }
+        free(materials);
+    }
+    if (model->tint_variants)
+        free(model->tint_variants);
+    if (model->transforms)
+        free(model->transforms);
+    for (int i = 0; (i < model->model.meshCount) && model->owns_lods; i++) {
+        for (int l = 1; l < model->n_lods[i]; l++) {
+            UnloadMesh(model->lods[i * (RENDER_MAX_LODS - 1) + l - 1]);
+        }
+    }
+    if (model->instance_lods)
+        free(model->instance_lods);
+    if (model->instance_lod_states)
+        free(model->instance_lod_states);
+    free(model->lods);
+    free(model->n_lods);
+    free(model->instance_bounds);
     free(model->mesh_bounding_boxes);
     free(model);
 }
@@ -405,85 +1043,563 @@ void render_init(void) {
     LOG_FUNC_CALL();
     render_load_default_shader();
     default_shader = render_get_default_shader();
+    cull_pool = flux_job_pool_create(cull_threads);
 }
 
 /**
- * @brief Renders a model using a specified shader and camera, applying viewport
- * transformations.
- * @param rmodel Render model to draw.
- * @param shader Shader to use for rendering.
- * @param camera Camera to use for the current view.
- * @param vp Combined view and projection matrix.
+ * @brief Makes sure the per-mesh transform scratch buffer can hold at least
+ * `n` instances.
+ * @param n Number of instances needed.
  */
-static void draw_rmodel(renderModel rmodel, Shader shader, Camera3D camera,
-                        Matrix vp) {
+static void reserve_visible_transforms(int n) {
     LOG_FUNC_CALL();
-    Model model = rmodel->model;
+    if (n <= visible_transforms_size)
+        return;
+    int new_size = visible_transforms_size > 0 ? visible_transforms_size : 64;
+    while (new_size < n)
+        new_size *= 2;
+    if (visible_transforms)
+        free(visible_transforms);
+    assert(visible_transforms = (Matrix*)malloc(sizeof(Matrix) * new_size));
+    instance_memory +=
+        (size_t)(new_size - visible_transforms_size) * sizeof(Matrix);
+    visible_transforms_size = new_size;
+}
 
-    Shader old_shader = model.materials[0].shader;
-    model.materials[0].shader = shader;
+/**
+ * @brief Makes sure the culling output buffer can hold at least `n`
+ * instances.
+ * @param n Number of instances needed.
+ */
+static void reserve_visible_instances(int n) {
+    LOG_FUNC_CALL();
+    if (n <= visible_instances_size)
+        return;
+    int new_size = visible_instances_size > 0 ? visible_instances_size : 64;
+    while (new_size < n)
+        new_size *= 2;
+    if (visible_instances)
+        free(visible_instances);
+    assert(visible_instances = (int*)malloc(sizeof(int) * new_size));
+    instance_memory +=
+        (size_t)(new_size - visible_instances_size) * sizeof(int);
+    visible_instances_size = new_size;
+}
 
-    betterBBox* bboxes = rmodel->mesh_bounding_boxes;
+/**
+ * @brief Submits the visible instances of a single mesh.
+ *
+ * If there are at least `instancing_threshold` instances, the mesh is drawn
+ * once with `DrawMeshInstanced` using `instanced_shader`, otherwise each
+ * instance gets its own `DrawMesh` with `shader`.
+ * @param mesh Mesh to draw.
+ * @param material Material to draw with (its shader is overridden).
+ * @param shader Shader for per-instance draws.
+ * @param instanced_shader Shader for instanced draws.
+ * @param transforms Transforms of the visible instances.
+ * @param n Number of visible instances.
+ */
+static void submit_mesh(Mesh mesh, Material material, Shader shader,
+                        Shader instanced_shader, const Matrix* transforms,
+                        int n) {
+    LOG_FUNC_CALL();
+    if (n == 0)
+        return;
+    if ((instancing_threshold > 0) && (n >= instancing_threshold)) {
+        material.shader = instanced_shader;
+        DrawMeshInstanced(mesh, material, transforms, n);
+        draw_calls++;
+        instanced_draw_calls++;
+        return;
+    }
+    material.shader = shader;
+    for (int j = 0; j < n; j++) {
+        DrawMesh(mesh, material, transforms[j]);
+        draw_calls++;
+    }
+}
 
-    Color tint = rmodel->tint;
+/**
+ * @brief Returns the id of the shader a run of `n` instances is drawn with.
+ */
+static unsigned int run_shader_id(Shader shader, Shader instanced_shader,
+                                  int n) {
+    LOG_FUNC_CALL();
+    if ((instancing_threshold > 0) && (n >= instancing_threshold))
+        return instanced_shader.id;
+    return shader.id;
+}
 
-    for (int i = 0; i < model.meshCount; i++) {
-        Color color = model.materials[model.meshMaterial[i]]
-                          .maps[MATERIAL_MAP_DIFFUSE]
-                          .color;
-        Color colorTint = WHITE;
-        colorTint.r = (unsigned char)((((float)color.r / 255.0f) *
-                                       ((float)tint.r / 255.0f)) *
-                                      255.0f);
-        colorTint.g = (unsigned char)((((float)color.g / 255.0f) *
-                                       ((float)tint.g / 255.0f)) *
-                                      255.0f);
-        colorTint.b = (unsigned char)((((float)color.b / 255.0f) *
-                                       ((float)tint.b / 255.0f)) *
-                                      255.0f);
-        colorTint.a = (unsigned char)((((float)color.a / 255.0f) *
-                                       ((float)tint.a / 255.0f)) *
-                                      255.0f);
-
-        model.materials[model.meshMaterial[i]]
-            .maps[MATERIAL_MAP_DIFFUSE]
-            .color = colorTint;
-
-        // TODO: only call this on model registration!!!
-        betterBBox bbox = bboxes[i];
-
-        for (int j = 0; j < rmodel->n_instances; j++) {
-
-            Matrix transform = rmodel->transforms[j];
-            betterBBox transformed = bboxTransform(bbox, transform);
-            betterBBox projected = bboxTransform(transformed, vp);
-
-            if (bboxVisible(projected)) {
-                visible_meshes++;
-                DrawMesh(model.meshes[i],
-                         model.materials[model.meshMaterial[i]], transform);
+/**
+ * @brief Makes sure `batches` can hold at least `n` batches.
+ * @param n Number of batches needed.
+ */
+static void reserve_batches(int n) {
+    LOG_FUNC_CALL();
+    if (n <= batches_size)
+        return;
+    int new_size = batches_size > 0 ? batches_size * 2 : 64;
+    while (new_size < n)
+        new_size *= 2;
+    renderBatch* grown;
+    assert(grown = (renderBatch*)malloc(sizeof(renderBatch) * new_size));
+    if (batches) {
+        memcpy(grown, batches, sizeof(renderBatch) * n_batches);
+        free(batches);
+    }
+    batches = grown;
+    batches_size = new_size;
+}
+
+/**
+ * @brief Appends a culling job, growing `cull_jobs` if needed.
+ */
+static void push_cull_job(int batch, int start, int end, int offset) {
+    LOG_FUNC_CALL();
+    if (n_cull_jobs >= cull_jobs_size) {
+        int new_size = cull_jobs_size > 0 ? cull_jobs_size * 2 : 64;
+        renderCullJob* grown;
+        assert(grown =
+                   (renderCullJob*)malloc(sizeof(renderCullJob) * new_size));
+        if (cull_jobs) {
+            memcpy(grown, cull_jobs, sizeof(renderCullJob) * n_cull_jobs);
+            free(cull_jobs);
+        }
+        cull_jobs = grown;
+        cull_jobs_size = new_size;
+    }
+    renderCullJob* job = &cull_jobs[n_cull_jobs];
+    job->batch = batch;
+    job->start = start;
+    job->end = end;
+    job->offset = offset;
+    job->n_visible = 0;
+    n_cull_jobs++;
+}
+
+/**
+ * @brief Returns where the level of detail of a mesh of an instance is kept.
+ * @param rmodel Model of the instance, which must have levels of detail.
+ * @param mesh Index of the mesh.
+ * @param k Index of the instance.
+ * @return The level the instance was last drawn with.
+ */
+static unsigned char* instance_lod(renderModel rmodel, int mesh, int k) {
+    unsigned char* state = rmodel->instance_lod_states[k];
+    if (state)
+        return &state[mesh];
+    return &rmodel->instance_lods[mesh * rmodel->instance_capacity + k];
+}
+
+/**
+ * @brief Sets the level of detail parameters of a pass from the main camera.
+ * @param pass The pass.
+ * @param update_lods Whether the levels chosen in the pass are stored.
+ */
+static void init_lod_pass(renderCullPass* pass, bool update_lods) {
+    pass->lod_eye = current_camera.position;
+    pass->lod_orthographic = current_camera.projection == CAMERA_ORTHOGRAPHIC;
+    if (pass->lod_orthographic) {
+        pass->lod_projection = 2.0f / current_camera.fovy;
+    } else {
+        pass->lod_projection =
+            1.0f / tanf(current_camera.fovy * DEG2RAD * 0.5f);
+    }
+    pass->lod_update = update_lods;
+}
+
+/**
+ * @brief Chooses the level of detail of an instance from its projected size
+ * (the radius of its bounds relative to half the screen height).
+ *
+ * Level `l` is drawn below a size of `RENDER_LOD_SCREEN_SIZE / 2^(l - 1)`. So
+ * that instances near a switch do not pop back and forth, the size has to
+ * move `RENDER_LOD_HYSTERESIS` (relative) past a switch before an instance
+ * leaves its current level.
+ * @param pass The culling pass.
+ * @param rmodel Model of the instance.
+ * @param bounds World space bounds of the mesh's instances.
+ * @param k Index of the instance.
+ * @param n_lods Number of levels of the mesh.
+ * @param current Level the instance was drawn with last frame.
+ * @return The level to draw.
+ */
+static int select_lod(const renderCullPass* pass, renderModel rmodel,
+                      const renderBounds* bounds, int k, int n_lods,
+                      int current) {
+    LOG_FUNC_CALL();
+    Vector3 half = {0.5f * (bounds->max_x[k] - bounds->min_x[k]),
+                    0.5f * (bounds->max_y[k] - bounds->min_y[k]),
+                    0.5f * (bounds->max_z[k] - bounds->min_z[k])};
+    float radius = Vector3Length(half);
+    float size = radius * pass->lod_projection * rmodel->lod_scale;
+    if (!pass->lod_orthographic) {
+        Vector3 center = {bounds->min_x[k] + half.x,
+                          bounds->min_y[k] + half.y,
+                          bounds->min_z[k] + half.z};
+        float distance = Vector3Distance(pass->lod_eye, center);
+        if (distance <= radius)
+            return 0;
+        size /= distance;
+    }
+    int lod = 0;
+    float threshold = RENDER_LOD_SCREEN_SIZE;
+    for (int l = 1; l < n_lods; l++) {
+        float band = current >= l ? 1.0f + RENDER_LOD_HYSTERESIS
+                                  : 1.0f - RENDER_LOD_HYSTERESIS;
+        if (size < threshold * band)
+            lod = l;
+        threshold *= 0.5f;
+    }
+    return lod;
+}
+
+/**
+ * @brief Culling job (runs on the cull pool): culls a range of instances of a
+ * mesh and writes a queue item for each visible one into the job's slice of
+ * the render queue, in the batch of the instance's level of detail.
+ * @param data The `renderCullPass`.
+ * @param index Index of the job in `cull_jobs`.
+ */
+static void cull_job(void* data, int index) {
+    LOG_FUNC_CALL();
+    const renderCullPass* pass = (const renderCullPass*)data;
+    renderCullJob* job = &cull_jobs[index];
+    const renderBatch* batch = &batches[job->batch];
+    const renderBounds* bounds =
+        &batch->rmodel->instance_bounds[batch->mesh];
+    int* visible = visible_instances + job->offset;
+    int n_visible = 0;
+    if (pass->frustum) {
+        n_visible = render_frustum_cull_range(pass->frustum, bounds,
+                                              job->start, job->end, visible);
+    } else {
+        for (int k = job->start; k < job->end; k++) {
+            visible[n_visible++] = k;
+        }
+    }
+    job->n_occluded = 0;
+    // occluders are never hidden by themselves, so do not test them
+    if (pass->occlusion && !batch->rmodel->occluder) {
+        int n_tested = n_visible;
+        n_visible = render_occlusion_cull(pass->occlusion, bounds, visible,
+                                          n_visible);
+        job->n_occluded = n_tested - n_visible;
+    }
+    renderModel rmodel = batch->rmodel;
+    int n_lods = rmodel->n_lods[batch->mesh];
+    memset(job->n_lod, 0, sizeof(job->n_lod));
+    renderQueueItem* items = queue.items + job->offset;
+    for (int j = 0; j < n_visible; j++) {
+        int k = visible[j];
+        int lod = 0;
+        if (n_lods > 1) {
+            unsigned char* current = instance_lod(rmodel, batch->mesh, k);
+            lod = select_lod(pass, rmodel, bounds, k, n_lods, *current);
+            if (pass->lod_update)
+                *current = (unsigned char)lod;
+        }
+        job->n_lod[lod]++;
+        Vector3 center = {0.5f * (bounds->min_x[k] + bounds->max_x[k]),
+                          0.5f * (bounds->min_y[k] + bounds->max_y[k]),
+                          0.5f * (bounds->min_z[k] + bounds->max_z[k])};
+        float depth =
+            Vector3Distance(pass->eye, center) / (float)RL_CULL_DISTANCE_FAR;
+        // the shader depends on how many instances of the batch are
+        // visible in the whole pass, and is filled in by queue_visible()
+        items[j].key = render_queue_make_key(batch->translucent, 0,
+                                             batch->texture, job->batch + lod,
+                                             depth);
+        items[j].instance = k;
+    }
+    job->n_visible = n_visible;
+}
+
+/**
+ * @brief Culls every registered model against a frustum and fills the render
+ * queue with an item for each visible mesh instance.
+ *
+ * The instances of every mesh are split into `RENDER_CULL_CHUNK` sized jobs,
+ * each of which culls its range and builds its queue items into its own slice
+ * on the cull pool. The slices are then compacted in job order, so the queue
+ * is the same whatever the number of threads.
+ *
+ * Also counts the shader and texture binds the visible meshes would have cost
+ * if they were submitted in registration order, as a baseline for the sorted
+ * queue.
+ * @param shader Shader to use for rendering.
+ * @param instanced_shader Shader to use when a mesh is drawn instanced.
+ * @param frustum Frustum to cull against, or NULL to draw every instance.
+ * @param occlusion Occlusion buffer to cull against (after the frustum), or
+ * NULL.
+ * @param eye Position the depth of the instances is measured from.
+ * @param update_lods Whether the levels of detail chosen in this pass are
+ * kept for hysteresis (the main pass).
+ * @return Number of mesh instances pushed.
+ */
+static int queue_visible(Shader shader, Shader instanced_shader,
+                         const renderFrustum* frustum,
+                         const renderOcclusionBuffer* occlusion,
+                         Vector3 eye, bool update_lods) {
+    LOG_FUNC_CALL();
+    n_batches = 0;
+    n_cull_jobs = 0;
+    int n_total = 0;
+    for (int r = 0; r < n_rmodels; r++) {
+        renderModel rmodel = rmodels[r].rmodel;
+        const Material* materials = rmodels[r].materials;
+        Model model = rmodel->model;
+        if (rmodel->n_instances == 0)
+            continue;
+        reserve_visible_transforms(rmodel->n_instances);
+        for (int i = 0; i < model.meshCount; i++) {
+            corner_transforms_saved += 16 * (long long)rmodel->n_instances;
+
+            const Material* material = &materials[model.meshMaterial[i]];
+            MaterialMap diffuse = material->maps[MATERIAL_MAP_DIFFUSE];
+
+            int n_lods = rmodel->n_lods[i];
+            reserve_batches(n_batches + n_lods);
+            int batch = n_batches;
+            for (int l = 0; l < n_lods; l++) {
+                batches[batch + l].rmodel = rmodel;
+                batches[batch + l].mesh = i;
+                batches[batch + l].lod = l;
+                batches[batch + l].material = material;
+                batches[batch + l].texture = diffuse.texture.id;
+                batches[batch + l].translucent = diffuse.color.a < 255;
+                batches[batch + l].n_visible = 0;
+            }
+            n_batches += n_lods;
+
+            for (int start = 0; start < rmodel->n_instances;
+                 start += RENDER_CULL_CHUNK) {
+                int end = start + RENDER_CULL_CHUNK;
+                if (end > rmodel->n_instances)
+                    end = rmodel->n_instances;
+                push_cull_job(batch, start, end, n_total + start);
             }
+            n_total += rmodel->n_instances;
         }
+    }
+
+    reserve_visible_instances(n_total);
+    render_queue_clear(&queue);
+    render_queue_reserve(&queue, n_total);
+
+    renderCullPass pass;
+    pass.frustum = frustum;
+    pass.occlusion = occlusion;
+    pass.eye = eye;
+    init_lod_pass(&pass, update_lods);
+    flux_job_pool_run(cull_pool, cull_job, &pass, n_cull_jobs);
+
+    int n_pushed = 0;
+    for (int j = 0; j < n_cull_jobs; j++) {
+        renderCullJob* job = &cull_jobs[j];
+        if (job->n_visible > 0 && job->offset != n_pushed) {
+            memmove(&queue.items[n_pushed], &queue.items[job->offset],
+                    sizeof(renderQueueItem) * job->n_visible);
+        }
+        const renderBatch* batch = &batches[job->batch];
+        for (int l = 0; l < batch->rmodel->n_lods[batch->mesh]; l++) {
+            batches[job->batch + l].n_visible += job->n_lod[l];
+        }
+        n_pushed += job->n_visible;
+        occluded_instances += job->n_occluded;
+    }
+    queue.n = n_pushed;
 
-        model.materials[model.meshMaterial[i]]
-            .maps[MATERIAL_MAP_DIFFUSE]
-            .color = color;
+    // now that every batch's count is known, key each draw by the shader it
+    // is submitted with, so instanced batches sort together
+    for (int j = 0; j < queue.n; j++) {
+        unsigned long long key = queue.items[j].key;
+        int b = render_queue_key_batch(key);
+        queue.items[j].key = render_queue_key_set_shader(
+            key, run_shader_id(shader, instanced_shader, batches[b].n_visible));
     }
 
-    model.materials[0].shader = old_shader;
+    unsigned int last_shader = 0;
+    unsigned int last_texture = 0;
+    for (int b = 0; b < n_batches; b++) {
+        if (batches[b].n_visible == 0)
+            continue;
+        unsigned int shader_id =
+            run_shader_id(shader, instanced_shader, batches[b].n_visible);
+        if (shader_id != last_shader)
+            unsorted_shader_binds++;
+        if (batches[b].texture != last_texture)
+            unsorted_texture_binds++;
+        last_shader = shader_id;
+        last_texture = batches[b].texture;
+    }
+    return n_pushed;
+}
+
+/**
+ * @brief Sorts the render queue and submits it.
+ *
+ * Consecutive items of the same batch (model mesh and level of detail) are
+ * submitted together, so they are drawn instanced if there are enough of
+ * them. Shader and texture changes between submissions are counted in
+ * `shader_binds` and `texture_binds`.
+ * @param shader Shader to use for rendering.
+ * @param instanced_shader Shader to use when a mesh is drawn instanced.
+ */
+static void submit_queue(Shader shader, Shader instanced_shader) {
+    LOG_FUNC_CALL();
+    render_queue_sort(&queue);
+    queue_items += queue.n;
+    unsigned int last_shader = 0;
+    unsigned int last_texture = 0;
+    int start = 0;
+    while (start < queue.n) {
+        int batch = render_queue_key_batch(queue.items[start].key);
+        renderModel rmodel = batches[batch].rmodel;
+        int end = start;
+        while ((end < queue.n) &&
+               (render_queue_key_batch(queue.items[end].key) == batch)) {
+            visible_transforms[end - start] =
+                rmodel->transforms[queue.items[end].instance];
+            end++;
+        }
+        int n = end - start;
+
+        Model model = rmodel->model;
+        int mesh = batches[batch].mesh;
+        Material material = *batches[batch].material;
+        unsigned int shader_id = run_shader_id(shader, instanced_shader, n);
+        unsigned int texture_id = batches[batch].texture;
+        if (shader_id != last_shader)
+            shader_binds++;
+        if (texture_id != last_texture)
+            texture_binds++;
+        last_shader = shader_id;
+        last_texture = texture_id;
+
+        Mesh drawn =
+            render_model_get_lod_mesh(rmodel, mesh, batches[batch].lod);
+        triangles_drawn += (long long)n * drawn.triangleCount;
+        triangles_full += (long long)n * model.meshes[mesh].triangleCount;
+
+        submit_mesh(drawn, material, shader, instanced_shader,
+                    visible_transforms, n);
+
+        start = end;
+    }
 }
 
 /**
- * @brief Draws all registered models using a default shader and custom camera
- * setup.
- * @param camera Custom camera configuration.
+ * @brief Mixes the levels of detail the shadow pass will draw some instances
+ * of a mesh with into a running hash.
+ * @param hash Running hash.
+ * @param pass Pass with the main camera's level of detail parameters.
+ * @param rmodel Model of the instances.
+ * @param mesh Index of the mesh.
+ * @param instances Indices of the instances, or NULL for all of them.
+ * @param n Number of instances.
+ * @return The updated hash.
  */
-void render_draw_all_no_shader(Camera3D camera) {
+static unsigned long long hash_lods(unsigned long long hash,
+                                    const renderCullPass* pass,
+                                    renderModel rmodel, int mesh,
+                                    const int* instances, int n) {
     LOG_FUNC_CALL();
-    Matrix view = GetCameraMatrix(camera);
-    for (int i = 0; i < n_rmodels; i++) {
-        draw_rmodel(rmodels[i], render_get_empty_shader(), camera, view);
+    int n_lods = rmodel->n_lods[mesh];
+    if (n_lods <= 1)
+        return hash;
+    const renderBounds* bounds = &rmodel->instance_bounds[mesh];
+    for (int j = 0; j < n; j++) {
+        int k = instances ? instances[j] : j;
+        int lod = select_lod(pass, rmodel, bounds, k, n_lods,
+                             *instance_lod(rmodel, mesh, k));
+        hash = hash_mix(hash, (unsigned long long)lod);
     }
+    return hash;
+}
+
+/**
+ * @brief Returns a hash of the shadow casters registered this frame: which
+ * models are registered, the transforms of their instances, and the levels of
+ * detail they will be drawn with.
+ *
+ * Used by the shadow pass to detect that nothing moved since a shadow map was
+ * rendered. Shadows are drawn with the levels the main camera chooses, so an
+ * instance switching level as the camera moves changes the hash as well.
+ * @param frustum If not NULL, only instances that touch this frustum are
+ * hashed, so that casters entering or leaving other views (e.g. the camera's)
+ * do not change the hash of a light.
+ * @return Hash of the registered models and their instances.
+ */
+unsigned long long render_get_caster_hash(const renderFrustum* frustum) {
+    LOG_FUNC_CALL();
+    renderCullPass pass;
+    init_lod_pass(&pass, false);
+    unsigned long long hash = 0;
+    for (int r = 0; r < n_rmodels; r++) {
+        renderModel rmodel = rmodels[r].rmodel;
+        hash = hash_mix(hash, (unsigned long long)(size_t)rmodel);
+        if (!frustum) {
+            hash = hash_mix(hash, (unsigned long long)rmodel->n_instances);
+            hash = hash_mix(hash, rmodel->instance_hash);
+            for (int i = 0; i < rmodel->model.meshCount; i++) {
+                hash = hash_lods(hash, &pass, rmodel, i, NULL,
+                                 rmodel->n_instances);
+            }
+            continue;
+        }
+        reserve_visible_instances(rmodel->n_instances);
+        for (int i = 0; i < rmodel->model.meshCount; i++) {
+            int n_visible = render_frustum_cull(
+                frustum, &rmodel->instance_bounds[i], visible_instances);
+            hash = hash_mix(hash, (unsigned long long)n_visible);
+            for (int j = 0; j < n_visible; j++) {
+                hash = hash_matrix(
+                    hash, rmodel->transforms[visible_instances[j]]);
+            }
+            hash = hash_lods(hash, &pass, rmodel, i, visible_instances,
+                             n_visible);
+        }
+    }
+    return hash;
+}
+
+/**
+ * @brief Returns the frustum of a camera as it will be rendered by
+ * `render_end()` (to the screen), for culling before rendering.
+ * @param camera Camera to get the frustum of.
+ * @return The frustum.
+ */
+renderFrustum render_get_view_frustum(Camera3D camera) {
+    LOG_FUNC_CALL();
+    int width = GetRenderWidth();
+    int height = GetRenderHeight();
+    float aspect = height > 0 ? (float)width / (float)height : 1.0f;
+    return render_frustum_from_camera(camera, aspect);
+}
+
+/**
+ * @brief Draws all registered models using the empty (depth only) shader, for
+ * the shadow pass.
+ *
+ * Must be called inside `BeginMode3D(camera)`. Casters are culled against the
+ * light camera's frustum with the near plane removed, so that casters between
+ * the light and the shadow map volume still throw shadows into it.
+ * @param camera The light camera.
+ * @return Number of mesh instances drawn.
+ */
+int render_draw_all_no_shader(Camera3D camera) {
+    LOG_FUNC_CALL();
+    renderFrustum frustum = render_frustum_from_matrix(
+        MatrixMultiply(rlGetMatrixModelview(), rlGetMatrixProjection()));
+    render_frustum_disable_plane(&frustum, RENDER_FRUSTUM_NEAR);
+    Shader shader = render_get_empty_shader();
+    Shader instanced_shader = render_get_empty_instanced_shader();
+    int n_drawn =
+        queue_visible(shader, instanced_shader, &frustum, NULL,
+                      camera.position, false);
+    submit_queue(shader, instanced_shader);
+    return n_drawn;
 }
 
 /**
@@ -495,23 +1611,88 @@ void render_begin(Camera3D camera) {
     LOG_FUNC_CALL();
     current_camera = camera;
     render_set_cam_pos(current_camera.position);
-    n_objects = 0;
     draw_grid = 0;
     n_rmodels = 0;
+    draw_calls = 0;
+    instanced_draw_calls = 0;
+    corner_transforms_saved = 0;
+    triangles_drawn = 0;
+    triangles_full = 0;
+    queue_items = 0;
+    shader_binds = 0;
+    texture_binds = 0;
+    unsorted_shader_binds = 0;
+    unsorted_texture_binds = 0;
+    occluded_instances = 0;
+}
+
+/**
+ * @brief Rasterizes the instances of occluder models that touch the view
+ * frustum into the occlusion buffer and builds its depth pyramid.
+ * @param frustum View frustum of the pass.
+ * @param vp View-projection matrix of the pass.
+ * @return The occlusion buffer, or NULL if occlusion culling is disabled.
+ */
+static const renderOcclusionBuffer* rasterize_occluders(
+    const renderFrustum* frustum, Matrix vp) {
+    LOG_FUNC_CALL();
+    if (!occlusion_enabled)
+        return NULL;
+    int width = GetRenderWidth();
+    int height = GetRenderHeight();
+    int buffer_height = RENDER_OCCLUSION_WIDTH;
+    if ((width > 0) && (height > 0))
+        buffer_height = RENDER_OCCLUSION_WIDTH * height / width;
+    if (buffer_height < 1)
+        buffer_height = 1;
+    if (occlusion_buffer.height != buffer_height) {
+        render_occlusion_free(&occlusion_buffer);
+        render_occlusion_init(&occlusion_buffer, RENDER_OCCLUSION_WIDTH,
+                              buffer_height);
+    }
+
+    render_occlusion_begin(&occlusion_buffer, vp);
+    for (int r = 0; r < n_rmodels; r++) {
+        renderModel rmodel = rmodels[r].rmodel;
+        if (!rmodel->occluder)
+            continue;
+        Model model = rmodel->model;
+        for (int i = 0; i < model.meshCount; i++) {
+            const renderBounds* bounds = &rmodel->instance_bounds[i];
+            for (int k = 0; k < bounds->n; k++) {
+                Vector3 min = {bounds->min_x[k], bounds->min_y[k],
+                               bounds->min_z[k]};
+                Vector3 max = {bounds->max_x[k], bounds->max_y[k],
+                               bounds->max_z[k]};
+                if (!render_frustum_test_aabb(frustum, min, max))
+                    continue;
+                render_occlusion_rasterize_mesh(
+                    &occlusion_buffer, model.meshes[i], rmodel->transforms[k]);
+            }
+        }
+    }
+    render_occlusion_build_hiz(&occlusion_buffer);
+    return &occlusion_buffer;
 }
 
 /**
  * @brief Draws all render models with the current settings and updates the
  * display.
- * @param camera Current camera configuration.
+ *
+ * Must be called inside `BeginMode3D()`, the frustum is built from the
+ * modelview and projection matrices that are currently set.
  */
-static void draw_all(Camera3D camera) {
+static void draw_all(void) {
     LOG_FUNC_CALL();
-    Matrix view = GetCameraMatrix(camera);
-    visible_meshes = 0;
-    for (int i = 0; i < n_rmodels; i++) {
-        draw_rmodel(rmodels[i], default_shader, camera, view);
-    }
+    Matrix vp =
+        MatrixMultiply(rlGetMatrixModelview(), rlGetMatrixProjection());
+    renderFrustum frustum = render_frustum_from_matrix(vp);
+    const renderOcclusionBuffer* occlusion = rasterize_occluders(&frustum, vp);
+    Shader instanced_shader = render_get_instanced_shader();
+    visible_meshes =
+        queue_visible(default_shader, instanced_shader, &frustum, occlusion,
+                      current_camera.position, true);
+    submit_queue(default_shader, instanced_shader);
 }
 
 /**
@@ -523,6 +1704,203 @@ int render_get_visible_meshes(void) {
     return visible_meshes;
 }
 
+/**
+ * @brief Returns the number of draw calls issued this frame (main and shadow
+ * passes).
+ * @return Integer representing the number of draw calls.
+ */
+int render_get_draw_calls(void) {
+    LOG_FUNC_CALL();
+    return draw_calls;
+}
+
+/**
+ * @brief Returns how many of this frame's draw calls were instanced.
+ * @return Integer representing the number of `DrawMeshInstanced` calls.
+ */
+int render_get_instanced_draw_calls(void) {
+    LOG_FUNC_CALL();
+    return instanced_draw_calls;
+}
+
+/**
+ * @brief Returns how many bounding box corner transforms were skipped this
+ * frame by using the instance bounds cached at `render_add_model_instance()`.
+ * @return Number of skipped corner transforms.
+ */
+long long render_get_corner_transforms_saved(void) {
+    LOG_FUNC_CALL();
+    return corner_transforms_saved;
+}
+
+/**
+ * @brief Returns the number of triangles submitted this frame (main and
+ * shadow passes), with levels of detail.
+ * @return Number of triangles.
+ */
+long long render_get_triangles_drawn(void) {
+    LOG_FUNC_CALL();
+    return triangles_drawn;
+}
+
+/**
+ * @brief Returns the number of triangles this frame's draws would have
+ * submitted if every instance was drawn with its full detail mesh.
+ * @return Number of triangles without levels of detail.
+ */
+long long render_get_triangles_full(void) {
+    LOG_FUNC_CALL();
+    return triangles_full;
+}
+
+/**
+ * @brief Returns the memory currently allocated by the renderer for
+ * per-instance data (transforms, bounds and scratch buffers).
+ * @return Size in bytes.
+ */
+size_t render_get_instance_memory(void) {
+    LOG_FUNC_CALL();
+    return instance_memory + render_queue_memory(&queue) +
+           sizeof(renderBatch) * (size_t)batches_size +
+           sizeof(renderCullJob) * (size_t)cull_jobs_size;
+}
+
+/**
+ * @brief Sets the minimum number of visible instances of a mesh needed to
+ * switch to a single instanced draw.
+ * @param threshold Instance count threshold, `<= 0` disables instancing.
+ */
+void render_set_instancing_threshold(int threshold) {
+    LOG_FUNC_CALL();
+    instancing_threshold = threshold;
+}
+
+/**
+ * @brief Returns the current instancing threshold.
+ * @return Instance count threshold.
+ */
+int render_get_instancing_threshold(void) {
+    LOG_FUNC_CALL();
+    return instancing_threshold;
+}
+
+/**
+ * @brief Sets the number of threads used to cull instances and build the
+ * render queue (including the render thread). Restarts the cull pool if the
+ * renderer is initialized.
+ * @param n Number of threads, `<= 0` for one per core.
+ */
+void render_set_cull_threads(int n) {
+    LOG_FUNC_CALL();
+    cull_threads = n;
+    if (cull_pool) {
+        flux_job_pool_destroy(cull_pool);
+        cull_pool = flux_job_pool_create(cull_threads);
+    }
+}
+
+/**
+ * @brief Returns the number of threads used to cull instances.
+ * @return Number of threads (including the render thread).
+ */
+int render_get_cull_threads(void) {
+    LOG_FUNC_CALL();
+    if (cull_pool)
+        return flux_job_pool_get_n_threads(cull_pool);
+    return cull_threads > 0 ? cull_threads : flux_get_n_cores();
+}
+
+/**
+ * @brief Returns the number of render queue items (mesh instances) submitted
+ * this frame (main and shadow passes).
+ * @return Number of queue items.
+ */
+int render_get_queue_items(void) {
+    LOG_FUNC_CALL();
+    return queue_items;
+}
+
+/**
+ * @brief Returns the number of shader changes between submissions this frame.
+ * @return Number of shader binds.
+ */
+int render_get_shader_binds(void) {
+    LOG_FUNC_CALL();
+    return shader_binds;
+}
+
+/**
+ * @brief Returns the number of diffuse texture changes between submissions
+ * this frame.
+ * @return Number of texture binds.
+ */
+int render_get_texture_binds(void) {
+    LOG_FUNC_CALL();
+    return texture_binds;
+}
+
+/**
+ * @brief Returns the number of shader changes this frame's draws would have
+ * cost if they were submitted in registration order.
+ * @return Number of shader binds without sorting.
+ */
+int render_get_unsorted_shader_binds(void) {
+    LOG_FUNC_CALL();
+    return unsorted_shader_binds;
+}
+
+/**
+ * @brief Returns the number of texture changes this frame's draws would have
+ * cost if they were submitted in registration order.
+ * @return Number of texture binds without sorting.
+ */
+int render_get_unsorted_texture_binds(void) {
+    LOG_FUNC_CALL();
+    return unsorted_texture_binds;
+}
+
+/**
+ * @brief Enables or disables occlusion culling in the main pass: instances
+ * hidden behind the occluder models (see `render_model_set_occluder()`) are
+ * not drawn. Disabled by default.
+ * @param enabled Whether to cull occluded instances.
+ */
+void render_set_occlusion(bool enabled) {
+    LOG_FUNC_CALL();
+    occlusion_enabled = enabled;
+}
+
+/**
+ * @brief Returns whether occlusion culling is enabled.
+ * @return `true` if the main pass culls occluded instances.
+ */
+bool render_get_occlusion(void) {
+    LOG_FUNC_CALL();
+    return occlusion_enabled;
+}
+
+/**
+ * @brief Returns how many mesh instances were inside the view frustum but
+ * hidden by occluders this frame.
+ * @return Number of occluded instances.
+ */
+int render_get_occluded_instances(void) {
+    LOG_FUNC_CALL();
+    return occluded_instances;
+}
+
+/**
+ * @brief Returns how many occluder triangles were rasterized into the
+ * occlusion buffer this frame.
+ * @return Number of triangles.
+ */
+int render_get_occluder_triangles(void) {
+    LOG_FUNC_CALL();
+    if (!occlusion_enabled)
+        return 0;
+    return occlusion_buffer.occluder_triangles;
+}
+
 /**
  * @brief Ends the rendering frame, handles post-processing tasks, and updates
  * the viewport.
@@ -535,7 +1913,7 @@ void render_end(void) {
 
     render_draw_skybox();
 
-    draw_all(current_camera);
+    draw_all();
 
     if (draw_grid)
         DrawGrid(n_grid, spacing_grid);
@@ -562,6 +1940,37 @@ void render_draw_grid(int n, float s) {
 void render_close(void) {
     LOG_FUNC_CALL();
     render_unload_default_shader();
+    if (cull_pool)
+        flux_job_pool_destroy(cull_pool);
+    cull_pool = NULL;
+    if (visible_transforms)
+        free(visible_transforms);
+    if (visible_instances)
+        free(visible_instances);
+    instance_memory -= (size_t)visible_transforms_size * sizeof(Matrix) +
+                       (size_t)visible_instances_size * sizeof(int);
+    visible_transforms = NULL;
+    visible_instances = NULL;
+    visible_transforms_size = 0;
+    visible_instances_size = 0;
+    if (cull_jobs)
+        free(cull_jobs);
+    cull_jobs = NULL;
+    cull_jobs_size = 0;
+    n_cull_jobs = 0;
+    if (rmodels)
+        free(rmodels);
+    rmodels = NULL;
+    rmodels_size = 0;
+    render_queue_free(&queue);
+    render_occlusion_free(&occlusion_buffer);
+    if (batches)
+        free(batches);
+    batches = NULL;
+    batches_size = 0;
+    n_batches = 0;
+    render_close_asset_stream();
+    render_clear_asset_cache();
 }
 
 /**
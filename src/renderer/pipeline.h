@@ -6,12 +6,37 @@
 #define _FLUX_RENDERER_PIPELINE_H_
 
 #include "raylib.h"
+#include "frustum.h"
 #include "raymath.h"
 #include "shader_manager.h"
 #include "transform.h"
+#include <stddef.h>
 
-#define RENDERER_MAX_OBJECTS 10000
-#define RENDER_MAX_INSTANCES 10000
+#define RENDER_DEFAULT_INSTANCING_THRESHOLD 16
+
+/** Number of instances culled per job of the cull pool. */
+#define RENDER_CULL_CHUNK 4096
+
+/** Width of the occlusion culling depth buffer, the height follows the
+ * aspect ratio of the screen. */
+#define RENDER_OCCLUSION_WIDTH 256
+
+/** Maximum number of levels of detail of a mesh, including the mesh itself. */
+#define RENDER_MAX_LODS 4
+
+/** Meshes with fewer triangles are not simplified. */
+#define RENDER_LOD_MIN_TRIANGLES 256
+
+/** Largest error of a level of detail, relative to the size of the mesh. */
+#define RENDER_LOD_MAX_ERROR 0.02f
+
+/** Projected size (bounding radius over half the screen height) below which
+ * level 1 is drawn, every further level halves it. */
+#define RENDER_LOD_SCREEN_SIZE 0.25f
+
+/** Relative band around each switch size in which an instance keeps its
+ * level of detail. */
+#define RENDER_LOD_HYSTERESIS 0.1f
 
 /** @addtogroup group1 Renderer API
  *  @brief The public API for interacting with the renderer module.
@@ -27,12 +52,36 @@
  * * To reset the number of instances currently for a `renderModel`, call
  * `render_reset_instances()`.
  * * Then, to add an instances, call `render_add_model_instance()`.
+ * * If the caller caches the instance matrix (`render_model_get_transform()`)
+ * and bounds (`render_model_get_instance_bounds()`), it can add the instance
+ * with `render_add_model_instance_ex()` instead, which skips recomputing them.
  * * When we actually want to render the scene, we first call `render_begin()`,
  * passing the camera to render from.
  * * We then call `render_rmodel()` on any `renderModel`s we want to draw.
  * * After this, we call `render_calculate_shadows()`, which does the shadow
- * calculations.
+ * calculations. Shadow maps are only re-rendered when their light or the
+ * registered instances changed (`render_invalidate_shadows()` forces it).
  * * Finally, we call `render_end()` to draw to the screen.
+ * * Meshes with at least `render_get_instancing_threshold()` visible instances
+ * in a pass are drawn with one `DrawMeshInstanced` call (see
+ * `render_set_instancing_threshold()`), `render_get_draw_calls()` reports the
+ * number of draw calls issued this frame.
+ * * Visible mesh instances go through a render queue that is sorted by shader,
+ * texture and mesh (opaque, front to back) or by depth (translucent, back to
+ * front), `render_get_shader_binds()` and `render_get_texture_binds()` report
+ * the resulting state changes.
+ * * Culling and building the render queue is split across a pool of worker
+ * threads (see `render_set_cull_threads()`), the queue does not depend on
+ * the number of threads.
+ * * Optionally (`render_set_occlusion()`), models marked as occluders with
+ * `render_model_set_occluder()` are rasterized into a small CPU depth buffer
+ * first, and instances hidden behind them are not drawn.
+ * * Meshes with enough triangles get up to `RENDER_MAX_LODS - 1` simplified
+ * levels of detail in `render_make_model()`. Every instance is drawn with the
+ * level matching its size on screen (see `render_model_set_lod_bias()`),
+ * `render_get_triangles_drawn()` reports the triangles submitted. Callers
+ * whose instances come and go pass each one's own level storage to
+ * `render_add_model_instance_ex()`, so the hysteresis follows the object.
  *
  *  @{
  */
@@ -59,16 +108,83 @@ void render_draw_grid(int n, float s);
 
 renderModel render_make_model(Model model);
 
+renderModel render_make_model_ex(Model model, bool lods);
+
 void render_reset_instances(renderModel model);
 
 void render_add_model_instance(renderModel model, fluxTransform transform);
 
+void render_add_model_instance_ex(renderModel model, Matrix transform,
+                                  const BoundingBox* mesh_bounds,
+                                  unsigned char* lods);
+
+Matrix render_model_get_transform(renderModel model, fluxTransform transform);
+
+int render_model_get_mesh_count(renderModel model);
+
+void render_model_get_instance_bounds(renderModel model, Matrix transform,
+                                      BoundingBox* out);
+
+void render_model_set_occluder(renderModel model, bool occluder);
+
+bool render_model_is_occluder(renderModel model);
+
+void render_model_set_lod_bias(renderModel model, float bias);
+
+float render_model_get_lod_bias(renderModel model);
+
+int render_model_get_lod_count(renderModel model, int mesh);
+
+Mesh render_model_get_lod_mesh(renderModel model, int mesh, int lod);
+
 void render_free_model(renderModel model);
 
 int render_get_visible_meshes(void);
 
+int render_get_draw_calls(void);
+
+int render_get_instanced_draw_calls(void);
+
+long long render_get_corner_transforms_saved(void);
+
+long long render_get_triangles_drawn(void);
+
+long long render_get_triangles_full(void);
+
+size_t render_get_instance_memory(void);
+
+void render_set_instancing_threshold(int threshold);
+
+int render_get_instancing_threshold(void);
+
+renderFrustum render_get_view_frustum(Camera3D camera);
+
+void render_set_cull_threads(int n);
+
+int render_get_cull_threads(void);
+
+int render_get_queue_items(void);
+
+int render_get_shader_binds(void);
+
+int render_get_texture_binds(void);
+
+int render_get_unsorted_shader_binds(void);
+
+int render_get_unsorted_texture_binds(void);
+
+void render_set_occlusion(bool enabled);
+
+bool render_get_occlusion(void);
+
+int render_get_occluded_instances(void);
+
+int render_get_occluder_triangles(void);
+
 /** @} */ // end of group1
 
-void render_draw_all_no_shader(Camera3D camera);
+int render_draw_all_no_shader(Camera3D camera);
+
+unsigned long long render_get_caster_hash(const renderFrustum* frustum);
 
 #endif
\ No newline at end of file
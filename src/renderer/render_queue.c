@@ -0,0 +1,212 @@
+/**
+ * @file render_queue.c
+ * @brief Render queue: draws are packed into 64 bit sort keys and sorted with
+ * an LSD radix sort, so that submission is grouped by GPU state (opaque) or
+ * ordered back to front (translucent).
+ **/
+
+#include "render_queue.h"
+#include "hqtools/hqtools.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Bits sorted per radix pass. */
+#define RADIX_BITS 8
+
+/** Buckets per radix pass. */
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+
+/**
+ * @brief Initializes an empty render queue.
+ * @param queue Queue to initialize.
+ */
+void render_queue_init(renderQueue* queue) {
+    LOG_FUNC_CALL();
+    assert(queue);
+    memset(queue, 0, sizeof(renderQueue));
+}
+
+/**
+ * @brief Frees the storage of a render queue and resets it to empty.
+ * @param queue Queue to free.
+ */
+void render_queue_free(renderQueue* queue) {
+    LOG_FUNC_CALL();
+    assert(queue);
+    if (queue->items)
+        free(queue->items);
+    if (queue->scratch)
+        free(queue->scratch);
+    render_queue_init(queue);
+}
+
+/**
+ * @brief Removes all draws from a render queue (keeps the storage).
+ * @param queue Queue to clear.
+ */
+void render_queue_clear(renderQueue* queue) {
+    LOG_FUNC_CALL();
+    assert(queue);
+    queue->n = 0;
+}
+
+/**
+ * @brief Grows the storage of a render queue so that it can hold at least `n`
+ * draws. Existing draws are kept.
+ * @param queue Queue to grow.
+ * @param n Number of draws needed.
+ */
+void render_queue_reserve(renderQueue* queue, int n) {
+    LOG_FUNC_CALL();
+    assert(queue);
+    if (n <= queue->capacity)
+        return;
+    int new_capacity = queue->capacity > 0 ? queue->capacity : 256;
+    while (new_capacity < n)
+        new_capacity *= 2;
+    renderQueueItem* items;
+    size_t bytes = sizeof(renderQueueItem) * new_capacity;
+    assert(items = (renderQueueItem*)malloc(bytes));
+    if (queue->items) {
+        memcpy(items, queue->items, sizeof(renderQueueItem) * queue->n);
+        free(queue->items);
+    }
+    if (queue->scratch)
+        free(queue->scratch);
+    assert(queue->scratch = (renderQueueItem*)malloc(bytes));
+    queue->items = items;
+    queue->capacity = new_capacity;
+}
+
+/**
+ * @brief Appends a draw to a render queue, growing it if needed.
+ * @param queue Queue to append to.
+ * @param key Sort key of the draw.
+ * @param instance Index of the instance within its batch.
+ */
+void render_queue_push(renderQueue* queue, unsigned long long key,
+                       int instance) {
+    LOG_FUNC_CALL();
+    assert(queue);
+    render_queue_reserve(queue, queue->n + 1);
+    queue->items[queue->n].key = key;
+    queue->items[queue->n].instance = instance;
+    queue->n++;
+}
+
+/**
+ * @brief Sorts the draws of a queue by key (stable LSD radix sort, 8 bits per
+ * pass). Passes where every key has the same digit are skipped, so keys that
+ * only use a few distinct values sort in a couple of passes.
+ * @param queue Queue to sort.
+ */
+void render_queue_sort(renderQueue* queue) {
+    LOG_FUNC_CALL();
+    assert(queue);
+    int n = queue->n;
+    if (n < 2)
+        return;
+    renderQueueItem* src = queue->items;
+    renderQueueItem* dst = queue->scratch;
+    for (int shift = 0; shift < 64; shift += RADIX_BITS) {
+        int counts[RADIX_BUCKETS] = {0};
+        for (int i = 0; i < n; i++) {
+            counts[(src[i].key >> shift) & (RADIX_BUCKETS - 1)]++;
+        }
+        if (counts[(src[0].key >> shift) & (RADIX_BUCKETS - 1)] == n)
+            continue;
+        int offset = 0;
+        for (int b = 0; b < RADIX_BUCKETS; b++) {
+            int count = counts[b];
+            counts[b] = offset;
+            offset += count;
+        }
+        for (int i = 0; i < n; i++) {
+            dst[counts[(src[i].key >> shift) & (RADIX_BUCKETS - 1)]++] =
+                src[i];
+        }
+        renderQueueItem* tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+    if (src != queue->items) {
+        memcpy(queue->items, src, sizeof(renderQueueItem) * n);
+    }
+}
+
+/**
+ * @brief Returns the bytes allocated by a render queue.
+ * @param queue Queue to query.
+ * @return Size in bytes.
+ */
+size_t render_queue_memory(const renderQueue* queue) {
+    LOG_FUNC_CALL();
+    assert(queue);
+    return (size_t)queue->capacity * 2 * sizeof(renderQueueItem);
+}
+
+/**
+ * @brief Packs the state of a draw into a sort key.
+ * @param translucent Whether the draw needs blending (sorted back to front,
+ * after all opaque draws).
+ * @param shader Shader id (only the low `RENDER_QUEUE_SHADER_BITS` are used).
+ * @param texture Diffuse texture id (only the low `RENDER_QUEUE_TEXTURE_BITS`
+ * are used).
+ * @param batch Index of the model mesh the draw belongs to.
+ * @param depth Distance to the camera, normalized to `[0, 1]` (clamped).
+ * @return The sort key.
+ */
+unsigned long long render_queue_make_key(bool translucent, unsigned int shader,
+                                         unsigned int texture, int batch,
+                                         float depth) {
+    LOG_FUNC_CALL();
+    assert((batch >= 0) && (batch < RENDER_QUEUE_MAX_BATCHES));
+    const unsigned long long depth_max = (1ULL << RENDER_QUEUE_DEPTH_BITS) - 1;
+    if (depth < 0.0f)
+        depth = 0.0f;
+    if (depth > 1.0f)
+        depth = 1.0f;
+    unsigned long long d = (unsigned long long)(depth * (float)depth_max);
+    unsigned long long s = shader & ((1u << RENDER_QUEUE_SHADER_BITS) - 1);
+    unsigned long long t = texture & ((1u << RENDER_QUEUE_TEXTURE_BITS) - 1);
+    unsigned long long b = (unsigned long long)batch;
+    unsigned long long state = (s << RENDER_QUEUE_TEXTURE_BITS) | t;
+    state = (state << RENDER_QUEUE_BATCH_BITS) | b;
+    if (translucent) {
+        return (1ULL << 63) |
+               ((depth_max - d) << (63 - RENDER_QUEUE_DEPTH_BITS)) | state;
+    }
+    return (state << RENDER_QUEUE_DEPTH_BITS) | d;
+}
+
+/**
+ * @brief Replaces the shader id of a sort key, for draws whose shader is only
+ * known once the whole pass is culled.
+ * @param key Sort key made by `render_queue_make_key()`.
+ * @param shader Shader id (only the low `RENDER_QUEUE_SHADER_BITS` are used).
+ * @return The sort key with the new shader.
+ */
+unsigned long long render_queue_key_set_shader(unsigned long long key,
+                                               unsigned int shader) {
+    LOG_FUNC_CALL();
+    int shift = RENDER_QUEUE_TEXTURE_BITS + RENDER_QUEUE_BATCH_BITS;
+    if (!(key >> 63))
+        shift += RENDER_QUEUE_DEPTH_BITS;
+    const unsigned long long mask = (1ULL << RENDER_QUEUE_SHADER_BITS) - 1;
+    unsigned long long s = shader & mask;
+    return (key & ~(mask << shift)) | (s << shift);
+}
+
+/**
+ * @brief Extracts the batch index from a sort key.
+ * @param key Sort key made by `render_queue_make_key()`.
+ * @return The batch index.
+ */
+int render_queue_key_batch(unsigned long long key) {
+    LOG_FUNC_CALL();
+    const unsigned long long mask = (1ULL << RENDER_QUEUE_BATCH_BITS) - 1;
+    if (key >> 63)
+        return (int)(key & mask);
+    return (int)((key >> RENDER_QUEUE_DEPTH_BITS) & mask);
+}
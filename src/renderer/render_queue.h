@@ -0,0 +1,85 @@
+/**
+ * @file render_queue.h
+ **/
+
+#ifndef _FLUX_RENDERER_RENDER_QUEUE_H_
+#define _FLUX_RENDERER_RENDER_QUEUE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Sort key layout, from the most significant bit down.
+ *
+ * Opaque: `[0 | shader | texture | batch | depth]`, so draws are grouped by
+ * state and instances of a batch are drawn front to back.
+ *
+ * Translucent: `[1 | ~depth | shader | texture | batch]`, so translucent draws
+ * come after all opaque ones, back to front.
+ *
+ * The shader is the one the draw's batch is submitted with, which depends on
+ * whether it has enough visible instances to be drawn instanced, so the
+ * pipeline sets it with `render_queue_key_set_shader()` after culling.
+ */
+#define RENDER_QUEUE_SHADER_BITS 7
+#define RENDER_QUEUE_TEXTURE_BITS 16
+#define RENDER_QUEUE_BATCH_BITS 24
+#define RENDER_QUEUE_DEPTH_BITS 16
+
+/** Maximum number of batches (model meshes) per queue. */
+#define RENDER_QUEUE_MAX_BATCHES (1 << RENDER_QUEUE_BATCH_BITS)
+
+/**
+ * @struct renderQueueItem
+ * @brief A single draw: a packed sort key and the instance it draws.
+ *
+ * @var unsigned long long key Sort key (see `render_queue_make_key()`).
+ * @var int instance Index of the instance within its batch.
+ */
+typedef struct renderQueueItem {
+    unsigned long long key;
+    int instance;
+} renderQueueItem;
+
+/**
+ * @struct renderQueue
+ * @brief Growable list of draws, radix sorted by key. The storage is kept
+ * across frames.
+ *
+ * @var renderQueueItem* items The draws.
+ * @var renderQueueItem* scratch Second buffer for the radix sort.
+ * @var int n Number of draws.
+ * @var int capacity Number of draws `items` and `scratch` can hold.
+ */
+typedef struct renderQueue {
+    renderQueueItem* items;
+    renderQueueItem* scratch;
+    int n;
+    int capacity;
+} renderQueue;
+
+void render_queue_init(renderQueue* queue);
+
+void render_queue_free(renderQueue* queue);
+
+void render_queue_clear(renderQueue* queue);
+
+void render_queue_reserve(renderQueue* queue, int n);
+
+void render_queue_push(renderQueue* queue, unsigned long long key,
+                       int instance);
+
+void render_queue_sort(renderQueue* queue);
+
+size_t render_queue_memory(const renderQueue* queue);
+
+unsigned long long render_queue_make_key(bool translucent, unsigned int shader,
+                                         unsigned int texture, int batch,
+                                         float depth);
+
+unsigned long long render_queue_key_set_shader(unsigned long long key,
+                                               unsigned int shader);
+
+int render_queue_key_batch(unsigned long long key);
+
+#endif
@@ -12,7 +12,13 @@
 
 #include "rlobj.h"
 
+#include "asset_registry.h"
 #include "hqtools/hqtools.h"
+#include "job_pool.h"
+#include "mapped_file.h"
+#include "mesh_optimizer.h"
+#include "parse_number.h"
+#include <assert.h>
 #include <ctype.h>
 #include <math.h>
 #include <rlgl.h>
@@ -62,25 +68,88 @@ typedef struct ValidVec3 {
 
 typedef struct GenericFile {
     char* data;
+    // End of the buffer, for reading numbers ahead (NULL if unknown)
+    const char* end;
 } GenericFile;
 
-typedef struct OBJFile {
-    char* base;
+typedef enum OBJDirectiveType {
+    OBJ_DIRECTIVE_OBJECT,
+    OBJ_DIRECTIVE_USEMTL,
+    OBJ_DIRECTIVE_MTLLIB
+} OBJDirectiveType;
+
+// An `o`, `usemtl` or `mtllib` line. These are handled on the loading thread
+// once the whole file is scanned, as they allocate and read other files.
+typedef struct OBJDirective {
+    OBJDirectiveType type;
+    char* args; // just after the keyword
+
+    // Elements read before this line, in the chunk and then in the file
+    int vertex_count;
+    int texcoord_count;
+    int normal_count;
+    int face_count;
+} OBJDirective;
+
+// A run of whole lines of the file, scanned by one job. The first pass only
+// counts elements (an upper bound, from the start of each line), so that the
+// second pass can write them straight into the file arrays at offsets given
+// by prefix sums, without allocating on worker threads.
+typedef struct OBJChunk {
+    char* begin;
+    char* end;
+
+    // Room in the arrays below, from a counting pass
+    int vertex_capacity;
+    int texcoord_capacity;
+    int normal_capacity;
+    int face_capacity;
+    int directive_capacity;
 
-    GenericFile data;
     Vector3 *vertices, *normals;
     Vector2* texcoords;
     Face* faces;
+    OBJDirective* directives;
 
+    // Elements read by the filling pass (faces past `face_capacity` are
+    // counted but not written)
     int vertex_count;
     int texcoord_count;
     int normal_count;
     int face_count;
+    int directive_count;
+
+    bool triangulated;
+} OBJChunk;
 
-    bool triangulation_warning;
+typedef struct OBJFile {
+    char* base;
+
+    // All elements of the file
+    Vector3 *vertices, *normals;
+    Vector2* texcoords;
+    Face* faces;
+
+    // Elements visible to the object being assembled: those read before the
+    // object ended (OBJ indices may not refer forwards)
+    int vertex_count;
+    int texcoord_count;
+    int normal_count;
 
     OBJMat* mats;
     int mat_count;
+    int mat_capacity;
+
+    // Meshes read so far; an object may be split into several meshes
+    OBJMesh* meshes;
+    int mesh_count;
+    int mesh_capacity;
+
+    // Statistics of the index buffers, for all meshes of the file
+    int corner_count;
+    int unique_count;
+    float indexed_misses;
+    float optimized_misses;
 } OBJFile;
 
 unsigned long hash(unsigned char* str) {
@@ -97,8 +166,10 @@ char* PutStringOnHeap(const char* string) {
     size_t string_len = strlen(string);
     if (string_len == 0)
         return NULL;
-    char* res = RL_CALLOC(strlen(string) + 1, sizeof(string));
-    strcpy(res, string);
+    // RL_MALLOC, not RL_CALLOC: these strings are reallocated and freed with
+    // the tracking allocator
+    char* res = RL_MALLOC(string_len + 1);
+    memcpy(res, string, string_len + 1);
     return res;
 }
 
@@ -114,12 +185,24 @@ char* AddBase(char* path, const char* base) {
     return path;
 }
 
+// Makes room for one more element in an array of `count` elements. The
+// capacity doubles, so reading n elements copies O(n) bytes instead of O(n^2)
+void* GrowArray(void* array, int count, int* capacity, size_t size) {
+    if (count < *capacity)
+        return array;
+    *capacity = *capacity ? *capacity * 2 : 1024;
+    if (!array)
+        return RL_MALLOC(size * *capacity);
+    return RL_REALLOC(array, size * *capacity);
+}
+
 // Generic reader functions
 
 void IgnoreLine(GenericFile* file) {
     for (; *file->data != '\n' && *file->data != '\0'; file->data++)
         ;
-    file->data++;
+    if (*file->data == '\n')
+        file->data++;
 }
 
 // Clears all whitespaces
@@ -143,40 +226,21 @@ char* ReadName(GenericFile* file) {
     char* data_cpy = file->data;
     for (; *data_cpy != '\n' && *data_cpy != '\0'; data_cpy++)
         ;
-    char* name = RL_CALLOC(data_cpy - file->data + 1, sizeof(char));
+    char* name = RL_MALLOC(data_cpy - file->data + 1);
 
     int i;
     for (i = 0; !isspace(file->data[i]) && file->data[i] != '\0'; i++) {
         name[i] = file->data[i];
     }
+    name[i] = '\0';
     file->data += i;
     return name;
 }
 
 float ReadFloat(GenericFile* file) {
-    float res = 0.f, fact = 1.f;
-    bool point_seen = false;
-
-    if (*file->data == '-') {
-        file->data++;
-        fact = -1;
-    }
-
-    for (; *file->data; file->data++) {
-        if (*file->data == '.') {
-            point_seen = true;
-            continue;
-        }
-
-        unsigned char c = *file->data - '0';
-        if (c > 9)
-            break; // same as isdigit(*file->data), but faster because we can
-                   // use c later
-        if (point_seen)
-            fact /= 10.f;
-        res = res * 10.f + (float)c;
-    }
-    return res * fact;
+    float res;
+    file->data = (char*)flux_parse_float(file->data, file->end, &res);
+    return res;
 }
 
 ValidFloat ReadValidFloat(GenericFile* file) {
@@ -193,16 +257,11 @@ float ReadFloatDefault(GenericFile* file, float def) {
     return def;
 }
 
+// Reads digits only, as indices are never negative
 int ReadInt(GenericFile* file) {
     int res = 0;
-    for (; *file->data; file->data++) {
-        unsigned char c = *file->data - '0';
-        if (c > 9)
-            break; // same as isdigit(*file->data), but faster because we can
-                   // use c later
-
-        res = res * 10 + c;
-    }
+    if (isdigit(*file->data))
+        file->data = (char*)flux_parse_int(file->data, file->end, &res);
     return res;
 }
 
@@ -337,14 +396,14 @@ char* ReadMtl(OBJFile* file, char* filename) {
         return filename;
     }
 
-    GenericFile mtl = (GenericFile){.data = data};
+    GenericFile mtl = (GenericFile){.data = data, .end = data + strlen(data)};
     const char* base = GetPrevDirectoryPath(filename);
 
     while (*mtl.data) {
-        file->mats =
-            (OBJMat*)RL_REALLOC(file->mats, sizeof(OBJMat) * ++file->mat_count);
-        file->mats[file->mat_count - 1] = LoadMtlMat(&mtl);
-        file->mats[file->mat_count - 1].base = PutStringOnHeap(base);
+        file->mats = (OBJMat*)GrowArray(file->mats, file->mat_count,
+                                        &file->mat_capacity, sizeof(OBJMat));
+        file->mats[file->mat_count] = LoadMtlMat(&mtl);
+        file->mats[file->mat_count++].base = PutStringOnHeap(base);
     }
 
     UnloadFileText(data);
@@ -352,58 +411,53 @@ char* ReadMtl(OBJFile* file, char* filename) {
 }
 
 // OBJ specific reader functions
+// These run on worker threads, so they must not allocate or log
 
-void ReadVertex(OBJFile* file) {
-    ValidFloat vX = ReadValidFloat(&file->data);
-    ValidFloat vY = ReadValidFloat(&file->data);
-    ValidFloat vZ = ReadValidFloat(&file->data);
+bool ReadVertex(GenericFile* file, Vector3* out) {
+    ValidFloat vX = ReadValidFloat(file);
+    ValidFloat vY = ReadValidFloat(file);
+    ValidFloat vZ = ReadValidFloat(file);
 
     if (!(vX.valid && vY.valid && vZ.valid)) {
-        return;
+        return false;
     }
 
-    ReadFloatDefault(&file->data, 1.f); // value ignored
+    ReadFloatDefault(file, 1.f); // value ignored
 
-    file->vertices = (Vector3*)RL_REALLOC(
-        file->vertices, sizeof(Vector3) * ++file->vertex_count);
-    int vc = file->vertex_count - 1;
-    file->vertices[vc].x = vX.f;
-    file->vertices[vc].y = vY.f;
-    file->vertices[vc].z = vZ.f;
+    out->x = vX.f;
+    out->y = vY.f;
+    out->z = vZ.f;
+    return true;
 }
 
-void ReadTextureCoord(OBJFile* file) {
-    ValidFloat tU = ReadValidFloat(&file->data);
+bool ReadTextureCoord(GenericFile* file, Vector2* out) {
+    ValidFloat tU = ReadValidFloat(file);
 
-    float tV = ReadFloatDefault(&file->data, 0.f);
-    ReadFloatDefault(&file->data, 0.f); // value ignored
+    float tV = ReadFloatDefault(file, 0.f);
+    ReadFloatDefault(file, 0.f); // value ignored
 
     if (!tU.valid) {
-        return;
+        return false;
     }
 
-    file->texcoords = (Vector2*)RL_REALLOC(
-        file->texcoords, sizeof(Vector2) * ++file->texcoord_count);
-    int tc = file->texcoord_count - 1;
-    file->texcoords[tc].x = tU.f;
-    file->texcoords[tc].y = tV;
+    out->x = tU.f;
+    out->y = tV;
+    return true;
 }
 
-void ReadNormal(OBJFile* file) {
-    ValidFloat nX = ReadValidFloat(&file->data);
-    ValidFloat nY = ReadValidFloat(&file->data);
-    ValidFloat nZ = ReadValidFloat(&file->data);
+bool ReadNormal(GenericFile* file, Vector3* out) {
+    ValidFloat nX = ReadValidFloat(file);
+    ValidFloat nY = ReadValidFloat(file);
+    ValidFloat nZ = ReadValidFloat(file);
 
     if (!(nX.valid && nY.valid && nZ.valid)) {
-        return;
+        return false;
     }
 
-    file->normals = (Vector3*)RL_REALLOC(
-        file->normals, sizeof(Vector3) * ++file->normal_count);
-    int nc = file->normal_count - 1;
-    file->normals[nc].x = nX.f;
-    file->normals[nc].y = nY.f;
-    file->normals[nc].z = nZ.f;
+    out->x = nX.f;
+    out->y = nY.f;
+    out->z = nZ.f;
+    return true;
 }
 
 #define InvalidEdge                                                            \
@@ -445,128 +499,345 @@ ValidEdge ReadEdge(GenericFile* file) {
     return (ValidEdge){e, true};
 }
 
-void ReadFace(OBJFile* file) {
+// Reads the triangles of a face line into `faces`, up to `capacity`, or only
+// counts them if `faces` is NULL
+void ReadFace(GenericFile* file, Face* faces, int capacity, int* face_count,
+              bool* triangulated) {
     Face f;
 
     for (int i = 0; i < 3; i++) {
-        ValidEdge vE = ReadEdge(&file->data);
+        ValidEdge vE = ReadEdge(file);
         if (vE.valid)
             f.edges[i] = vE.e;
         else
             return;
     }
+    if (faces && *face_count < capacity)
+        faces[*face_count] = f;
+    (*face_count)++;
 
-    file->faces =
-        (Face*)RL_REALLOC(file->faces, sizeof(Face) * ++file->face_count);
-    int fc = file->face_count - 1;
-    file->faces[fc] = f;
-
-    ClearWhitespace(&file->data);
+    ClearWhitespace(file);
 
     // Naïve triangulation
-    while (isdigit(*file->data.data)) {
-        if (!file->triangulation_warning) {
-            TraceLog(LOG_WARNING, "MESH: Triangulation is only very basic. Try "
-                                  "doing that in your modeling software.");
-            file->triangulation_warning = true;
-        }
-        file->faces =
-            (Face*)RL_REALLOC(file->faces, sizeof(Face) * ++file->face_count);
+    while (isdigit(*file->data)) {
+        *triangulated = true;
         f.edges[1] = f.edges[2];
 
-        ValidEdge vE = ReadEdge(&file->data);
-        if (vE.valid) {
-            f.edges[2] = vE.e;
-            f.edges[2] = vE.e;
-            file->faces[++fc] = f;
-        } else
+        ValidEdge vE = ReadEdge(file);
+        if (!vE.valid)
             return;
-        ClearWhitespace(&file->data);
+        f.edges[2] = vE.e;
+        if (faces && *face_count < capacity)
+            faces[*face_count] = f;
+        (*face_count)++;
+        ClearWhitespace(file);
     }
 }
 
-OBJMesh LoadObjMesh(OBJFile* file) {
-    unsigned long mat_hash;
-    bool seen_o = false;
+void AddDirective(OBJChunk* chunk, OBJDirectiveType type, char* args,
+                  bool fill) {
+    if (fill) {
+        chunk->directives[chunk->directive_count++] =
+            (OBJDirective){.type = type,
+                           .args = args,
+                           .vertex_count = chunk->vertex_count,
+                           .texcoord_count = chunk->texcoord_count,
+                           .normal_count = chunk->normal_count,
+                           .face_count = chunk->face_count};
+    } else {
+        chunk->directive_capacity++;
+    }
+}
 
-    while (*file->data.data) {
-        if (*file->data.data == 'v') {
-            if (isspace(*(++file->data.data))) {
-                file->data.data++;
-                ReadVertex(file);
-            } else if (*file->data.data == 't') {
-                file->data.data++;
-                ReadTextureCoord(file);
-            } else if (*file->data.data == 'n') {
-                file->data.data++;
-                ReadNormal(file);
+// Parses the lines of a chunk. With `fill` false this only sets the
+// capacities, exactly for faces; otherwise it writes the elements.
+void ScanChunk(OBJChunk* chunk, bool fill) {
+    GenericFile file = (GenericFile){.data = chunk->begin, .end = chunk->end};
+
+    while (file.data < chunk->end && *file.data) {
+        if (*file.data == 'v') {
+            file.data++;
+            if (isspace(*file.data) && *file.data != '\n') {
+                file.data++;
+                if (!fill)
+                    chunk->vertex_capacity++;
+                else if (ReadVertex(&file,
+                                    &chunk->vertices[chunk->vertex_count]))
+                    chunk->vertex_count++;
+            } else if (*file.data == 't') {
+                file.data++;
+                if (!fill)
+                    chunk->texcoord_capacity++;
+                else if (ReadTextureCoord(
+                             &file, &chunk->texcoords[chunk->texcoord_count]))
+                    chunk->texcoord_count++;
+            } else if (*file.data == 'n') {
+                file.data++;
+                if (!fill)
+                    chunk->normal_capacity++;
+                else if (ReadNormal(&file,
+                                    &chunk->normals[chunk->normal_count]))
+                    chunk->normal_count++;
             }
-        } else if (*file->data.data == 'f') {
-            file->data.data++;
-            ReadFace(file);
-        } else if (*file->data.data == 'o') {
-            if (seen_o)
-                break;
-            seen_o = true;
-        } else if (strncmp(file->data.data, "usemtl", 6) == 0) {
-            file->data.data += 6;
-            char* name = ReadName(&file->data);
-            mat_hash = hash((unsigned char*)name);
-            RL_FREE(name);
-        } else if (strncmp(file->data.data, "mtllib", 6) == 0) {
-            file->data.data += 6;
-            char* name = ReadName(&file->data);
-            RL_FREE(ReadMtl(file, name));
+        } else if (*file.data == 'f') {
+            file.data++;
+            if (fill)
+                ReadFace(&file, chunk->faces, chunk->face_capacity,
+                         &chunk->face_count, &chunk->triangulated);
+            else
+                ReadFace(&file, NULL, 0, &chunk->face_capacity,
+                         &chunk->triangulated);
+        } else if (*file.data == 'o') {
+            AddDirective(chunk, OBJ_DIRECTIVE_OBJECT, file.data + 1, fill);
+        } else if (strncmp(file.data, "usemtl", 6) == 0) {
+            AddDirective(chunk, OBJ_DIRECTIVE_USEMTL, file.data + 6, fill);
+        } else if (strncmp(file.data, "mtllib", 6) == 0) {
+            AddDirective(chunk, OBJ_DIRECTIVE_MTLLIB, file.data + 6, fill);
         }
-        IgnoreLine(&file->data);
+        IgnoreLine(&file);
     }
+}
 
-    Mesh m = (Mesh){0};
-    if (file->vertex_count != 0) {
-        if (!file->texcoord_count || !file->texcoords) {
-            file->texcoords = (Vector2*)RL_CALLOC(
-                file->vertex_count,
-                sizeof(Vector2)); // all texcoords will be 0,0
+// Counts the elements of a chunk from the first characters of its lines,
+// without parsing them. Faces are bounded by the number of corners on the
+// line, which only malformed face lines can exceed.
+void CountChunk(OBJChunk* chunk) {
+    char* line = chunk->begin;
+    while (line < chunk->end) {
+        char* next = (char*)memchr(line, '\n', chunk->end - line);
+        next = next ? next + 1 : chunk->end;
+        if (line[0] == 'v') {
+            if (isspace(line[1]) && line[1] != '\n')
+                chunk->vertex_capacity++;
+            else if (line[1] == 't')
+                chunk->texcoord_capacity++;
+            else if (line[1] == 'n')
+                chunk->normal_capacity++;
+        } else if (line[0] == 'f') {
+            int corners = 0;
+            bool in_corner = false;
+            for (char* c = line + 1; c < next; c++) {
+                bool space = isspace(*c);
+                corners += !space && !in_corner;
+                in_corner = !space;
+            }
+            if (corners > 2)
+                chunk->face_capacity += corners - 2;
+        } else if (line[0] == 'o' || strncmp(line, "usemtl", 6) == 0 ||
+                   strncmp(line, "mtllib", 6) == 0) {
+            chunk->directive_capacity++;
+        }
+        line = next;
+    }
+}
+
+typedef enum OBJScanPass {
+    OBJ_PASS_COUNT,       // CountChunk
+    OBJ_PASS_COUNT_EXACT, // ScanChunk without filling
+    OBJ_PASS_FILL         // ScanChunk
+} OBJScanPass;
+
+typedef struct OBJScanJob {
+    OBJChunk* chunks;
+    OBJScanPass pass;
+} OBJScanJob;
+
+void ScanChunkJob(void* data, int job) {
+    OBJScanJob* scan = (OBJScanJob*)data;
+    if (scan->pass == OBJ_PASS_COUNT)
+        CountChunk(&scan->chunks[job]);
+    else
+        ScanChunk(&scan->chunks[job], scan->pass == OBJ_PASS_FILL);
+}
+
+// Most vertices in one mesh, as raylib indices are 16 bit
+#define MAX_MESH_VERTICES 65535
+
+// OBJ indices start at 1; a missing or out of range index reads as zero
+Vector3 ObjVertexAt(const Vector3* array, int count, int index) {
+    if (index < 1 || index > count)
+        return (Vector3){0};
+    return array[index - 1];
+}
+
+Vector2 ObjTexcoordAt(const Vector2* array, int count, int index) {
+    if (index < 1 || index > count)
+        return (Vector2){0};
+    return array[index - 1];
+}
+
+unsigned int HashEdge(Edge e) {
+    return ((unsigned int)e.vertex * 73856093u) ^
+           ((unsigned int)e.texcoord * 19349663u) ^
+           ((unsigned int)e.normal * 83492791u);
+}
+
+// Finds the unique (vertex, texcoord, normal) triplets of the faces with an
+// open addressing hash table. Writes the unique triplets to `corners` and one
+// index into them per face corner to `indices`, and returns how many are
+// unique.
+int DeduplicateCorners(const Face* faces, int face_count, Edge* corners,
+                       unsigned int* indices) {
+    int corner_count = face_count * 3;
+    int table_size = 16;
+    while (table_size < corner_count * 2)
+        table_size *= 2;
+    int* table;
+    assert(table = (int*)malloc(sizeof(int) * table_size));
+    memset(table, -1, sizeof(int) * table_size);
+
+    int unique_count = 0;
+    for (int i = 0; i < corner_count; i++) {
+        Edge e = faces[i / 3].edges[i % 3];
+        unsigned int slot = HashEdge(e) & (table_size - 1);
+        while (table[slot] >= 0) {
+            Edge other = corners[table[slot]];
+            if (other.vertex == e.vertex && other.texcoord == e.texcoord &&
+                other.normal == e.normal)
+                break;
+            slot = (slot + 1) & (table_size - 1);
         }
-        if (!file->normal_count || !file->normals) {
-            file->normals = (Vector3*)RL_CALLOC(
-                file->vertex_count,
-                sizeof(Vector3)); // all normals will be 0,0,0
+        if (table[slot] < 0) {
+            table[slot] = unique_count;
+            corners[unique_count++] = e;
         }
+        indices[i] = table[slot];
+    }
 
-        m.vertexCount = file->face_count * 3;
-        m.triangleCount = (int)file->face_count;
+    free(table);
+    return unique_count;
+}
 
-        m.vertices = (float*)RL_CALLOC(m.vertexCount * 3, sizeof(float));
-        m.texcoords = (float*)RL_CALLOC(m.vertexCount * 2, sizeof(float));
-        m.normals = (float*)RL_CALLOC(m.vertexCount * 3, sizeof(float));
+// Builds a mesh from `face_count` faces of the deduplicated triplets.
+// `remap` maps the triplets used by these faces to their vertex in the mesh.
+Mesh BuildIndexedMesh(OBJFile* file, const Edge* corners,
+                      const unsigned int* indices, int face_count,
+                      const int* remap, int vertex_count) {
+    Mesh m = (Mesh){0};
+    m.vertexCount = vertex_count;
+    m.triangleCount = face_count;
+
+    m.vertices = (float*)RL_CALLOC(m.vertexCount * 3, sizeof(float));
+    m.texcoords = (float*)RL_CALLOC(m.vertexCount * 2, sizeof(float));
+    m.normals = (float*)RL_CALLOC(m.vertexCount * 3, sizeof(float));
+    m.indices =
+        (unsigned short*)RL_CALLOC(m.triangleCount * 3, sizeof(unsigned short));
+
+    for (int i = 0; i < face_count * 3; i++) {
+        int local = remap[indices[i]];
+        m.indices[i] = (unsigned short)local;
+
+        Edge e = corners[indices[i]];
+        Vector3 v = ObjVertexAt(file->vertices, file->vertex_count, e.vertex);
+        Vector2 t =
+            ObjTexcoordAt(file->texcoords, file->texcoord_count, e.texcoord);
+        Vector3 n = ObjVertexAt(file->normals, file->normal_count, e.normal);
+
+        m.vertices[local * 3] = v.x;
+        m.vertices[local * 3 + 1] = v.y;
+        m.vertices[local * 3 + 2] = v.z;
+        m.texcoords[local * 2] = t.x;
+        m.texcoords[local * 2 + 1] =
+            1.f - t.y; // raylib flips textures upside down
+        m.normals[local * 3] = n.x;
+        m.normals[local * 3 + 1] = n.y;
+        m.normals[local * 3 + 2] = n.z;
+    }
+    return m;
+}
 
-        // Sort vertices, texcoords and normals
-        for (int i = 0; i < file->face_count; i++) {
+void PushMesh(OBJFile* file, Mesh mesh, unsigned long mat_hash) {
+    file->meshes = (OBJMesh*)GrowArray(file->meshes, file->mesh_count,
+                                       &file->mesh_capacity, sizeof(OBJMesh));
+    file->meshes[file->mesh_count++] =
+        (OBJMesh){.mesh = mesh, .mat_hash = mat_hash};
+}
+
+// Appends an object of the file to `file->meshes`, as one or more indexed
+// meshes
+void AssembleObject(OBJFile* file, const Face* faces, int face_count,
+                    unsigned long mat_hash) {
+    if (file->vertex_count == 0 || face_count == 0) {
+        PushMesh(file, (Mesh){0}, mat_hash);
+        return;
+    }
+
+    // Each (vertex, texcoord, normal) triplet becomes one vertex
+    int corner_count = face_count * 3;
+    Edge* corners;
+    unsigned int* indices;
+    assert(corners = (Edge*)malloc(sizeof(Edge) * corner_count));
+    assert(indices =
+               (unsigned int*)malloc(sizeof(unsigned int) * corner_count));
+    int unique_count =
+        DeduplicateCorners(faces, face_count, corners, indices);
+
+    float* positions;
+    assert(positions = (float*)malloc(sizeof(float) * 3 * unique_count));
+    for (int i = 0; i < unique_count; i++) {
+        Vector3 p = ObjVertexAt(file->vertices, file->vertex_count,
+                                corners[i].vertex);
+        positions[i * 3] = p.x;
+        positions[i * 3 + 1] = p.y;
+        positions[i * 3 + 2] = p.z;
+    }
+
+    file->corner_count += corner_count;
+    file->unique_count += unique_count;
+    file->indexed_misses +=
+        render_vertex_cache_acmr(indices, corner_count, unique_count,
+                                 RENDER_VERTEX_CACHE_SIZE) *
+        face_count;
+    render_optimize_vertex_cache(indices, corner_count, unique_count);
+    render_optimize_overdraw(indices, corner_count, positions, unique_count);
+    file->optimized_misses +=
+        render_vertex_cache_acmr(indices, corner_count, unique_count,
+                                 RENDER_VERTEX_CACHE_SIZE) *
+        face_count;
+    free(positions);
+
+    // raylib indices are 16 bit, so big meshes are split into several
+    // meshes of the same material, keeping the optimized triangle order
+    int* remap;
+    assert(remap = (int*)malloc(sizeof(int) * unique_count));
+    for (int i = 0; i < unique_count; i++) {
+        remap[i] = -1;
+    }
+    int first = 0;
+    while (first < face_count) {
+        int local_count = 0;
+        int last = first;
+        for (; last < face_count; last++) {
+            int added = 0;
             for (int j = 0; j < 3; j++) {
-                int vIn = file->faces[i].edges[j].vertex - 1;
-                int tIn = file->faces[i].edges[j].texcoord - 1;
-                int nIn = file->faces[i].edges[j].normal - 1;
-
-                // Three vertices per face, three floats per vertex
-                m.vertices[i * 9 + j * 3] = file->vertices[vIn].x;
-                m.vertices[i * 9 + j * 3 + 1] = file->vertices[vIn].y;
-                m.vertices[i * 9 + j * 3 + 2] = file->vertices[vIn].z;
-
-                // Three coords per face, two floats per coords
-                m.texcoords[i * 6 + j * 2] = file->texcoords[tIn].x;
-                m.texcoords[i * 6 + j * 2 + 1] =
-                    1.f -
-                    file->texcoords[tIn].y; // raylib flips textures upside down
-
-                // Three normals per face, three floats per normal
-                m.normals[i * 9 + j * 3] = file->normals[nIn].x;
-                m.normals[i * 9 + j * 3 + 1] = file->normals[nIn].y;
-                m.normals[i * 9 + j * 3 + 2] = file->normals[nIn].z;
+                if (remap[indices[last * 3 + j]] < 0) {
+                    remap[indices[last * 3 + j]] = local_count + added++;
+                }
+            }
+            if (local_count + added > MAX_MESH_VERTICES) {
+                for (int j = 0; j < 3; j++) {
+                    if (remap[indices[last * 3 + j]] >= local_count)
+                        remap[indices[last * 3 + j]] = -1;
+                }
+                break;
             }
+            local_count += added;
+        }
+
+        PushMesh(file,
+                 BuildIndexedMesh(file, corners, indices + first * 3,
+                                  last - first, remap, local_count),
+                 mat_hash);
+
+        for (int i = first * 3; i < last * 3; i++) {
+            remap[indices[i]] = -1;
         }
+        first = last;
     }
-    return (OBJMesh){.mesh = m, .mat_hash = mat_hash};
+
+    free(remap);
+    free(indices);
+    free(corners);
 }
 
 Color Vector3ToColor(Vector3 vec, float opacity) {
@@ -576,46 +847,274 @@ Color Vector3ToColor(Vector3 vec, float opacity) {
                    .a = (char)roundf(opacity * 255.f)};
 }
 
+// Textures are shared with every other model that uses them
 Texture LoadTextureBase(char* filename, char* base) {
     Texture res;
     if (base)
         filename = AddBase(filename, base);
-    res = LoadTexture(filename);
+    res = render_acquire_texture(filename);
     RL_FREE(filename);
     return res;
 }
 
-// Wrapper around read LoadObjMesh and LoadMtlMat
-// Loads model without uploading meshes
-Model LoadObjDry(const char* filename) {
-    char* data = LoadFileText(filename);
-    if (!data)
-        return (Model){0};
+// Threads used to scan OBJ files, <= 0 for one per core
+static int obj_loader_threads = 0;
+
+void SetObjLoaderThreads(int n_threads) { obj_loader_threads = n_threads; }
 
-    OBJMesh* meshes = NULL;
-    int mesh_count = 0;
+// Smallest chunk worth handing to a thread
+#define OBJ_MIN_CHUNK_SIZE (256 * 1024)
+
+// Splits `size` bytes of `data` into chunks of whole lines
+int SplitChunks(char* data, size_t size, int n_threads, OBJChunk** chunks) {
+    int n_chunks = 1;
+    if (n_threads > 1) {
+        size_t by_size = size / OBJ_MIN_CHUNK_SIZE;
+        // a few chunks per thread, so that uneven chunks even out
+        n_chunks = by_size < (size_t)n_threads * 4 ? (int)by_size
+                                                    : n_threads * 4;
+        if (n_chunks < 1)
+            n_chunks = 1;
+    }
+    *chunks = (OBJChunk*)RL_MALLOC(sizeof(OBJChunk) * n_chunks);
+    memset(*chunks, 0, sizeof(OBJChunk) * n_chunks);
+
+    char* end = data + size;
+    char* begin = data;
+    for (int i = 0; i < n_chunks; i++) {
+        char* cut = data + size / n_chunks * (i + 1);
+        if (i == n_chunks - 1)
+            cut = end;
+        if (cut < begin)
+            cut = begin;
+        // move the cut to the start of the next line
+        while (cut < end && cut > data && cut[-1] != '\n')
+            cut++;
+        (*chunks)[i].begin = begin;
+        (*chunks)[i].end = cut;
+        begin = cut;
+    }
+    return n_chunks;
+}
+
+void RunScan(fluxJobPool pool, OBJChunk* chunks, int n_chunks,
+             OBJScanPass pass) {
+    OBJScanJob scan = (OBJScanJob){.chunks = chunks, .pass = pass};
+    if (pool)
+        flux_job_pool_run(pool, ScanChunkJob, &scan, n_chunks);
+    else
+        ScanChunkJob(&scan, 0);
+}
+
+// Moves the elements of a chunk down to `offset` in the file array, closing
+// the gap left by invalid lines in earlier chunks
+void CompactChunk(void* array, size_t size, void* chunk_array, int offset,
+                  int count) {
+    char* to = (char*)array + size * offset;
+    if (count > 0 && to != (char*)chunk_array)
+        memmove(to, chunk_array, size * count);
+}
+
+// Allocates the file arrays for the capacities of the chunks, and points
+// each chunk at its part of them. Returns the array of directives.
+OBJDirective* LayoutChunks(OBJFile* file, OBJChunk* chunks, int n_chunks) {
+    int vertex_count = 0, texcoord_count = 0, normal_count = 0;
+    int face_count = 0, directive_count = 0;
+    for (int i = 0; i < n_chunks; i++) {
+        vertex_count += chunks[i].vertex_capacity;
+        texcoord_count += chunks[i].texcoord_capacity;
+        normal_count += chunks[i].normal_capacity;
+        face_count += chunks[i].face_capacity;
+        directive_count += chunks[i].directive_capacity;
+    }
+    // (one spare element each, so that empty files allocate too)
+    file->vertices = (Vector3*)RL_MALLOC(sizeof(Vector3) * (vertex_count + 1));
+    file->texcoords =
+        (Vector2*)RL_MALLOC(sizeof(Vector2) * (texcoord_count + 1));
+    file->normals = (Vector3*)RL_MALLOC(sizeof(Vector3) * (normal_count + 1));
+    file->faces = (Face*)RL_MALLOC(sizeof(Face) * (face_count + 1));
+    OBJDirective* directives = (OBJDirective*)RL_MALLOC(
+        sizeof(OBJDirective) * (directive_count + 1));
+
+    vertex_count = texcoord_count = normal_count = 0;
+    face_count = directive_count = 0;
+    for (int i = 0; i < n_chunks; i++) {
+        chunks[i].vertices = file->vertices + vertex_count;
+        chunks[i].texcoords = file->texcoords + texcoord_count;
+        chunks[i].normals = file->normals + normal_count;
+        chunks[i].faces = file->faces + face_count;
+        chunks[i].directives = directives + directive_count;
+        vertex_count += chunks[i].vertex_capacity;
+        texcoord_count += chunks[i].texcoord_capacity;
+        normal_count += chunks[i].normal_capacity;
+        face_count += chunks[i].face_capacity;
+        directive_count += chunks[i].directive_capacity;
+    }
+    return directives;
+}
+
+void FreeObjArrays(OBJFile* file) {
+    RL_FREE(file->faces);
+    RL_FREE(file->vertices);
+    RL_FREE(file->texcoords);
+    RL_FREE(file->normals);
+}
+
+// Copies the directory of a file, like GetPrevDirectoryPath() but without
+// its static buffer, as models also load on streaming threads
+char* PutDirectoryOnHeap(const char* filename) {
+    int length = (int)strlen(filename);
+    if (length <= 3)
+        return PutStringOnHeap(filename);
+    for (int i = length - 1; i >= 0; i--) {
+        if ((filename[i] == '\\') || (filename[i] == '/')) {
+            // keep the separator of a root: "C:\" or "/"
+            if (((i == 2) && (filename[1] == ':')) || (i == 0))
+                i++;
+            char* res = RL_MALLOC(i + 1);
+            memcpy(res, filename, i);
+            res[i] = '\0';
+            return res;
+        }
+    }
+    return NULL;
+}
+
+// Wrapper around ScanChunk, AssembleObject and LoadMtlMat
+// Loads model without uploading meshes, with its textures if `load_textures`
+// is set
+static Model ParseObj(const char* filename, bool load_textures) {
+    fluxMappedFile mapped = flux_map_file(filename);
+    if (!mapped.data)
+        return (Model){0};
 
     OBJFile file = (OBJFile){0};
-    file.data.data = data;
-    file.base = PutStringOnHeap(GetPrevDirectoryPath(filename));
+    file.base = PutDirectoryOnHeap(filename);
+
+    // Big files are split into chunks of lines, scanned in parallel
+    int n_threads =
+        obj_loader_threads > 0 ? obj_loader_threads : flux_get_n_cores();
+    OBJChunk* chunks;
+    // the scan only ever reads the mapping
+    int n_chunks =
+        SplitChunks((char*)mapped.data, mapped.size, n_threads, &chunks);
+    fluxJobPool pool = NULL;
+    if (n_chunks > 1)
+        pool = flux_job_pool_create(n_threads);
+
+    RunScan(pool, chunks, n_chunks, OBJ_PASS_COUNT);
+    OBJDirective* directives = LayoutChunks(&file, chunks, n_chunks);
+    RunScan(pool, chunks, n_chunks, OBJ_PASS_FILL);
+
+    bool overflow = false;
+    for (int i = 0; i < n_chunks; i++) {
+        overflow = overflow || chunks[i].face_count > chunks[i].face_capacity;
+    }
+    if (overflow) {
+        // a malformed face line made more triangles than it has corners:
+        // count exactly and read again
+        RL_FREE(directives);
+        FreeObjArrays(&file);
+        for (int i = 0; i < n_chunks; i++) {
+            chunks[i] = (OBJChunk){.begin = chunks[i].begin,
+                                   .end = chunks[i].end};
+        }
+        RunScan(pool, chunks, n_chunks, OBJ_PASS_COUNT_EXACT);
+        directives = LayoutChunks(&file, chunks, n_chunks);
+        RunScan(pool, chunks, n_chunks, OBJ_PASS_FILL);
+    }
+    if (pool)
+        flux_job_pool_destroy(pool);
+
+    // Close the gaps left by invalid lines, and make the counts of the
+    // directives relative to the file
+    int vertex_count = 0, texcoord_count = 0, normal_count = 0;
+    int face_count = 0, directive_count = 0;
+    bool triangulated = false;
+    for (int i = 0; i < n_chunks; i++) {
+        OBJChunk* chunk = &chunks[i];
+        for (int j = 0; j < chunk->directive_count; j++) {
+            chunk->directives[j].vertex_count += vertex_count;
+            chunk->directives[j].texcoord_count += texcoord_count;
+            chunk->directives[j].normal_count += normal_count;
+            chunk->directives[j].face_count += face_count;
+        }
+        CompactChunk(file.vertices, sizeof(Vector3), chunk->vertices,
+                     vertex_count, chunk->vertex_count);
+        CompactChunk(file.texcoords, sizeof(Vector2), chunk->texcoords,
+                     texcoord_count, chunk->texcoord_count);
+        CompactChunk(file.normals, sizeof(Vector3), chunk->normals,
+                     normal_count, chunk->normal_count);
+        CompactChunk(file.faces, sizeof(Face), chunk->faces, face_count,
+                     chunk->face_count);
+        CompactChunk(directives, sizeof(OBJDirective), chunk->directives,
+                     directive_count, chunk->directive_count);
+        vertex_count += chunk->vertex_count;
+        texcoord_count += chunk->texcoord_count;
+        normal_count += chunk->normal_count;
+        face_count += chunk->face_count;
+        directive_count += chunk->directive_count;
+        triangulated = triangulated || chunk->triangulated;
+    }
+    RL_FREE(chunks);
+    if (triangulated)
+        TraceLog(LOG_WARNING, "MESH: Triangulation is only very basic. Try "
+                              "doing that in your modeling software.");
 
-    while (*file.data.data) {
-        meshes = (OBJMesh*)RL_REALLOC(meshes, sizeof(OBJMesh) * ++mesh_count);
-        meshes[mesh_count - 1] = LoadObjMesh(&file);
-        file.face_count = 0;
-        RL_FREE(file.faces);
-        file.faces = NULL;
+    // Objects end at every `o` line but the first. An object uses the last
+    // material it names.
+    bool seen_o = false;
+    unsigned long mat_hash = 0;
+    int first_face = 0;
+    for (int i = 0; i < directive_count; i++) {
+        OBJDirective d = directives[i];
+        GenericFile args = (GenericFile){.data = d.args};
+        if (d.type == OBJ_DIRECTIVE_MTLLIB) {
+            char* name = ReadName(&args);
+            RL_FREE(ReadMtl(&file, name));
+        } else if (d.type == OBJ_DIRECTIVE_USEMTL) {
+            char* name = ReadName(&args);
+            mat_hash = hash((unsigned char*)name);
+            RL_FREE(name);
+        } else if (!seen_o) {
+            seen_o = true;
+        } else {
+            file.vertex_count = d.vertex_count;
+            file.texcoord_count = d.texcoord_count;
+            file.normal_count = d.normal_count;
+            AssembleObject(&file, file.faces + first_face,
+                           d.face_count - first_face, mat_hash);
+            first_face = d.face_count;
+            mat_hash = 0;
+        }
+    }
+    if (mapped.size > 0 && *mapped.data) {
+        file.vertex_count = vertex_count;
+        file.texcoord_count = texcoord_count;
+        file.normal_count = normal_count;
+        AssembleObject(&file, file.faces + first_face, face_count - first_face,
+                       mat_hash);
+    }
+    RL_FREE(directives);
+
+    if (file.corner_count > 0) {
+        TraceLog(LOG_INFO,
+                 "OBJ: [%s] %d -> %d vertices, ACMR 3.00 -> %.2f (indexed) -> "
+                 "%.2f (optimized)",
+                 filename, file.corner_count, file.unique_count,
+                 file.indexed_misses / (file.corner_count / 3),
+                 file.optimized_misses / (file.corner_count / 3));
     }
 
-    UnloadFileText(data);
-    RL_FREE(file.vertices);
-    RL_FREE(file.texcoords);
-    RL_FREE(file.normals);
+    flux_unmap_file(&mapped);
+    FreeObjArrays(&file);
 
     Model model = {0};
 
     model.transform = (Matrix){1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
                                0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f};
+    OBJMesh* meshes = file.meshes;
+    int mesh_count = file.mesh_count;
     model.meshes = (Mesh*)RL_CALLOC(mesh_count, sizeof(Mesh));
     model.meshCount = mesh_count;
     model.materialCount = file.mat_count;
@@ -631,47 +1130,56 @@ Model LoadObjDry(const char* filename) {
         m.maps[MATERIAL_MAP_METALNESS].color =
             Vector3ToColor(names.specular, names.opacity);
 
+        if (!load_textures) {
+            // the textures are loaded by the caller, from the MTL file
+            char* maps[5] = {names.diffuse_map, names.reflection_map,
+                             names.specular_map, names.highlight_map,
+                             names.bump_map};
+            for (int j = 0; j < 5; j++) {
+                if (maps[j])
+                    RL_FREE(maps[j]);
+            }
+            names.diffuse_map = names.reflection_map = names.specular_map =
+                names.highlight_map = names.bump_map = NULL;
+        }
+
         // if-check here, to prevent replacing default textures
         // These are used to display .color values even if no image is present
         if (names.diffuse_map)
             m.maps[MATERIAL_MAP_ALBEDO].texture =
                 LoadTextureBase(names.diffuse_map, names.base);
-        else
-            RL_FREE(names.diffuse_map);
         // NOTE: I'm not totally sure which one is right, but for raylib
         // specular is the same as "metalness" so that's what
         //  we are using if both are defined
         if (names.reflection_map)
             m.maps[MATERIAL_MAP_METALNESS].texture =
                 LoadTextureBase(names.reflection_map, names.base);
-        else
-            RL_FREE(names.reflection_map);
         if (names.specular_map) {
             if (rlGetTextureIdDefault() !=
                 m.maps[MATERIAL_MAP_METALNESS].texture.id)
-                UnloadTexture(m.maps[MATERIAL_MAP_METALNESS].texture);
+                render_release_texture(
+                    m.maps[MATERIAL_MAP_METALNESS].texture);
             m.maps[MATERIAL_MAP_METALNESS].texture =
                 LoadTextureBase(names.specular_map, names.base);
-        } else
-            RL_FREE(names.specular_map);
+        }
 
         if (names.highlight_map)
             m.maps[MATERIAL_MAP_ROUGHNESS].texture =
                 LoadTextureBase(names.highlight_map, names.base);
-        else
-            RL_FREE(names.highlight_map);
         if (names.bump_map)
             m.maps[MATERIAL_MAP_NORMAL].texture =
                 LoadTextureBase(names.bump_map, names.base);
-        else
-            RL_FREE(names.bump_map);
 
         // Free unused maps (used ones are freed in LoadTextureBase because of
         // reallocates)
-        RL_FREE(names.alpha_map);
-        RL_FREE(names.ambient_map);
-        RL_FREE(names.decal_map);
-        RL_FREE(names.displacement_map);
+        char* unused[4] = {names.alpha_map, names.ambient_map,
+                           names.decal_map, names.displacement_map};
+        for (int j = 0; j < 4; j++) {
+            if (unused[j])
+                RL_FREE(unused[j]);
+        }
+        if (names.base)
+            RL_FREE(names.base);
 
         model.materials[i] = m;
     }
@@ -684,19 +1192,37 @@ Model LoadObjDry(const char* filename) {
         model.meshes[i] = meshes[i].mesh;
     }
 
-    RL_FREE(meshes);
-    RL_FREE(file.mats);
+    if (meshes)
+        RL_FREE(meshes);
+    if (file.mats)
+        RL_FREE(file.mats);
     RL_FREE(file.base);
 
     return model;
 }
 
+Model LoadObjDry(const char* filename) { return ParseObj(filename, true); }
+
+Model LoadObjData(const char* filename) {
+    Model obj = ParseObj(filename, false);
+
+    if (obj.meshCount > 0 && obj.materialCount == 0) {
+        MemFree(obj.materials);
+        obj.materialCount = 1;
+        obj.materials = RL_CALLOC(1, sizeof(Material));
+        obj.materials[0] = LoadMaterialDefault();
+    }
+
+    return obj;
+}
+
 // Wrapper around LoadObjDry
 // This basically does the same job as LoadMaterial does for LoadOBJ
 Model LoadObj(const char* filename) {
     Model obj = LoadObjDry(filename);
 
     if (obj.materialCount == 0) {
+        MemFree(obj.materials);
         obj.materialCount = 1;
         obj.materials = RL_CALLOC(1, sizeof(Material));
         obj.materials[0] = LoadMaterialDefault();
@@ -24,6 +24,17 @@ extern "C" {
 // raylib has a LoadOBJ
 Model LoadObj(const char* filename);
 
+// Loads the model without uploading its meshes or adding a default material
+Model LoadObjDry(const char* filename);
+
+// Loads the model without touching the GPU: the meshes are not uploaded and
+// the materials keep their default textures. Safe to call from any thread
+Model LoadObjData(const char* filename);
+
+// Sets the number of threads used to scan big OBJ files, <= 0 for one per
+// core (the default)
+void SetObjLoaderThreads(int n_threads);
+
 #ifdef __cplusplus
 };
 #endif
@@ -10,14 +10,28 @@
 #include "pipeline.h"
 #include "raylib.h"
 #include "raymath.h"
+#include "rlgl.h"
+#include "shadow_atlas.h"
 #include "shadow_map_texture.h"
 #include "transform.h"
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
 
-/** Maximum number of lights supported. */
-#define FLUX_MAX_LIGHTS 4
+/** Number of shaders that receive the light uniforms (default + instanced). */
+#define FLUX_N_LIT_SHADERS 2
+
+/** Width and height of the shadow atlas shared by all lights. */
+#define FLUX_SHADOW_ATLAS_RES 4096
+
+/** Smallest shadow map tile that can be handed out. */
+#define FLUX_SHADOW_MIN_RES 256
+
+/** Shadow map resolution of a light that did not set one. */
+#define FLUX_DEFAULT_SHADOW_RES 2048
+
+/** Texture slot the shadow atlas is bound to (0 is used by materials). */
+#define FLUX_SHADOW_ATLAS_SLOT 14
 
 /**
  * @brief Converts a Vector3 to an array format, typically for OpenGL
@@ -44,40 +58,70 @@ typedef struct Light {
     Color cL;        /**< Color of the light. */
     Vector3 pos;     /**< Position of the light in 3D space. */
     Vector3 L;       /**< Direction of the light. */
-    RenderTexture2D shadow_map; /**< Texture for shadow mapping. */
-    Matrix light_vp;            /**< View-projection matrix for the light. */
+    int shadow_res;              /**< Requested shadow map resolution. */
+    bool has_tile;               /**< Whether the light owns an atlas tile. */
+    renderAtlasTile shadow_tile; /**< Shadow map tile in the atlas. */
+    Matrix light_vp;             /**< View-projection matrix for the light. */
 
     float scale; /**< Scale factor for the light's influence. */
     float fov;   /**< Field of view for the light. */
 
+    int visible_casters; /**< Mesh instances drawn into the shadow map in the
+                            last shadow pass. */
+
+    unsigned int generation; /**< Bumped whenever a setting that changes the
+                                shadow map (L, scale, fov) changes. */
+    bool shadow_valid;       /**< Whether the light's tile holds a render. */
+    unsigned int shadow_generation; /**< `generation` the shadow map was
+                                       rendered with. */
+    unsigned long long shadow_caster_hash; /**< Caster hash the shadow map was
+                                              rendered with. */
+
+    renderShaderAttr shader_enabled
+        [FLUX_N_LIT_SHADERS]; /**< Shader attribute for light enable state. */
+    renderShaderAttr shader_type
+        [FLUX_N_LIT_SHADERS]; /**< Shader attribute for light type. */
+    renderShaderAttr shader_kd
+        [FLUX_N_LIT_SHADERS]; /**< Shader attribute for diffuse reflectivity. */
+    renderShaderAttr shader_ks[FLUX_N_LIT_SHADERS]; /**< Shader attribute for
+                                                       specular reflectivity. */
+    renderShaderAttr shader_p
+        [FLUX_N_LIT_SHADERS]; /**< Shader attribute for shininess factor. */
+    renderShaderAttr shader_intensity
+        [FLUX_N_LIT_SHADERS]; /**< Shader attribute for light intensity. */
     renderShaderAttr
-        shader_enabled; /**< Shader attribute for light enable state. */
-    renderShaderAttr shader_type; /**< Shader attribute for light type. */
-    renderShaderAttr
-        shader_kd; /**< Shader attribute for diffuse reflectivity. */
-    renderShaderAttr
-        shader_ks; /**< Shader attribute for specular reflectivity. */
-    renderShaderAttr shader_p; /**< Shader attribute for shininess factor. */
-    renderShaderAttr
-        shader_intensity;        /**< Shader attribute for light intensity. */
-    renderShaderAttr shader_cL;  /**< Shader attribute for light color. */
-    renderShaderAttr shader_pos; /**< Shader attribute for light position. */
-    renderShaderAttr shader_L;   /**< Shader attribute for light direction. */
-    renderShaderAttr shader_light_vp; /**< Shader attribute for light
-                                         view-projection matrix. */
-
-    int shader_shadow_map_loc; /**< Location index for the shadow map in the
-                                  shader. */
+        shader_cL[FLUX_N_LIT_SHADERS]; /**< Shader attribute for light color. */
+    renderShaderAttr shader_pos
+        [FLUX_N_LIT_SHADERS]; /**< Shader attribute for light position. */
+    renderShaderAttr shader_L
+        [FLUX_N_LIT_SHADERS]; /**< Shader attribute for light direction. */
+    renderShaderAttr shader_light_vp
+        [FLUX_N_LIT_SHADERS]; /**< Shader attribute for light view-projection
+                                 matrix. */
+    renderShaderAttr shader_shadow_rect
+        [FLUX_N_LIT_SHADERS]; /**< Shader attribute for the UV rect of the
+                                 light's tile in the shadow atlas. */
+    renderShaderAttr shader_has_shadow
+        [FLUX_N_LIT_SHADERS]; /**< Shader attribute for whether the light
+                                 has a shadow map to sample. */
 } Light;
 
 static Shader flux_default_shader; /**< Default shader used for rendering. */
 static Shader flux_empty_shader; /**< Shader used when no lights are active. */
+static Shader flux_instanced_shader; /**< Default shader for instanced draws. */
+static Shader
+    flux_empty_instanced_shader; /**< Empty shader for instanced draws. */
+static Shader lit_shaders[FLUX_N_LIT_SHADERS]; /**< Shaders that receive the
+                                                  light uniforms. */
 static renderShaderAttr
-    shader_ka; /**< Ambient light coefficient shader attribute. */
-static renderShaderAttr
-    shader_cam_pos; /**< Camera position shader attribute. */
-static renderShaderAttr
-    shader_shadow_map_res; /**< Shadow map resolution shader attribute. */
+    shader_ka[FLUX_N_LIT_SHADERS]; /**< Ambient light coefficient shader
+                                      attribute. */
+static renderShaderAttr shader_cam_pos
+    [FLUX_N_LIT_SHADERS]; /**< Camera position shader attribute. */
+static renderShaderAttr shader_shadow_map_res
+    [FLUX_N_LIT_SHADERS]; /**< Shadow atlas resolution shader attribute. */
+static int shader_shadow_atlas_loc
+    [FLUX_N_LIT_SHADERS]; /**< Location of the shadow atlas sampler. */
 static Light lights[FLUX_MAX_LIGHTS]; /**< Array of light structures. */
 
 static int skybox_loaded = 0; /**< Flag to check if the skybox is loaded. */
@@ -86,7 +130,21 @@ static Model skybox;          /**< 3D model for the skybox. */
 
 static bool skybox_enabled = true;
 
-static int shadowMapRes = 4096; /**< Resolution of the shadow map. */
+static int shadowMapRes =
+    FLUX_SHADOW_ATLAS_RES; /**< Resolution of the shadow atlas. */
+
+static bool shadow_atlas_loaded =
+    false; /**< Whether the atlas texture is loaded. */
+static RenderTexture2D
+    shadow_atlas; /**< Depth texture holding every light's shadow map. */
+static renderAtlasAllocator
+    shadow_atlas_tiles; /**< Tile bookkeeping for `shadow_atlas`. */
+
+static int shadow_maps_rendered =
+    0; /**< Shadow maps re-rendered by the last `render_calculate_shadows()`. */
+static int shadow_maps_cached = 0; /**< Shadow maps reused from a previous
+                                      frame by the last
+                                      `render_calculate_shadows()`. */
 
 /**
  * @brief Retrieves a shader attribute location for a specified attribute name.
@@ -143,42 +201,52 @@ void render_set_shader_attr_vec3(renderShaderAttr attr, Vector3 val) {
 static void init_lights(void) {
     LOG_FUNC_CALL();
     TraceLog(LOG_INFO, "init_lights");
-    TraceLog(LOG_INFO, "shadowMapRes %dx%d", shadowMapRes, shadowMapRes);
+    TraceLog(LOG_INFO, "shadow atlas %dx%d", shadowMapRes, shadowMapRes);
+    render_atlas_init(&shadow_atlas_tiles, shadowMapRes, FLUX_SHADOW_MIN_RES);
     for (int i = 0; i < FLUX_MAX_LIGHTS; i++) {
-        lights[i].shader_enabled = render_get_shader_attr(
-            flux_default_shader, TextFormat("lights[%i].enabled", i));
-        lights[i].shader_type = render_get_shader_attr(
-            flux_default_shader, TextFormat("lights[%i].type", i));
-        lights[i].shader_cL = render_get_shader_attr(
-            flux_default_shader, TextFormat("lights[%i].cL", i));
-        lights[i].shader_kd = render_get_shader_attr(
-            flux_default_shader, TextFormat("lights[%i].kd", i));
-        lights[i].shader_ks = render_get_shader_attr(
-            flux_default_shader, TextFormat("lights[%i].ks", i));
-        lights[i].shader_pos = render_get_shader_attr(
-            flux_default_shader, TextFormat("lights[%i].pos", i));
-        lights[i].shader_L = render_get_shader_attr(
-            flux_default_shader, TextFormat("lights[%i].L", i));
-        lights[i].shader_p = render_get_shader_attr(
-            flux_default_shader, TextFormat("lights[%i].p", i));
-        lights[i].shader_intensity = render_get_shader_attr(
-            flux_default_shader, TextFormat("lights[%i].intensity", i));
-        lights[i].shader_light_vp = render_get_shader_attr(
-            flux_default_shader, TextFormat("light_vp[%i]", i));
-
-        lights[i].shader_shadow_map_loc =
-            render_get_shader_attr(flux_default_shader,
-                                   TextFormat("lights[%i].shadowMap", i))
-                .loc;
-
-        lights[i].shadow_map =
-            LoadShadowmapRenderTexture(shadowMapRes, shadowMapRes);
+        for (int s = 0; s < FLUX_N_LIT_SHADERS; s++) {
+            Shader shader = lit_shaders[s];
+            lights[i].shader_enabled[s] = render_get_shader_attr(
+                shader, TextFormat("lights[%i].enabled", i));
+            lights[i].shader_type[s] = render_get_shader_attr(
+                shader, TextFormat("lights[%i].type", i));
+            lights[i].shader_cL[s] =
+                render_get_shader_attr(shader, TextFormat("lights[%i].cL", i));
+            lights[i].shader_kd[s] =
+                render_get_shader_attr(shader, TextFormat("lights[%i].kd", i));
+            lights[i].shader_ks[s] =
+                render_get_shader_attr(shader, TextFormat("lights[%i].ks", i));
+            lights[i].shader_pos[s] =
+                render_get_shader_attr(shader, TextFormat("lights[%i].pos", i));
+            lights[i].shader_L[s] =
+                render_get_shader_attr(shader, TextFormat("lights[%i].L", i));
+            lights[i].shader_p[s] =
+                render_get_shader_attr(shader, TextFormat("lights[%i].p", i));
+            lights[i].shader_intensity[s] = render_get_shader_attr(
+                shader, TextFormat("lights[%i].intensity", i));
+            lights[i].shader_light_vp[s] =
+                render_get_shader_attr(shader, TextFormat("light_vp[%i]", i));
+            lights[i].shader_shadow_rect[s] = render_get_shader_attr(
+                shader, TextFormat("lights[%i].shadowRect", i));
+            lights[i].shader_has_shadow[s] = render_get_shader_attr(
+                shader, TextFormat("lights[%i].hasShadow", i));
+        }
+
+        // shadow map tiles are only handed out once the light is enabled
+        lights[i].shadow_res = FLUX_DEFAULT_SHADOW_RES;
+        lights[i].has_tile = false;
 
         lights[i].scale = 15.0f;
         lights[i].fov = 20.0f;
 
+        lights[i].generation = 0;
+        lights[i].shadow_valid = false;
+        lights[i].visible_casters = 0;
+
         lights[i].enabled = 0;
-        render_set_shader_attr_int(lights[i].shader_enabled, lights[i].enabled);
+        for (int s = 0; s < FLUX_N_LIT_SHADERS; s++)
+            render_set_shader_attr_int(lights[i].shader_enabled[s],
+                                       lights[i].enabled);
     }
 }
 
@@ -190,8 +258,12 @@ static void delete_lights(void) {
     LOG_FUNC_CALL();
     TraceLog(LOG_INFO, "delete_lights");
     for (int i = 0; i < FLUX_MAX_LIGHTS; i++) {
-        UnloadShadowmapRenderTexture(lights[i].shadow_map);
+        lights[i].has_tile = false;
     }
+    if (shadow_atlas_loaded)
+        UnloadShadowmapRenderTexture(shadow_atlas);
+    shadow_atlas_loaded = false;
+    render_atlas_delete(&shadow_atlas_tiles);
 }
 
 /**
@@ -205,14 +277,35 @@ void render_load_default_shader(void) {
     skybox_loaded = 0;
     flux_default_shader = LoadShader("src/renderer/shaders/lights.vs",
                                      "src/renderer/shaders/lights.fs");
-    shader_ka = render_get_shader_attr(flux_default_shader, "ka");
-    shader_cam_pos = render_get_shader_attr(flux_default_shader, "camPos");
-    shader_shadow_map_res =
-        render_get_shader_attr(flux_default_shader, "shadowMapRes");
-    render_set_shader_attr_int(shader_shadow_map_res, shadowMapRes);
+    flux_instanced_shader =
+        LoadShader("src/renderer/shaders/lights_instancing.vs",
+                   "src/renderer/shaders/lights.fs");
+    // DrawMeshInstanced sends the instance transforms through the model
+    // matrix location, so point it at the per-instance attribute
+    flux_instanced_shader.locs[SHADER_LOC_MATRIX_MODEL] =
+        GetShaderLocationAttrib(flux_instanced_shader, "instanceTransform");
+
+    lit_shaders[0] = flux_default_shader;
+    lit_shaders[1] = flux_instanced_shader;
+
+    for (int s = 0; s < FLUX_N_LIT_SHADERS; s++) {
+        shader_ka[s] = render_get_shader_attr(lit_shaders[s], "ka");
+        shader_cam_pos[s] = render_get_shader_attr(lit_shaders[s], "camPos");
+        shader_shadow_map_res[s] =
+            render_get_shader_attr(lit_shaders[s], "shadowMapRes");
+        render_set_shader_attr_int(shader_shadow_map_res[s], shadowMapRes);
+        shader_shadow_atlas_loc[s] =
+            GetShaderLocation(lit_shaders[s], "shadowAtlas");
+    }
 
     flux_empty_shader = LoadShader("src/renderer/shaders/lights.vs",
                                    "src/renderer/shaders/empty_lights.fs");
+    flux_empty_instanced_shader =
+        LoadShader("src/renderer/shaders/lights_instancing.vs",
+                   "src/renderer/shaders/empty_lights.fs");
+    flux_empty_instanced_shader.locs[SHADER_LOC_MATRIX_MODEL] =
+        GetShaderLocationAttrib(flux_empty_instanced_shader,
+                                "instanceTransform");
     init_lights();
 }
 
@@ -290,6 +383,8 @@ void render_unload_default_shader(void) {
     delete_lights();
     UnloadShader(flux_default_shader);
     UnloadShader(flux_empty_shader);
+    UnloadShader(flux_instanced_shader);
+    UnloadShader(flux_empty_instanced_shader);
     render_unload_skybox();
 }
 
@@ -311,6 +406,24 @@ Shader render_get_empty_shader(void) {
     return flux_empty_shader;
 }
 
+/**
+ * @brief Returns the default shader used for instanced draws.
+ * @return The instanced default shader.
+ */
+Shader render_get_instanced_shader(void) {
+    LOG_FUNC_CALL();
+    return flux_instanced_shader;
+}
+
+/**
+ * @brief Returns the empty (shadow pass) shader used for instanced draws.
+ * @return The instanced empty shader.
+ */
+Shader render_get_empty_instanced_shader(void) {
+    LOG_FUNC_CALL();
+    return flux_empty_instanced_shader;
+}
+
 /**
  * @brief Calculates and returns a camera configuration for a light based on its
  * index. This camera is used for shadow mapping.
@@ -328,50 +441,264 @@ Camera3D render_get_light_cam(int i) {
     return lightCam;
 }
 
+/**
+ * @brief Returns the volume a light's shadow map covers: the frustum of its
+ * light camera, without the near plane (casters between the light and the
+ * shadow map volume still throw shadows into it).
+ * @param i Index of the light.
+ * @return The frustum.
+ */
+renderFrustum render_light_get_frustum(int i) {
+    LOG_FUNC_CALL();
+    assert((i >= 0) && (i < FLUX_MAX_LIGHTS));
+    // shadow maps are square, so the aspect ratio is 1
+    renderFrustum frustum =
+        render_frustum_from_camera(render_get_light_cam(i), 1.0f);
+    render_frustum_disable_plane(&frustum, RENDER_FRUSTUM_NEAR);
+    return frustum;
+}
+
+/**
+ * @brief Marks the shadow map of a light as out of date.
+ * @param light Light whose settings changed.
+ */
+static void invalidate_shadow(Light* light) {
+    LOG_FUNC_CALL();
+    light->generation++;
+}
+
+/**
+ * @brief Sends the UV rect of a light's atlas tile to the lit shaders, and
+ * whether it has one at all. Lights without a tile are not shadowed, as
+ * there is no shadow map (or `light_vp`) to sample.
+ * @param light Light to update.
+ */
+static void update_shadow_rect(Light* light) {
+    LOG_FUNC_CALL();
+    int has_shadow = light->has_tile;
+    float rect[4] = {0, 0, 0, 0};
+    if (light->has_tile) {
+        rect[0] = (float)light->shadow_tile.x / (float)shadowMapRes;
+        rect[1] = (float)light->shadow_tile.y / (float)shadowMapRes;
+        rect[2] = (float)light->shadow_tile.size / (float)shadowMapRes;
+        rect[3] = rect[2];
+    }
+    for (int s = 0; s < FLUX_N_LIT_SHADERS; s++) {
+        SetShaderValue(lit_shaders[s], light->shader_shadow_rect[s].loc, rect,
+                       SHADER_UNIFORM_VEC4);
+        SetShaderValue(lit_shaders[s], light->shader_has_shadow[s].loc,
+                       &has_shadow, SHADER_UNIFORM_INT);
+    }
+}
+
+/**
+ * @brief Returns a light's atlas tile to the atlas.
+ * @param light Light to release the tile of.
+ */
+static void release_shadow_tile(Light* light) {
+    LOG_FUNC_CALL();
+    if (!light->has_tile)
+        return;
+    render_atlas_release(&shadow_atlas_tiles, light->shadow_tile);
+    light->has_tile = false;
+    update_shadow_rect(light);
+    invalidate_shadow(light);
+}
+
+/**
+ * @brief Makes sure an enabled light owns an atlas tile, loading the atlas
+ * texture if this is the first one.
+ *
+ * If there is no space for the requested resolution, the largest tile that
+ * fits is used instead.
+ * @param i Index of the light.
+ * @return False if no tile could be allocated at all.
+ */
+static bool acquire_shadow_tile(int i) {
+    LOG_FUNC_CALL();
+    Light* light = &lights[i];
+    if (light->has_tile)
+        return true;
+    if (!shadow_atlas_loaded) {
+        shadow_atlas = LoadShadowmapRenderTexture(shadowMapRes, shadowMapRes);
+        shadow_atlas_loaded = true;
+    }
+    for (int res = light->shadow_res; res >= FLUX_SHADOW_MIN_RES; res /= 2) {
+        if (render_atlas_alloc(&shadow_atlas_tiles, res,
+                               &light->shadow_tile)) {
+            if (res != light->shadow_res)
+                TraceLog(LOG_WARNING,
+                         "shadow atlas full, light %d uses %dx%d instead of "
+                         "%dx%d",
+                         i, res, res, light->shadow_res, light->shadow_res);
+            light->has_tile = true;
+            update_shadow_rect(light);
+            invalidate_shadow(light);
+            return true;
+        }
+    }
+    TraceLog(LOG_WARNING, "shadow atlas full, light %d has no shadows", i);
+    return false;
+}
+
 /**
  * @brief Calculates shadows for all enabled lights.
- * This function updates the shadow maps for each light if it is enabled.
+ *
+ * Every enabled light renders into its own tile of the shadow atlas (tiles are
+ * handed out on enable and given back when the light is disabled; the atlas
+ * texture is unloaded when no light uses it).
+ *
+ * A light's tile is only re-rendered if the light's generation (bumped
+ * by `render_light_set_L()`, `render_light_set_scale()`,
+ * `render_light_set_fov()` and tile changes) or the set of shadow casters
+ * inside its frustum (`render_get_caster_hash()`) changed since it was last
+ * rendered. Otherwise the previous shadow map is reused.
  */
 void render_calculate_shadows(void) {
     LOG_FUNC_CALL();
-    int slot_start = 15 - FLUX_MAX_LIGHTS;
+    shadow_maps_rendered = 0;
+    shadow_maps_cached = 0;
+
+    // give back the tiles of disabled lights first, so enabled ones can use
+    // the space
+    for (int i = 0; i < FLUX_MAX_LIGHTS; i++) {
+        if (!lights[i].enabled)
+            release_shadow_tile(&lights[i]);
+    }
+
     for (int i = 0; i < FLUX_MAX_LIGHTS; i++) {
         if (!lights[i].enabled)
             continue;
+        if (!acquire_shadow_tile(i))
+            continue;
+
+        renderFrustum frustum = render_light_get_frustum(i);
+        unsigned long long caster_hash = render_get_caster_hash(&frustum);
+        if (lights[i].shadow_valid &&
+            (lights[i].shadow_generation == lights[i].generation) &&
+            (lights[i].shadow_caster_hash == caster_hash)) {
+            shadow_maps_cached++;
+            continue;
+        }
+
         Camera3D lightCam = render_get_light_cam(i);
+        renderAtlasTile tile = lights[i].shadow_tile;
 
         Matrix lightView;
         Matrix lightProj;
-        BeginTextureMode(lights[i].shadow_map);
+        BeginTextureMode(shadow_atlas);
+        // only touch this light's tile: clear it with the scissor test and
+        // render into it with the viewport (both in GL coordinates, which
+        // match the tile's texture coordinates)
+        rlViewport(tile.x, tile.y, tile.size, tile.size);
+        rlEnableScissorTest();
+        rlScissor(tile.x, tile.y, tile.size, tile.size);
         ClearBackground(WHITE);
+        rlDisableScissorTest();
         BeginMode3D(lightCam);
         lightView = rlGetMatrixModelview();
         lightProj = rlGetMatrixProjection();
-        render_draw_all_no_shader(lightCam);
+        lights[i].visible_casters = render_draw_all_no_shader(lightCam);
         EndMode3D();
         EndTextureMode();
-        Matrix lightViewProj = MatrixMultiply(lightView, lightProj);
-        SetShaderValueMatrix(flux_default_shader, lights[i].shader_light_vp.loc,
-                             lightViewProj);
-
-        rlEnableShader(flux_default_shader.id);
-        int slot =
-            slot_start +
-            i; // Can be anything 0 to 15, but 0 will probably be taken up
-        rlActiveTextureSlot(slot);
-        rlEnableTexture(lights[i].shadow_map.depth.id);
-        rlSetUniform(lights[i].shader_shadow_map_loc, &slot, SHADER_UNIFORM_INT,
-                     1);
+        lights[i].light_vp = MatrixMultiply(lightView, lightProj);
+        lights[i].shadow_valid = true;
+        lights[i].shadow_generation = lights[i].generation;
+        lights[i].shadow_caster_hash = caster_hash;
+        shadow_maps_rendered++;
+    }
+
+    if (shadow_atlas_loaded && render_atlas_is_empty(&shadow_atlas_tiles)) {
+        UnloadShadowmapRenderTexture(shadow_atlas);
+        shadow_atlas_loaded = false;
+        return;
+    }
+    if (!shadow_atlas_loaded)
+        return;
+
+    int slot = FLUX_SHADOW_ATLAS_SLOT;
+    rlActiveTextureSlot(slot);
+    rlEnableTexture(shadow_atlas.depth.id);
+    for (int s = 0; s < FLUX_N_LIT_SHADERS; s++) {
+        rlEnableShader(lit_shaders[s].id);
+        rlSetUniform(shader_shadow_atlas_loc[s], &slot, SHADER_UNIFORM_INT, 1);
+        for (int i = 0; i < FLUX_MAX_LIGHTS; i++) {
+            if (!lights[i].has_tile)
+                continue;
+            SetShaderValueMatrix(lit_shaders[s],
+                                 lights[i].shader_light_vp[s].loc,
+                                 lights[i].light_vp);
+        }
+    }
+}
+
+/**
+ * @brief Forces every shadow map to be re-rendered on the next
+ * `render_calculate_shadows()`.
+ */
+void render_invalidate_shadows(void) {
+    LOG_FUNC_CALL();
+    for (int i = 0; i < FLUX_MAX_LIGHTS; i++) {
+        invalidate_shadow(&lights[i]);
     }
 }
 
+/**
+ * @brief Returns the fraction of the shadow atlas handed out to lights.
+ * @return Occupancy between 0 and 1.
+ */
+float render_get_shadow_atlas_occupancy(void) {
+    LOG_FUNC_CALL();
+    return render_atlas_occupancy(&shadow_atlas_tiles);
+}
+
+/**
+ * @brief Returns the resolution of the shadow atlas.
+ * @return Width and height of the atlas in texels.
+ */
+int render_get_shadow_atlas_res(void) {
+    LOG_FUNC_CALL();
+    return shadowMapRes;
+}
+
+/**
+ * @brief Checks whether the shadow atlas texture is currently loaded (it is
+ * only loaded while at least one light is enabled).
+ * @return True if the atlas is loaded.
+ */
+bool render_shadow_atlas_is_loaded(void) {
+    LOG_FUNC_CALL();
+    return shadow_atlas_loaded;
+}
+
+/**
+ * @brief Returns how many shadow maps the last `render_calculate_shadows()`
+ * re-rendered.
+ * @return Number of re-rendered shadow maps.
+ */
+int render_get_shadow_maps_rendered(void) {
+    LOG_FUNC_CALL();
+    return shadow_maps_rendered;
+}
+
+/**
+ * @brief Returns how many shadow maps the last `render_calculate_shadows()`
+ * reused from a previous frame.
+ * @return Number of cached shadow maps.
+ */
+int render_get_shadow_maps_cached(void) {
+    LOG_FUNC_CALL();
+    return shadow_maps_cached;
+}
+
 /**
  * @brief Sets the ambient light coefficient in the shader.
  * @param ka Ambient coefficient to set.
  */
 void render_set_ka(float ka) {
     LOG_FUNC_CALL();
-    render_set_shader_attr_float(shader_ka, ka);
+    for (int s = 0; s < FLUX_N_LIT_SHADERS; s++)
+        render_set_shader_attr_float(shader_ka[s], ka);
 }
 
 /**
@@ -380,7 +707,8 @@ void render_set_ka(float ka) {
  */
 void render_set_cam_pos(Vector3 pos) {
     LOG_FUNC_CALL();
-    render_set_shader_attr_vec3(shader_cam_pos, pos);
+    for (int s = 0; s < FLUX_N_LIT_SHADERS; s++)
+        render_set_shader_attr_vec3(shader_cam_pos[s], pos);
 }
 
 /**
@@ -424,7 +752,8 @@ void render_light_set_enabled(int i, int val) {
     LOG_FUNC_CALL();
     Light* light = get_light(i);
     light->enabled = val;
-    render_set_shader_attr_int(light->shader_enabled, light->enabled);
+    for (int s = 0; s < FLUX_N_LIT_SHADERS; s++)
+        render_set_shader_attr_int(light->shader_enabled[s], light->enabled);
 }
 
 /**
@@ -464,7 +793,8 @@ void render_light_set_type(int i, int type) {
     LOG_FUNC_CALL();
     Light* light = get_light(i);
     light->type = type;
-    render_set_shader_attr_int(light->shader_type, light->type);
+    for (int s = 0; s < FLUX_N_LIT_SHADERS; s++)
+        render_set_shader_attr_int(light->shader_type[s], light->type);
 }
 
 /**
@@ -488,7 +818,8 @@ void render_light_set_cL(int i, Color col) {
     light->cL = col;
     Vector3 vec_cL = (Vector3){((float)col.r) / 255.0f, ((float)col.g) / 255.0f,
                                ((float)col.b) / 255.0f};
-    render_set_shader_attr_vec3(light->shader_cL, vec_cL);
+    for (int s = 0; s < FLUX_N_LIT_SHADERS; s++)
+        render_set_shader_attr_vec3(light->shader_cL[s], vec_cL);
 }
 
 /**
@@ -512,7 +843,8 @@ void render_light_set_kd(int i, float kd) {
     LOG_FUNC_CALL();
     Light* light = get_light(i);
     light->kd = kd;
-    render_set_shader_attr_float(light->shader_kd, light->kd);
+    for (int s = 0; s < FLUX_N_LIT_SHADERS; s++)
+        render_set_shader_attr_float(light->shader_kd[s], light->kd);
 }
 
 /**
@@ -536,7 +868,8 @@ void render_light_set_ks(int i, float ks) {
     LOG_FUNC_CALL();
     Light* light = get_light(i);
     light->ks = ks;
-    render_set_shader_attr_float(light->shader_ks, light->ks);
+    for (int s = 0; s < FLUX_N_LIT_SHADERS; s++)
+        render_set_shader_attr_float(light->shader_ks[s], light->ks);
 }
 
 /**
@@ -558,7 +891,8 @@ void render_light_set_pos(int i, Vector3 pos) {
     LOG_FUNC_CALL();
     Light* light = get_light(i);
     light->pos = pos;
-    render_set_shader_attr_vec3(light->shader_pos, light->pos);
+    for (int s = 0; s < FLUX_N_LIT_SHADERS; s++)
+        render_set_shader_attr_vec3(light->shader_pos[s], light->pos);
 }
 
 /**
@@ -580,8 +914,12 @@ Vector3 render_light_get_L(int i) {
 void render_light_set_L(int i, Vector3 L) {
     LOG_FUNC_CALL();
     Light* light = get_light(i);
+    if ((light->L.x != L.x) || (light->L.y != L.y) || (light->L.z != L.z))
+        invalidate_shadow(light);
     light->L = L;
-    render_set_shader_attr_vec3(light->shader_L, Vector3Normalize(light->L));
+    for (int s = 0; s < FLUX_N_LIT_SHADERS; s++)
+        render_set_shader_attr_vec3(light->shader_L[s],
+                                    Vector3Normalize(light->L));
 }
 
 /**
@@ -604,7 +942,8 @@ void render_light_set_p(int i, float p) {
     LOG_FUNC_CALL();
     Light* light = get_light(i);
     light->p = p;
-    render_set_shader_attr_float(light->shader_p, light->p);
+    for (int s = 0; s < FLUX_N_LIT_SHADERS; s++)
+        render_set_shader_attr_float(light->shader_p[s], light->p);
 }
 
 /**
@@ -626,7 +965,9 @@ void render_light_set_intensity(int i, float intensity) {
     LOG_FUNC_CALL();
     Light* light = get_light(i);
     light->intensity = intensity;
-    render_set_shader_attr_float(light->shader_intensity, light->intensity);
+    for (int s = 0; s < FLUX_N_LIT_SHADERS; s++)
+        render_set_shader_attr_float(light->shader_intensity[s],
+                                     light->intensity);
 }
 
 /**
@@ -637,6 +978,8 @@ void render_light_set_intensity(int i, float intensity) {
 void render_light_set_scale(int i, float scale) {
     LOG_FUNC_CALL();
     Light* light = get_light(i);
+    if (light->scale != scale)
+        invalidate_shadow(light);
     light->scale = scale;
 }
 
@@ -649,6 +992,8 @@ void render_light_set_scale(int i, float scale) {
 void render_light_set_fov(int i, float fov) {
     LOG_FUNC_CALL();
     Light* light = get_light(i);
+    if (light->fov != fov)
+        invalidate_shadow(light);
     light->fov = fov;
 }
 
@@ -662,6 +1007,47 @@ float render_light_get_scale(int i) {
     return get_light(i)->scale;
 }
 
+/**
+ * @brief Sets the shadow map resolution of a light.
+ *
+ * The light gets a new atlas tile on the next `render_calculate_shadows()`.
+ * @param i Index of the light to modify.
+ * @param res Resolution, rounded up to a power of two and clamped to the
+ * atlas size.
+ */
+void render_light_set_shadow_res(int i, int res) {
+    LOG_FUNC_CALL();
+    Light* light = get_light(i);
+    int pow2 = FLUX_SHADOW_MIN_RES;
+    while ((pow2 < res) && (pow2 < shadowMapRes))
+        pow2 *= 2;
+    if (light->shadow_res == pow2)
+        return;
+    light->shadow_res = pow2;
+    release_shadow_tile(light);
+}
+
+/**
+ * @brief Retrieves the requested shadow map resolution of a light.
+ * @param i Index of the light.
+ * @return Shadow map resolution.
+ */
+int render_light_get_shadow_res(int i) {
+    LOG_FUNC_CALL();
+    return get_light(i)->shadow_res;
+}
+
+/**
+ * @brief Retrieves the number of mesh instances that were drawn into a
+ * light's shadow map in the last shadow pass (after caster culling).
+ * @param i Index of the light.
+ * @return Number of visible shadow casters.
+ */
+int render_light_get_visible_casters(int i) {
+    LOG_FUNC_CALL();
+    return get_light(i)->visible_casters;
+}
+
 /**
  * @brief Retrieves the field of view of a light based on its index.
  * @param i Index of the light whose field of view is to be retrieved.
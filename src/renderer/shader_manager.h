@@ -4,8 +4,12 @@
 #ifndef _FLUX_RENDERER_SHADER_MANAGER_H_
 #define _FLUX_RENDERER_SHADER_MANAGER_H_
 
+#include "frustum.h"
 #include "raylib.h"
 
+/** Maximum number of lights supported. */
+#define FLUX_MAX_LIGHTS 4
+
 typedef struct renderShaderAttr {
     Shader shader;
     const char* attr;
@@ -19,6 +23,8 @@ void render_unload_default_shader(void);
 
 Shader render_get_default_shader(void);
 Shader render_get_empty_shader(void);
+Shader render_get_instanced_shader(void);
+Shader render_get_empty_instanced_shader(void);
 
 void render_set_ka(float ka);
 
@@ -48,6 +54,18 @@ void render_disable_skybox(void);
 
 void render_calculate_shadows(void);
 
+void render_invalidate_shadows(void);
+
+int render_get_shadow_maps_rendered(void);
+
+float render_get_shadow_atlas_occupancy(void);
+
+int render_get_shadow_atlas_res(void);
+
+bool render_shadow_atlas_is_loaded(void);
+
+int render_get_shadow_maps_cached(void);
+
 void render_load_skybox(const char* path);
 
 void render_unload_skybox();
@@ -96,6 +114,8 @@ void render_light_set_intensity(int i, float intensity);
 
 Camera3D render_get_light_cam(int i);
 
+renderFrustum render_light_get_frustum(int i);
+
 void render_light_set_scale(int i, float scale);
 
 void render_light_set_fov(int i, float fov);
@@ -104,6 +124,12 @@ float render_light_get_scale(int i);
 
 float render_light_get_fov(int i);
 
+int render_light_get_visible_casters(int i);
+
+void render_light_set_shadow_res(int i, int res);
+
+int render_light_get_shadow_res(int i);
+
 /** @} */ // end of group1
 
 #endif
\ No newline at end of file
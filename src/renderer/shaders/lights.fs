@@ -14,7 +14,8 @@ uniform vec4 colDiffuse;
 
 uniform vec3 camPos;
 uniform float ka;
-uniform int shadowMapRes;
+uniform int shadowMapRes; // resolution of the shadow atlas
+uniform sampler2D shadowAtlas;
 
 out vec4 finalColor;
 
@@ -30,7 +31,8 @@ struct Light {
     vec3 L;
     float p;
     float intensity;
-    sampler2D shadowMap;
+    vec4 shadowRect; // xy = offset, zw = size of the light's tile in atlas uv
+    int hasShadow; // 0 if the light got no atlas tile (the atlas was full)
 };
 
 uniform mat4 light_vp[FLUX_MAX_LIGHTS];
@@ -54,6 +56,11 @@ vec3 calculate_light(Light light, mat4 vp, vec3 cM, vec3 N, vec3 V){
     float p = light.p;
     vec3 temp = kd * diffuse(cM,cL,N,L) + ks * specular(cL,N,H,p);
 
+    // no tile, so no shadow map and no valid vp to sample it with
+    if (light.hasShadow == 0){
+        return temp;
+    }
+
     vec4 fragPosLightSpace = vp * vec4(fragPosition, 1);
     fragPosLightSpace.xyz /= fragPosLightSpace.w; // Perform the perspective division
     fragPosLightSpace.xyz = (fragPosLightSpace.xyz + 1.0f) / 2.0f; // Transform from [-1, 1] range to [0, 1] range
@@ -71,12 +78,18 @@ vec3 calculate_light(Light light, mat4 vp, vec3 cM, vec3 N, vec3 V){
     // Instead of testing if just one point is closer to the current point,
     // we test the surrounding points as well.
     // This blurs shadow edges, hiding aliasing artifacts.
+    // samples are clamped to the light's tile so PCF never reads a
+    // neighbouring light's shadow map
     vec2 texelSize = vec2(1.0f / float(shadowMapRes));
+    vec2 tileMin = light.shadowRect.xy + 0.5f * texelSize;
+    vec2 tileMax = light.shadowRect.xy + light.shadowRect.zw - 0.5f * texelSize;
+    vec2 atlasCoords = light.shadowRect.xy + sampleCoords * light.shadowRect.zw;
     for (int x = -sample_factor; x <= sample_factor; x++)
     {
         for (int y = -sample_factor; y <= sample_factor; y++)
         {
-            float sampleDepth = texture(light.shadowMap, sampleCoords + texelSize * vec2(x, y)).r;
+            vec2 coords = clamp(atlasCoords + texelSize * vec2(x, y), tileMin, tileMax);
+            float sampleDepth = texture(shadowAtlas, coords).r;
             if (curDepth - bias > sampleDepth)
             {
                 shadowCounter++;
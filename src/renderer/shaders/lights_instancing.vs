@@ -14,7 +14,6 @@ in mat4 instanceTransform;
 
 // Input uniform values
 uniform mat4 mvp;
-uniform mat4 matNormal;
 
 // Output vertex attributes (to fragment shader)
 out vec3 fragPosition;
@@ -30,11 +29,13 @@ void main()
     mat4 mvpi = mvp*instanceTransform;
 
     // Send vertex attributes to fragment shader
-    fragPosition = vec3(mvpi*vec4(vertexPosition, 1.0));
+    // NOTE: lights.fs works in world space, so use the instance transform
+    // (not mvpi) for the position and the per-instance normal matrix
+    fragPosition = vec3(instanceTransform*vec4(vertexPosition, 1.0));
     fragTexCoord = vertexTexCoord;
-    //fragColor = vertexColor;
-    fragNormal = normalize(vec3(matNormal*vec4(vertexNormal, 1.0)));
+    fragColor = vec4(1.0);
+    fragNormal = normalize(transpose(inverse(mat3(instanceTransform)))*vertexNormal);
 
     // Calculate final vertex position
     gl_Position = mvpi*vec4(vertexPosition, 1.0);
-}
\ No newline at end of file
+}
@@ -0,0 +1,185 @@
+/**
+ * @file shadow_atlas.c
+ * @brief Quadtree tile allocator used to pack the shadow maps of all lights
+ * into a single depth texture.
+ *
+ * Every node of the quadtree is either free, split into four children, or
+ * used by a tile. Allocating a tile of size `atlas_size >> level` splits free
+ * nodes on the way down; releasing a tile merges four free siblings back into
+ * their parent.
+ **/
+
+#include "shadow_atlas.h"
+#include "hqtools/hqtools.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Node states. */
+enum { ATLAS_FREE = 0, ATLAS_SPLIT = 1, ATLAS_USED = 2 };
+
+/**
+ * @brief Returns the index of the node at `(x, y)` on a quadtree level.
+ *
+ * Levels are stored one after the other, level `l` is a `2^l * 2^l` grid
+ * stored row by row.
+ */
+static int node_index(int level, int x, int y) {
+    LOG_FUNC_CALL();
+    int offset = ((1 << (2 * level)) - 1) / 3;
+    return offset + y * (1 << level) + x;
+}
+
+/**
+ * @brief Initializes an empty atlas allocator.
+ * @param atlas Allocator to initialize.
+ * @param size Width and height of the atlas, a power of two.
+ * @param min_tile Smallest tile that can be allocated, a power of two
+ * `<= size`.
+ */
+void render_atlas_init(renderAtlasAllocator* atlas, int size, int min_tile) {
+    LOG_FUNC_CALL();
+    assert(atlas);
+    assert(size > 0);
+    assert((size & (size - 1)) == 0);
+    assert((min_tile > 0) && (min_tile <= size));
+    assert((min_tile & (min_tile - 1)) == 0);
+    atlas->size = size;
+    atlas->min_tile = min_tile;
+    atlas->n_levels = 1;
+    while ((size >> (atlas->n_levels - 1)) > min_tile)
+        atlas->n_levels++;
+    int n_nodes = node_index(atlas->n_levels, 0, 0);
+    assert(atlas->nodes = (unsigned char*)malloc(n_nodes));
+    memset(atlas->nodes, ATLAS_FREE, n_nodes);
+    atlas->used_area = 0;
+}
+
+/**
+ * @brief Frees the bookkeeping of an atlas allocator.
+ * @param atlas Allocator to delete.
+ */
+void render_atlas_delete(renderAtlasAllocator* atlas) {
+    LOG_FUNC_CALL();
+    assert(atlas);
+    assert(atlas->nodes);
+    free(atlas->nodes);
+    atlas->nodes = NULL;
+    atlas->used_area = 0;
+}
+
+/**
+ * @brief Looks for a free node on level `target` below node `(x, y)` of
+ * `level`, splitting free nodes on the way. Partially used (split) subtrees
+ * are tried before free ones, to keep large free areas intact.
+ * @return True if a node was found, in which case it is marked as used.
+ */
+static bool find_node(renderAtlasAllocator* atlas, int level, int x, int y,
+                      int target, renderAtlasTile* out) {
+    LOG_FUNC_CALL();
+    unsigned char* node = &atlas->nodes[node_index(level, x, y)];
+    if (*node == ATLAS_USED)
+        return false;
+    if (level == target) {
+        if (*node != ATLAS_FREE)
+            return false;
+        *node = ATLAS_USED;
+        out->size = atlas->size >> level;
+        out->x = x * out->size;
+        out->y = y * out->size;
+        out->level = level;
+        return true;
+    }
+    for (int pass = 0; pass < 2; pass++) {
+        // pass 0: split children, pass 1: free children
+        unsigned char wanted = pass == 0 ? ATLAS_SPLIT : ATLAS_FREE;
+        for (int child = 0; child < 4; child++) {
+            int cx = 2 * x + (child & 1);
+            int cy = 2 * y + (child >> 1);
+            if (atlas->nodes[node_index(level + 1, cx, cy)] != wanted)
+                continue;
+            if (find_node(atlas, level + 1, cx, cy, target, out)) {
+                *node = ATLAS_SPLIT;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Allocates a square tile.
+ * @param atlas Allocator to allocate from.
+ * @param size Requested tile size, rounded up to a power of two and clamped to
+ * `[min_tile, atlas size]`.
+ * @param out Output, the allocated tile.
+ * @return False if there is no free space for a tile of this size.
+ */
+bool render_atlas_alloc(renderAtlasAllocator* atlas, int size,
+                        renderAtlasTile* out) {
+    LOG_FUNC_CALL();
+    assert(atlas);
+    assert(atlas->nodes);
+    assert(out);
+    int level = atlas->n_levels - 1;
+    while ((level > 0) && ((atlas->size >> level) < size))
+        level--;
+    if (!find_node(atlas, 0, 0, 0, level, out))
+        return false;
+    atlas->used_area += (long long)out->size * (long long)out->size;
+    return true;
+}
+
+/**
+ * @brief Returns a tile to the atlas, merging free siblings.
+ * @param atlas Allocator the tile was allocated from.
+ * @param tile Tile to release.
+ */
+void render_atlas_release(renderAtlasAllocator* atlas, renderAtlasTile tile) {
+    LOG_FUNC_CALL();
+    assert(atlas);
+    assert(atlas->nodes);
+    int level = tile.level;
+    int x = tile.x / tile.size;
+    int y = tile.y / tile.size;
+    assert(atlas->nodes[node_index(level, x, y)] == ATLAS_USED);
+    atlas->nodes[node_index(level, x, y)] = ATLAS_FREE;
+    atlas->used_area -= (long long)tile.size * (long long)tile.size;
+    while (level > 0) {
+        int px = x / 2;
+        int py = y / 2;
+        for (int child = 0; child < 4; child++) {
+            int cx = 2 * px + (child & 1);
+            int cy = 2 * py + (child >> 1);
+            if (atlas->nodes[node_index(level, cx, cy)] != ATLAS_FREE)
+                return;
+        }
+        level--;
+        x = px;
+        y = py;
+        atlas->nodes[node_index(level, x, y)] = ATLAS_FREE;
+    }
+}
+
+/**
+ * @brief Returns the fraction of the atlas currently handed out as tiles.
+ * @param atlas Allocator to query.
+ * @return Occupancy between 0 and 1.
+ */
+float render_atlas_occupancy(const renderAtlasAllocator* atlas) {
+    LOG_FUNC_CALL();
+    assert(atlas);
+    return (float)((double)atlas->used_area /
+                   ((double)atlas->size * (double)atlas->size));
+}
+
+/**
+ * @brief Checks whether no tiles are allocated.
+ * @param atlas Allocator to query.
+ * @return True if the atlas is empty.
+ */
+bool render_atlas_is_empty(const renderAtlasAllocator* atlas) {
+    LOG_FUNC_CALL();
+    assert(atlas);
+    return atlas->used_area == 0;
+}
@@ -0,0 +1,58 @@
+/**
+ * @file shadow_atlas.h
+ **/
+
+#ifndef _FLUX_RENDERER_SHADOW_ATLAS_H_
+#define _FLUX_RENDERER_SHADOW_ATLAS_H_
+
+#include <stdbool.h>
+
+/**
+ * @struct renderAtlasTile
+ * @brief A square tile handed out by a `renderAtlasAllocator`.
+ *
+ * @var int x Left edge of the tile in texels.
+ * @var int y Bottom edge of the tile in texels.
+ * @var int size Width and height of the tile in texels.
+ * @var int level Quadtree level of the tile (0 is the whole atlas).
+ */
+typedef struct renderAtlasTile {
+    int x;
+    int y;
+    int size;
+    int level;
+} renderAtlasTile;
+
+/**
+ * @struct renderAtlasAllocator
+ * @brief Quadtree (buddy) allocator for square power of two tiles of a square
+ * atlas. Pure CPU bookkeeping, the texture itself is owned by the caller.
+ *
+ * @var int size Width and height of the atlas in texels.
+ * @var int min_tile Smallest tile size that can be allocated.
+ * @var int n_levels Number of quadtree levels.
+ * @var unsigned char* nodes State of every quadtree node, level by level.
+ * @var long long used_area Texels currently handed out.
+ */
+typedef struct renderAtlasAllocator {
+    int size;
+    int min_tile;
+    int n_levels;
+    unsigned char* nodes;
+    long long used_area;
+} renderAtlasAllocator;
+
+void render_atlas_init(renderAtlasAllocator* atlas, int size, int min_tile);
+
+void render_atlas_delete(renderAtlasAllocator* atlas);
+
+bool render_atlas_alloc(renderAtlasAllocator* atlas, int size,
+                        renderAtlasTile* out);
+
+void render_atlas_release(renderAtlasAllocator* atlas, renderAtlasTile tile);
+
+float render_atlas_occupancy(const renderAtlasAllocator* atlas);
+
+bool render_atlas_is_empty(const renderAtlasAllocator* atlas);
+
+#endif
@@ -0,0 +1,704 @@
+/**
+ * @file simplify.c
+ * @brief Triangle mesh simplification with quadric error metrics (Garland and
+ * Heckbert), used to generate levels of detail. This module only does CPU
+ * work (no GL calls), so it can run on any thread and be tested without a
+ * window.
+ *
+ * Vertices with the same position are welded, so attribute seams (UV or
+ * normal splits) do not stop simplification. Each welded vertex accumulates
+ * the quadrics of the planes of its triangles, and edges are collapsed onto
+ * one of their two vertices in order of increasing error, in passes. A
+ * collapse is rejected if it would flip a triangle, and vertices on open
+ * borders never move, so holes and outlines are kept.
+ *
+ * Vertices are never created or moved: the output is an index buffer into the
+ * input vertices. Corners that survive keep their original vertex (and its
+ * attributes); corners that moved point to the first input vertex at the new
+ * position. `render_simplify_mesh()` wraps this for raylib meshes.
+ **/
+
+#include "simplify.h"
+#include "hqtools/hqtools.h"
+#include "mesh_optimizer.h"
+#include "pipeline.h"
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @struct simplifyQuadric
+ * @brief Symmetric 4x4 matrix `sum(w * p * p^T)` over planes
+ * `p = (a, b, c, d)` weighted by triangle area `w`, upper triangle only, and
+ * the sum of the weights.
+ */
+typedef struct simplifyQuadric {
+    double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+    double w;
+} simplifyQuadric;
+
+/**
+ * @struct simplifyCollapse
+ * @brief A candidate edge collapse: `from` moves onto `to`.
+ */
+typedef struct simplifyCollapse {
+    int from;
+    int to;
+    double error;
+} simplifyCollapse;
+
+/**
+ * @brief Adds the quadric of the plane `(a, b, c, d)` with weight `w` to `q`.
+ */
+static void quadric_add_plane(simplifyQuadric* q, double a, double b, double c,
+                              double d, double w) {
+    LOG_FUNC_CALL();
+    q->a2 += w * a * a;
+    q->ab += w * a * b;
+    q->ac += w * a * c;
+    q->ad += w * a * d;
+    q->b2 += w * b * b;
+    q->bc += w * b * c;
+    q->bd += w * b * d;
+    q->c2 += w * c * c;
+    q->cd += w * c * d;
+    q->d2 += w * d * d;
+    q->w += w;
+}
+
+/**
+ * @brief Adds quadric `b` to `a`.
+ */
+static void quadric_add(simplifyQuadric* a, const simplifyQuadric* b) {
+    LOG_FUNC_CALL();
+    a->a2 += b->a2;
+    a->ab += b->ab;
+    a->ac += b->ac;
+    a->ad += b->ad;
+    a->b2 += b->b2;
+    a->bc += b->bc;
+    a->bd += b->bd;
+    a->c2 += b->c2;
+    a->cd += b->cd;
+    a->d2 += b->d2;
+    a->w += b->w;
+}
+
+/**
+ * @brief Evaluates the sum of two quadrics at a point: the mean squared
+ * distance of the point to their planes, weighted by area.
+ */
+static double quadric_error(const simplifyQuadric* q0,
+                            const simplifyQuadric* q1, const float* p) {
+    LOG_FUNC_CALL();
+    double x = p[0];
+    double y = p[1];
+    double z = p[2];
+    double a2 = q0->a2 + q1->a2, ab = q0->ab + q1->ab, ac = q0->ac + q1->ac;
+    double ad = q0->ad + q1->ad, b2 = q0->b2 + q1->b2, bc = q0->bc + q1->bc;
+    double bd = q0->bd + q1->bd, c2 = q0->c2 + q1->c2, cd = q0->cd + q1->cd;
+    double d2 = q0->d2 + q1->d2;
+    double e = a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x +
+               b2 * y * y + 2 * bc * y * z + 2 * bd * y + c2 * z * z +
+               2 * cd * z + d2;
+    double w = q0->w + q1->w;
+    if ((e <= 0) || (w <= 0))
+        return 0;
+    return e / w;
+}
+
+/**
+ * @brief Hashes the bits of a vertex position.
+ */
+static unsigned int hash_position(const float* p) {
+    LOG_FUNC_CALL();
+    unsigned int bits[3];
+    memcpy(bits, p, sizeof(bits));
+    unsigned int h = bits[0] * 73856093u;
+    h ^= bits[1] * 19349663u;
+    h ^= bits[2] * 83492791u;
+    return h ^ (h >> 16);
+}
+
+/**
+ * @brief Maps every vertex to the first vertex with the same position.
+ * @param positions 3 floats per vertex.
+ * @param n_vertices Number of vertices.
+ * @param weld Output, `n_vertices` welded vertex ids.
+ */
+static void weld_positions(const float* positions, int n_vertices,
+                           int* weld) {
+    LOG_FUNC_CALL();
+    int size = 1;
+    while (size < n_vertices * 2)
+        size *= 2;
+    int* table;
+    assert(table = (int*)malloc(sizeof(int) * size));
+    for (int i = 0; i < size; i++) {
+        table[i] = -1;
+    }
+    for (int v = 0; v < n_vertices; v++) {
+        const float* p = positions + v * 3;
+        unsigned int slot = hash_position(p) & (size - 1);
+        while (true) {
+            int other = table[slot];
+            if (other < 0) {
+                table[slot] = v;
+                weld[v] = v;
+                break;
+            }
+            if (memcmp(positions + other * 3, p, sizeof(float) * 3) == 0) {
+                weld[v] = other;
+                break;
+            }
+            slot = (slot + 1) & (size - 1);
+        }
+    }
+    free(table);
+}
+
+/**
+ * @brief Marks the vertices of edges used by only one triangle.
+ * @param tris Welded indices, 3 per triangle.
+ * @param n_indices Number of indices.
+ * @param n_vertices Number of vertices.
+ * @param locked Set to true for border vertices.
+ */
+static void lock_borders(const int* tris, int n_indices, int n_vertices,
+                         bool* locked) {
+    LOG_FUNC_CALL();
+    // edge hash table: keys are (min, max) vertex pairs, values use counts
+    int size = 1;
+    while (size < n_indices * 2)
+        size *= 2;
+    long long* keys;
+    int* counts;
+    assert(keys = (long long*)malloc(sizeof(long long) * size));
+    assert(counts = (int*)malloc(sizeof(int) * size));
+    for (int i = 0; i < size; i++) {
+        keys[i] = -1;
+        counts[i] = 0;
+    }
+    for (int i = 0; i < n_indices; i++) {
+        int a = tris[i];
+        int b = tris[(i % 3 == 2) ? i - 2 : i + 1];
+        long long lo = a < b ? a : b;
+        long long hi = a < b ? b : a;
+        long long key = lo * n_vertices + hi;
+        unsigned int slot =
+            (unsigned int)((key * 0x9E3779B97F4A7C15ULL) >> 32) & (size - 1);
+        while ((keys[slot] != -1) && (keys[slot] != key))
+            slot = (slot + 1) & (size - 1);
+        keys[slot] = key;
+        counts[slot]++;
+    }
+    for (int i = 0; i < size; i++) {
+        if ((keys[i] != -1) && (counts[i] == 1)) {
+            locked[keys[i] / n_vertices] = true;
+            locked[keys[i] % n_vertices] = true;
+        }
+    }
+    free(counts);
+    free(keys);
+}
+
+/**
+ * @brief Computes the (unnormalized) normal of a triangle.
+ */
+static void triangle_normal(const float* p0, const float* p1, const float* p2,
+                            double* n) {
+    LOG_FUNC_CALL();
+    double e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+    double e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+    n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+/**
+ * @brief Checks that moving `from` onto `to` does not flip or collapse any
+ * triangle around `from` (other than the ones that disappear).
+ */
+static bool collapse_is_valid(const float* positions, const int* tris,
+                              const int* adjacency, const int* offsets,
+                              int from, int to) {
+    LOG_FUNC_CALL();
+    for (int j = offsets[from]; j < offsets[from + 1]; j++) {
+        const int* t = tris + adjacency[j] * 3;
+        if ((t[0] == to) || (t[1] == to) || (t[2] == to))
+            continue;
+        double before[3];
+        double after[3];
+        const float* p[3];
+        const float* q[3];
+        for (int k = 0; k < 3; k++) {
+            p[k] = positions + t[k] * 3;
+            q[k] = positions + (t[k] == from ? to : t[k]) * 3;
+        }
+        triangle_normal(p[0], p[1], p[2], before);
+        triangle_normal(q[0], q[1], q[2], after);
+        double dot = before[0] * after[0] + before[1] * after[1] +
+                     before[2] * after[2];
+        double len2 = (before[0] * before[0] + before[1] * before[1] +
+                       before[2] * before[2]) *
+                      (after[0] * after[0] + after[1] * after[1] +
+                       after[2] * after[2]);
+        // reject flips and normals turning by more than ~75 degrees
+        if ((dot <= 0) || (dot * dot < 0.0625 * len2))
+            return false;
+    }
+    return true;
+}
+
+/** Number of buckets of `sort_collapses()`. */
+#define SIMPLIFY_SORT_BUCKETS 2048
+
+/**
+ * @brief Returns the sort bucket of an error: the top 11 bits of the error as
+ * a float (errors are positive, so their bits sort like their values).
+ */
+static unsigned int collapse_bucket(double error) {
+    LOG_FUNC_CALL();
+    float e = (float)error;
+    unsigned int bits;
+    memcpy(&bits, &e, sizeof(bits));
+    return bits >> 21;
+}
+
+/**
+ * @brief Sorts collapses by error with one counting sort pass over the top
+ * bits of the errors. Errors within ~12% of each other may stay out of order,
+ * which does not matter for greedy collapsing and is much cheaper than a
+ * comparison sort.
+ * @param collapses Collapses to sort.
+ * @param n Number of collapses.
+ * @param out Output, the sorted collapses.
+ */
+static void sort_collapses(const simplifyCollapse* collapses, int n,
+                           simplifyCollapse* out) {
+    LOG_FUNC_CALL();
+    int offsets[SIMPLIFY_SORT_BUCKETS];
+    memset(offsets, 0, sizeof(offsets));
+    for (int i = 0; i < n; i++) {
+        offsets[collapse_bucket(collapses[i].error)]++;
+    }
+    int total = 0;
+    for (int b = 0; b < SIMPLIFY_SORT_BUCKETS; b++) {
+        int count = offsets[b];
+        offsets[b] = total;
+        total += count;
+    }
+    for (int i = 0; i < n; i++) {
+        out[offsets[collapse_bucket(collapses[i].error)]++] = collapses[i];
+    }
+}
+
+/**
+ * @brief Simplifies an indexed triangle mesh.
+ *
+ * Edges are collapsed until the mesh has at most `target_indices` indices, or
+ * until the next collapse would move the surface by more than `target_error`
+ * (relative to the size of the mesh).
+ * @param positions Vertex positions, 3 floats per vertex.
+ * @param n_vertices Number of vertices.
+ * @param indices 3 indices per triangle, or NULL if every 3 consecutive
+ * vertices form a triangle.
+ * @param n_indices Number of indices (or vertices if `indices` is NULL).
+ * @param target_indices Number of indices to stop at.
+ * @param target_error Largest error allowed, as a fraction of the largest
+ * extent of the mesh's bounding box (e.g. 0.01 for 1%).
+ * @param out Output indices into `positions`, at most `n_indices`.
+ * @param out_error If not NULL, set to the largest error of a collapse that
+ * was made, relative like `target_error`.
+ * @return Number of indices written to `out`.
+ */
+int render_simplify(const float* positions, int n_vertices,
+                    const unsigned int* indices, int n_indices,
+                    int target_indices, float target_error,
+                    unsigned int* out, float* out_error) {
+    LOG_FUNC_CALL();
+    assert(positions);
+    assert(out);
+    assert(n_indices % 3 == 0);
+    if (out_error)
+        *out_error = 0.0f;
+    if (n_indices == 0)
+        return 0;
+
+    // extent of the mesh, to make errors relative
+    float lo[3] = {positions[0], positions[1], positions[2]};
+    float hi[3] = {positions[0], positions[1], positions[2]};
+    for (int v = 0; v < n_vertices; v++) {
+        for (int k = 0; k < 3; k++) {
+            float x = positions[v * 3 + k];
+            lo[k] = x < lo[k] ? x : lo[k];
+            hi[k] = x > hi[k] ? x : hi[k];
+        }
+    }
+    double extent = 0;
+    for (int k = 0; k < 3; k++) {
+        if (hi[k] - lo[k] > extent)
+            extent = hi[k] - lo[k];
+    }
+    if (extent <= 0)
+        extent = 1;
+    double max_error = (double)target_error * extent;
+    double max_cost = max_error * max_error;
+
+    int* weld;
+    int* tris;
+    bool* locked;
+    bool* touched;
+    simplifyQuadric* quadrics;
+    int* offsets;
+    int* adjacency;
+    simplifyCollapse* collapses;
+    simplifyCollapse* sorted;
+    assert(weld = (int*)malloc(sizeof(int) * n_vertices));
+    assert(tris = (int*)malloc(sizeof(int) * n_indices));
+    assert(locked = (bool*)malloc(sizeof(bool) * n_vertices));
+    assert(touched = (bool*)malloc(sizeof(bool) * n_vertices));
+    assert(quadrics =
+               (simplifyQuadric*)malloc(sizeof(simplifyQuadric) * n_vertices));
+    assert(offsets = (int*)malloc(sizeof(int) * (n_vertices + 1)));
+    assert(adjacency = (int*)malloc(sizeof(int) * n_indices));
+    assert(collapses = (simplifyCollapse*)malloc(sizeof(simplifyCollapse) *
+                                                 n_indices));
+    assert(sorted = (simplifyCollapse*)malloc(sizeof(simplifyCollapse) *
+                                              n_indices));
+
+    weld_positions(positions, n_vertices, weld);
+    for (int i = 0; i < n_indices; i++) {
+        int v = indices ? (int)indices[i] : i;
+        assert((v >= 0) && (v < n_vertices));
+        out[i] = (unsigned int)v;
+        tris[i] = weld[v];
+    }
+    memset(locked, 0, sizeof(bool) * n_vertices);
+    lock_borders(tris, n_indices, n_vertices, locked);
+
+    memset(quadrics, 0, sizeof(simplifyQuadric) * n_vertices);
+    for (int t = 0; t < n_indices / 3; t++) {
+        const int* tri = tris + t * 3;
+        double n[3];
+        triangle_normal(positions + tri[0] * 3, positions + tri[1] * 3,
+                        positions + tri[2] * 3, n);
+        double len = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (len == 0)
+            continue;
+        n[0] /= len;
+        n[1] /= len;
+        n[2] /= len;
+        const float* p = positions + tri[0] * 3;
+        double d = -(n[0] * p[0] + n[1] * p[1] + n[2] * p[2]);
+        for (int k = 0; k < 3; k++) {
+            quadric_add_plane(&quadrics[tri[k]], n[0], n[1], n[2], d,
+                              len * 0.5);
+        }
+    }
+
+    double worst = 0;
+    int n_out = n_indices;
+    while (n_out > target_indices) {
+        int n_tris = n_out / 3;
+
+        // vertex -> triangle adjacency
+        memset(offsets, 0, sizeof(int) * (n_vertices + 1));
+        for (int i = 0; i < n_out; i++) {
+            offsets[tris[i] + 1]++;
+        }
+        for (int v = 0; v < n_vertices; v++) {
+            offsets[v + 1] += offsets[v];
+        }
+        for (int i = 0; i < n_out; i++) {
+            adjacency[offsets[tris[i]]++] = i / 3;
+        }
+        for (int v = n_vertices; v > 0; v--) {
+            offsets[v] = offsets[v - 1];
+        }
+        offsets[0] = 0;
+
+        // cheapest direction of every edge (each interior edge appears twice,
+        // once per triangle, only the a < b copy is kept)
+        int n_collapses = 0;
+        for (int i = 0; i < n_out; i++) {
+            int a = tris[i];
+            int b = tris[(i % 3 == 2) ? i - 2 : i + 1];
+            if ((a > b) || (a == b))
+                continue;
+            if (locked[a] && locked[b])
+                continue;
+            double e_ab = locked[a] ? INFINITY
+                                    : quadric_error(&quadrics[a], &quadrics[b],
+                                                    positions + b * 3);
+            double e_ba = locked[b] ? INFINITY
+                                    : quadric_error(&quadrics[a], &quadrics[b],
+                                                    positions + a * 3);
+            simplifyCollapse c;
+            c.from = e_ab <= e_ba ? a : b;
+            c.to = e_ab <= e_ba ? b : a;
+            c.error = e_ab <= e_ba ? e_ab : e_ba;
+            if (c.error > max_cost)
+                continue;
+            collapses[n_collapses++] = c;
+        }
+        if (n_collapses == 0)
+            break;
+        sort_collapses(collapses, n_collapses, sorted);
+
+        // each collapse removes about two triangles, only make half of the
+        // collapses still needed so that the rest see the updated quadrics
+        int budget = (n_tris - target_indices / 3 + 1) / 4;
+        if (budget < 1)
+            budget = 1;
+        memset(touched, 0, sizeof(bool) * n_vertices);
+        int n_done = 0;
+        for (int c = 0; (c < n_collapses) && (n_done < budget); c++) {
+            int from = sorted[c].from;
+            int to = sorted[c].to;
+            if (touched[from] || touched[to])
+                continue;
+            if (!collapse_is_valid(positions, tris, adjacency, offsets, from,
+                                   to))
+                continue;
+            // the one ring of `from` changes, so none of it may collapse again
+            // in this pass
+            for (int j = offsets[from]; j < offsets[from + 1]; j++) {
+                const int* t = tris + adjacency[j] * 3;
+                touched[t[0]] = true;
+                touched[t[1]] = true;
+                touched[t[2]] = true;
+            }
+            weld[from] = to;
+            quadric_add(&quadrics[to], &quadrics[from]);
+            if (sorted[c].error > worst)
+                worst = sorted[c].error;
+            n_done++;
+        }
+        if (n_done == 0)
+            break;
+
+        // move the corners of collapsed vertices and drop degenerate
+        // triangles
+        int n_kept = 0;
+        for (int t = 0; t < n_tris; t++) {
+            int w[3];
+            unsigned int o[3];
+            for (int k = 0; k < 3; k++) {
+                int v = tris[t * 3 + k];
+                w[k] = weld[v] != v ? weld[v] : v;
+                o[k] = w[k] != v ? (unsigned int)w[k] : out[t * 3 + k];
+            }
+            if ((w[0] == w[1]) || (w[1] == w[2]) || (w[2] == w[0]))
+                continue;
+            for (int k = 0; k < 3; k++) {
+                tris[n_kept * 3 + k] = w[k];
+                out[n_kept * 3 + k] = o[k];
+            }
+            n_kept++;
+        }
+        // collapsed vertices are gone, point them at themselves again so the
+        // next pass does not follow them
+        for (int t = 0; t < n_kept * 3; t++) {
+            weld[tris[t]] = tris[t];
+        }
+        n_out = n_kept * 3;
+    }
+
+    if (out_error)
+        *out_error = (float)(sqrt(worst) / extent);
+
+    free(sorted);
+    free(collapses);
+    free(adjacency);
+    free(offsets);
+    free(quadrics);
+    free(touched);
+    free(locked);
+    free(tris);
+    free(weld);
+    return n_out;
+}
+
+/**
+ * @brief Copies the attributes of vertex `from` of `src` into vertex `to` of
+ * `dst`. `dst` has the same attribute arrays as `src`.
+ */
+static void copy_vertex(const Mesh* src, int from, Mesh* dst, int to) {
+    LOG_FUNC_CALL();
+    memcpy(dst->vertices + to * 3, src->vertices + from * 3, sizeof(float) * 3);
+    if (src->texcoords)
+        memcpy(dst->texcoords + to * 2, src->texcoords + from * 2,
+               sizeof(float) * 2);
+    if (src->texcoords2)
+        memcpy(dst->texcoords2 + to * 2, src->texcoords2 + from * 2,
+               sizeof(float) * 2);
+    if (src->normals)
+        memcpy(dst->normals + to * 3, src->normals + from * 3,
+               sizeof(float) * 3);
+    if (src->tangents)
+        memcpy(dst->tangents + to * 4, src->tangents + from * 4,
+               sizeof(float) * 4);
+    if (src->colors)
+        memcpy(dst->colors + to * 4, src->colors + from * 4,
+               sizeof(unsigned char) * 4);
+}
+
+/**
+ * @brief Allocates the attribute arrays of `dst` that `src` has, for `n`
+ * vertices. Arrays are allocated with `RL_CALLOC`, so that `UnloadMesh()` can
+ * free them.
+ */
+static void alloc_vertices(const Mesh* src, Mesh* dst, int n) {
+    LOG_FUNC_CALL();
+    dst->vertexCount = n;
+    assert(dst->vertices = (float*)RL_CALLOC(n * 3, sizeof(float)));
+    if (src->texcoords)
+        assert(dst->texcoords = (float*)RL_CALLOC(n * 2, sizeof(float)));
+    if (src->texcoords2)
+        assert(dst->texcoords2 = (float*)RL_CALLOC(n * 2, sizeof(float)));
+    if (src->normals)
+        assert(dst->normals = (float*)RL_CALLOC(n * 3, sizeof(float)));
+    if (src->tangents)
+        assert(dst->tangents = (float*)RL_CALLOC(n * 4, sizeof(float)));
+    if (src->colors)
+        assert(dst->colors =
+                   (unsigned char*)RL_CALLOC(n * 4, sizeof(unsigned char)));
+}
+
+/**
+ * @brief Makes a simplified copy of a mesh, for use as a level of detail.
+ *
+ * Only the vertices still used are kept, in the order they are first used,
+ * and triangles are reordered for the vertex cache. The copy is indexed if it
+ * has at most 65535 vertices (raylib indices are 16 bit), and unindexed
+ * otherwise.
+ * The copy is not uploaded to the GPU (see `UploadMesh()`), and is freed with
+ * `UnloadMesh()`.
+ * @param mesh Mesh to simplify, with CPU side vertices. Skinning data is not
+ * copied, so animated meshes should not be simplified.
+ * @param target_triangles Number of triangles to stop at.
+ * @param target_error Largest error allowed, relative to the size of the mesh
+ * (see `render_simplify()`).
+ * @param out_error If not NULL, set to the error of the copy.
+ * @return The simplified mesh, with `triangleCount` 0 if `mesh` has no
+ * vertices.
+ */
+Mesh render_simplify_mesh(Mesh mesh, int target_triangles, float target_error,
+                          float* out_error) {
+    LOG_FUNC_CALL();
+    Mesh out = {0};
+    if (out_error)
+        *out_error = 0.0f;
+    if ((mesh.vertices == NULL) || (mesh.triangleCount == 0))
+        return out;
+
+    int n_indices = mesh.triangleCount * 3;
+    unsigned int* indices = NULL;
+    unsigned int* simplified;
+    if (mesh.indices) {
+        assert(indices =
+                   (unsigned int*)malloc(sizeof(unsigned int) * n_indices));
+        for (int i = 0; i < n_indices; i++) {
+            indices[i] = mesh.indices[i];
+        }
+    }
+    assert(simplified =
+               (unsigned int*)malloc(sizeof(unsigned int) * n_indices));
+    int n_out = render_simplify(mesh.vertices, mesh.vertexCount, indices,
+                                n_indices, target_triangles * 3, target_error,
+                                simplified, out_error);
+    render_optimize_vertex_cache(simplified, n_out, mesh.vertexCount);
+
+    int* remap;
+    assert(remap = (int*)malloc(sizeof(int) * mesh.vertexCount));
+    for (int v = 0; v < mesh.vertexCount; v++) {
+        remap[v] = -1;
+    }
+    int n_used = 0;
+    for (int i = 0; i < n_out; i++) {
+        if (remap[simplified[i]] < 0)
+            remap[simplified[i]] = n_used++;
+    }
+
+    out.triangleCount = n_out / 3;
+    if (n_used <= 65535) {
+        alloc_vertices(&mesh, &out, n_used);
+        for (int v = 0; v < mesh.vertexCount; v++) {
+            if (remap[v] >= 0)
+                copy_vertex(&mesh, v, &out, remap[v]);
+        }
+        assert(out.indices = (unsigned short*)RL_CALLOC(
+                   n_out, sizeof(unsigned short)));
+        for (int i = 0; i < n_out; i++) {
+            out.indices[i] = (unsigned short)remap[simplified[i]];
+        }
+    } else {
+        alloc_vertices(&mesh, &out, n_out);
+        for (int i = 0; i < n_out; i++) {
+            copy_vertex(&mesh, simplified[i], &out, i);
+        }
+    }
+
+    free(remap);
+    free(simplified);
+    if (indices)
+        free(indices);
+    return out;
+}
+
+/**
+ * @brief Frees a mesh from `render_simplify_mesh()` that was not uploaded.
+ * Unlike `UnloadMesh()`, this makes no GL calls, so it can run on any thread.
+ * @param mesh The mesh.
+ */
+void render_free_simplified_mesh(Mesh mesh) {
+    LOG_FUNC_CALL();
+    assert(mesh.vboId == NULL);
+    // the arrays come from raylib's allocator
+    MemFree(mesh.vertices);
+    MemFree(mesh.texcoords);
+    MemFree(mesh.texcoords2);
+    MemFree(mesh.normals);
+    MemFree(mesh.tangents);
+    MemFree(mesh.colors);
+    MemFree(mesh.indices);
+}
+
+/**
+ * @brief Simplifies the levels of detail of a mesh for a render model.
+ *
+ * Level `l` targets `1 / 2^l` of the triangles of the mesh. Meshes with fewer
+ * than `RENDER_LOD_MIN_TRIANGLES` triangles, without CPU side vertices, or
+ * with skinning data are not simplified, and levels stop as soon as the
+ * simplifier cannot remove at least a fifth of the previous level (e.g. flat
+ * or open meshes it is not allowed to change). The levels are not uploaded,
+ * so this can run on any thread.
+ * @param mesh Mesh to simplify.
+ * @param lods Set to up to `RENDER_MAX_LODS - 1` simplified meshes, level 1
+ * first, to free with `UnloadMesh()` (or upload).
+ * @return Number of levels of the mesh, including the mesh itself.
+ */
+int render_simplify_lods(Mesh mesh, Mesh* lods) {
+    LOG_FUNC_CALL();
+    assert(lods);
+    if ((mesh.triangleCount < RENDER_LOD_MIN_TRIANGLES) ||
+        (mesh.vertices == NULL) || mesh.boneIds || mesh.animVertices)
+        return 1;
+    int n_lods = 1;
+    int previous = mesh.triangleCount;
+    for (int l = 1; l < RENDER_MAX_LODS; l++) {
+        Mesh lod = render_simplify_mesh(mesh, mesh.triangleCount >> l,
+                                        RENDER_LOD_MAX_ERROR, NULL);
+        if ((lod.triangleCount == 0) ||
+            (lod.triangleCount * 5 > previous * 4)) {
+            render_free_simplified_mesh(lod);
+            break;
+        }
+        lods[n_lods++ - 1] = lod;
+        previous = lod.triangleCount;
+    }
+    return n_lods;
+}
@@ -0,0 +1,28 @@
+/**
+ * @file simplify.h
+ **/
+
+#ifndef _FLUX_RENDERER_SIMPLIFY_H_
+#define _FLUX_RENDERER_SIMPLIFY_H_
+
+#include "raylib.h"
+
+/** @addtogroup group1 Renderer API
+ *  @{
+ */
+
+int render_simplify(const float* positions, int n_vertices,
+                    const unsigned int* indices, int n_indices,
+                    int target_indices, float target_error,
+                    unsigned int* out, float* out_error);
+
+Mesh render_simplify_mesh(Mesh mesh, int target_triangles, float target_error,
+                          float* out_error);
+
+void render_free_simplified_mesh(Mesh mesh);
+
+int render_simplify_lods(Mesh mesh, Mesh* lods);
+
+/** @} */ // end of group1
+
+#endif
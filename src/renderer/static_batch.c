@@ -0,0 +1,350 @@
+/**
+ * @file static_batch.c
+ * @brief Merges many instances of a static model into a few large meshes
+ * with pre-transformed vertices, so they can be culled and drawn with a
+ * handful of draw calls instead of one per instance and mesh.
+ *
+ * Instances are grouped into cubic chunks of a grid by the center of their
+ * bounds. Within a chunk, every mesh that uses the same material is appended
+ * to the same output mesh, which is split whenever it would go over
+ * `RENDER_STATIC_BATCH_MAX_VERTICES`. This module only does CPU work (the
+ * meshes are not uploaded), so it can be tested without a window.
+ **/
+
+#include "static_batch.h"
+#include "hqtools/hqtools.h"
+#include "raymath.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef MAX_MATERIAL_MAPS
+/** Number of maps of a raylib material (see raylib's config.h). */
+#define MAX_MATERIAL_MAPS 12
+#endif
+
+/**
+ * @struct staticBatchCell
+ * @brief The grid cell of an instance.
+ *
+ * @var int x Cell along x.
+ * @var int y Cell along y.
+ * @var int z Cell along z.
+ * @var int instance Index of the instance.
+ */
+typedef struct staticBatchCell {
+    int x;
+    int y;
+    int z;
+    int instance;
+} staticBatchCell;
+
+/**
+ * @struct staticBatchPart
+ * @brief A mesh of an instance, appended to a chunk.
+ *
+ * @var int instance Index of the instance.
+ * @var int mesh Index of the mesh in the model.
+ */
+typedef struct staticBatchPart {
+    int instance;
+    int mesh;
+} staticBatchPart;
+
+/**
+ * @brief Compares two cells (then instances), for `qsort()`.
+ */
+static int compare_cells(const void* a, const void* b) {
+    LOG_FUNC_CALL();
+    const staticBatchCell* ca = (const staticBatchCell*)a;
+    const staticBatchCell* cb = (const staticBatchCell*)b;
+    if (ca->x != cb->x)
+        return (ca->x > cb->x) - (ca->x < cb->x);
+    if (ca->y != cb->y)
+        return (ca->y > cb->y) - (ca->y < cb->y);
+    if (ca->z != cb->z)
+        return (ca->z > cb->z) - (ca->z < cb->z);
+    return (ca->instance > cb->instance) - (ca->instance < cb->instance);
+}
+
+/**
+ * @brief Checks that a model can be merged into a static batch: it has CPU
+ * side vertices and no skinning data.
+ * @param model Model to check.
+ * @return `true` if `render_build_static_batch()` can merge the model.
+ */
+bool render_static_batch_supported(Model model) {
+    LOG_FUNC_CALL();
+    if ((model.meshCount == 0) || (model.boneCount > 0))
+        return false;
+    for (int i = 0; i < model.meshCount; i++) {
+        Mesh mesh = model.meshes[i];
+        if ((mesh.vertices == NULL) || mesh.boneIds || mesh.animVertices)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Writes one output mesh from a list of instance meshes.
+ * @param model Model the meshes belong to.
+ * @param transforms Transforms of the instances.
+ * @param parts Meshes to append, in order.
+ * @param n_parts Number of meshes.
+ * @return The merged mesh (not uploaded).
+ */
+static Mesh build_chunk(Model model, const Matrix* transforms,
+                        const staticBatchPart* parts, int n_parts) {
+    LOG_FUNC_CALL();
+    Mesh out = {0};
+    bool texcoords = false;
+    bool texcoords2 = false;
+    bool normals = false;
+    bool tangents = false;
+    bool colors = false;
+    for (int p = 0; p < n_parts; p++) {
+        Mesh mesh = model.meshes[parts[p].mesh];
+        out.vertexCount += mesh.vertexCount;
+        out.triangleCount += mesh.triangleCount;
+        texcoords = texcoords || mesh.texcoords;
+        texcoords2 = texcoords2 || mesh.texcoords2;
+        normals = normals || mesh.normals;
+        tangents = tangents || mesh.tangents;
+        colors = colors || mesh.colors;
+    }
+    int n = out.vertexCount;
+    // only a single unindexed mesh can go over the limit, it stays unindexed
+    bool indexed = n <= RENDER_STATIC_BATCH_MAX_VERTICES;
+    assert(indexed || (n_parts == 1));
+    assert(out.vertices = (float*)RL_CALLOC(n * 3, sizeof(float)));
+    if (texcoords)
+        assert(out.texcoords = (float*)RL_CALLOC(n * 2, sizeof(float)));
+    if (texcoords2)
+        assert(out.texcoords2 = (float*)RL_CALLOC(n * 2, sizeof(float)));
+    if (normals)
+        assert(out.normals = (float*)RL_CALLOC(n * 3, sizeof(float)));
+    if (tangents)
+        assert(out.tangents = (float*)RL_CALLOC(n * 4, sizeof(float)));
+    if (colors)
+        assert(out.colors =
+                   (unsigned char*)RL_CALLOC(n * 4, sizeof(unsigned char)));
+    if (indexed)
+        assert(out.indices = (unsigned short*)RL_CALLOC(
+                   out.triangleCount * 3, sizeof(unsigned short)));
+
+    int base = 0;
+    int n_indices = 0;
+    for (int p = 0; p < n_parts; p++) {
+        Mesh mesh = model.meshes[parts[p].mesh];
+        Matrix transform = transforms[parts[p].instance];
+        Matrix normal_matrix = MatrixTranspose(MatrixInvert(transform));
+        for (int v = 0; v < mesh.vertexCount; v++) {
+            int o = base + v;
+            const float* src = mesh.vertices + v * 3;
+            Vector3 pos = Vector3Transform((Vector3){src[0], src[1], src[2]},
+                                           transform);
+            out.vertices[o * 3] = pos.x;
+            out.vertices[o * 3 + 1] = pos.y;
+            out.vertices[o * 3 + 2] = pos.z;
+            if (mesh.texcoords)
+                memcpy(out.texcoords + o * 2, mesh.texcoords + v * 2,
+                       sizeof(float) * 2);
+            if (mesh.texcoords2)
+                memcpy(out.texcoords2 + o * 2, mesh.texcoords2 + v * 2,
+                       sizeof(float) * 2);
+            if (mesh.colors)
+                memcpy(out.colors + o * 4, mesh.colors + v * 4,
+                       sizeof(unsigned char) * 4);
+            if (mesh.normals) {
+                const float* n = mesh.normals + v * 3;
+                Vector3 normal = Vector3Normalize(Vector3Transform(
+                    (Vector3){n[0], n[1], n[2]}, normal_matrix));
+                out.normals[o * 3] = normal.x;
+                out.normals[o * 3 + 1] = normal.y;
+                out.normals[o * 3 + 2] = normal.z;
+            }
+            if (mesh.tangents) {
+                const float* t = mesh.tangents + v * 4;
+                Vector3 tangent = {
+                    transform.m0 * t[0] + transform.m4 * t[1] +
+                        transform.m8 * t[2],
+                    transform.m1 * t[0] + transform.m5 * t[1] +
+                        transform.m9 * t[2],
+                    transform.m2 * t[0] + transform.m6 * t[1] +
+                        transform.m10 * t[2]};
+                tangent = Vector3Normalize(tangent);
+                out.tangents[o * 4] = tangent.x;
+                out.tangents[o * 4 + 1] = tangent.y;
+                out.tangents[o * 4 + 2] = tangent.z;
+                out.tangents[o * 4 + 3] = t[3];
+            }
+        }
+        if (indexed) {
+            for (int i = 0; i < mesh.triangleCount * 3; i++) {
+                int index = mesh.indices ? mesh.indices[i] : i;
+                out.indices[n_indices++] = (unsigned short)(base + index);
+            }
+        }
+        base += mesh.vertexCount;
+    }
+    return out;
+}
+
+/**
+ * @struct staticBatchMeshes
+ * @brief Growable list of the output meshes and their materials.
+ *
+ * @var Mesh* meshes The meshes.
+ * @var int* materials Material index of each mesh.
+ * @var int n Number of meshes.
+ * @var int capacity Allocated size of the arrays.
+ */
+typedef struct staticBatchMeshes {
+    Mesh* meshes;
+    int* materials;
+    int n;
+    int capacity;
+} staticBatchMeshes;
+
+/**
+ * @brief Appends a mesh to the list of output meshes.
+ */
+static void push_mesh(staticBatchMeshes* list, Mesh mesh, int material) {
+    LOG_FUNC_CALL();
+    if (list->capacity == 0) {
+        list->capacity = 16;
+        assert(list->meshes = (Mesh*)malloc(sizeof(Mesh) * list->capacity));
+        assert(list->materials = (int*)malloc(sizeof(int) * list->capacity));
+    } else if (list->n == list->capacity) {
+        list->capacity *= 2;
+        assert(list->meshes = (Mesh*)realloc(list->meshes,
+                                             sizeof(Mesh) * list->capacity));
+        assert(list->materials = (int*)realloc(
+                   list->materials, sizeof(int) * list->capacity));
+    }
+    list->meshes[list->n] = mesh;
+    list->materials[list->n] = material;
+    list->n++;
+}
+
+/**
+ * @brief Merges instances of a model into a static batch.
+ *
+ * The result is a new model with the materials of `model` (sharing their
+ * shaders and textures) and an identity transform. Each of its meshes holds
+ * the instance meshes of one material in one cube of `chunk_size` of the
+ * grid, with world space vertices, so it is drawn as a single instance and
+ * culled chunk by chunk. The meshes are not uploaded (see `UploadMesh()`),
+ * and the model is freed with `UnloadModel()`.
+ * @param model Model to merge (see `render_static_batch_supported()`).
+ * @param transforms World matrix of every instance, including the model's own
+ * transform (see `render_model_get_transform()`).
+ * @param n_transforms Number of instances.
+ * @param chunk_size Size of the cells of the grid.
+ * @return The merged model.
+ */
+Model render_build_static_batch(Model model, const Matrix* transforms,
+                                int n_transforms, float chunk_size) {
+    LOG_FUNC_CALL();
+    assert(transforms || (n_transforms == 0));
+    assert(chunk_size > 0);
+    assert(render_static_batch_supported(model));
+
+    Model out = {0};
+    out.transform = MatrixIdentity();
+    out.materialCount = model.materialCount;
+    assert(out.materials =
+               (Material*)RL_CALLOC(model.materialCount, sizeof(Material)));
+    for (int i = 0; i < model.materialCount; i++) {
+        out.materials[i] = model.materials[i];
+        assert(out.materials[i].maps = (MaterialMap*)RL_CALLOC(
+                   MAX_MATERIAL_MAPS, sizeof(MaterialMap)));
+        memcpy(out.materials[i].maps, model.materials[i].maps,
+               sizeof(MaterialMap) * MAX_MATERIAL_MAPS);
+    }
+
+    // model space center of the model, placed in the grid for each instance
+    Vector3 min = {INFINITY, INFINITY, INFINITY};
+    Vector3 max = {-INFINITY, -INFINITY, -INFINITY};
+    for (int i = 0; i < model.meshCount; i++) {
+        Mesh mesh = model.meshes[i];
+        for (int v = 0; v < mesh.vertexCount; v++) {
+            Vector3 p = {mesh.vertices[v * 3], mesh.vertices[v * 3 + 1],
+                         mesh.vertices[v * 3 + 2]};
+            min = Vector3Min(min, p);
+            max = Vector3Max(max, p);
+        }
+    }
+    Vector3 center = Vector3Scale(Vector3Add(min, max), 0.5f);
+
+    staticBatchCell* cells;
+    staticBatchPart* parts;
+    assert(cells = (staticBatchCell*)malloc(sizeof(staticBatchCell) *
+                                            (n_transforms + 1)));
+    assert(parts = (staticBatchPart*)malloc(
+               sizeof(staticBatchPart) * (n_transforms * model.meshCount + 1)));
+    for (int k = 0; k < n_transforms; k++) {
+        Vector3 c = Vector3Transform(center, transforms[k]);
+        cells[k].x = (int)floorf(c.x / chunk_size);
+        cells[k].y = (int)floorf(c.y / chunk_size);
+        cells[k].z = (int)floorf(c.z / chunk_size);
+        cells[k].instance = k;
+    }
+    qsort(cells, n_transforms, sizeof(staticBatchCell), compare_cells);
+
+    staticBatchMeshes list = {0};
+    int start = 0;
+    while (start < n_transforms) {
+        int end = start + 1;
+        while ((end < n_transforms) &&
+               (cells[end].x == cells[start].x) &&
+               (cells[end].y == cells[start].y) &&
+               (cells[end].z == cells[start].z))
+            end++;
+        for (int m = 0; m < model.materialCount; m++) {
+            int n_parts = 0;
+            int n_vertices = 0;
+            for (int c = start; c < end; c++) {
+                for (int i = 0; i < model.meshCount; i++) {
+                    if (model.meshMaterial[i] != m)
+                        continue;
+                    int count = model.meshes[i].vertexCount;
+                    if ((n_parts > 0) &&
+                        (n_vertices + count >
+                         RENDER_STATIC_BATCH_MAX_VERTICES)) {
+                        push_mesh(&list,
+                                  build_chunk(model, transforms, parts,
+                                              n_parts),
+                                  m);
+                        n_parts = 0;
+                        n_vertices = 0;
+                    }
+                    parts[n_parts].instance = cells[c].instance;
+                    parts[n_parts].mesh = i;
+                    n_parts++;
+                    n_vertices += count;
+                }
+            }
+            if (n_parts > 0)
+                push_mesh(&list,
+                          build_chunk(model, transforms, parts, n_parts), m);
+        }
+        start = end;
+    }
+
+    // the model is freed by raylib, so its arrays come from RL_CALLOC
+    out.meshCount = list.n;
+    if (list.n > 0) {
+        assert(out.meshes = (Mesh*)RL_CALLOC(list.n, sizeof(Mesh)));
+        assert(out.meshMaterial = (int*)RL_CALLOC(list.n, sizeof(int)));
+        memcpy(out.meshes, list.meshes, sizeof(Mesh) * list.n);
+        memcpy(out.meshMaterial, list.materials, sizeof(int) * list.n);
+        free(list.meshes);
+        free(list.materials);
+    }
+
+    free(parts);
+    free(cells);
+    return out;
+}
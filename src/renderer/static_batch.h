@@ -0,0 +1,26 @@
+/**
+ * @file static_batch.h
+ **/
+
+#ifndef _FLUX_RENDERER_STATIC_BATCH_H_
+#define _FLUX_RENDERER_STATIC_BATCH_H_
+
+#include "raylib.h"
+#include <stdbool.h>
+
+/** @addtogroup group1 Renderer API
+ *  @{
+ */
+
+/** Most vertices in one chunk of a static batch (raylib indices are 16 bit).
+ */
+#define RENDER_STATIC_BATCH_MAX_VERTICES 65535
+
+bool render_static_batch_supported(Model model);
+
+Model render_build_static_batch(Model model, const Matrix* transforms,
+                                int n_transforms, float chunk_size);
+
+/** @} */ // end of group1
+
+#endif